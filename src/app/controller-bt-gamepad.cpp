@@ -6,32 +6,15 @@
 #include <XboxGamepadConfiguration.h>
 
 #include "app/controller.h"
+#include "app/latency.h"
+#include "app/output.h"
+#include "app/report.h"
+#include "app/telemetry.h"
+#include "app/trace.h"
 
 // Maximum simultaneous notes
 static constexpr int MAX_SIMULTANEOUS_NOTES = 5;
 
-// Gamepad action type constants
-static constexpr int ACTION_BUTTON = 1;
-static constexpr int ACTION_DPAD = 2;
-static constexpr int ACTION_L_TRIGGER = 3;
-static constexpr int ACTION_R_TRIGGER = 4;
-static constexpr int ACTION_L_STICK = 5;
-static constexpr int ACTION_R_STICK = 6;
-
-// Direction constants (common for stick and DPAD)
-static constexpr int DIRECTION_LEFT = 1;
-static constexpr int DIRECTION_RIGHT = 2;
-static constexpr int DIRECTION_UP = 3;
-static constexpr int DIRECTION_DOWN = 4;
-
-// Mapping entry structure
-struct MappingEntry
-{
-    int type;
-    // ACTION_NONE, ACTION_BUTTON, ACTION_DPAD, ACTION_L_TRIGGER, ACTION_R_TRIGGER, ACTION_L_STICK, ACTION_R_STICK
-    int value;
-};
-
 // Mapping 1
 const MappingEntry mapping1[15] = {
     {ACTION_L_TRIGGER, 1023}, // LT
@@ -85,6 +68,9 @@ static XboxGamepadDevice* gamepad;
 // Filter to prevent old notes from reappearing
 static Notes15Filter noteFilter;
 
+// Gamepad state builder for the current mapping and conflict policy
+static ReportBuilder reportBuilder;
+
 static void applyMIDIToGamepad(const Notes15& notes15, const int mapping)
 {
     // Get mapping
@@ -92,106 +78,78 @@ static void applyMIDIToGamepad(const Notes15& notes15, const int mapping)
 
     // Limit to latest notes for gamepad
     const Notes15 latestNotes15 = noteFilter.latest(notes15, MAX_SIMULTANEOUS_NOTES);
+    markLatency(LatencyStage::FILTER);
+    const uint16_t keptKeys = getPressedKeys(latestNotes15);
+    traceFilter(getPressedKeys(notes15), keptKeys);
 
     gamepad->resetInputs();
 
-    // Variables for accumulating stick input
-    int16_t leftThumbX = 0, leftThumbY = 0;
-    int16_t rightThumbX = 0, rightThumbY = 0;
-
-    // DPad state
-    bool dpadPressed[4] = {false}; // NORTH, SOUTH, EAST, WEST
+    const ConflictPolicy conflict = getOutputConflict();
+    if (!reportBuilder.isCompiled(currentMapping, conflict)) {
+        reportBuilder.compile(currentMapping, conflict);
+    }
+    const GamepadState state = reportBuilder.build(latestNotes15);
 
+    // Buttons
     for (int i = 0; i < 15; i++) {
-        if (latestNotes15.get(i) != 0) {
-            const MappingEntry& mappingEntry = currentMapping[i];
-            switch (mappingEntry.type) {
-            case ACTION_BUTTON:
-                gamepad->press(mappingEntry.value);
-                break;
-            case ACTION_DPAD:
-                // Record DPad state
-                if (mappingEntry.value == DIRECTION_UP) dpadPressed[0] = true;
-                else if (mappingEntry.value == DIRECTION_DOWN) dpadPressed[1] = true;
-                else if (mappingEntry.value == DIRECTION_RIGHT) dpadPressed[2] = true;
-                else if (mappingEntry.value == DIRECTION_LEFT) dpadPressed[3] = true;
-                break;
-            case ACTION_L_TRIGGER:
-                gamepad->setLeftTrigger(mappingEntry.value);
-                break;
-            case ACTION_R_TRIGGER:
-                gamepad->setRightTrigger(mappingEntry.value);
-                break;
-            case ACTION_L_STICK:
-                if (mappingEntry.value == DIRECTION_LEFT) {
-                    leftThumbX = -32768; // L-Stick ←
-                } else if (mappingEntry.value == DIRECTION_RIGHT) {
-                    leftThumbX = 32767; // L-Stick →
-                } else if (mappingEntry.value == DIRECTION_UP) {
-                    leftThumbY = 32767; // L-Stick ↑
-                } else if (mappingEntry.value == DIRECTION_DOWN) {
-                    leftThumbY = -32768; // L-Stick ↓
-                }
-                break;
-            case ACTION_R_STICK:
-                if (mappingEntry.value == DIRECTION_LEFT) {
-                    rightThumbX = -32768; // R-Stick ←
-                } else if (mappingEntry.value == DIRECTION_RIGHT) {
-                    rightThumbX = 32767; // R-Stick →
-                } else if (mappingEntry.value == DIRECTION_UP) {
-                    rightThumbY = 32767; // R-Stick ↑
-                } else if (mappingEntry.value == DIRECTION_DOWN) {
-                    rightThumbY = -32768; // R-Stick ↓
-                }
-                break;
-            default:
-                break;
-            }
+        if (state.buttonKeys & (1 << i)) {
+            gamepad->press(currentMapping[i].value);
         }
     }
 
+    // Triggers
+    if (state.leftTrigger != 0) {
+        gamepad->setLeftTrigger(state.leftTrigger);
+    }
+    if (state.rightTrigger != 0) {
+        gamepad->setRightTrigger(state.rightTrigger);
+    }
+
     // Set DPad direction (diagonal directions supported)
-    const bool north = dpadPressed[0];
-    const bool south = dpadPressed[1];
-    const bool east = dpadPressed[2];
-    const bool west = dpadPressed[3];
-
-    if (north && east) {
-        gamepad->pressDPadDirection(XBOX_BUTTON_DPAD_NORTHEAST);
-    } else if (north && west) {
-        gamepad->pressDPadDirection(XBOX_BUTTON_DPAD_NORTHWEST);
-    } else if (south && east) {
-        gamepad->pressDPadDirection(XBOX_BUTTON_DPAD_SOUTHEAST);
-    } else if (south && west) {
-        gamepad->pressDPadDirection(XBOX_BUTTON_DPAD_SOUTHWEST);
-    } else if (north) {
-        gamepad->pressDPadDirection(XBOX_BUTTON_DPAD_NORTH);
-    } else if (south) {
-        gamepad->pressDPadDirection(XBOX_BUTTON_DPAD_SOUTH);
-    } else if (east) {
-        gamepad->pressDPadDirection(XBOX_BUTTON_DPAD_EAST);
-    } else if (west) {
-        gamepad->pressDPadDirection(XBOX_BUTTON_DPAD_WEST);
+    const uint8_t DPAD_DIRECTIONS[] = {
+        XBOX_BUTTON_DPAD_NONE,
+        XBOX_BUTTON_DPAD_NORTH,
+        XBOX_BUTTON_DPAD_NORTHEAST,
+        XBOX_BUTTON_DPAD_EAST,
+        XBOX_BUTTON_DPAD_SOUTHEAST,
+        XBOX_BUTTON_DPAD_SOUTH,
+        XBOX_BUTTON_DPAD_SOUTHWEST,
+        XBOX_BUTTON_DPAD_WEST,
+        XBOX_BUTTON_DPAD_NORTHWEST,
+    };
+    const DpadDirection direction = getDpadDirection(state);
+    if (direction != DpadDirection::CENTERED) {
+        gamepad->pressDPadDirection(DPAD_DIRECTIONS[static_cast<int>(direction)]);
     }
 
     // Set stick input
-    gamepad->setLeftThumb(leftThumbX, leftThumbY);
-    gamepad->setRightThumb(rightThumbX, rightThumbY);
+    gamepad->setLeftThumb(scaleStick(state.leftX, -32768, 0, 32767), scaleStick(state.leftY, -32768, 0, 32767));
+    gamepad->setRightThumb(scaleStick(state.rightX, -32768, 0, 32767), scaleStick(state.rightY, -32768, 0, 32767));
 
     gamepad->sendGamepadReport();
+    markLatency(LatencyStage::REPORT);
+    recordTrace(TraceType::REPORT, static_cast<uint8_t>(mapping), keptKeys);
+    countTelemetry(Counter::REPORTS);
 }
 
 void updateController(const Notes15& notes15, const int mapping)
+{
+    // Check BLE connection status
+    if (bleHID->isConnected()) {
+        applyMIDIToGamepad(notes15, mapping);
+    } else {
+        recordTrace(TraceType::DROPPED, 0, getPressedKeys(notes15));
+    }
+}
+
+void drawController()
 {
     M5.Display.setCursor(0, 0);
     M5.Display.setTextColor(TFT_BLUE, TFT_BLACK);
     M5.Display.println("Bluetooth Gamepad");
 
-    // Check BLE connection status
     if (bleHID->isConnected()) {
         M5.Display.println("Connected       ");
-
-        applyMIDIToGamepad(notes15, mapping);
     } else {
         M5.Display.println("                ");
     }
@@ -5,6 +5,12 @@
 #include <USBHIDGamepad.h>
 
 #include "app/controller.h"
+#include "app/latency.h"
+#include "app/output.h"
+#include "app/report.h"
+#include "app/telemetry.h"
+#include "app/trace.h"
+#include "app/usb-ready.h"
 
 #define GAMEPAD_VID 0x046D    // Logitech
 #define GAMEPAD_PID 0xc216    // Logitech F310 Gamepad
@@ -12,20 +18,6 @@
 // Maximum simultaneous notes
 static constexpr int MAX_SIMULTANEOUS_NOTES = 5;
 
-// Gamepad action type constants
-static constexpr int ACTION_BUTTON = 1;
-static constexpr int ACTION_DPAD = 2;
-static constexpr int ACTION_L_TRIGGER = 3;
-static constexpr int ACTION_R_TRIGGER = 4;
-static constexpr int ACTION_L_STICK = 5;
-static constexpr int ACTION_R_STICK = 6;
-
-// Direction constants (common for stick and DPAD)
-static constexpr int DIRECTION_LEFT = 1;
-static constexpr int DIRECTION_RIGHT = 2;
-static constexpr int DIRECTION_UP = 3;
-static constexpr int DIRECTION_DOWN = 4;
-
 // Button constants
 static constexpr int D_BUTTON_X = 1;
 static constexpr int D_BUTTON_A = 2;
@@ -36,13 +28,6 @@ static constexpr int D_BUTTON_R = 6;
 static constexpr int D_BUTTON_ZL = 7;
 static constexpr int D_BUTTON_ZR = 8;
 
-// Mapping entry structure
-struct MappingEntry
-{
-    int type;
-    int value;
-};
-
 // Mapping 1
 const MappingEntry mapping1[15] = {
     {ACTION_L_TRIGGER, 255}, // ZL
@@ -93,6 +78,9 @@ static USBHIDGamepad gamepad;
 // Filter to prevent old notes from reappearing
 static Notes15Filter noteFilter;
 
+// Gamepad state builder for the current mapping and conflict policy
+static ReportBuilder reportBuilder;
+
 static void applyMIDIToUSBGamepad(const Notes15& notes15, const int mapping)
 {
     // Get mapping
@@ -100,107 +88,80 @@ static void applyMIDIToUSBGamepad(const Notes15& notes15, const int mapping)
 
     // Limit to latest notes for gamepad
     const Notes15 latestNotes15 = noteFilter.latest(notes15, MAX_SIMULTANEOUS_NOTES);
+    markLatency(LatencyStage::FILTER);
+    const uint16_t keptKeys = getPressedKeys(latestNotes15);
+    traceFilter(getPressedKeys(notes15), keptKeys);
 
-    // Variables for accumulating stick input (-127 to 127 range for USB HID)
-    int8_t leftThumbX = 0, leftThumbY = 0;
-    int8_t rightThumbX = 0, rightThumbY = 0;
-
-    // DPad state
-    bool dpadPressed[4] = {false}; // UP, DOWN, RIGHT, LEFT
+    const ConflictPolicy conflict = getOutputConflict();
+    if (!reportBuilder.isCompiled(currentMapping, conflict)) {
+        reportBuilder.compile(currentMapping, conflict);
+    }
+    const GamepadState state = reportBuilder.build(latestNotes15);
 
     // Button state
     uint32_t buttons = 0;
-
-    // Process 15-pitch array
     for (int i = 0; i < 15; i++) {
-        if (latestNotes15.get(i) != 0) {
-            const MappingEntry& mappingEntry = currentMapping[i];
-            switch (mappingEntry.type) {
-            case ACTION_BUTTON:
-                buttons |= (1UL << (mappingEntry.value - 1));
-                break;
-            case ACTION_DPAD:
-                // Record DPad state
-                if (mappingEntry.value == DIRECTION_UP) dpadPressed[0] = true;
-                else if (mappingEntry.value == DIRECTION_DOWN) dpadPressed[1] = true;
-                else if (mappingEntry.value == DIRECTION_RIGHT) dpadPressed[2] = true;
-                else if (mappingEntry.value == DIRECTION_LEFT) dpadPressed[3] = true;
-                break;
-            case ACTION_L_TRIGGER:
-                // In USB HID, treat triggers as buttons
-                buttons |= (1UL << (D_BUTTON_ZL - 1));
-                break;
-            case ACTION_R_TRIGGER:
-                // In USB HID, treat triggers as buttons
-                buttons |= (1UL << (D_BUTTON_ZR - 1));
-                break;
-            case ACTION_L_STICK:
-                if (mappingEntry.value == DIRECTION_LEFT) {
-                    leftThumbX = -127; // L-Stick ←
-                } else if (mappingEntry.value == DIRECTION_RIGHT) {
-                    leftThumbX = 127; // L-Stick →
-                } else if (mappingEntry.value == DIRECTION_UP) {
-                    leftThumbY = 127; // L-Stick ↑
-                } else if (mappingEntry.value == DIRECTION_DOWN) {
-                    leftThumbY = -127; // L-Stick ↓
-                }
-                break;
-            case ACTION_R_STICK:
-                if (mappingEntry.value == DIRECTION_LEFT) {
-                    rightThumbX = -127; // R-Stick ←
-                } else if (mappingEntry.value == DIRECTION_RIGHT) {
-                    rightThumbX = 127; // R-Stick →
-                } else if (mappingEntry.value == DIRECTION_UP) {
-                    rightThumbY = 127; // R-Stick ↑
-                } else if (mappingEntry.value == DIRECTION_DOWN) {
-                    rightThumbY = -127; // R-Stick ↓
-                }
-                break;
-            default:
-                break;
-            }
+        if (state.buttonKeys & (1 << i)) {
+            buttons |= (1UL << (currentMapping[i].value - 1));
         }
     }
 
-    // Set DPad direction
-    uint8_t hat = GAMEPAD_HAT_CENTERED;
-    const bool north = dpadPressed[0];
-    const bool south = dpadPressed[1];
-    const bool east = dpadPressed[2];
-    const bool west = dpadPressed[3];
-
-    if (north && east) {
-        hat = GAMEPAD_HAT_UP_RIGHT;
-    } else if (north && west) {
-        hat = GAMEPAD_HAT_UP_LEFT;
-    } else if (south && east) {
-        hat = GAMEPAD_HAT_DOWN_RIGHT;
-    } else if (south && west) {
-        hat = GAMEPAD_HAT_DOWN_LEFT;
-    } else if (north) {
-        hat = GAMEPAD_HAT_UP;
-    } else if (south) {
-        hat = GAMEPAD_HAT_DOWN;
-    } else if (east) {
-        hat = GAMEPAD_HAT_RIGHT;
-    } else if (west) {
-        hat = GAMEPAD_HAT_LEFT;
+    // In USB HID, treat triggers as buttons
+    if (state.leftTrigger != 0) {
+        buttons |= (1UL << (D_BUTTON_ZL - 1));
+    }
+    if (state.rightTrigger != 0) {
+        buttons |= (1UL << (D_BUTTON_ZR - 1));
     }
 
+    // Set DPad direction
+    const uint8_t HATS[] = {
+        GAMEPAD_HAT_CENTERED,
+        GAMEPAD_HAT_UP,
+        GAMEPAD_HAT_UP_RIGHT,
+        GAMEPAD_HAT_RIGHT,
+        GAMEPAD_HAT_DOWN_RIGHT,
+        GAMEPAD_HAT_DOWN,
+        GAMEPAD_HAT_DOWN_LEFT,
+        GAMEPAD_HAT_LEFT,
+        GAMEPAD_HAT_UP_LEFT,
+    };
+    const uint8_t hat = HATS[static_cast<int>(getDpadDirection(state))];
+
+    // Stick input (-127 to 127 range for USB HID)
+    const int8_t leftThumbX = scaleStick(state.leftX, -127, 0, 127);
+    const int8_t leftThumbY = scaleStick(state.leftY, -127, 0, 127);
+    const int8_t rightThumbX = scaleStick(state.rightX, -127, 0, 127);
+    const int8_t rightThumbY = scaleStick(state.rightY, -127, 0, 127);
+
     // Send input (x, y, rx, ry, z, rz, hat, buttons)
     gamepad.send(leftThumbX, leftThumbY, rightThumbX, rightThumbY, 0, 0, hat, buttons);
+    markLatency(LatencyStage::REPORT);
+    recordTrace(TraceType::REPORT, static_cast<uint8_t>(mapping), keptKeys);
+    countTelemetry(Counter::REPORTS);
 }
 
 void updateController(const Notes15& notes15, const int mapping)
 {
-    M5.Display.setCursor(0, 0);
-    M5.Display.setTextColor(TFT_GREEN, TFT_BLACK);
-    M5.Display.println("USB Gamepad   ");
+    // Hold reports until the host has configured the device
+    if (!isUSBReady()) {
+        countTelemetry(Counter::REPORTS_DROPPED);
+        recordTrace(TraceType::DROPPED, 0, getPressedKeys(notes15));
+        return;
+    }
 
     // MIDI to gamepad processing
     applyMIDIToUSBGamepad(notes15, mapping);
 }
 
+void drawController()
+{
+    M5.Display.setCursor(0, 0);
+    M5.Display.setTextColor(TFT_GREEN, TFT_BLACK);
+    M5.Display.println("USB Gamepad   ");
+    drawUSBStatus();
+}
+
 void setupController(const char* deviceName, const char* deviceManufacturer)
 {
     USB.VID(GAMEPAD_VID);
@@ -209,8 +170,8 @@ void setupController(const char* deviceName, const char* deviceManufacturer)
     USB.manufacturerName(deviceManufacturer);
 
     gamepad.begin();
+    setupUSBReady();
     USB.begin();
-    delay(3000);
 }
 
 #endif // defined(CONTROLLER_USB_GAMEPAD)
@@ -5,6 +5,11 @@
 #include <USBHIDKeyboard.h>
 
 #include "app/controller.h"
+#include "app/latency.h"
+#include "app/report.h"
+#include "app/telemetry.h"
+#include "app/trace.h"
+#include "app/usb-ready.h"
 
 // Maximum simultaneous notes
 static constexpr int MAX_SIMULTANEOUS_NOTES = 5;
@@ -56,21 +61,29 @@ static void applyMIDIToUSBKeyboard(const Notes15& notes15, const int mapping)
 
     // Limit to latest keys for USB keyboard
     const Notes15 latestNotes15 = noteFilter.latest(notes15, MAX_SIMULTANEOUS_NOTES);
-
-    // Process 15-pitch array
+    markLatency(LatencyStage::FILTER);
+
+    // Send key events only for keys whose state changes
+    const uint16_t currentKeys = getPressedKeys(latestNotes15);
+    traceFilter(getPressedKeys(notes15), currentKeys);
+    const uint16_t prevKeys = getPressedKeys(prevNotes15);
+    const uint16_t pressedKeys = currentKeys & ~prevKeys;
+    const uint16_t releasedKeys = prevKeys & ~currentKeys;
     for (int i = 0; i < 15; i++) {
-        const bool currentState = latestNotes15.get(i) != 0;
-        const bool prevState = prevNotes15.get(i) != 0;
-
-        // Send key event only when state changes
-        if (currentState && !prevState) {
+        if (pressedKeys & (1 << i)) {
             // Key pressed
             keyboard.press(currentMapping[i].key);
-        } else if (!currentState && prevState) {
+        } else if (releasedKeys & (1 << i)) {
             // Key released
             keyboard.release(currentMapping[i].key);
         }
     }
+    const bool sent = (pressedKeys | releasedKeys) != 0;
+    if (sent) {
+        markLatency(LatencyStage::REPORT);
+        recordTrace(TraceType::REPORT, static_cast<uint8_t>(mapping), currentKeys);
+        countTelemetry(Counter::REPORTS);
+    }
 
     // Update previous state
     prevNotes15 = notes15;
@@ -78,14 +91,25 @@ static void applyMIDIToUSBKeyboard(const Notes15& notes15, const int mapping)
 
 void updateController(const Notes15& notes15, const int mapping)
 {
-    M5.Display.setCursor(0, 0);
-    M5.Display.setTextColor(TFT_CYAN, TFT_BLACK);
-    M5.Display.println("USB Keyboard");
+    // Hold reports until the host has configured the device
+    if (!isUSBReady()) {
+        countTelemetry(Counter::REPORTS_DROPPED);
+        recordTrace(TraceType::DROPPED, 0, getPressedKeys(notes15));
+        return;
+    }
 
     // MIDI to keyboard processing
     applyMIDIToUSBKeyboard(notes15, mapping);
 }
 
+void drawController()
+{
+    M5.Display.setCursor(0, 0);
+    M5.Display.setTextColor(TFT_CYAN, TFT_BLACK);
+    M5.Display.println("USB Keyboard");
+    drawUSBStatus();
+}
+
 void setupController(const char* deviceName, const char* deviceManufacturer)
 {
     USB.productName(deviceName);
@@ -93,8 +117,8 @@ void setupController(const char* deviceName, const char* deviceManufacturer)
 
     // Initialize USB keyboard
     keyboard.begin();
+    setupUSBReady();
     USB.begin();
-    delay(3000);
 }
 
 #endif // defined(CONTROLLER_USB_KEYBOARD)
@@ -4,31 +4,16 @@
 #include <switch_ESP32.h>
 
 #include "app/controller.h"
+#include "app/latency.h"
+#include "app/output.h"
+#include "app/report.h"
+#include "app/telemetry.h"
+#include "app/trace.h"
+#include "app/usb-ready.h"
 
 // Maximum simultaneous notes
 static constexpr int MAX_SIMULTANEOUS_NOTES = 5;
 
-// Gamepad action type constants
-static constexpr int ACTION_BUTTON = 1;
-static constexpr int ACTION_DPAD = 2;
-static constexpr int ACTION_L_TRIGGER = 3;
-static constexpr int ACTION_R_TRIGGER = 4;
-static constexpr int ACTION_L_STICK = 5;
-static constexpr int ACTION_R_STICK = 6;
-
-// Direction constants (common for stick and DPAD)
-static constexpr int DIRECTION_LEFT = 1;
-static constexpr int DIRECTION_RIGHT = 2;
-static constexpr int DIRECTION_UP = 3;
-static constexpr int DIRECTION_DOWN = 4;
-
-// Mapping entry structure
-struct MappingEntry
-{
-    int type;
-    int value;
-};
-
 // Mapping 1
 const MappingEntry mapping1[15] = {
     {ACTION_L_TRIGGER, 255}, // ZL
@@ -79,6 +64,9 @@ static NSGamepad gamepad;
 // Filter to prevent old notes from reappearing
 static Notes15Filter noteFilter;
 
+// Gamepad state builder for the current mapping and conflict policy
+static ReportBuilder reportBuilder;
+
 static void applyMIDIToNSwitchGamepad(const Notes15& notes15, const int mapping)
 {
     // Get mapping
@@ -86,118 +74,85 @@ static void applyMIDIToNSwitchGamepad(const Notes15& notes15, const int mapping)
 
     // Limit to latest notes for gamepad
     const Notes15 latestNotes15 = noteFilter.latest(notes15, MAX_SIMULTANEOUS_NOTES);
+    markLatency(LatencyStage::FILTER);
+    const uint16_t keptKeys = getPressedKeys(latestNotes15);
+    traceFilter(getPressedKeys(notes15), keptKeys);
 
-    // Variables for accumulating stick input (Nintendo Switch typically uses 0-255 range)
-    uint8_t leftStickX = 128, leftStickY = 128; // Center position
-    uint8_t rightStickX = 128, rightStickY = 128; // Center position
-
-    // DPad state
-    bool dpadPressed[4] = {false}; // UP, DOWN, RIGHT, LEFT
+    const ConflictPolicy conflict = getOutputConflict();
+    if (!reportBuilder.isCompiled(currentMapping, conflict)) {
+        reportBuilder.compile(currentMapping, conflict);
+    }
+    const GamepadState state = reportBuilder.build(latestNotes15);
 
     // Clear button state
     gamepad.releaseAll();
 
-    // Process 15-pitch array
     for (int i = 0; i < 15; i++) {
-        if (latestNotes15.get(i) != 0) {
-            const MappingEntry& mappingEntry = currentMapping[i];
-            switch (mappingEntry.type) {
-            case ACTION_BUTTON:
-                gamepad.press(mappingEntry.value);
-                break;
-            case ACTION_DPAD:
-                // Record DPad state
-                if (mappingEntry.value == DIRECTION_UP) dpadPressed[0] = true;
-                else if (mappingEntry.value == DIRECTION_DOWN) dpadPressed[1] = true;
-                else if (mappingEntry.value == DIRECTION_RIGHT) dpadPressed[2] = true;
-                else if (mappingEntry.value == DIRECTION_LEFT) dpadPressed[3] = true;
-                break;
-            case ACTION_L_TRIGGER:
-                gamepad.press(NSButton_LeftThrottle);
-                break;
-            case ACTION_R_TRIGGER:
-                gamepad.press(NSButton_RightThrottle);
-                break;
-            case ACTION_L_STICK:
-                if (mappingEntry.value == DIRECTION_LEFT) {
-                    leftStickX = 0; // L-Stick ←
-                } else if (mappingEntry.value == DIRECTION_RIGHT) {
-                    leftStickX = 255; // L-Stick →
-                } else if (mappingEntry.value == DIRECTION_UP) {
-                    leftStickY = 0; // L-Stick ↑
-                } else if (mappingEntry.value == DIRECTION_DOWN) {
-                    leftStickY = 255; // L-Stick ↓
-                }
-                break;
-            case ACTION_R_STICK:
-                if (mappingEntry.value == DIRECTION_LEFT) {
-                    rightStickX = 0; // R-Stick ←
-                } else if (mappingEntry.value == DIRECTION_RIGHT) {
-                    rightStickX = 255; // R-Stick →
-                } else if (mappingEntry.value == DIRECTION_UP) {
-                    rightStickY = 0; // R-Stick ↑
-                } else if (mappingEntry.value == DIRECTION_DOWN) {
-                    rightStickY = 255; // R-Stick ↓
-                }
-                break;
-            default:
-                break;
-            }
+        if (state.buttonKeys & (1 << i)) {
+            gamepad.press(currentMapping[i].value);
         }
     }
-
-    // Set DPad direction
-    const bool north = dpadPressed[0];
-    const bool south = dpadPressed[1];
-    const bool east = dpadPressed[2];
-    const bool west = dpadPressed[3];
-
-    if (north && east) {
-        gamepad.dPad(NSGAMEPAD_DPAD_UP_RIGHT);
-    } else if (north && west) {
-        gamepad.dPad(NSGAMEPAD_DPAD_UP_LEFT);
-    } else if (south && east) {
-        gamepad.dPad(NSGAMEPAD_DPAD_DOWN_RIGHT);
-    } else if (south && west) {
-        gamepad.dPad(NSGAMEPAD_DPAD_DOWN_LEFT);
-    } else if (north) {
-        gamepad.dPad(NSGAMEPAD_DPAD_UP);
-    } else if (south) {
-        gamepad.dPad(NSGAMEPAD_DPAD_DOWN);
-    } else if (east) {
-        gamepad.dPad(NSGAMEPAD_DPAD_RIGHT);
-    } else if (west) {
-        gamepad.dPad(NSGAMEPAD_DPAD_LEFT);
-    } else {
-        gamepad.dPad(NSGAMEPAD_DPAD_CENTERED);
+    if (state.leftTrigger != 0) {
+        gamepad.press(NSButton_LeftThrottle);
+    }
+    if (state.rightTrigger != 0) {
+        gamepad.press(NSButton_RightThrottle);
     }
 
-    // Set stick positions
-    gamepad.leftXAxis(leftStickX);
-    gamepad.leftYAxis(leftStickY);
-    gamepad.rightXAxis(rightStickX);
-    gamepad.rightYAxis(rightStickY);
+    // Set DPad direction
+    const uint8_t DPAD_DIRECTIONS[] = {
+        NSGAMEPAD_DPAD_CENTERED,
+        NSGAMEPAD_DPAD_UP,
+        NSGAMEPAD_DPAD_UP_RIGHT,
+        NSGAMEPAD_DPAD_RIGHT,
+        NSGAMEPAD_DPAD_DOWN_RIGHT,
+        NSGAMEPAD_DPAD_DOWN,
+        NSGAMEPAD_DPAD_DOWN_LEFT,
+        NSGAMEPAD_DPAD_LEFT,
+        NSGAMEPAD_DPAD_UP_LEFT,
+    };
+    gamepad.dPad(DPAD_DIRECTIONS[static_cast<int>(getDpadDirection(state))]);
+
+    // Set stick positions (0-255 range, 128 = center, 0 = left/up)
+    gamepad.leftXAxis(scaleStick(state.leftX, 0, 128, 255));
+    gamepad.leftYAxis(scaleStick(state.leftY, 255, 128, 0));
+    gamepad.rightXAxis(scaleStick(state.rightX, 0, 128, 255));
+    gamepad.rightYAxis(scaleStick(state.rightY, 255, 128, 0));
 
     // Send report
     gamepad.loop();
+    markLatency(LatencyStage::REPORT);
+    recordTrace(TraceType::REPORT, static_cast<uint8_t>(mapping), keptKeys);
+    countTelemetry(Counter::REPORTS);
 }
 
 void updateController(const Notes15& notes15, const int mapping)
 {
-    M5.Display.setCursor(0, 0);
-    M5.Display.setTextColor(TFT_PURPLE, TFT_BLACK);
-    M5.Display.println("USB Nintendo Switch");
+    // Hold reports until the host has configured the device
+    if (!isUSBReady()) {
+        countTelemetry(Counter::REPORTS_DROPPED);
+        recordTrace(TraceType::DROPPED, 0, getPressedKeys(notes15));
+        return;
+    }
 
     // MIDI to gamepad processing
     applyMIDIToNSwitchGamepad(notes15, mapping);
 }
 
+void drawController()
+{
+    M5.Display.setCursor(0, 0);
+    M5.Display.setTextColor(TFT_PURPLE, TFT_BLACK);
+    M5.Display.println("USB Nintendo Switch");
+    drawUSBStatus();
+}
+
 void setupController(const char* deviceName, const char* deviceManufacturer)
 {
     // Initialize Nintendo Switch controller
     gamepad.begin();
+    setupUSBReady();
     USB.begin();
-    delay(3000);
 }
 
 #endif // defined(CONTROLLER_USB_NSWITCH)
@@ -5,6 +5,8 @@
 
 void updateController(const Notes15& notes15, int mapping);
 
+void drawController();
+
 void setupController(const char *deviceName, const char *deviceManufacturer);
 
 #endif // !defined(APP_CONTROLLER_H)
@@ -0,0 +1,114 @@
+#if !defined(APP_CPU_LOAD_H)
+#define APP_CPU_LOAD_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+// CPU load and stack monitor (development builds)
+//
+// Disabled by default: with CPU_MONITOR 0 the measuring scopes are empty and nothing is sampled or
+// reported. Enable with -DCPU_MONITOR=1 in build_flags or in config.h.
+#if !defined(CPU_MONITOR)
+#define CPU_MONITOR 0
+#endif
+
+// Interval of the "cpu" lines printed on the USB serial port
+#if !defined(CPU_MONITOR_INTERVAL_MS)
+#define CPU_MONITOR_INTERVAL_MS 2000
+#endif
+
+// Also show the core loads on the screen
+#if !defined(CPU_MONITOR_STATUS_LINE)
+#define CPU_MONITOR_STATUS_LINE 0
+#endif
+
+static constexpr int CPU_LOAD_CORES = 2;
+static constexpr int CPU_LOAD_MAX_TASKS = 8;
+
+// Gap between idle hook calls still counted as idle (longer gaps mean another task ran)
+static constexpr uint32_t CPU_IDLE_GAP_US = 50;
+
+// Busy and idle time over one sampling window
+struct CpuLoadSnapshot
+{
+    uint32_t windowUs = 0;
+    uint32_t taskUs[CPU_LOAD_MAX_TASKS]{};
+    uint32_t idleUs[CPU_LOAD_CORES]{};
+
+    /** Load of a core in per mille (everything but its idle task) */
+    uint32_t corePermille(const int core) const
+    {
+        return windowUs == 0 ? 0 : 1000 - toPermille(idleUs[core]);
+    }
+
+    /** Share of one core used by a task in per mille */
+    uint32_t taskPermille(const int task) const { return toPermille(taskUs[task]); }
+
+    uint32_t toPermille(const uint32_t us) const
+    {
+        if (windowUs == 0) {
+            return 0;
+        }
+        const uint64_t permille = static_cast<uint64_t>(us) * 1000 / windowUs;
+        return permille > 1000 ? 1000 : static_cast<uint32_t>(permille);
+    }
+};
+
+// Accumulates busy time of the measured tasks and idle time of each core
+//
+// Counters are updated with relaxed atomic additions from any task or idle hook and handed over by
+// take(), which starts the next window.
+class CpuLoad
+{
+public:
+    void addTaskBusy(const int task, const uint32_t us)
+    {
+        taskUs[task].fetch_add(us, std::memory_order_relaxed);
+    }
+
+    void addIdle(const int core, const uint32_t us)
+    {
+        idleUs[core].fetch_add(us, std::memory_order_relaxed);
+    }
+
+    /** Counters of the window ending now, then restart */
+    CpuLoadSnapshot take(const uint32_t nowUs)
+    {
+        CpuLoadSnapshot snapshot;
+        snapshot.windowUs = nowUs - windowStartUs;
+        windowStartUs = nowUs;
+        for (int i = 0; i < CPU_LOAD_MAX_TASKS; i++) {
+            snapshot.taskUs[i] = taskUs[i].exchange(0, std::memory_order_relaxed);
+        }
+        for (int i = 0; i < CPU_LOAD_CORES; i++) {
+            snapshot.idleUs[i] = idleUs[i].exchange(0, std::memory_order_relaxed);
+        }
+        return snapshot;
+    }
+
+private:
+    std::atomic<uint32_t> taskUs[CPU_LOAD_MAX_TASKS]{};
+    std::atomic<uint32_t> idleUs[CPU_LOAD_CORES]{};
+    uint32_t windowStartUs = 0;
+};
+
+/** Core loads as "core0=12.5% core1=3.0%" */
+inline size_t formatCpuLoad(const CpuLoadSnapshot& snapshot, char* buffer, const size_t size)
+{
+    size_t length = 0;
+    for (int core = 0; core < CPU_LOAD_CORES && length + 1 < size; core++) {
+        const uint32_t permille = snapshot.corePermille(core);
+        const int written = snprintf(buffer + length, size - length, "%score%d=%lu.%lu%%", core == 0 ? "" : " ",
+                                     core, static_cast<unsigned long>(permille / 10),
+                                     static_cast<unsigned long>(permille % 10));
+        if (written < 0) {
+            break;
+        }
+        length += written;
+    }
+    return length < size ? length : size - 1;
+}
+
+#endif // !defined(APP_CPU_LOAD_H)
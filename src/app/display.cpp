@@ -1,22 +1,28 @@
-#include <M5Unified.h>
+#include <algorithm>
+#include <iterator>
 
 #include "app/display.h"
-#include "app/midi.h"
+#include "app/hal.h"
+#include "app/note-mapping.h"
 
 static bool prevPressed[15] = {false};
 
 void resetDisplay(const bool settingsMode)
 {
-    M5.Display.fillScreen(TFT_BLACK);
-    drawButtons(208, M5.Display.width(), 32, settingsMode, settingsMode);
+    Display& display = *getHal().display;
+
+    display.fillScreen(COLOR_BLACK);
+    drawButtons(208, display.width(), 32, settingsMode, settingsMode);
 }
 
 void drawNotes(const Notes15& notes15, const int startY, const int width, const int height, const int spacing, const bool firstDraw)
 {
+    Display& display = *getHal().display;
+
     // Calculate square size to fit 5 columns with spacing in given area
     const int availableWidth = width - (spacing * 6); // 6 spaces: left, 4 between, right
     const int availableHeight = height - (spacing * 4); // 4 spaces: top, 2 between, bottom
-    const int squareSize = min(availableWidth / 5, availableHeight / 3);
+    const int squareSize = std::min(availableWidth / 5, availableHeight / 3);
 
     // Calculate starting position to center the grid in given area
     const int totalGridWidth = (squareSize * 5) + (spacing * 4);
@@ -33,11 +39,11 @@ void drawNotes(const Notes15& notes15, const int startY, const int width, const
             const int x = startX + col * (squareSize + spacing);
             const int y = gridStartY + row * (squareSize + spacing);
 
-            const uint16_t fillColor = isPressed ? TFT_WHITE : TFT_BLACK;
-            constexpr uint16_t borderColor = TFT_DARKGRAY;
+            const uint16_t fillColor = isPressed ? COLOR_WHITE : COLOR_BLACK;
+            constexpr uint16_t borderColor = COLOR_DARKGRAY;
 
-            M5.Display.fillRect(x, y, squareSize, squareSize, fillColor);
-            M5.Display.drawRect(x, y, squareSize, squareSize, borderColor);
+            display.fillRect(x, y, squareSize, squareSize, fillColor);
+            display.drawRect(x, y, squareSize, squareSize, borderColor);
 
             prevPressed[i] = isPressed;
         }
@@ -46,12 +52,14 @@ void drawNotes(const Notes15& notes15, const int startY, const int width, const
 
 void drawButtons(const int startY, const int width, const int height, const bool buttonA, const bool buttonC)
 {
+    Display& display = *getHal().display;
+
     const int buttonWidth = width / 3;
 
     // Draw three button frames
     for (int i = 0; i < 3; i++) {
         const int x = i * buttonWidth;
-        M5.Display.drawRect(x + 2, startY, buttonWidth - 2, height, TFT_DARKGRAY);
+        display.drawRect(x + 2, startY, buttonWidth - 2, height, COLOR_DARKGRAY);
     }
 
     const int y = startY + height / 2;
@@ -60,31 +68,228 @@ void drawButtons(const int startY, const int width, const int height, const bool
     // Button A
     if (buttonA) {
         const int xa = buttonWidth / 2;
-        M5.Display.fillTriangle(
+        display.fillTriangle(
             xa - size / 2, y, // Left point
             xa + size / 2, y - size, // Top right
             xa + size / 2, y + size, // Bottom right
-            TFT_WHITE
+            COLOR_WHITE
         );
     }
 
     // Button B
     const int xb = buttonWidth + buttonWidth / 2;
-    M5.Display.fillTriangle(
+    display.fillTriangle(
         xb, y + size / 2, // Bottom point
         xb - size, y - size / 2, // Top left
         xb + size, y - size / 2, // Top right
-        TFT_WHITE
+        COLOR_WHITE
     );
 
     // Button C
     if (buttonC) {
         const int xc = 2 * buttonWidth + buttonWidth / 2;
-        M5.Display.fillTriangle(
+        display.fillTriangle(
             xc + size / 2, y, // Right point
             xc - size / 2, y - size, // Top left
             xc - size / 2, y + size, // Bottom left
-            TFT_WHITE
+            COLOR_WHITE
         );
     }
 }
+
+void drawLatencyOverlay(const LatencyHistogram& histogram, const int startY, const int width)
+{
+    Display& display = *getHal().display;
+
+    display.setTextSize(1);
+    display.setTextColor(COLOR_ORANGE, COLOR_BLACK);
+    display.fillRect(0, startY, width, 8, COLOR_BLACK);
+    display.setCursor(0, startY);
+    display.printf("latency p50 %luus p99 %luus max %luus n=%lu",
+                   static_cast<unsigned long>(histogram.percentile(50)),
+                   static_cast<unsigned long>(histogram.percentile(99)),
+                   static_cast<unsigned long>(histogram.getMax()),
+                   static_cast<unsigned long>(histogram.getCount()));
+    display.setTextSize(2);
+}
+
+void drawLoopbackStatus(const LoopbackStatus& status, const int startY, const int width)
+{
+    Display& display = *getHal().display;
+
+    display.setTextSize(1);
+    display.setTextColor(status.phase == LoopbackPhase::NO_SIGNAL ? COLOR_ORANGE : COLOR_CYAN, COLOR_BLACK);
+    display.fillRect(0, startY, width, 16, COLOR_BLACK);
+    display.setCursor(0, startY);
+    display.printf("loopback %s %lu/%lu rtt p50 %luus p99 %luus\n", getLoopbackPhaseName(status.phase),
+                   static_cast<unsigned long>(status.received), static_cast<unsigned long>(status.sent),
+                   static_cast<unsigned long>(status.roundTrip.percentile(50)),
+                   static_cast<unsigned long>(status.roundTrip.percentile(99)));
+    display.printf("parse p50 %luus p99 %luus rate %lu/%lu msg/s",
+                   static_cast<unsigned long>(status.parse.percentile(50)),
+                   static_cast<unsigned long>(status.parse.percentile(99)),
+                   static_cast<unsigned long>(status.maxRate), static_cast<unsigned long>(LOOPBACK_LINE_RATE));
+    display.setTextSize(2);
+}
+
+void drawCpuLoadLine(const CpuLoadSnapshot& snapshot, const int startY, const int width)
+{
+    Display& display = *getHal().display;
+
+    char text[48];
+    formatCpuLoad(snapshot, text, sizeof(text));
+    display.setTextSize(1);
+    display.setTextColor(COLOR_CYAN, COLOR_BLACK);
+    display.fillRect(0, startY, width, 8, COLOR_BLACK);
+    display.setCursor(0, startY);
+    display.printf("cpu %s", text);
+    display.setTextSize(2);
+}
+
+void drawKeyboard(const int startY, const int width, const int height, const int baseNote)
+{
+    Display& display = *getHal().display;
+
+    const int blackKeyHeight = height * 3 / 5;
+
+    // White keys
+    const int whiteKeyNotes[] = {
+        0, 2, 4, 5, 7, 9, 11, 12, 14, 16, 17, 19, 21, 23, 24, 26, 28, 29, 31, 33, 35,
+    };
+    constexpr int numWhiteKeys = std::size(whiteKeyNotes);
+
+    // Black keys
+    const int blackKeyNotes[] = {
+        1, 3, 6, 8, 10, 13, 15, 18, 20, 22, 25, 27, 30, 32, 34,
+    };
+    // Black key positions relative to white keys
+    const int blackKeyPositions[] = {
+        0, 1, 3, 4, 5, 7, 8, 10, 11, 12, 14, 15, 17, 18, 19, 21,
+    };
+    constexpr int numBlackKeys = std::size(blackKeyNotes);
+
+    const int whiteKeyWidth = width / numWhiteKeys;
+    const int blackKeyWidth = whiteKeyWidth * 2 / 3;
+
+    int base = baseNote;
+    while (base >= 12) {
+        base -= 12;
+    }
+    bool activeNotes[36] = {false};
+    for (const int validKeyNote : SKY_KEY_PITCHES) {
+        activeNotes[base + validKeyNote] = true;
+    }
+
+    for (int i = 0; i < numWhiteKeys; i++) {
+        const int note = whiteKeyNotes[i];
+        const int x = i * whiteKeyWidth;
+        uint16_t color = activeNotes[note] ? COLOR_CYAN : COLOR_WHITE;
+        display.fillRect(x, startY, whiteKeyWidth - 1, height, color);
+        display.drawRect(x, startY, whiteKeyWidth - 1, height, COLOR_BLACK);
+    }
+    for (int i = 0; i < numBlackKeys; i++) {
+        const int pos = blackKeyPositions[i];
+        const int note = blackKeyNotes[i];
+        const int x = pos * whiteKeyWidth + whiteKeyWidth - blackKeyWidth / 2;
+        uint16_t color = activeNotes[note] ? COLOR_CYAN : COLOR_BLACK;
+        display.fillRect(x, startY, blackKeyWidth, blackKeyHeight, color);
+        display.drawRect(x, startY, blackKeyWidth, blackKeyHeight, COLOR_BLACK);
+    }
+}
+
+static const char* getBaseNote(const int baseNote)
+{
+    const char* KEYS[] = {
+        "C",
+        "C#",
+        "D",
+        "D#",
+        "E",
+        "F",
+        "F#",
+        "G",
+        "G#",
+        "A",
+        "A#",
+        "B",
+    };
+    return KEYS[baseNote % 12];
+}
+
+static const char* getKey(const int baseNote)
+{
+    const char* KEYS[] = {
+        "C/Am",
+        "Db/Bbm",
+        "D/Bm",
+        "Eb/Cm",
+        "E/C#m",
+        "F/Dm",
+        "F#/D#m",
+        "G/Em",
+        "Ab/Fm",
+        "A/F#m",
+        "Bb/Gm",
+        "B/G#m",
+    };
+    return KEYS[baseNote % 12];
+}
+
+void drawSettings(const Settings& settings)
+{
+    Display& display = *getHal().display;
+
+    const auto settingType = settings.getSettingType();
+
+    // One line per setting (all but NONE)
+    display.fillRect(0, 48, 320, (static_cast<int>(SettingType::COUNT) - 1) * 16, COLOR_BLACK);
+    display.setCursor(0, 48);
+
+    display.setTextColor(settingType == SettingType::MAPPING ? COLOR_YELLOW : COLOR_WHITE, COLOR_BLACK);
+    display.printf("Mapping: %d\n", settings.getMapping());
+
+    display.setTextColor(settingType == SettingType::BASENOTE ? COLOR_YELLOW : COLOR_WHITE, COLOR_BLACK);
+    display.printf("Base note: %s%d (%s)\n", getBaseNote(settings.getBaseNote()),
+                   settings.getBaseNote() / 12 - 1, getKey(settings.getBaseNote()));
+
+    display.setTextColor(settingType == SettingType::EXPAND ? COLOR_YELLOW : COLOR_WHITE, COLOR_BLACK);
+    display.printf("Expand: %s\n", settings.getExpand() ? "ON" : "OFF");
+
+    display.setTextColor(settingType == SettingType::SUSTAIN ? COLOR_YELLOW : COLOR_WHITE, COLOR_BLACK);
+    display.printf("Sustain: %s\n", settings.getSustain() ? "ON" : "OFF");
+
+    // Keys are numbered from 1 as in the map command
+    const KeyBindings& bindings = settings.getBindings();
+    const int key = settings.getLearnKey();
+    const int note = bindings.getNote(key);
+    display.setTextColor(settingType == SettingType::LEARN ? COLOR_YELLOW : COLOR_WHITE, COLOR_BLACK);
+    if (note >= 0) {
+        display.printf("Learn: key %d = %s%d\n", key + 1, getBaseNote(note), note / 12 - 1);
+    } else {
+        display.printf("Learn: key %d = -\n", key + 1);
+    }
+
+    display.setTextColor(settingType == SettingType::ACTION ? COLOR_YELLOW : COLOR_WHITE, COLOR_BLACK);
+    display.printf("Action: key %d -> %d\n", key + 1, bindings.getAction(key) + 1);
+
+    drawKeyboard(150, 320, 44, settings.getBaseNote());
+}
+
+void drawKeySuggestion(const KeyEstimate& estimate, const int suggestedBaseNote, const bool autoKey, const int startY,
+                       const int width)
+{
+    Display& display = *getHal().display;
+
+    display.setTextSize(1);
+    display.setTextColor(COLOR_CYAN, COLOR_BLACK);
+    display.fillRect(0, startY, width, 8, COLOR_BLACK);
+    display.setCursor(0, startY);
+    if (estimate.valid) {
+        display.printf("Key %s, suggested base note %s%d (%d%% on keys)%s", getKeyName(estimate.tonic, estimate.minor),
+                       getBaseNote(suggestedBaseNote), suggestedBaseNote / 12 - 1,
+                       static_cast<int>(estimate.coverage * 100 + 0.5f), autoKey ? " auto" : "");
+    } else {
+        display.printf("Key: listening...%s", autoKey ? " auto" : "");
+    }
+    display.setTextSize(2);
+}
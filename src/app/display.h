@@ -1,7 +1,12 @@
 #if !defined(APP_DISPLAY_H)
 #define APP_DISPLAY_H
 
+#include "app/cpu-load.h"
+#include "app/key-estimator.h"
+#include "app/latency.h"
+#include "app/loopback.h"
 #include "app/notes.h"
+#include "app/settings.h"
 
 void resetDisplay(bool settingsMode);
 
@@ -9,4 +14,17 @@ void drawNotes(const Notes15& notes15, int startY, int width, int height, int sp
 
 void drawButtons(int startY, int width, int height, bool buttonA, bool buttonC);
 
+void drawLatencyOverlay(const LatencyHistogram& histogram, int startY, int width);
+
+/** Two lines: progress and round trip, then parse latency and the highest rate without loss */
+void drawLoopbackStatus(const LoopbackStatus& status, int startY, int width);
+
+void drawCpuLoadLine(const CpuLoadSnapshot& snapshot, int startY, int width);
+
+void drawKeyboard(int startY, int width, int height, int baseNote);
+
+void drawSettings(const Settings& settings);
+
+void drawKeySuggestion(const KeyEstimate& estimate, int suggestedBaseNote, bool autoKey, int startY, int width);
+
 #endif // !defined(APP_DISPLAY_H)
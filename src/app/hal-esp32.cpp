@@ -0,0 +1,112 @@
+#if defined(ARDUINO)
+
+#include "../config.h"
+
+#include <M5Unified.h>
+
+#include "app/controller.h"
+#include "app/hal.h"
+
+class Esp32Clock final : public Clock
+{
+public:
+    unsigned long millis() override { return ::millis(); }
+    uint32_t micros() override { return ::micros(); }
+};
+
+class Esp32SerialPort final : public SerialPort
+{
+public:
+    explicit Esp32SerialPort(Stream& stream) : stream(stream) {}
+
+    int available() override { return stream.available(); }
+    int read() override { return stream.read(); }
+    size_t write(const uint8_t* data, const size_t size) override { return stream.write(data, size); }
+
+private:
+    Stream& stream;
+};
+
+class M5UnifiedDisplay final : public Display
+{
+public:
+    int width() override { return M5.Display.width(); }
+    void fillScreen(const uint16_t color) override { M5.Display.fillScreen(color); }
+
+    void fillRect(const int x, const int y, const int w, const int h, const uint16_t color) override
+    {
+        M5.Display.fillRect(x, y, w, h, color);
+    }
+
+    void drawRect(const int x, const int y, const int w, const int h, const uint16_t color) override
+    {
+        M5.Display.drawRect(x, y, w, h, color);
+    }
+
+    void fillTriangle(const int x0, const int y0, const int x1, const int y1, const int x2, const int y2,
+                      const uint16_t color) override
+    {
+        M5.Display.fillTriangle(x0, y0, x1, y1, x2, y2, color);
+    }
+
+    void setTextSize(const int size) override { M5.Display.setTextSize(size); }
+
+    void setTextColor(const uint16_t foreground, const uint16_t background) override
+    {
+        M5.Display.setTextColor(foreground, background);
+    }
+
+    void setCursor(const int x, const int y) override { M5.Display.setCursor(x, y); }
+    void print(const char* text) override { M5.Display.print(text); }
+};
+
+class M5UnifiedSpeaker final : public Speaker
+{
+public:
+    void tone(const float frequency, const uint32_t durationMs) override { M5.Speaker.tone(frequency, durationMs); }
+};
+
+class ControllerOutput final : public HidOutput
+{
+public:
+    void send(const Notes15& notes15, const int mapping) override { updateController(notes15, mapping); }
+};
+
+class Esp32Power final : public PowerControl
+{
+public:
+    // 80 MHz and above keep the APB clock (UART baud rate, Bluetooth) unchanged
+    void setCpuMhz(const uint32_t mhz) override { setCpuFrequencyMhz(mhz); }
+    int32_t batteryCurrent() override { return M5.Power.getBatteryCurrent(); }
+};
+
+static Esp32Clock esp32Clock;
+static Esp32SerialPort consolePort(Serial);
+static Esp32SerialPort midiPort(Serial2);
+#if defined(MIDI2_GPIO_RX)
+static Esp32SerialPort midi2Port(Serial1);
+#endif
+static M5UnifiedDisplay m5Display;
+static M5UnifiedSpeaker m5Speaker;
+static ControllerOutput controllerOutput;
+static Esp32Power esp32Power;
+
+#if defined(MIDI2_GPIO_RX)
+static Hal hal = {&esp32Clock, &consolePort, &midiPort, &midi2Port, &m5Display, &m5Speaker, &controllerOutput,
+                  &esp32Power};
+#else
+static Hal hal = {&esp32Clock, &consolePort, &midiPort, nullptr, &m5Display, &m5Speaker, &controllerOutput,
+                  &esp32Power};
+#endif
+
+Hal& getHal()
+{
+    return hal;
+}
+
+void setHal(const Hal& replacement)
+{
+    hal = replacement;
+}
+
+#endif // defined(ARDUINO)
@@ -0,0 +1,29 @@
+#if !defined(ARDUINO)
+
+#include "app/hal-host.h"
+
+// Default stand-ins until a test installs its own
+static HostHal defaultHal;
+
+static Hal hal = {
+    &defaultHal.clock,
+    &defaultHal.console,
+    &defaultHal.midiSerial,
+    &defaultHal.midiSerial2,
+    &defaultHal.display,
+    &defaultHal.speaker,
+    &defaultHal.hid,
+    &defaultHal.power,
+};
+
+Hal& getHal()
+{
+    return hal;
+}
+
+void setHal(const Hal& replacement)
+{
+    hal = replacement;
+}
+
+#endif // !defined(ARDUINO)
@@ -0,0 +1,206 @@
+#if !defined(APP_HAL_HOST_H)
+#define APP_HAL_HOST_H
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <deque>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+#include "app/hal.h"
+
+// Host stand-ins for the hardware, used by native tests
+
+/** Deterministic clock, advanced only by the test */
+class FakeClock final : public Clock
+{
+public:
+    unsigned long millis() override { return static_cast<unsigned long>(now / 1000); }
+    uint32_t micros() override { return static_cast<uint32_t>(now); }
+
+    void advance(const unsigned long ms) { now += static_cast<uint64_t>(ms) * 1000; }
+    void advanceMicros(const uint32_t us) { now += us; }
+
+private:
+    // Starts away from 0 (0 means "not pressed" for note timestamps)
+    uint64_t now = 1000000;
+};
+
+/** Serial port fed from a buffer; written bytes are kept for inspection */
+class BufferSerialPort final : public SerialPort
+{
+public:
+    int available() override { return static_cast<int>(input.size()); }
+
+    int read() override
+    {
+        if (input.empty()) {
+            return -1;
+        }
+        const uint8_t byte = input.front();
+        input.pop_front();
+        return byte;
+    }
+
+    size_t write(const uint8_t* data, const size_t size) override
+    {
+        output.insert(output.end(), data, data + size);
+        if (jumpered) {
+            input.insert(input.end(), data, data + size);
+        }
+        return size;
+    }
+
+    void push(std::initializer_list<uint8_t> bytes) { input.insert(input.end(), bytes.begin(), bytes.end()); }
+
+    std::deque<uint8_t> input;
+    std::vector<uint8_t> output;
+    bool jumpered = false; // written bytes are also received (TX wired to RX)
+};
+
+/** Display that keeps the printed text and counts drawing calls */
+class RecordingDisplay final : public Display
+{
+public:
+    int width() override { return 320; }
+    void fillScreen(uint16_t) override { text.clear(); }
+    void fillRect(int, int, int, int, uint16_t) override { drawCalls++; }
+    void drawRect(int, int, int, int, uint16_t) override { drawCalls++; }
+    void fillTriangle(int, int, int, int, int, int, uint16_t) override { drawCalls++; }
+    void setTextSize(int) override {}
+    void setTextColor(uint16_t, uint16_t) override {}
+    void setCursor(int, int) override {}
+    void print(const char* value) override { text += value; }
+
+    std::string text;
+    int drawCalls = 0;
+};
+
+class RecordingSpeaker final : public Speaker
+{
+public:
+    struct Tone
+    {
+        float frequency;
+        uint32_t durationMs;
+    };
+
+    void tone(const float frequency, const uint32_t durationMs) override { tones.push_back({frequency, durationMs}); }
+
+    std::vector<Tone> tones;
+};
+
+class RecordingHid final : public HidOutput
+{
+public:
+    struct Report
+    {
+        Notes15 notes15;
+        int mapping;
+    };
+
+    void send(const Notes15& notes15, const int mapping) override { reports.push_back({notes15, mapping}); }
+
+    std::vector<Report> reports;
+};
+
+/** Keeps the CPU clock settings; the battery current is set by the test */
+class RecordingPower final : public PowerControl
+{
+public:
+    void setCpuMhz(const uint32_t mhz) override
+    {
+        cpuMhz = mhz;
+        changes.push_back(mhz);
+    }
+
+    int32_t batteryCurrent() override { return current; }
+
+    uint32_t cpuMhz = 240;
+    std::vector<uint32_t> changes;
+    int32_t current = 0;
+};
+
+/** Non-blocking UDP socket on the loopback interface */
+class UdpDatagramPort final : public DatagramPort
+{
+public:
+    /** Bind to a local port (0 = any free port) */
+    explicit UdpDatagramPort(const uint16_t port = 0)
+    {
+        socketFd = socket(AF_INET, SOCK_DGRAM, 0);
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(port);
+        bind(socketFd, reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+        fcntl(socketFd, F_SETFL, fcntl(socketFd, F_GETFL) | O_NONBLOCK);
+    }
+
+    ~UdpDatagramPort() override { close(socketFd); }
+
+    UdpDatagramPort(const UdpDatagramPort&) = delete;
+    UdpDatagramPort& operator=(const UdpDatagramPort&) = delete;
+
+    /** Bound address, 0 if the socket could not be bound */
+    DatagramAddress address() const
+    {
+        sockaddr_in address{};
+        socklen_t length = sizeof(address);
+        if (getsockname(socketFd, reinterpret_cast<sockaddr*>(&address), &length) != 0) {
+            return {};
+        }
+        return {ntohl(address.sin_addr.s_addr), ntohs(address.sin_port)};
+    }
+
+    int receive(uint8_t* buffer, const size_t size, DatagramAddress& from) override
+    {
+        sockaddr_in address{};
+        socklen_t length = sizeof(address);
+        const ssize_t received =
+            recvfrom(socketFd, buffer, size, 0, reinterpret_cast<sockaddr*>(&address), &length);
+        if (received < 0) {
+            return -1;
+        }
+        from = {ntohl(address.sin_addr.s_addr), ntohs(address.sin_port)};
+        return static_cast<int>(received);
+    }
+
+    bool send(const DatagramAddress& to, const uint8_t* data, const size_t size) override
+    {
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(to.ip);
+        address.sin_port = htons(to.port);
+        return sendto(socketFd, data, size, 0, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) ==
+            static_cast<ssize_t>(size);
+    }
+
+private:
+    int socketFd = -1;
+};
+
+/** A complete set of stand-ins */
+struct HostHal
+{
+    FakeClock clock;
+    BufferSerialPort console;
+    BufferSerialPort midiSerial;
+    BufferSerialPort midiSerial2;
+    RecordingDisplay display;
+    RecordingSpeaker speaker;
+    RecordingHid hid;
+    RecordingPower power;
+
+    void install()
+    {
+        setHal({&clock, &console, &midiSerial, &midiSerial2, &display, &speaker, &hid, &power});
+    }
+};
+
+#endif // !defined(APP_HAL_HOST_H)
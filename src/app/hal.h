@@ -0,0 +1,189 @@
+#if !defined(APP_HAL_H)
+#define APP_HAL_H
+
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+#if defined(ARDUINO)
+#include <freertos/FreeRTOS.h>
+#else
+#include <mutex>
+#endif
+
+#include "app/notes.h"
+
+// Hardware abstraction layer
+//
+// Firmware logic (MIDI, settings, mapping, display, output) reaches the hardware only through the interfaces below.
+// hal-esp32.cpp implements them on top of Arduino/M5Unified; hal-host.h provides stand-ins (fake clock,
+// buffered serial, recording display/speaker/HID) so the same code runs natively under env:test.
+
+// RGB565 colors (same values as the M5GFX TFT_* constants)
+static constexpr uint16_t COLOR_BLACK = 0x0000;
+static constexpr uint16_t COLOR_WHITE = 0xFFFF;
+static constexpr uint16_t COLOR_CYAN = 0x07FF;
+static constexpr uint16_t COLOR_YELLOW = 0xFFE0;
+static constexpr uint16_t COLOR_DARKGRAY = 0x7BEF;
+static constexpr uint16_t COLOR_ORANGE = 0xFDA0;
+
+// Maximum length of a formatted printf() line
+static constexpr size_t HAL_PRINTF_MAX = 128;
+
+class Clock
+{
+public:
+    virtual ~Clock() = default;
+
+    virtual unsigned long millis() = 0;
+    virtual uint32_t micros() = 0;
+};
+
+class SerialPort
+{
+public:
+    virtual ~SerialPort() = default;
+
+    virtual int available() = 0;
+
+    /** Next received byte, or -1 if none */
+    virtual int read() = 0;
+
+    virtual size_t write(const uint8_t* data, size_t size) = 0;
+
+    size_t write(const uint8_t byte) { return write(&byte, 1); }
+
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)))
+    {
+        char buffer[HAL_PRINTF_MAX];
+        va_list args;
+        va_start(args, format);
+        const int length = vsnprintf(buffer, sizeof(buffer), format, args);
+        va_end(args);
+        if (length <= 0) {
+            return 0;
+        }
+        const size_t size = static_cast<size_t>(length) < sizeof(buffer) ? length : sizeof(buffer) - 1;
+        return write(reinterpret_cast<const uint8_t*>(buffer), size);
+    }
+};
+
+class Display
+{
+public:
+    virtual ~Display() = default;
+
+    virtual int width() = 0;
+    virtual void fillScreen(uint16_t color) = 0;
+    virtual void fillRect(int x, int y, int w, int h, uint16_t color) = 0;
+    virtual void drawRect(int x, int y, int w, int h, uint16_t color) = 0;
+    virtual void fillTriangle(int x0, int y0, int x1, int y1, int x2, int y2, uint16_t color) = 0;
+    virtual void setTextSize(int size) = 0;
+    virtual void setTextColor(uint16_t foreground, uint16_t background) = 0;
+    virtual void setCursor(int x, int y) = 0;
+    virtual void print(const char* text) = 0;
+
+    void printf(const char* format, ...) __attribute__((format(printf, 2, 3)))
+    {
+        char buffer[HAL_PRINTF_MAX];
+        va_list args;
+        va_start(args, format);
+        vsnprintf(buffer, sizeof(buffer), format, args);
+        va_end(args);
+        print(buffer);
+    }
+};
+
+class Speaker
+{
+public:
+    virtual ~Speaker() = default;
+
+    virtual void tone(float frequency, uint32_t durationMs) = 0;
+};
+
+/** Controller report output (the selected USB/Bluetooth backend) */
+class HidOutput
+{
+public:
+    virtual ~HidOutput() = default;
+
+    virtual void send(const Notes15& notes15, int mapping) = 0;
+};
+
+/** CPU clock and battery monitor */
+class PowerControl
+{
+public:
+    virtual ~PowerControl() = default;
+
+    virtual void setCpuMhz(uint32_t mhz) = 0;
+
+    /** Battery current in mA (negative while discharging, 0 if the board cannot measure it) */
+    virtual int32_t batteryCurrent() = 0;
+};
+
+// IPv4 address and port of a datagram peer (host byte order)
+struct DatagramAddress
+{
+    uint32_t ip = 0;
+    uint16_t port = 0;
+
+    bool operator==(const DatagramAddress& other) const { return ip == other.ip && port == other.port; }
+    bool operator!=(const DatagramAddress& other) const { return !(*this == other); }
+};
+
+/** UDP socket bound to a local port (network MIDI) */
+class DatagramPort
+{
+public:
+    virtual ~DatagramPort() = default;
+
+    /**
+     * Take the next received datagram (longer ones are truncated to the buffer)
+     *
+     * @return datagram size, or -1 if none
+     */
+    virtual int receive(uint8_t* buffer, size_t size, DatagramAddress& from) = 0;
+
+    virtual bool send(const DatagramAddress& to, const uint8_t* data, size_t size) = 0;
+};
+
+// Short critical section shared between tasks (spinlock on ESP32, mutex on host)
+class CriticalSection
+{
+public:
+#if defined(ARDUINO)
+    void enter() { portENTER_CRITICAL(&mux); }
+    void exit() { portEXIT_CRITICAL(&mux); }
+
+private:
+    portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+#else
+    void enter() { mutex.lock(); }
+    void exit() { mutex.unlock(); }
+
+private:
+    std::mutex mutex;
+#endif
+};
+
+struct Hal
+{
+    Clock* clock;
+    SerialPort* console;
+    SerialPort* midiSerial;
+    SerialPort* midiSerial2; // second MIDI input (nullptr if not fitted)
+    Display* display;
+    Speaker* speaker;
+    HidOutput* hid;
+    PowerControl* power;
+};
+
+Hal& getHal();
+
+/** Replace the hardware (host tests install stand-ins) */
+void setHal(const Hal& hal);
+
+#endif // !defined(APP_HAL_H)
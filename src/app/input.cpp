@@ -0,0 +1,50 @@
+#include <M5Unified.h>
+
+#include "app/input.h"
+
+// Interval between button/touch polls; M5.update() reads the touch controller over I2C on Core2/CoreS3
+static constexpr unsigned long INPUT_POLL_INTERVAL_MS = 15;
+
+InputButtons pollInput()
+{
+    // Touch state tracking for one-touch detection
+    static bool wasTouchPressed = false;
+    static unsigned long lastPollTime = 0;
+
+    InputButtons buttons;
+
+    const unsigned long now = millis();
+    if (now - lastPollTime < INPUT_POLL_INTERVAL_MS) {
+        return buttons;
+    }
+    lastPollTime = now;
+
+    M5.update();
+
+    // Touch detection with one-touch logic
+    const bool isTouchPressed = M5.Touch.getCount() > 0;
+    const bool touchJustPressed = isTouchPressed && !wasTouchPressed;
+    wasTouchPressed = isTouchPressed;
+    if (touchJustPressed) {
+        const auto t = M5.Touch.getDetail();
+        if (200 <= t.y && t.y < 240) {
+            if (0 <= t.x && t.x < 106) {
+                buttons.a = true;
+            } else if (t.x < 214) {
+                buttons.b = true;
+            } else {
+                buttons.c = true;
+            }
+        }
+    }
+    if (M5.BtnA.wasPressed()) {
+        buttons.a = true;
+    }
+    if (M5.BtnB.wasPressed()) {
+        buttons.b = true;
+    }
+    if (M5.BtnC.wasPressed()) {
+        buttons.c = true;
+    }
+    return buttons;
+}
@@ -0,0 +1,16 @@
+#if !defined(APP_INPUT_H)
+#define APP_INPUT_H
+
+// Button presses detected since the previous poll (hardware buttons and touch zones)
+struct InputButtons
+{
+    bool a = false;
+    bool b = false;
+    bool c = false;
+
+    bool any() const { return a || b || c; }
+};
+
+InputButtons pollInput();
+
+#endif // !defined(APP_INPUT_H)
@@ -0,0 +1,247 @@
+#if !defined(APP_KEY_ESTIMATOR_H)
+#define APP_KEY_ESTIMATOR_H
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <initializer_list>
+
+#include "app/note-mapping.h"
+
+// Weight kept by older notes at each new note (half-life of about 34 notes)
+static constexpr float KEY_ESTIMATOR_DECAY = 0.98f;
+
+// Notes needed before an estimate is reported
+static constexpr uint32_t KEY_ESTIMATOR_MIN_NOTES = 16;
+
+// Coverage gain (share of notes on the keys) needed to switch the base note automatically
+static constexpr float KEY_ESTIMATOR_MIN_GAIN = 0.1f;
+
+// Krumhansl-Kessler key profiles (tonic first)
+static constexpr float KEY_PROFILE_MAJOR[12] = {
+    6.35f, 2.23f, 3.48f, 2.33f, 4.38f, 4.09f, 2.52f, 5.19f, 2.39f, 3.66f, 2.29f, 2.88f,
+};
+static constexpr float KEY_PROFILE_MINOR[12] = {
+    6.33f, 2.68f, 3.52f, 5.38f, 2.60f, 3.53f, 2.54f, 4.75f, 3.98f, 2.69f, 3.34f, 3.17f,
+};
+
+struct KeyEstimate
+{
+    bool valid = false; // enough notes seen
+    int tonic = 0; // pitch class (0 = C)
+    bool minor = false;
+    float correlation = 0; // with the key profile, -1 to 1
+    int basePitchClass = 0; // base note pitch class putting most notes on the Sky keys
+    float coverage = 0; // share of recent notes on the Sky keys with that base note, 0 to 1
+    float coverageByBase[12] = {}; // the same for every base pitch class
+    float meanPitch = 0; // recent average MIDI note
+};
+
+// Online key estimator
+//
+// The ingest task calls addNote() on every Note On: one bin update on a decayed pitch-class histogram,
+// O(1) (older notes decay by growing the weight of new ones instead of scaling every bin). Readers on
+// other tasks call update(), which copies the histogram under a sequence counter and only correlates
+// it with the 24 key profiles when notes arrived since the previous call.
+class KeyEstimator
+{
+public:
+    /** Count a Note On (single writer) */
+    void addNote(const int note)
+    {
+        const uint32_t seq = sequence.load(std::memory_order_relaxed);
+        sequence.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        if (weight > RESCALE_LIMIT) {
+            // Rare: bring the weights back into range
+            for (std::atomic<float>& bin : bins) {
+                bin.store(bin.load(std::memory_order_relaxed) / weight, std::memory_order_relaxed);
+            }
+            pitchSum.store(pitchSum.load(std::memory_order_relaxed) / weight, std::memory_order_relaxed);
+            weight = 1;
+        }
+        std::atomic<float>& bin = bins[note % 12];
+        bin.store(bin.load(std::memory_order_relaxed) + weight, std::memory_order_relaxed);
+        pitchSum.store(pitchSum.load(std::memory_order_relaxed) + weight * note, std::memory_order_relaxed);
+        weight /= KEY_ESTIMATOR_DECAY;
+        if (count.load(std::memory_order_relaxed) < UINT32_MAX) {
+            count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+
+        sequence.store(seq + 2, std::memory_order_release);
+    }
+
+    /**
+     * Re-estimate if notes arrived since the last call
+     *
+     * @return false if nothing changed (estimate left as is)
+     */
+    bool update(KeyEstimate& estimate)
+    {
+        float histogram[12];
+        float pitches = 0;
+        uint32_t notes = 0;
+        uint32_t seq;
+        do {
+            seq = sequence.load(std::memory_order_acquire);
+            if (seq == evaluatedSequence) {
+                return false;
+            }
+            for (int i = 0; i < 12; i++) {
+                histogram[i] = bins[i].load(std::memory_order_relaxed);
+            }
+            pitches = pitchSum.load(std::memory_order_relaxed);
+            notes = count.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+        } while ((seq & 1) != 0 || seq != sequence.load(std::memory_order_relaxed));
+        evaluatedSequence = seq;
+
+        estimate = estimateKey(histogram);
+        float total = 0;
+        for (const float value : histogram) {
+            total += value;
+        }
+        estimate.meanPitch = total > 0 ? pitches / total : 0;
+        estimate.valid = notes >= KEY_ESTIMATOR_MIN_NOTES;
+        return true;
+    }
+
+    void reset()
+    {
+        const uint32_t seq = sequence.load(std::memory_order_relaxed);
+        sequence.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (std::atomic<float>& bin : bins) {
+            bin.store(0, std::memory_order_relaxed);
+        }
+        pitchSum.store(0, std::memory_order_relaxed);
+        count.store(0, std::memory_order_relaxed);
+        weight = 1;
+        sequence.store(seq + 2, std::memory_order_release);
+    }
+
+    /** Best key and base note for a pitch-class histogram */
+    static KeyEstimate estimateKey(const float histogram[12])
+    {
+        KeyEstimate estimate;
+        estimate.correlation = -2;
+        for (int tonic = 0; tonic < 12; tonic++) {
+            for (const bool minor : {false, true}) {
+                const float r = correlate(histogram, minor ? KEY_PROFILE_MINOR : KEY_PROFILE_MAJOR, tonic);
+                if (r > estimate.correlation) {
+                    estimate.correlation = r;
+                    estimate.tonic = tonic;
+                    estimate.minor = minor;
+                }
+            }
+        }
+
+        // Base note: the Sky keys are a major scale, so try every pitch class as its tonic. Ties go to the
+        // relative major of the estimated key.
+        float total = 0;
+        for (int i = 0; i < 12; i++) {
+            total += histogram[i];
+        }
+        const int preferred = (estimate.tonic + (estimate.minor ? 3 : 0)) % 12;
+        float best = -1;
+        for (int offset = 0; offset < 12; offset++) {
+            const int base = (preferred + offset) % 12;
+            float onKeys = 0;
+            for (int i = 0; i < 7; i++) {
+                onKeys += histogram[(base + SKY_KEY_PITCHES[i]) % 12];
+            }
+            estimate.coverageByBase[base] = total > 0 ? onKeys / total : 0;
+            if (onKeys > best) {
+                best = onKeys;
+                estimate.basePitchClass = base;
+            }
+        }
+        estimate.coverage = estimate.coverageByBase[estimate.basePitchClass];
+        return estimate;
+    }
+
+    /** Note of the given pitch class nearest to target, within [minNote, maxNote] */
+    static int nearestNote(const int pitchClass, const int target, const int minNote, const int maxNote)
+    {
+        int note = target - ((target - pitchClass) % 12 + 12) % 12;
+        if (target - note > 6) {
+            note += 12;
+        }
+        while (note < minNote) {
+            note += 12;
+        }
+        while (note > maxNote) {
+            note -= 12;
+        }
+        return note;
+    }
+
+    /** Base note with the estimated pitch class that centers the 15 keys (two octaves) on the recent notes */
+    static int suggestBaseNote(const KeyEstimate& estimate, const int minNote, const int maxNote)
+    {
+        return nearestNote(estimate.basePitchClass, static_cast<int>(lroundf(estimate.meanPitch)) - 12, minNote,
+                           maxNote);
+    }
+
+    /**
+     * Whether to switch from the current base note to the suggested one automatically
+     *
+     * Only a different key counts (the octave is left to the user), and only when it puts clearly more notes
+     * on the keys, so that an ambiguous passage does not flip the mapping back and forth.
+     */
+    static bool shouldApply(const KeyEstimate& estimate, const int currentBaseNote)
+    {
+        const int current = currentBaseNote % 12;
+        return estimate.valid && estimate.basePitchClass != current &&
+            estimate.coverage >= estimate.coverageByBase[current] + KEY_ESTIMATOR_MIN_GAIN;
+    }
+
+private:
+    static constexpr float RESCALE_LIMIT = 1e6f;
+
+    /** Pearson correlation of the histogram with a profile rotated to the tonic */
+    static float correlate(const float histogram[12], const float profile[12], const int tonic)
+    {
+        float meanHistogram = 0;
+        float meanProfile = 0;
+        for (int i = 0; i < 12; i++) {
+            meanHistogram += histogram[i];
+            meanProfile += profile[i];
+        }
+        meanHistogram /= 12;
+        meanProfile /= 12;
+
+        float covariance = 0;
+        float varianceHistogram = 0;
+        float varianceProfile = 0;
+        for (int i = 0; i < 12; i++) {
+            const float h = histogram[(tonic + i) % 12] - meanHistogram;
+            const float p = profile[i] - meanProfile;
+            covariance += h * p;
+            varianceHistogram += h * h;
+            varianceProfile += p * p;
+        }
+        if (varianceHistogram <= 0) {
+            return 0;
+        }
+        return covariance / sqrtf(varianceHistogram * varianceProfile);
+    }
+
+    std::atomic<float> bins[12]{};
+    std::atomic<float> pitchSum{0};
+    std::atomic<uint32_t> count{0};
+    std::atomic<uint32_t> sequence{0};
+    float weight = 1; // writer only
+    uint32_t evaluatedSequence = 0; // reader only
+};
+
+/** Name of a key, e.g. "D" or "Bm" */
+inline const char* getKeyName(const int tonic, const bool minor)
+{
+    static const char* const MAJOR[] = {"C", "Db", "D", "Eb", "E", "F", "F#", "G", "Ab", "A", "Bb", "B"};
+    static const char* const MINOR[] = {"Cm", "C#m", "Dm", "D#m", "Em", "Fm", "F#m", "Gm", "G#m", "Am", "Bbm", "Bm"};
+    return minor ? MINOR[tonic] : MAJOR[tonic];
+}
+
+#endif // !defined(APP_KEY_ESTIMATOR_H)
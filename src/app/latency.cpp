@@ -0,0 +1,105 @@
+#include <atomic>
+
+#include "app/hal.h"
+#include "app/latency.h"
+
+// Histograms and probe state, guarded by latencyLock
+static LatencyHistogram histograms[static_cast<int>(LatencyStage::COUNT)];
+static CriticalSection latencyLock;
+
+// Probe handed over from midiTask, waiting for the output task
+static bool pendingProbe = false;
+static uint32_t pendingArrival = 0;
+static uint32_t pendingParsed = 0;
+static LatencySource pendingSource = LatencySource::DIN;
+
+// Trace being followed through the output task (only touched by the output task)
+static bool traceActive = false;
+static uint32_t traceArrival = 0;
+static uint32_t traceLast = 0;
+static LatencySource traceSource = LatencySource::DIN;
+
+static std::atomic<bool> overlayEnabled{false};
+
+static void recordLatency(const LatencyStage stage, const uint32_t us)
+{
+    histograms[static_cast<int>(stage)].record(us);
+}
+
+void beginLatencyProbe(const uint32_t arrivalUs, const uint32_t parsedUs, const LatencySource source)
+{
+    latencyLock.enter();
+    if (source != LatencySource::NETWORK) {
+        recordLatency(LatencyStage::PARSE, parsedUs - arrivalUs);
+    }
+    // Keep the oldest unserved event so the total covers the longest wait
+    if (!pendingProbe) {
+        pendingProbe = true;
+        pendingArrival = arrivalUs;
+        pendingParsed = parsedUs;
+        pendingSource = source;
+    }
+    latencyLock.exit();
+}
+
+/** Called by the output task at the start of each evaluation */
+void startLatencyTrace()
+{
+    latencyLock.enter();
+    traceActive = pendingProbe;
+    traceArrival = pendingArrival;
+    traceLast = pendingParsed;
+    traceSource = pendingSource;
+    pendingProbe = false;
+    latencyLock.exit();
+}
+
+/** Called by the output task when a stage has completed */
+void markLatency(const LatencyStage stage)
+{
+    if (!traceActive) {
+        return;
+    }
+    const uint32_t now = getHal().clock->micros();
+
+    latencyLock.enter();
+    recordLatency(stage, now - traceLast);
+    if (stage == LatencyStage::REPORT) {
+        recordLatency(traceSource == LatencySource::NETWORK ? LatencyStage::NETWORK : LatencyStage::TOTAL,
+                      now - traceArrival);
+        if (traceSource == LatencySource::WAKE) {
+            recordLatency(LatencyStage::WAKE, now - traceArrival);
+        }
+        traceActive = false;
+    }
+    latencyLock.exit();
+
+    traceLast = now;
+}
+
+void resetLatency()
+{
+    latencyLock.enter();
+    for (LatencyHistogram& histogram : histograms) {
+        histogram.reset();
+    }
+    latencyLock.exit();
+}
+
+LatencyHistogram getLatencyHistogram(const LatencyStage stage)
+{
+    latencyLock.enter();
+    const LatencyHistogram histogram = histograms[static_cast<int>(stage)];
+    latencyLock.exit();
+    return histogram;
+}
+
+void setLatencyOverlay(const bool enabled)
+{
+    overlayEnabled.store(enabled);
+}
+
+bool isLatencyOverlayEnabled()
+{
+    return overlayEnabled.load();
+}
@@ -0,0 +1,146 @@
+#if !defined(APP_LATENCY_H)
+#define APP_LATENCY_H
+
+#include <cstdint>
+
+// Pipeline stages measured between MIDI byte arrival and the report leaving the controller
+enum class LatencyStage
+{
+    PARSE = 0, // first byte seen by midiTask -> message parsed
+    MAPPING = 1, // message parsed -> getNotes15() result (includes output task wake-up)
+    FILTER = 2, // getNotes15() result -> filter output
+    REPORT = 3, // filter output -> report sent
+    TOTAL = 4, // first byte seen -> report sent
+    NETWORK = 5, // network MIDI packet received -> report sent (includes the jitter buffer delay)
+    WAKE = 6, // first byte seen -> report sent, for notes that woke the controller from the idle mode
+    COUNT = 7,
+};
+
+// Input a latency probe came from
+enum class LatencySource
+{
+    DIN = 0, // MIDI UART (and song playback)
+    NETWORK = 1, // RTP-MIDI session
+    WAKE = 2, // MIDI UART message that woke the controller from the idle mode (also counted as DIN)
+};
+
+inline const char* getLatencyStageName(const LatencyStage stage)
+{
+    const char* NAMES[] = {
+        "parse",
+        "mapping",
+        "filter",
+        "report",
+        "total",
+        "net",
+        "wake",
+    };
+    return NAMES[static_cast<int>(stage)];
+}
+
+// Fixed-bucket latency histogram in microseconds
+//
+// Values below 8 us get exact buckets, above that each power of two is split into 4 buckets
+// (at most 25% relative error). Values beyond the last bucket are counted in it; max is exact.
+class LatencyHistogram
+{
+public:
+    static constexpr int BUCKETS = 64;
+
+    void record(const uint32_t us)
+    {
+        buckets[bucketOf(us)]++;
+        count++;
+        if (us > maxValue) {
+            maxValue = us;
+        }
+    }
+
+    uint32_t getCount() const { return count; }
+
+    uint32_t getMax() const { return maxValue; }
+
+    /**
+     * Upper bound of the bucket holding the given percentile
+     *
+     * @param percent 0-100
+     */
+    uint32_t percentile(const uint32_t percent) const
+    {
+        if (count == 0) {
+            return 0;
+        }
+        const uint64_t rank = (static_cast<uint64_t>(count) * percent + 99) / 100;
+        uint64_t cumulative = 0;
+        for (int i = 0; i < BUCKETS; i++) {
+            cumulative += buckets[i];
+            if (cumulative >= rank && cumulative > 0) {
+                if (i == BUCKETS - 1) {
+                    break;
+                }
+                const uint32_t upper = upperBoundOf(i);
+                return upper < maxValue ? upper : maxValue;
+            }
+        }
+        return maxValue;
+    }
+
+    void reset()
+    {
+        for (uint32_t& bucket : buckets) {
+            bucket = 0;
+        }
+        count = 0;
+        maxValue = 0;
+    }
+
+    static int bucketOf(const uint32_t us)
+    {
+        if (us < 8) {
+            return static_cast<int>(us);
+        }
+        const int msb = 31 - __builtin_clz(us);
+        const int sub = static_cast<int>((us >> (msb - 2)) & 3);
+        const int index = 8 + (msb - 3) * 4 + sub;
+        return index < BUCKETS ? index : BUCKETS - 1;
+    }
+
+    static uint32_t upperBoundOf(const int index)
+    {
+        if (index < 8) {
+            return static_cast<uint32_t>(index);
+        }
+        const int msb = 3 + (index - 8) / 4;
+        const uint32_t sub = (index - 8) % 4;
+        const uint32_t lower = (4 + sub) << (msb - 2);
+        return lower + (1u << (msb - 2)) - 1;
+    }
+
+private:
+    uint32_t buckets[BUCKETS]{};
+    uint32_t count = 0;
+    uint32_t maxValue = 0;
+};
+
+/**
+ * Start a probe for a parsed note message (called by midiTask)
+ *
+ * DIN probes record the parse stage and end in the total stage; network probes skip the parse stage (the
+ * arrival is the packet reception) and end in the network stage. Wake probes are DIN probes that also end in the
+ * wake stage.
+ */
+void beginLatencyProbe(uint32_t arrivalUs, uint32_t parsedUs, LatencySource source = LatencySource::DIN);
+
+void startLatencyTrace();
+
+void markLatency(LatencyStage stage);
+
+void resetLatency();
+
+LatencyHistogram getLatencyHistogram(LatencyStage stage);
+
+void setLatencyOverlay(bool enabled);
+
+bool isLatencyOverlayEnabled();
+
+#endif // !defined(APP_LATENCY_H)
@@ -0,0 +1,172 @@
+#include <atomic>
+
+#include "app/hal.h"
+#include "app/loopback.h"
+#include "app/power.h"
+
+static std::atomic<LoopbackPhase> phase{LoopbackPhase::IDLE};
+static std::atomic<bool> startRequested{false};
+static std::atomic<bool> stopRequested{false};
+
+// Results published by the MIDI task, guarded by statusLock
+static LoopbackStatus publishedStatus;
+static CriticalSection statusLock;
+
+// Current phase or rate step (only touched by the MIDI task)
+static unsigned long phaseStartMs = 0;
+static unsigned long lastSendMs = 0;
+static uint32_t phaseSent = 0;
+static uint32_t phaseReceived = 0;
+static int rateStep = 0;
+
+static uint32_t getStepRate(const int step)
+{
+    return LOOPBACK_LINE_RATE * LOOPBACK_RATE_PERCENT[step] / 100;
+}
+
+static void sendTestMessage()
+{
+    uint8_t message[LOOPBACK_MESSAGE_SIZE];
+    encodeLoopbackMessage(getHal().clock->micros(), message);
+    getHal().midiSerial->write(message, sizeof(message));
+    phaseSent++;
+}
+
+static void beginPhase(const LoopbackPhase next, const unsigned long now)
+{
+    phaseStartMs = now;
+    lastSendMs = now;
+    phaseSent = 0;
+    phaseReceived = 0;
+    phase = next;
+}
+
+static void beginRateStep(const int step, const unsigned long now)
+{
+    rateStep = step;
+    statusLock.enter();
+    publishedStatus.rate = getStepRate(step);
+    statusLock.exit();
+    beginPhase(LoopbackPhase::RATE, now);
+}
+
+/** One probe every interval, then wait for the last ones to come back */
+static void pollLatencyPhase(const unsigned long now)
+{
+    if (phaseSent < LOOPBACK_PROBES) {
+        if (phaseSent == 0 || now - lastSendMs >= LOOPBACK_PROBE_INTERVAL_MS) {
+            lastSendMs = now;
+            sendTestMessage();
+            statusLock.enter();
+            publishedStatus.sent = phaseSent;
+            statusLock.exit();
+        }
+        return;
+    }
+    if (phaseReceived < phaseSent && now - lastSendMs < LOOPBACK_SETTLE_MS) {
+        return;
+    }
+    if (phaseReceived == 0) {
+        phase = LoopbackPhase::NO_SIGNAL;
+        return;
+    }
+    beginRateStep(0, now);
+}
+
+/** Send at the step's rate for the step duration; any message missing after the settle time ends the phase */
+static void pollRateStep(const unsigned long now)
+{
+    const unsigned long elapsed = now - phaseStartMs;
+    const uint32_t rate = getStepRate(rateStep);
+    const uint32_t due = rate * (elapsed < LOOPBACK_STEP_MS ? elapsed : LOOPBACK_STEP_MS) / 1000;
+    while (phaseSent < due) {
+        sendTestMessage();
+    }
+    if (elapsed < LOOPBACK_STEP_MS || (phaseReceived < phaseSent && elapsed < LOOPBACK_STEP_MS + LOOPBACK_SETTLE_MS)) {
+        return;
+    }
+
+    const uint32_t lost = phaseReceived < phaseSent ? phaseSent - phaseReceived : 0;
+    statusLock.enter();
+    if (lost == 0) {
+        publishedStatus.maxRate = rate;
+    }
+    publishedStatus.lost = lost;
+    statusLock.exit();
+    if (lost > 0 || rateStep + 1 == LOOPBACK_RATE_STEPS) {
+        phase = LoopbackPhase::DONE;
+        return;
+    }
+    beginRateStep(rateStep + 1, now);
+}
+
+void startLoopback()
+{
+    startRequested = true;
+}
+
+void stopLoopback()
+{
+    stopRequested = true;
+}
+
+void pollLoopback()
+{
+    const unsigned long now = getHal().clock->millis();
+    if (stopRequested.exchange(false)) {
+        phase = LoopbackPhase::IDLE;
+    }
+    if (startRequested.exchange(false)) {
+        statusLock.enter();
+        publishedStatus = LoopbackStatus();
+        statusLock.exit();
+        beginPhase(LoopbackPhase::LATENCY, now);
+    }
+
+    switch (phase.load()) {
+    case LoopbackPhase::LATENCY:
+        // Measure at the full clock
+        wakePower();
+        pollLatencyPhase(now);
+        break;
+    case LoopbackPhase::RATE:
+        wakePower();
+        pollRateStep(now);
+        break;
+    default:
+        break;
+    }
+}
+
+bool isLoopbackRunning()
+{
+    const LoopbackPhase current = phase.load(std::memory_order_relaxed);
+    return current == LoopbackPhase::LATENCY || current == LoopbackPhase::RATE;
+}
+
+void receiveLoopback(const MidiMessage& message, const uint32_t arrivalUs, const uint32_t parsedUs)
+{
+    const int32_t roundTrip = getLoopbackRoundTrip(message, parsedUs);
+    if (roundTrip < 0) {
+        return;
+    }
+    phaseReceived++;
+    if (phase.load() == LoopbackPhase::LATENCY) {
+        statusLock.enter();
+        publishedStatus.received++;
+        publishedStatus.roundTrip.record(static_cast<uint32_t>(roundTrip));
+        // The arrival is tagged odd (never 0), so it may read 1 us after the parse time
+        const uint32_t parse = parsedUs - arrivalUs;
+        publishedStatus.parse.record(static_cast<int32_t>(parse) < 0 ? 0 : parse);
+        statusLock.exit();
+    }
+}
+
+LoopbackStatus getLoopbackStatus()
+{
+    statusLock.enter();
+    LoopbackStatus status = publishedStatus;
+    statusLock.exit();
+    status.phase = phase.load();
+    return status;
+}
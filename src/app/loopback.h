@@ -0,0 +1,115 @@
+#if !defined(APP_LOOPBACK_H)
+#define APP_LOOPBACK_H
+
+#include <cstdint>
+
+#include "app/latency.h"
+#include "app/midi-parser.h"
+#include "app/midi.h"
+
+// UART loopback self-test
+//
+// With MIDI_GPIO_TX jumpered to MIDI_GPIO_RX, the MIDI task sends test messages on the DIN output and takes
+// them back from its own input through the normal read and parse path. Each message carries its send time, so
+// the round trip (write -> message parsed) is measured per message together with the parse stage
+// (first byte seen -> message parsed). A second phase sends at rising rates up to the line rate and reports the
+// highest rate at which every message came back.
+//
+// While the test runs, MIDI thru is off on the DIN port (the echo would circulate on the jumper) and DIN input
+// is not played.
+
+// Messages of the latency phase, sent one at a time
+static constexpr uint32_t LOOPBACK_PROBES = 200;
+static constexpr unsigned long LOOPBACK_PROBE_INTERVAL_MS = 10;
+
+// Duration of each rate step, and the time allowed for the last messages of a phase to come back
+static constexpr unsigned long LOOPBACK_STEP_MS = 1000;
+static constexpr unsigned long LOOPBACK_SETTLE_MS = 100;
+
+// Rate steps in percent of the line rate
+static constexpr uint32_t LOOPBACK_RATE_PERCENT[] = {25, 50, 75, 90, 100};
+static constexpr int LOOPBACK_RATE_STEPS = sizeof(LOOPBACK_RATE_PERCENT) / sizeof(LOOPBACK_RATE_PERCENT[0]);
+
+// Test messages are Polyphonic Key Pressure: channel nibble and both data bytes carry 18 bits of the send time
+// in 4 us units (wraps after about 1 s, longer than any backlog of the transmit buffer)
+static constexpr uint32_t LOOPBACK_MESSAGE_SIZE = 3;
+static constexpr int LOOPBACK_TIME_SHIFT = 2;
+static constexpr uint32_t LOOPBACK_TIME_MASK = (1u << 18) - 1;
+
+// Messages per second that fit the line
+static constexpr uint32_t LOOPBACK_LINE_RATE = MIDI_BYTES_PER_SECOND / LOOPBACK_MESSAGE_SIZE;
+
+inline void encodeLoopbackMessage(const uint32_t sentUs, uint8_t message[LOOPBACK_MESSAGE_SIZE])
+{
+    const uint32_t time = (sentUs >> LOOPBACK_TIME_SHIFT) & LOOPBACK_TIME_MASK;
+    message[0] = static_cast<uint8_t>(0xA0 | (time >> 14));
+    message[1] = static_cast<uint8_t>((time >> 7) & 0x7F);
+    message[2] = static_cast<uint8_t>(time & 0x7F);
+}
+
+/**
+ * Time since a test message was sent
+ *
+ * @return microseconds (resolution 4 us), or -1 if the message is not a test message
+ */
+inline int32_t getLoopbackRoundTrip(const MidiMessage& message, const uint32_t nowUs)
+{
+    if (message.type != MidiType::POLY_PRESSURE) {
+        return -1;
+    }
+    const uint32_t time = (static_cast<uint32_t>(message.channel - 1) << 14) |
+        (static_cast<uint32_t>(message.data1) << 7) | message.data2;
+    const uint32_t elapsed = ((nowUs >> LOOPBACK_TIME_SHIFT) - time) & LOOPBACK_TIME_MASK;
+    return static_cast<int32_t>(elapsed << LOOPBACK_TIME_SHIFT);
+}
+
+enum class LoopbackPhase
+{
+    IDLE = 0,
+    LATENCY = 1,
+    RATE = 2,
+    DONE = 3,
+    NO_SIGNAL = 4, // no test message came back (jumper missing)
+};
+
+inline const char* getLoopbackPhaseName(const LoopbackPhase phase)
+{
+    const char* NAMES[] = {
+        "idle",
+        "latency",
+        "rate",
+        "done",
+        "no-signal",
+    };
+    return NAMES[static_cast<int>(phase)];
+}
+
+struct LoopbackStatus
+{
+    LoopbackPhase phase = LoopbackPhase::IDLE;
+    uint32_t sent = 0; // latency phase
+    uint32_t received = 0;
+    LatencyHistogram roundTrip; // write -> parsed, microseconds
+    LatencyHistogram parse; // first byte seen -> parsed, microseconds
+    uint32_t rate = 0; // messages per second of the current (or last) rate step
+    uint32_t maxRate = 0; // highest rate step without loss
+    uint32_t lost = 0; // messages lost in the step that ended the rate phase
+};
+
+/** Start the self-test on the MIDI task's next tick (a test in progress starts over) */
+void startLoopback();
+
+void stopLoopback();
+
+/** Send test messages and advance the phases (called by the MIDI task after reading the input) */
+void pollLoopback();
+
+/** True while DIN input belongs to the self-test */
+bool isLoopbackRunning();
+
+/** Take a message received on the DIN port during the self-test (MIDI task) */
+void receiveLoopback(const MidiMessage& message, uint32_t arrivalUs, uint32_t parsedUs);
+
+LoopbackStatus getLoopbackStatus();
+
+#endif // !defined(APP_LOOPBACK_H)
@@ -4,11 +4,58 @@
 
 #include "app/controller.h"
 #include "app/display.h"
+#include "app/input.h"
+#include "app/latency.h"
+#include "app/loopback.h"
 #include "app/midi.h"
+#include "app/network-midi.h"
+#include "app/output.h"
+#include "app/playback.h"
+#include "app/power.h"
+#include "app/serial-command.h"
 #include "app/settings.h"
+#include "app/storage.h"
+#include "app/tasks.h"
+#include "app/telemetry.h"
+#include "app/trace.h"
+
+// Interval of controller status redraws (connection state)
+static constexpr unsigned long STATUS_DRAW_INTERVAL_MS = 500;
+
+// Interval of key estimate updates
+static constexpr unsigned long KEY_UPDATE_INTERVAL_MS = 500;
+
+// Row of the key suggestion in settings mode (below the keyboard)
+static constexpr int KEY_SUGGESTION_Y = 196;
+
+// Row of the CPU monitor status line (between the keys and the latency overlay)
+static constexpr int CPU_STATUS_LINE_Y = 184;
+
+// Rows of the loopback self-test results (in place of the latency overlay)
+static constexpr int LOOPBACK_STATUS_Y = 188;
+
+SET_LOOP_TASK_STACK_SIZE(RENDER_TASK_STACK);
+
+// Settings
+static Settings settings;
+
+/** Note table settings of the output task */
+static OutputTableSettings getOutputTable(const Settings& settings)
+{
+    OutputTableSettings table;
+    table.mapping = settings.getMapping();
+    table.baseNote = settings.getBaseNote();
+    table.expand = settings.getExpand();
+    table.fold = settings.getFold();
+    table.split = settings.getSplit();
+    table.bindings = settings.getBindings();
+    return table;
+}
 
 void setup()
 {
+    registerTask(TaskId::RENDER);
+
     Serial.begin(115200);
 
     const auto cfg = m5::M5Unified::config();
@@ -16,63 +63,68 @@ void setup()
     M5.Display.setTextSize(2);
     M5.Display.setCursor(0, 0);
     M5.Speaker.setVolume(20);
+    logBootPhase("m5");
+
+    setupTrace();
+    setupCpuMonitor();
+    logBootPhase("trace");
 
     setupMIDI(MIDI_GPIO_RX, MIDI_GPIO_TX);
+    setupPlayback();
+    setupNetworkMIDI(DEVICE_NAME);
+    setupPower(IDLE_POWER_TIMEOUT_S);
+    logBootPhase("midi");
+
+    // Restore saved settings
+    setupStorage();
+    SettingsRecord record = settings.toRecord();
+    if (loadSettings(record)) {
+        settings.applyRecord(record);
+    }
+    publishSettings(settings.toRecord());
+    setupSerialCommand();
+    logBootPhase("settings");
+
+    // Controller enumeration completes in background (USB) or on pairing (Bluetooth)
     setupController(DEVICE_NAME, DEVICE_MANUFACTURER);
+    logBootPhase("controller");
+
+    // Start output task
+    setOutputTable(getOutputTable(settings));
+    setOutputStrum(settings.getStrum());
+    setOutputConflict(settings.getConflict());
+    setDebounceGuard(settings.getDebounce());
+    setNetworkJitter(settings.getJitter());
+    setupOutput();
 
     // Initialize display
     resetDisplay(false);
+    logBootPhase("ready");
 }
 
 
 void loop()
 {
+    const int64_t busyStart = beginTaskBusy();
     static bool firstDraw = true;
 
     // Settings
-    static Settings settings;
     static bool previousSettingsMode = false;
 
     // Previous notes state
     static Notes15 prevNotes15;
 
-    // Touch state tracking for one-touch detection
-    static bool wasTouchPressed = false;
-
-    bool btnPressedA = false;
-    bool btnPressedB = false;
-    bool btnPressedC = false;
-
-    M5.update();
-
-    // Touch detection with one-touch logic
-    const bool isTouchPressed = M5.Touch.getCount() > 0;
-    const bool touchJustPressed = isTouchPressed && !wasTouchPressed;
-    wasTouchPressed = isTouchPressed;
-    if (touchJustPressed) {
-        const auto t = M5.Touch.getDetail();
-        if (200 <= t.y && t.y < 240) {
-            if (0 <= t.x && t.x < 106) {
-                btnPressedA = true;
-            } else if (t.x < 214) {
-                btnPressedB = true;
-            } else {
-                btnPressedC = true;
-            }
-        }
-    }
-    if (M5.BtnA.wasPressed()) {
-        btnPressedA = true;
-    }
-    if (M5.BtnB.wasPressed()) {
-        btnPressedB = true;
-    }
-    if (M5.BtnC.wasPressed()) {
-        btnPressedC = true;
-    }
-    if (btnPressedA || btnPressedB || btnPressedC) {
+    static unsigned long lastStatusDraw = 0;
+    static bool previousOverlay = false;
+    static bool previousLoopback = false;
+
+    // Buttons and touch (polled at a low rate)
+    const InputButtons buttons = pollInput();
+    if (buttons.any()) {
+        notePowerActivity();
+
         // Process setting button presses
-        if (settings.processButtons(btnPressedA, btnPressedB, btnPressedC)) {
+        if (settings.processButtons(buttons.a, buttons.b, buttons.c)) {
             const auto isSettingsMode = settings.isSettingsMode();
             if (isSettingsMode != previousSettingsMode) {
                 resetDisplay(isSettingsMode);
@@ -82,36 +134,102 @@ void loop()
                 drawSettings(settings);
             }
             previousSettingsMode = isSettingsMode;
+
+            // Persist in background
+            saveSettings(settings.toRecord());
+            publishSettings(settings.toRecord());
         }
     }
 
-#if defined(MODE_TEST)
-    // test mode
-    static int testIndex = 14;
-    static unsigned long testPrevTs = 0;
-    const unsigned long ts = millis();
-    if (ts - testPrevTs > 500) {
-        testPrevTs = ts;
-        testIndex = ++testIndex % 15;
+    // MIDI-learn: a note played on the learn page is bound to the selected key
+    const int learnedNote = takeLearnNote();
+    if (learnedNote >= 0 && settings.learnNote(learnedNote)) {
+        drawSettings(settings);
+        saveSettings(settings.toRecord());
+        publishSettings(settings.toRecord());
+    }
+
+    // Settings updates from serial commands, merged into the live settings
+    SettingsRecord update;
+    while (takeSettingsUpdate(settings.toRecord(), update)) {
+        settings.applyRecord(update);
+        if (settings.isSettingsMode()) {
+            drawSettings(settings);
+        }
+        saveSettings(settings.toRecord());
+        publishSettings(settings.toRecord());
+        completeSettingsUpdate();
+    }
+
+    // Key estimate from recent notes (recomputed only after new notes)
+    static KeyEstimate keyEstimate;
+    static unsigned long lastKeyUpdate = 0;
+    if (millis() - lastKeyUpdate >= KEY_UPDATE_INTERVAL_MS) {
+        lastKeyUpdate = millis();
+        const bool updated = getKeyEstimator().update(keyEstimate);
+
+        // Auto transpose between phrases only, never under held keys
+        if (updated && settings.getAutoKey() && !getOutputNotes15().any() &&
+            KeyEstimator::shouldApply(keyEstimate, settings.getBaseNote())) {
+            SettingsRecord record = settings.toRecord();
+            record.baseNote = static_cast<uint8_t>(KeyEstimator::nearestNote(
+                keyEstimate.basePitchClass, settings.getBaseNote(), BASENOTE_MIN, BASENOTE_MAX));
+            settings.applyRecord(record);
+            if (settings.isSettingsMode()) {
+                drawSettings(settings);
+            }
+            saveSettings(settings.toRecord());
+            publishSettings(settings.toRecord());
+        }
+
+        if (settings.isSettingsMode()) {
+            drawKeySuggestion(keyEstimate, KeyEstimator::suggestBaseNote(keyEstimate, BASENOTE_MIN, BASENOTE_MAX),
+                              settings.getAutoKey(), KEY_SUGGESTION_Y, 320);
+        }
     }
-    unsigned long testTimestamps[15] = {0};
-    testTimestamps[testIndex] = ts;
-    const Notes15 notes15{testTimestamps};
-#else
-    const Notes15 notes15 = getNotes15(settings.getBaseNote(), settings.getExpand());
-#endif
-    // Update controller if there are changes
-    if (firstDraw || notes15 != prevNotes15) {
-        updateController(notes15, settings.getMapping());
+
+    // Hand settings over to output task
+    setOutputTable(getOutputTable(settings));
+    setOutputStrum(settings.getStrum());
+    setOutputConflict(settings.getConflict());
+    setDebounceGuard(settings.getDebounce());
+    setNetworkJitter(settings.getJitter());
+
+    // Redraw if notes sent by output task have changed
+    const Notes15 notes15 = getOutputNotes15();
+    if (firstDraw || notes15 != prevNotes15 || millis() - lastStatusDraw >= STATUS_DRAW_INTERVAL_MS) {
+        drawController();
+        lastStatusDraw = millis();
 
         // Display notes when not in settings mode
         if (!settings.isSettingsMode()) {
             drawNotes(notes15, 32, 320, 160, 16, firstDraw);
+            const LoopbackStatus loopback = getLoopbackStatus();
+            const bool overlay = isLatencyOverlayEnabled();
+            if (loopback.phase != LoopbackPhase::IDLE) {
+                drawLoopbackStatus(loopback, LOOPBACK_STATUS_Y, 320);
+            } else if (previousLoopback) {
+                // Redraw the keys under the results
+                M5.Display.fillRect(0, LOOPBACK_STATUS_Y, 320, 16, TFT_BLACK);
+                drawNotes(notes15, 32, 320, 160, 16, true);
+            } else if (overlay) {
+                drawLatencyOverlay(getLatencyHistogram(LatencyStage::TOTAL), 196, 320);
+            } else if (previousOverlay) {
+                M5.Display.fillRect(0, 196, 320, 8, TFT_BLACK);
+            }
+            previousOverlay = overlay;
+            previousLoopback = loopback.phase != LoopbackPhase::IDLE;
+#if CPU_MONITOR && CPU_MONITOR_STATUS_LINE
+            drawCpuLoadLine(getLastCpuLoad(), CPU_STATUS_LINE_Y, 320);
+#endif
         }
 
         prevNotes15 = notes15;
         firstDraw = false;
     }
 
-    delay(1);
+    samplePower();
+
+    endTaskBusy(TaskId::RENDER, busyStart);
+    delay(getPowerState() == PowerState::IDLE ? POWER_IDLE_LOOP_MS : 1);
 }
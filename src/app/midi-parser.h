@@ -0,0 +1,145 @@
+#if !defined(APP_MIDI_PARSER_H)
+#define APP_MIDI_PARSER_H
+
+#include <cstdint>
+
+// MIDI message types (channel messages use the status nibble)
+enum class MidiType : uint8_t
+{
+    NONE = 0x00,
+    NOTE_OFF = 0x80,
+    NOTE_ON = 0x90,
+    POLY_PRESSURE = 0xA0,
+    CONTROL_CHANGE = 0xB0,
+    PROGRAM_CHANGE = 0xC0,
+    CHANNEL_PRESSURE = 0xD0,
+    PITCH_BEND = 0xE0,
+    SYSTEM = 0xF0, // system exclusive, common and real-time messages
+};
+
+// Sustain pedal controller number
+static constexpr uint8_t MIDI_CC_SUSTAIN = 64;
+
+struct MidiMessage
+{
+    MidiType type = MidiType::NONE;
+    uint8_t channel = 0; // 1-16, 0 for system messages
+    uint8_t data1 = 0; // system messages: status byte
+    uint8_t data2 = 0;
+};
+
+// Byte-wise MIDI stream parser
+//
+// Handles running status, real-time bytes interleaved in other messages and system exclusive.
+// Note On with velocity 0 is reported as Note Off.
+class MidiParser
+{
+public:
+    /**
+     * Feed one received byte
+     *
+     * @return true if a message has been completed (see message())
+     */
+    bool feed(const uint8_t byte)
+    {
+        if (byte >= 0xF8) {
+            // Real-time: single byte, does not disturb the message in progress
+            return complete(byte, 0, 0);
+        }
+
+        if (byte >= 0x80) {
+            count = 0;
+            if (byte == 0xF7) {
+                // End of system exclusive
+                const bool inSysEx = status == 0xF0;
+                status = 0;
+                return inSysEx && complete(0xF0, 0, 0);
+            }
+            status = byte;
+            expected = getDataLength(byte);
+            if (expected == 0) {
+                // Tune request (or undefined): no data
+                status = 0;
+                return byte == 0xF6 && complete(byte, 0, 0);
+            }
+            return false;
+        }
+
+        // Data byte (ignored without status and inside system exclusive)
+        if (status == 0 || status == 0xF0) {
+            return false;
+        }
+        data[count++] = byte;
+        if (count < expected) {
+            return false;
+        }
+        count = 0;
+        const uint8_t messageStatus = status;
+        if (messageStatus >= 0xF0) {
+            // System common messages cancel running status
+            status = 0;
+        }
+        return complete(messageStatus, data[0], expected > 1 ? data[1] : 0);
+    }
+
+    const MidiMessage& message() const { return current; }
+
+    void reset()
+    {
+        status = 0;
+        count = 0;
+        expected = 0;
+    }
+
+    /** Number of data bytes after a status byte (-1 = system exclusive, until 0xF7) */
+    static int getDataLength(const uint8_t statusByte)
+    {
+        switch (statusByte & 0xF0) {
+        case 0xC0:
+        case 0xD0:
+            return 1;
+        case 0xF0:
+            switch (statusByte) {
+            case 0xF0: // system exclusive (until 0xF7)
+                return -1;
+            case 0xF1: // MTC quarter frame
+            case 0xF3: // song select
+                return 1;
+            case 0xF2: // song position
+                return 2;
+            default:
+                return 0;
+            }
+        default:
+            return 2;
+        }
+    }
+
+private:
+    bool complete(const uint8_t messageStatus, const uint8_t data1, const uint8_t data2)
+    {
+        if (messageStatus >= 0xF0) {
+            current.type = MidiType::SYSTEM;
+            current.channel = 0;
+            current.data1 = messageStatus;
+            current.data2 = 0;
+            return true;
+        }
+        current.type = static_cast<MidiType>(messageStatus & 0xF0);
+        current.channel = (messageStatus & 0x0F) + 1;
+        current.data1 = data1;
+        current.data2 = data2;
+        if (current.type == MidiType::NOTE_ON && data2 == 0) {
+            current.type = MidiType::NOTE_OFF;
+        }
+        return true;
+    }
+
+    MidiMessage current;
+    uint8_t status = 0;
+    uint8_t data[2] = {0};
+    int count = 0;
+    int expected = 0;
+};
+
+#endif // !defined(APP_MIDI_PARSER_H)
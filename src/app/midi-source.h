@@ -0,0 +1,148 @@
+#if !defined(APP_MIDI_SOURCE_H)
+#define APP_MIDI_SOURCE_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "app/midi-parser.h"
+
+// Inputs merged into the note state
+enum class MidiSource : uint8_t
+{
+    DIN = 0, // MIDI UART (Serial2)
+    DIN2 = 1, // second MIDI UART (Serial1, when MIDI2_GPIO_RX is set)
+    NETWORK = 2, // RTP-MIDI session
+    PLAYBACK = 3, // song playback
+    COUNT = 4,
+};
+
+inline const char* getMidiSourceName(const MidiSource source)
+{
+    const char* NAMES[] = {
+        "din",
+        "din2",
+        "net",
+        "play",
+    };
+    return NAMES[static_cast<int>(source)];
+}
+
+// Throughput of one source
+struct MidiSourceStats
+{
+    uint32_t bytes = 0; // bytes received (byte sources only)
+    uint32_t messages = 0; // complete messages handed to the note state
+    uint32_t foreignOffs = 0; // Note Offs for notes this source did not hold (ignored)
+    uint32_t held = 0; // notes currently held by this source
+};
+
+// Sources holding each note
+//
+// A note stays pressed while any source holds it, so a Note Off from one source never releases a note that
+// another one still holds.
+class NoteOwnership
+{
+public:
+    static constexpr int NOTES = 128;
+
+    /** @return true if the source did not hold the note yet */
+    bool press(const int note, const MidiSource source)
+    {
+        const uint8_t bit = bitOf(source);
+        if (owners[note] & bit) {
+            return false;
+        }
+        owners[note] |= bit;
+        held[static_cast<int>(source)]++;
+        return true;
+    }
+
+    /** @return false if the source did not hold the note (the Note Off is foreign) */
+    bool release(const int note, const MidiSource source)
+    {
+        const uint8_t bit = bitOf(source);
+        if ((owners[note] & bit) == 0) {
+            return false;
+        }
+        owners[note] &= static_cast<uint8_t>(~bit);
+        held[static_cast<int>(source)]--;
+        return true;
+    }
+
+    bool isHeld(const int note) const { return owners[note] != 0; }
+
+    uint8_t getOwners(const int note) const { return owners[note]; }
+
+    int getHeldCount(const MidiSource source) const { return held[static_cast<int>(source)]; }
+
+    void reset()
+    {
+        for (uint8_t& owner : owners) {
+            owner = 0;
+        }
+        for (int& count : held) {
+            count = 0;
+        }
+    }
+
+    static uint8_t bitOf(const MidiSource source) { return static_cast<uint8_t>(1 << static_cast<int>(source)); }
+
+private:
+    uint8_t owners[NOTES]{};
+    int held[static_cast<int>(MidiSource::COUNT)]{};
+};
+
+static_assert(static_cast<int>(MidiSource::COUNT) <= 8, "NoteOwnership keeps one bit per source");
+
+// Messages parsed from several sources in one pass, handed on in arrival order
+//
+// Arrival is the time the first byte of a message was seen (wrap-around safe); messages with the same arrival keep
+// the order they were added in.
+class MidiMerger
+{
+public:
+    static constexpr size_t CAPACITY = 32;
+
+    struct Entry
+    {
+        uint32_t arrivalUs;
+        MidiSource source;
+        MidiMessage message;
+    };
+
+    bool isFull() const { return count == CAPACITY; }
+
+    size_t size() const { return count; }
+
+    void add(const uint32_t arrivalUs, const MidiSource source, const MidiMessage& message)
+    {
+        if (count == CAPACITY) {
+            return;
+        }
+        size_t index = count;
+        while (index > 0 && static_cast<int32_t>(entries[index - 1].arrivalUs - arrivalUs) > 0) {
+            entries[index] = entries[index - 1];
+            index--;
+        }
+        entries[index] = Entry{arrivalUs, source, message};
+        count++;
+    }
+
+    /** Hand every message on, oldest first, and empty the merger */
+    template <typename Handle>
+    void flush(Handle handle)
+    {
+        for (size_t i = 0; i < count; i++) {
+            handle(entries[i]);
+        }
+        count = 0;
+    }
+
+    void reset() { count = 0; }
+
+private:
+    Entry entries[CAPACITY]{};
+    size_t count = 0;
+};
+
+#endif // !defined(APP_MIDI_SOURCE_H)
@@ -1,13 +1,29 @@
-#include <M5Unified.h>
-#include <MIDI.h>
+#include <atomic>
+#include <cstring>
 
-#include "app/midi.h"
+#if defined(ARDUINO)
+#include "../config.h"
 
-// Total number of MIDI notes (0-127)
-static constexpr int MAX_NOTES = 128;
+#include <Arduino.h>
+#endif
 
-// Duration to temporarily turn off key during repress
-static constexpr unsigned long REPRESS_KEY_OFF_DURATION_MS = 50;
+#include "app/hal.h"
+#include "app/latency.h"
+#include "app/loopback.h"
+#include "app/midi.h"
+#include "app/midi-parser.h"
+#include "app/midi-source.h"
+#include "app/note-mapping.h"
+#include "app/output.h"
+#include "app/power.h"
+#include "app/telemetry.h"
+#include "app/trace.h"
+
+#if defined(ARDUINO)
+#include "app/network-midi.h"
+#include "app/playback.h"
+#include "app/tasks.h"
+#endif
 
 // Global flag to enable/disable sustain pedal processing
 static bool sustainEnabled = false;
@@ -15,8 +31,14 @@ static bool sustainEnabled = false;
 // Key states - timestamp when each note was last pressed (0 = not pressed)
 static unsigned long notes[MAX_NOTES] = {0};
 
-// Physical key press state (true = physically pressed)
-static bool physicallyPressed[MAX_NOTES] = {false};
+// Note On velocity of each note (valid while pressed)
+static uint8_t velocities[MAX_NOTES] = {0};
+
+// Most recent Note On for MIDI-learn (-1 = none since taken)
+static std::atomic<int> learnNote{-1};
+
+// Sources physically holding each note
+static NoteOwnership ownership;
 
 // Timestamps for repressed keys (milliseconds)
 static unsigned long repressedTime[MAX_NOTES] = {};
@@ -24,214 +46,448 @@ static unsigned long repressedTime[MAX_NOTES] = {};
 // Sustain pedal state
 static bool sustainPedal = false;
 
-MIDI_CREATE_INSTANCE(HardwareSerial, Serial2, MIDI);
+// Retrigger guard of the debounce stage (milliseconds, 0 = off)
+static unsigned long debounceGuardMs = 0;
 
-/** MIDI receive task */
-[[noreturn]] void midiTask(void*)
+// Time a Note Off was received while held back by the guard (milliseconds, 0 = none)
+static unsigned long releaseTime[MAX_NOTES] = {};
+
+// Number of notes with a held back Note Off
+static int pendingReleases = 0;
+
+// Time of the last note on/off event (milliseconds)
+static volatile unsigned long lastNoteTime = 0;
+
+// Parser of the song being played back (kept apart from the input stream, which may be mid-message)
+static MidiParser playbackParser;
+
+// Parser of the network MIDI session (complete messages from the RTP-MIDI packets)
+static MidiParser networkParser;
+
+static KeyEstimator keyEstimator;
+
+// MIDI UART with its own parser state (indexes match MidiSource::DIN and MidiSource::DIN2)
+struct UartInput
 {
-    while (true) {
-        if (MIDI.read()) {
-            switch (MIDI.getType()) {
-            case midi::NoteOn:
-                {
-                    const int noteNum = MIDI.getData1();
-                    if (0 <= noteNum && noteNum < MAX_NOTES) {
-                        physicallyPressed[noteNum] = true;
-                        notes[noteNum] = millis();
-                        if (sustainEnabled && sustainPedal && notes[noteNum] != 0) {
-                            // Re-press while pedal is down and note is sustained
-                            repressedTime[noteNum] = millis();
-                        } else {
-                            repressedTime[noteNum] = 0;
-                        }
-                    }
+    MidiParser parser;
+
+    // Time the first byte of the current message was seen (micros, 0 = none)
+    uint32_t arrivalUs = 0;
+
+    // Set when received bytes were lost: the message in progress is dropped instead of being completed with
+    // bytes of the following ones
+    std::atomic<bool> resync{false};
+};
+
+static constexpr int UART_INPUTS = 2;
+static UartInput uartInputs[UART_INPUTS];
+
+// Messages of one pass over the UARTs, merged by arrival time
+static MidiMerger merger;
+
+// Throughput per source (written by the MIDI task)
+static std::atomic<uint32_t> sourceBytes[static_cast<int>(MidiSource::COUNT)];
+static std::atomic<uint32_t> sourceMessages[static_cast<int>(MidiSource::COUNT)];
+static std::atomic<uint32_t> sourceForeignOffs[static_cast<int>(MidiSource::COUNT)];
+static std::atomic<uint32_t> sourceHeld[static_cast<int>(MidiSource::COUNT)];
+
+static void releaseNote(const int noteNum)
+{
+    if (releaseTime[noteNum] != 0) {
+        releaseTime[noteNum] = 0;
+        pendingReleases--;
+    }
+    if (sustainEnabled && sustainPedal && notes[noteNum] != 0) {
+        // Keep note sustained while pedal is down
+    } else {
+        notes[noteNum] = 0;
+    }
+    repressedTime[noteNum] = 0;
+}
+
+/** A source holds the note, or the debounce stage still holds back its release */
+static bool isPressed(const int noteNum)
+{
+    return ownership.isHeld(noteNum) || releaseTime[noteNum] != 0;
+}
+
+/**
+ * Debounce stage for a Note On (constant work per event)
+ *
+ * @return true if the Note On is a glitch to drop: a second Note On within the guard after the press, or the end of
+ *         a Note Off/Note On blip within the guard (the held back Note Off is dropped with it)
+ */
+static bool debounceNoteOn(const int noteNum, const unsigned long now, const bool wasHeld)
+{
+    if (releaseTime[noteNum] != 0) {
+        if (now - releaseTime[noteNum] < debounceGuardMs) {
+            releaseTime[noteNum] = 0;
+            pendingReleases--;
+            countTelemetry(Counter::DEBOUNCED_BLIPS);
+            return true;
+        }
+        // The guard has passed but the release was not applied yet: the note was really released
+        releaseNote(noteNum);
+    } else if (debounceGuardMs > 0 && wasHeld && now - notes[noteNum] < debounceGuardMs) {
+        countTelemetry(Counter::DEBOUNCED_DOUBLES);
+        return true;
+    }
+    return false;
+}
+
+/** Apply the held back Note Offs whose guard has passed */
+static void applyPendingReleases()
+{
+    if (pendingReleases == 0) {
+        return;
+    }
+    const unsigned long now = getHal().clock->millis();
+    for (int i = 0; i < MAX_NOTES; i++) {
+        if (releaseTime[i] != 0 && now - releaseTime[i] >= debounceGuardMs) {
+            releaseNote(i);
+            notifyOutput();
+        }
+    }
+}
+
+static void handleMIDIMessage(const MidiMessage& message, const uint32_t messageArrivalUs, const uint32_t parsedUs,
+                              const MidiSource source)
+{
+    Clock& clock = *getHal().clock;
+    const int sourceIndex = static_cast<int>(source);
+
+    // Channel messages keep the controller out of the idle mode (real-time clock and active sensing do not)
+    const bool woke = message.type != MidiType::SYSTEM && wakePower();
+    LatencySource latencySource = LatencySource::DIN;
+    if (source == MidiSource::NETWORK) {
+        latencySource = LatencySource::NETWORK;
+    } else if (woke) {
+        latencySource = LatencySource::WAKE;
+    }
+
+    countTelemetry(Counter::MIDI_MESSAGES);
+    sourceMessages[sourceIndex].fetch_add(1, std::memory_order_relaxed);
+    if (message.type == MidiType::SYSTEM) {
+        recordTrace(TraceType::MIDI, message.data1, message.data2);
+    } else {
+        recordTrace(TraceType::MIDI, static_cast<uint8_t>(static_cast<uint8_t>(message.type) | (message.channel - 1)),
+                    static_cast<uint16_t>(message.data1 | message.data2 << 8));
+    }
+    switch (message.type) {
+    case MidiType::NOTE_ON:
+        {
+            countTelemetry(Counter::NOTE_ON);
+            const int noteNum = message.data1;
+            lastNoteTime = clock.millis();
+            if (0 <= noteNum && noteNum < MAX_NOTES) {
+                const bool wasHeld = ownership.isHeld(noteNum);
+                if (ownership.press(noteNum, source)) {
+                    sourceHeld[sourceIndex].fetch_add(1, std::memory_order_relaxed);
+                }
+                if (debounceNoteOn(noteNum, clock.millis(), wasHeld)) {
                     break;
                 }
-            case midi::NoteOff:
-                {
-                    const int noteNum = MIDI.getData1();
-                    if (0 <= noteNum && noteNum < MAX_NOTES) {
-                        physicallyPressed[noteNum] = false;
-                        if (sustainEnabled && sustainPedal && notes[noteNum] != 0) {
-                            // Keep note sustained while pedal is down
-                        } else {
-                            notes[noteNum] = 0;
-                        }
-                        repressedTime[noteNum] = 0;
-                    }
+                keyEstimator.addNote(noteNum);
+                learnNote.store(noteNum, std::memory_order_relaxed);
+                const bool sustained = notes[noteNum] != 0;
+                notes[noteNum] = clock.millis();
+                velocities[noteNum] = static_cast<uint8_t>(message.data2);
+                if (sustainEnabled && sustainPedal && sustained) {
+                    // Re-press while pedal is down and note is sustained
+                    repressedTime[noteNum] = clock.millis();
+                } else {
+                    repressedTime[noteNum] = 0;
+                }
+                beginLatencyProbe(messageArrivalUs, parsedUs, latencySource);
+                notifyOutput();
+            }
+            break;
+        }
+    case MidiType::NOTE_OFF:
+        {
+            countTelemetry(Counter::NOTE_OFF);
+            const int noteNum = message.data1;
+            lastNoteTime = clock.millis();
+            if (0 <= noteNum && noteNum < MAX_NOTES) {
+                // Only the sources holding the note can release it, and only the last one does
+                if (!ownership.release(noteNum, source)) {
+                    sourceForeignOffs[sourceIndex].fetch_add(1, std::memory_order_relaxed);
+                    break;
+                }
+                sourceHeld[sourceIndex].fetch_sub(1, std::memory_order_relaxed);
+                if (ownership.isHeld(noteNum)) {
                     break;
                 }
-            case midi::ControlChange:
-                {
-                    const int ccNum = MIDI.getData1();
-                    const int ccValue = MIDI.getData2();
-
-                    // Sustain pedal (CC64)
-                    if (ccNum == midi::MidiControlChangeNumber::Sustain && sustainEnabled) {
-                        sustainPedal = ccValue >= 64;
-                        // If sustain pedal is released, turn off sustained notes except physically pressed ones
-                        if (!sustainPedal) {
-                            for (int i = 0; i < MAX_NOTES; i++) {
-                                if (notes[i] != 0 && !physicallyPressed[i]) {
-                                    notes[i] = 0;
-                                }
-                            }
+                if (debounceGuardMs > 0 && releaseTime[noteNum] == 0) {
+                    // Hold back: a Note On within the guard makes this a glitch
+                    releaseTime[noteNum] = clock.millis();
+                    pendingReleases++;
+                    break;
+                }
+                releaseNote(noteNum);
+                beginLatencyProbe(messageArrivalUs, parsedUs, latencySource);
+                notifyOutput();
+            }
+            break;
+        }
+    case MidiType::CONTROL_CHANGE:
+        {
+            countTelemetry(Counter::CONTROL_CHANGE);
+            const int ccNum = message.data1;
+            const int ccValue = message.data2;
+
+            // Sustain pedal (CC64)
+            if (ccNum == MIDI_CC_SUSTAIN && sustainEnabled) {
+                sustainPedal = ccValue >= 64;
+                // If sustain pedal is released, turn off sustained notes except physically pressed ones
+                if (!sustainPedal) {
+                    for (int i = 0; i < MAX_NOTES; i++) {
+                        if (notes[i] != 0 && !isPressed(i)) {
+                            notes[i] = 0;
                         }
                     }
-                    break;
+                    notifyOutput();
                 }
-            default:
-                break;
             }
+            break;
         }
-        vTaskDelay(1);
+    default:
+        break;
     }
 }
 
-void setupMIDI(const int8_t rxPin, const int8_t txPin)
+/** Hand the merged messages to the note state, oldest first */
+static void flushMerger()
 {
-    Serial2.begin(31250, SERIAL_8N1, rxPin, txPin);
+    const bool loopback = isLoopbackRunning();
+    merger.flush([loopback](const MidiMerger::Entry& entry) {
+        if (loopback && entry.source == MidiSource::DIN) {
+            receiveLoopback(entry.message, entry.arrivalUs, getHal().clock->micros());
+            return;
+        }
+        handleMIDIMessage(entry.message, entry.arrivalUs, getHal().clock->micros(), entry.source);
+    });
+}
 
-    memset(notes, 0, sizeof(unsigned long) * MAX_NOTES);
-    memset(physicallyPressed, false, sizeof(bool) * MAX_NOTES);
-    memset(repressedTime, 0, sizeof(unsigned long) * MAX_NOTES);
-    sustainPedal = false;
+/**
+ * Read one byte of a UART
+ *
+ * @return false if nothing could be read
+ */
+static bool readUartByte(const int index, SerialPort& port)
+{
+    UartInput& input = uartInputs[index];
+    if (input.arrivalUs == 0) {
+        input.arrivalUs = getHal().clock->micros() | 1;
+    }
+    const int byte = port.read();
+    if (byte < 0) {
+        return false;
+    }
+    sourceBytes[index].fetch_add(1, std::memory_order_relaxed);
 
-    MIDI.turnThruOn();
+    // MIDI thru (each port echoes its own input; not on the jumpered DIN port during the loopback self-test)
+    if (index != 0 || !isLoopbackRunning()) {
+        port.write(static_cast<uint8_t>(byte));
+    }
 
-    // Start MIDI receive task
-    xTaskCreatePinnedToCore(
-        midiTask,
-        "midiTask",
-        8192,
-        nullptr,
-        1,
-        nullptr,
-        0
-    );
+    if (input.parser.feed(static_cast<uint8_t>(byte))) {
+        merger.add(input.arrivalUs, static_cast<MidiSource>(index), input.parser.message());
+        input.arrivalUs = 0;
+        if (merger.isFull()) {
+            flushMerger();
+        }
+    }
+    return true;
 }
 
-void setSustainEnabled(const bool enabled)
+void pollMIDI()
 {
-    sustainEnabled = enabled;
+    SerialPort* const ports[UART_INPUTS] = {getHal().midiSerial, getHal().midiSerial2};
+    bool pending[UART_INPUTS] = {};
+    for (int i = 0; i < UART_INPUTS; i++) {
+        if (uartInputs[i].resync.exchange(false)) {
+            uartInputs[i].parser.reset();
+            uartInputs[i].arrivalUs = 0;
+        }
+        pending[i] = ports[i] != nullptr;
+    }
 
-    // If sustain is disabled, immediately turn off all sustained notes
-    if (!enabled && sustainPedal) {
-        for (int i = 0; i < MAX_NOTES; i++) {
-            if (notes[i] != 0 && !physicallyPressed[i]) {
-                notes[i] = 0;
+    // Drain everything buffered (at 31250 baud about 3 bytes arrive per scheduler tick), one byte per port in
+    // turn so that the arrival times of the ports interleave
+    bool reading = true;
+    while (reading) {
+        reading = false;
+        for (int i = 0; i < UART_INPUTS; i++) {
+            if (pending[i]) {
+                pending[i] = ports[i]->available() > 0 && readUartByte(i, *ports[i]);
+                reading = reading || pending[i];
             }
         }
     }
+    flushMerger();
+    applyPendingReleases();
 }
 
-Notes15 getNotes15(const int baseNote, const bool expand)
+void playMIDIMessage(const uint8_t* data, const size_t size, const uint32_t dueUs)
 {
-    // 15 pitches
-    const static int noteMapping[15] = {
-        0, 2, 4, 5, 7, 9, 11, 12, 14, 16, 17, 19, 21, 23, 24,
-    };
-
-    // Initialize output array to 0 (not pressed)
-    unsigned long timestamps[15] = {0};
-
-    const unsigned long currentTime = millis();
-    for (int midiNote = 0; midiNote < MAX_NOTES; midiNote++) {
-        if (notes[midiNote] == 0) {
-            continue;
+    for (size_t i = 0; i < size; i++) {
+        if (playbackParser.feed(data[i])) {
+            handleMIDIMessage(playbackParser.message(), dueUs, getHal().clock->micros(), MidiSource::PLAYBACK);
         }
+    }
+}
 
-        // Handle re-pressed state: return as off for first REPRESS_KEY_OFF_DURATION_MS, then continue normally
-        if (repressedTime[midiNote] > 0) {
-            if (currentTime - repressedTime[midiNote] >= REPRESS_KEY_OFF_DURATION_MS) {
-                repressedTime[midiNote] = 0;
-            } else {
-                continue;
-            }
+void receiveNetworkMIDIMessage(const uint8_t* data, const size_t size, const uint32_t receivedUs)
+{
+    for (size_t i = 0; i < size; i++) {
+        if (networkParser.feed(data[i])) {
+            handleMIDIMessage(networkParser.message(), receivedUs, getHal().clock->micros(), MidiSource::NETWORK);
         }
+    }
+}
 
-        // Apply transpose
-        int targetNote = midiNote - baseNote;
+void notifyMIDI()
+{
+#if defined(ARDUINO)
+    notifyTask(TaskId::INGEST);
+#endif
+}
 
-        // Expand
-        if (expand) {
-            // map all notes
-            while (targetNote < 0) {
-                targetNote += 12;
-            }
-            while (targetNote > 24) {
-                targetNote -= 12;
-            }
-        } else if (targetNote < 0 || targetNote > 24) {
-            // ignore outside
-            continue;
-        }
+#if defined(ARDUINO)
+/** UART receive errors (called from the UART event task) */
+static void handleReceiveError(const hardwareSerial_error_t error, UartInput& input)
+{
+    switch (error) {
+    case UART_FIFO_OVF_ERROR:
+        countTelemetry(Counter::RX_OVERFLOW);
+        input.resync = true;
+        break;
+    case UART_BUFFER_FULL_ERROR:
+        countTelemetry(Counter::RX_BUFFER_FULL);
+        input.resync = true;
+        break;
+    case UART_BREAK_ERROR:
+    case UART_FRAME_ERROR:
+    case UART_PARITY_ERROR:
+        countTelemetry(Counter::RX_ERRORS);
+        break;
+    default:
+        break;
+    }
+}
 
-        // Find corresponding index in 15-pitch array
-        for (int i = 0; i < 15; i++) {
-            if (noteMapping[i] == targetNote) {
-                // Keep the latest timestamp for each position
-                if (timestamps[i] == 0 || notes[midiNote] > timestamps[i]) {
-                    timestamps[i] = notes[midiNote];
-                }
-                break;
-            }
-        }
+/** MIDI receive task */
+[[noreturn]] static void midiTask(void*)
+{
+    while (true) {
+        const int64_t busyStart = beginTaskBusy();
+        pollMIDI();
+        pollNetworkMIDI();
+        pollPlayback();
+        pollLoopback();
+        pollPower();
+        endTaskBusy(TaskId::INGEST, busyStart);
+
+        // Poll the input every tick; the playback timer (song event times) and the network task (queued
+        // commands) wake the task in between
+        takeTaskNotification(TaskId::INGEST, 1);
     }
+}
+#endif
 
-    return Notes15(timestamps);
+void setupMIDI(const int8_t rxPin, const int8_t txPin)
+{
+    memset(notes, 0, sizeof(unsigned long) * MAX_NOTES);
+    memset(velocities, 0, sizeof(velocities));
+    ownership.reset();
+    memset(repressedTime, 0, sizeof(unsigned long) * MAX_NOTES);
+    memset(releaseTime, 0, sizeof(releaseTime));
+    pendingReleases = 0;
+    sustainPedal = false;
+    for (UartInput& input : uartInputs) {
+        input.parser.reset();
+        input.arrivalUs = 0;
+        input.resync = false;
+    }
+    merger.reset();
+    for (std::atomic<uint32_t>& held : sourceHeld) {
+        held = 0;
+    }
+    playbackParser.reset();
+    networkParser.reset();
+    keyEstimator.reset();
+
+#if defined(ARDUINO)
+    // Buffer sizes must be set before begin(); the thru output gets the same room so that forwarding a
+    // backlog after a stall does not block on the line rate
+    Serial2.setRxBufferSize(MIDI_RX_BUFFER_SIZE);
+    Serial2.setTxBufferSize(MIDI_RX_BUFFER_SIZE);
+    Serial2.begin(MIDI_BAUD_RATE, SERIAL_8N1, rxPin, txPin);
+    Serial2.onReceiveError([](const hardwareSerial_error_t error) { handleReceiveError(error, uartInputs[0]); });
+#if defined(MIDI2_GPIO_RX)
+    Serial1.setRxBufferSize(MIDI_RX_BUFFER_SIZE);
+    Serial1.setTxBufferSize(MIDI_RX_BUFFER_SIZE);
+    Serial1.begin(MIDI_BAUD_RATE, SERIAL_8N1, MIDI2_GPIO_RX, MIDI2_GPIO_TX);
+    Serial1.onReceiveError([](const hardwareSerial_error_t error) { handleReceiveError(error, uartInputs[1]); });
+#endif
+
+    // Start MIDI receive task
+    createTask(TaskId::INGEST, midiTask);
+#else
+    // The host stand-ins have no pins
+    (void)rxPin;
+    (void)txPin;
+#endif
 }
 
-void drawKeyboard(const int startY, const int width, const int height, const int baseNote)
+void setSustainEnabled(const bool enabled)
 {
-    const int blackKeyHeight = height * 3 / 5;
+    sustainEnabled = enabled;
 
-    // White keys
-    const int whiteKeyNotes[] = {
-        0, 2, 4, 5, 7, 9, 11, 12, 14, 16, 17, 19, 21, 23, 24, 26, 28, 29, 31, 33, 35,
-    };
-    constexpr int numWhiteKeys = std::size(whiteKeyNotes);
+    // If sustain is disabled, immediately turn off all sustained notes
+    if (!enabled && sustainPedal) {
+        for (int i = 0; i < MAX_NOTES; i++) {
+            if (notes[i] != 0 && !isPressed(i)) {
+                notes[i] = 0;
+            }
+        }
+        notifyOutput();
+    }
+}
 
-    // Black keys
-    const int blackKeyNotes[] = {
-        1, 3, 6, 8, 10, 13, 15, 18, 20, 22, 25, 27, 30, 32, 34,
-    };
-    // Black key positions relative to white keys
-    const int blackKeyPositions[] = {
-        0, 1, 3, 4, 5, 7, 8, 10, 11, 12, 14, 15, 17, 18, 19, 21,
-    };
-    constexpr int numBlackKeys = std::size(blackKeyNotes);
+void setDebounceGuard(const int guardMs)
+{
+    debounceGuardMs = static_cast<unsigned long>(guardMs);
+}
 
-    // Valid keys (C3 to C5)
-    const int validKeyNotes[] = {
-        0, 2, 4, 5, 7, 9, 11, 12, 14, 16, 17, 19, 21, 23, 24,
-    };
+unsigned long getLastNoteTime()
+{
+    return lastNoteTime;
+}
 
-    const int whiteKeyWidth = width / numWhiteKeys;
-    const int blackKeyWidth = whiteKeyWidth * 2 / 3;
+Notes15 getNotes15(const NoteKeyTable& table)
+{
+    return mapNotes15(notes, repressedTime, table, getHal().clock->millis(), velocities);
+}
 
-    int base = baseNote;
-    while (base >= 12) {
-        base -= 12;
-    }
-    bool activeNotes[36] = {false};
-    for (const int validKeyNote : validKeyNotes) {
-        activeNotes[base + validKeyNote] = true;
-    }
+MidiSourceStats getMidiSourceStats(const MidiSource source)
+{
+    const int index = static_cast<int>(source);
+    MidiSourceStats stats;
+    stats.bytes = sourceBytes[index].load(std::memory_order_relaxed);
+    stats.messages = sourceMessages[index].load(std::memory_order_relaxed);
+    stats.foreignOffs = sourceForeignOffs[index].load(std::memory_order_relaxed);
+    stats.held = sourceHeld[index].load(std::memory_order_relaxed);
+    return stats;
+}
 
-    for (int i = 0; i < numWhiteKeys; i++) {
-        const int note = whiteKeyNotes[i];
-        const int x = i * whiteKeyWidth;
-        uint16_t color = activeNotes[note] ? TFT_CYAN : TFT_WHITE;
-        M5.Display.fillRect(x, startY, whiteKeyWidth - 1, height, color);
-        M5.Display.drawRect(x, startY, whiteKeyWidth - 1, height, TFT_BLACK);
-    }
-    for (int i = 0; i < numBlackKeys; i++) {
-        const int pos = blackKeyPositions[i];
-        const int note = blackKeyNotes[i];
-        const int x = pos * whiteKeyWidth + whiteKeyWidth - blackKeyWidth / 2;
-        uint16_t color = activeNotes[note] ? TFT_CYAN : TFT_BLACK;
-        M5.Display.fillRect(x, startY, blackKeyWidth, blackKeyHeight, color);
-        M5.Display.drawRect(x, startY, blackKeyWidth, blackKeyHeight, TFT_BLACK);
-    }
+int takeLearnNote()
+{
+    return learnNote.exchange(-1);
+}
+
+KeyEstimator& getKeyEstimator()
+{
+    return keyEstimator;
 }
@@ -1,14 +1,80 @@
 #if !defined(APP_MIDI_H)
 #define APP_MIDI_H
 
+#include <cstddef>
+#include <cstdint>
+
+#include "app/key-estimator.h"
+#include "app/midi-source.h"
+#include "app/note-mapping.h"
 #include "app/notes.h"
 
+// MIDI DIN: 31250 baud, 10 bits per byte (start, 8 data, stop)
+static constexpr uint32_t MIDI_BAUD_RATE = 31250;
+static constexpr uint32_t MIDI_BYTES_PER_SECOND = MIDI_BAUD_RATE / 10;
+
+// Longest time the MIDI task may be kept from reading (flash writes, higher priority work on its core)
+static constexpr uint32_t MIDI_RX_STALL_BUDGET_MS = 250;
+
+// UART receive buffer: holds a saturated input stream for the whole stall budget (1024 bytes = 327 ms)
+static constexpr size_t MIDI_RX_BUFFER_SIZE = 1024;
+
+static_assert(MIDI_RX_BUFFER_SIZE >= MIDI_BYTES_PER_SECOND * MIDI_RX_STALL_BUDGET_MS / 1000,
+              "MIDI_RX_BUFFER_SIZE must cover MIDI_RX_STALL_BUDGET_MS of saturated input");
+
 void setupMIDI(int8_t rxPin, int8_t txPin);
 
+/** Process all received MIDI input (called by the MIDI task; call directly where there is no task) */
+void pollMIDI();
+
+/**
+ * Handle a complete message from song playback as if it had been received (MIDI task only)
+ *
+ * @param dueUs time the message was due, taken as its arrival for the latency probe
+ */
+void playMIDIMessage(const uint8_t* data, size_t size, uint32_t dueUs);
+
+/**
+ * Handle a complete message from the network MIDI session (MIDI task only)
+ *
+ * @param receivedUs time the packet carrying the message was received (start of the network latency probe)
+ */
+void receiveNetworkMIDIMessage(const uint8_t* data, size_t size, uint32_t receivedUs);
+
+/**
+ * Throughput and held notes of an input
+ *
+ * The inputs share one note state: a note stays pressed while any input holds it, and a Note Off from an input
+ * that does not hold the note is ignored (counted as foreign).
+ */
+MidiSourceStats getMidiSourceStats(MidiSource source);
+
+/** Wake the MIDI task before its next tick (song playback timer) */
+void notifyMIDI();
+
+// Longest configurable retrigger guard
+static constexpr int DEBOUNCE_GUARD_MAX_MS = 50;
+
 void setSustainEnabled(bool enabled);
 
-Notes15 getNotes15(int baseNote, bool expand);
+/**
+ * Retrigger guard of the debounce stage (0 = off)
+ *
+ * Within the guard after a press, a repeated Note On for the held note is dropped; a Note Off is held back for the
+ * guard and dropped together with a Note On of the same note that follows within it. Releases are delayed by the
+ * guard while it is on.
+ */
+void setDebounceGuard(int guardMs);
+
+unsigned long getLastNoteTime();
+
+/** Sky keys of the held notes, mapped with a table from buildNoteKeyTable() */
+Notes15 getNotes15(const NoteKeyTable& table);
+
+/** Most recent Note On since the previous call, for MIDI-learn (-1 if none) */
+int takeLearnNote();
 
-void drawKeyboard(int startY, int width, int height, int baseNote);
+/** Key estimator fed with every Note On */
+KeyEstimator& getKeyEstimator();
 
 #endif // !defined(APP_MIDI_H)
@@ -0,0 +1,376 @@
+#include <atomic>
+#include <cstring>
+
+#if defined(ARDUINO)
+#include "../config.h"
+
+#include <ESPmDNS.h>
+#include <WiFi.h>
+#include <WiFiUdp.h>
+#endif
+
+#include "app/hal.h"
+#include "app/midi.h"
+#include "app/network-midi.h"
+
+#if defined(ARDUINO)
+#include "app/tasks.h"
+#endif
+
+#if !defined(NETWORK_MIDI)
+#define NETWORK_MIDI 0
+#endif
+
+#if NETWORK_MIDI && !defined(WIFI_SSID)
+#error "NETWORK_MIDI needs WIFI_SSID and WIFI_PASSWORD in config.h"
+#endif
+
+#if !defined(NETWORK_MIDI_HOSTNAME)
+#define NETWORK_MIDI_HOSTNAME "m5-midi-sky"
+#endif
+
+static DatagramPort* controlPort = nullptr;
+static DatagramPort* dataPort = nullptr;
+static char sessionName[APPLE_MIDI_NAME_MAX] = {};
+static uint32_t localSsrc = 0;
+
+// Session state (network task only)
+static bool controlAccepted = false;
+static bool connected = false;
+static uint32_t peerSsrc = 0;
+static RtpSequenceTracker sequence;
+static RtpJitterBuffer jitterBuffer;
+
+// Notes held by the peer, released when the session ends
+static bool heldNotes[128] = {};
+
+// Received packet, parsed in place
+static uint8_t packet[NETWORK_MIDI_PACKET_SIZE];
+
+// Monotonic local time for the jitter buffer and clock sync (network task only)
+static int64_t localUs = 0;
+static uint32_t lastMicros = 0;
+
+static std::atomic<int> requestedJitterMs{0};
+
+// Commands on their way to the MIDI task
+static RtpCommandQueue commandQueue;
+
+// Statistics kept by the network task and published under statusLock
+static NetworkMidiStatus sessionStatus;
+static NetworkMidiStatus publishedStatus;
+static CriticalSection statusLock;
+static bool statusChanged = false;
+
+#if defined(ARDUINO) && NETWORK_MIDI
+/** WiFiUDP socket */
+class WiFiDatagramPort final : public DatagramPort
+{
+public:
+    bool begin(const uint16_t port) { return udp.begin(port) == 1; }
+
+    int receive(uint8_t* buffer, const size_t size, DatagramAddress& from) override
+    {
+        if (udp.parsePacket() <= 0) {
+            return -1;
+        }
+        const IPAddress ip = udp.remoteIP();
+        from = {static_cast<uint32_t>(ip[0]) << 24 | static_cast<uint32_t>(ip[1]) << 16 |
+                    static_cast<uint32_t>(ip[2]) << 8 | ip[3],
+                udp.remotePort()};
+        const int length = udp.read(buffer, size);
+        return length < 0 ? 0 : length;
+    }
+
+    bool send(const DatagramAddress& to, const uint8_t* data, const size_t size) override
+    {
+        const IPAddress ip(to.ip >> 24, to.ip >> 16 & 0xFF, to.ip >> 8 & 0xFF, to.ip & 0xFF);
+        return udp.beginPacket(ip, to.port) == 1 && udp.write(data, size) == size && udp.endPacket() == 1;
+    }
+
+private:
+    WiFiUDP udp;
+};
+
+static WiFiDatagramPort wifiControlPort;
+static WiFiDatagramPort wifiDataPort;
+static bool mdnsStarted = false;
+#endif
+
+static int64_t getLocalMicros()
+{
+    const uint32_t now = getHal().clock->micros();
+    localUs += static_cast<uint32_t>(now - lastMicros);
+    lastMicros = now;
+    return localUs;
+}
+
+/** Queue a command for the MIDI input, keeping track of the notes held by the peer */
+static void dispatchCommand(const uint8_t* data, const size_t size, const uint32_t receivedUs)
+{
+    const uint8_t type = data[0] & 0xF0;
+    if (size == 3 && (type == 0x90 || type == 0x80)) {
+        heldNotes[data[1]] = type == 0x90 && data[2] != 0;
+    }
+    // Never drop a command (a lost Note Off would hang the key): wait for the MIDI task to make room
+    while (!commandQueue.push(data, size, receivedUs)) {
+#if defined(ARDUINO)
+        notifyMIDI();
+        vTaskDelay(1);
+#else
+        pollNetworkMIDI();
+#endif
+    }
+    sessionStatus.commands++;
+    statusChanged = true;
+}
+
+static void dispatchEvent(const RtpJitterBuffer::Event& event)
+{
+    dispatchCommand(event.data, event.size, event.receivedUs);
+}
+
+static void endSession()
+{
+    jitterBuffer.flush(dispatchEvent);
+    jitterBuffer.reset();
+
+    // Release what the peer still holds, as if it had sent the Note Offs
+    const uint32_t now = getHal().clock->micros();
+    for (int i = 0; i < 128; i++) {
+        if (heldNotes[i]) {
+            const uint8_t noteOff[] = {0x80, static_cast<uint8_t>(i), 0};
+            dispatchCommand(noteOff, sizeof(noteOff), now);
+        }
+    }
+
+    controlAccepted = false;
+    connected = false;
+    peerSsrc = 0;
+    sequence.reset();
+    sessionStatus.connected = false;
+    statusChanged = true;
+}
+
+static void reply(DatagramPort& port, const DatagramAddress& to, const uint16_t command, const uint32_t token)
+{
+    // Only an acceptance carries our name
+    const char* name = command == APPLE_MIDI_ACCEPTED ? sessionName : nullptr;
+    uint8_t buffer[APPLE_MIDI_INVITATION_SIZE + APPLE_MIDI_NAME_MAX];
+    port.send(to, buffer, buildAppleMidiSession(command, token, localSsrc, name, buffer, sizeof(buffer)));
+}
+
+static void handleSessionPacket(DatagramPort& port, const bool isDataPort, const AppleMidiPacket& session,
+                                const DatagramAddress& from)
+{
+    switch (session.command) {
+    case APPLE_MIDI_INVITATION:
+        if (session.version != APPLE_MIDI_PROTOCOL_VERSION) {
+            reply(port, from, APPLE_MIDI_REJECTED, session.token);
+            break;
+        }
+        if (!isDataPort) {
+            // A new peer replaces the current session
+            if ((controlAccepted || connected) && session.ssrc != peerSsrc) {
+                endSession();
+            }
+            controlAccepted = true;
+            peerSsrc = session.ssrc;
+            strncpy(sessionStatus.peer, session.name != nullptr ? session.name : "", APPLE_MIDI_NAME_MAX - 1);
+            sessionStatus.peer[APPLE_MIDI_NAME_MAX - 1] = '\0';
+        } else if (!controlAccepted || session.ssrc != peerSsrc) {
+            reply(port, from, APPLE_MIDI_REJECTED, session.token);
+            break;
+        } else {
+            connected = true;
+            sequence.reset();
+            jitterBuffer.reset();
+            sessionStatus.connected = true;
+        }
+        statusChanged = true;
+        reply(port, from, APPLE_MIDI_ACCEPTED, session.token);
+        break;
+    case APPLE_MIDI_END:
+        if ((controlAccepted || connected) && session.ssrc == peerSsrc) {
+            endSession();
+        }
+        break;
+    case APPLE_MIDI_SYNC:
+        // The initiator keeps the clock: answer its first timestamp with ours
+        if (session.count == 0) {
+            const uint64_t timestamps[3] = {session.timestamps[0],
+                                            static_cast<uint64_t>(getLocalMicros() / RTP_MIDI_TICK_US), 0};
+            uint8_t buffer[APPLE_MIDI_SYNC_SIZE];
+            port.send(from, buffer, buildAppleMidiSync(localSsrc, 1, timestamps, buffer, sizeof(buffer)));
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static void handleRtpMidi(const size_t size)
+{
+    RtpHeader header;
+    size_t offset = 0;
+    if (!connected || !parseRtpHeader(packet, size, header, offset) || header.ssrc != peerSsrc) {
+        return;
+    }
+    const uint32_t receivedUs = getHal().clock->micros();
+    const int64_t nowUs = getLocalMicros();
+
+    sessionStatus.packets++;
+    if (sequence.update(header.sequence) == RtpSequenceTracker::Result::LATE) {
+        sessionStatus.reordered++;
+    }
+    sessionStatus.lost = sequence.getLost();
+    statusChanged = true;
+
+    const bool buffered = jitterBuffer.getDelay() > 0;
+    if (buffered) {
+        jitterBuffer.beginPacket(header.timestamp, nowUs);
+    }
+    parseRtpMidi(packet, size, header, [&](const RtpMidiCommand& command) {
+        // Channel and system common/real-time messages only (the input ignores system exclusive)
+        if (command.status == 0xF0 || command.length > RtpJitterBuffer::EVENT_MAX - 1) {
+            return;
+        }
+        uint8_t message[RtpJitterBuffer::EVENT_MAX];
+        message[0] = command.status;
+        memcpy(message + 1, command.data, command.length);
+        if (!buffered) {
+            dispatchCommand(message, command.length + 1, receivedUs);
+        } else if (jitterBuffer.push(command.timestamp, message, command.length + 1, receivedUs, nowUs,
+                                     dispatchEvent)) {
+            sessionStatus.late++;
+        }
+    });
+}
+
+/** Read the packets waiting on a port, at most NETWORK_MIDI_PACKETS_PER_POLL */
+static void pollPort(DatagramPort& port, const bool isDataPort)
+{
+    DatagramAddress from;
+    for (int i = 0; i < NETWORK_MIDI_PACKETS_PER_POLL; i++) {
+        const int size = port.receive(packet, sizeof(packet), from);
+        if (size < 0) {
+            break;
+        }
+        AppleMidiPacket session;
+        if (parseAppleMidiPacket(packet, static_cast<size_t>(size), session)) {
+            handleSessionPacket(port, isDataPort, session, from);
+        } else if (isDataPort) {
+            handleRtpMidi(static_cast<size_t>(size));
+        }
+    }
+}
+
+void setupNetworkMIDI(const char* name, DatagramPort* control, DatagramPort* data)
+{
+    controlPort = control;
+    dataPort = data;
+    strncpy(sessionName, name, sizeof(sessionName) - 1);
+    sessionName[sizeof(sessionName) - 1] = '\0';
+    lastMicros = getHal().clock->micros();
+    localUs = 0;
+    localSsrc = lastMicros | 1;
+
+    controlAccepted = false;
+    connected = false;
+    peerSsrc = 0;
+    sequence.reset();
+    jitterBuffer.reset();
+    jitterBuffer.setDelay(0);
+    memset(heldNotes, 0, sizeof(heldNotes));
+    commandQueue.reset();
+    sessionStatus = NetworkMidiStatus();
+    statusChanged = true;
+}
+
+#if defined(ARDUINO) && NETWORK_MIDI
+/** Network task: sockets, session and jitter buffer, once per tick */
+[[noreturn]] static void networkTask(void*)
+{
+    while (true) {
+        const int64_t busyStart = beginTaskBusy();
+        serviceNetworkMIDI();
+        endTaskBusy(TaskId::NETWORK, busyStart);
+        if (!commandQueue.empty()) {
+            notifyMIDI();
+        }
+        vTaskDelay(1);
+    }
+}
+#endif
+
+void setupNetworkMIDI(const char* name)
+{
+#if defined(ARDUINO) && NETWORK_MIDI
+    WiFi.mode(WIFI_STA);
+    WiFi.setSleep(false);
+    WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
+    wifiControlPort.begin(APPLE_MIDI_CONTROL_PORT);
+    wifiDataPort.begin(APPLE_MIDI_CONTROL_PORT + 1);
+    setupNetworkMIDI(name, &wifiControlPort, &wifiDataPort);
+    createTask(TaskId::NETWORK, networkTask);
+#else
+    (void)name;
+#endif
+}
+
+void serviceNetworkMIDI()
+{
+    if (controlPort == nullptr || dataPort == nullptr) {
+        return;
+    }
+
+#if defined(ARDUINO) && NETWORK_MIDI
+    // Announce the session once an address has been obtained
+    if (!mdnsStarted && WiFi.status() == WL_CONNECTED) {
+        mdnsStarted = MDNS.begin(NETWORK_MIDI_HOSTNAME);
+        if (mdnsStarted) {
+            MDNS.addService("apple-midi", "udp", APPLE_MIDI_CONTROL_PORT);
+        }
+    }
+#endif
+
+    const uint32_t jitterUs = static_cast<uint32_t>(requestedJitterMs.load()) * 1000;
+    if (jitterUs != jitterBuffer.getDelay()) {
+        jitterBuffer.flush(dispatchEvent);
+        jitterBuffer.reset();
+        jitterBuffer.setDelay(jitterUs);
+        sessionStatus.jitterMs = jitterUs / 1000;
+        statusChanged = true;
+    }
+
+    pollPort(*controlPort, false);
+    pollPort(*dataPort, true);
+    jitterBuffer.release(getLocalMicros(), dispatchEvent);
+
+    if (statusChanged) {
+        statusChanged = false;
+        statusLock.enter();
+        publishedStatus = sessionStatus;
+        statusLock.exit();
+    }
+}
+
+void pollNetworkMIDI()
+{
+    commandQueue.drain([](const RtpCommandQueue::Command& command) {
+        receiveNetworkMIDIMessage(command.data, command.size, command.receivedUs);
+    });
+}
+
+void setNetworkJitter(const int jitterMs)
+{
+    requestedJitterMs = jitterMs;
+}
+
+NetworkMidiStatus getNetworkMidiStatus()
+{
+    statusLock.enter();
+    const NetworkMidiStatus status = publishedStatus;
+    statusLock.exit();
+    return status;
+}
@@ -0,0 +1,62 @@
+#if !defined(APP_NETWORK_MIDI_H)
+#define APP_NETWORK_MIDI_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "app/hal.h"
+#include "app/rtp-midi.h"
+
+// Longest configurable jitter buffer delay
+static constexpr int NETWORK_JITTER_MAX_MS = 20;
+
+// Largest RTP-MIDI packet read (longer ones are truncated and their MIDI list rejected)
+static constexpr size_t NETWORK_MIDI_PACKET_SIZE = 512;
+
+// Packets read per port in one pass of the network task (the rest waits in the socket for the next pass)
+static constexpr int NETWORK_MIDI_PACKETS_PER_POLL = 4;
+
+struct NetworkMidiStatus
+{
+    bool connected = false;
+    char peer[APPLE_MIDI_NAME_MAX] = {}; // session name of the peer
+    uint32_t packets = 0; // RTP-MIDI packets received
+    uint32_t commands = 0; // MIDI commands handed to the input
+    uint32_t lost = 0; // packets skipped in the sequence and never received
+    uint32_t reordered = 0; // packets older than one already received
+    uint32_t late = 0; // commands that arrived after their playout time
+    uint32_t jitterMs = 0;
+};
+
+/**
+ * Accept AppleMIDI sessions on a control and a data port (control port + 1)
+ *
+ * One peer at a time: an invitation from another peer replaces the current session. With ARDUINO and
+ * NETWORK_MIDI set in config.h, setupNetworkMIDI(name) joins Wi-Fi, announces the session over mDNS and starts
+ * the network task. All socket work runs there, below the MIDI task's priority, so the UART input is never
+ * held up by the network; the MIDI task only takes the commands it queued.
+ */
+void setupNetworkMIDI(const char* name, DatagramPort* control, DatagramPort* data);
+
+void setupNetworkMIDI(const char* name);
+
+/**
+ * Answer session packets and queue the due MIDI commands for the MIDI task
+ *
+ * Called by the network task; call directly where there is no task.
+ */
+void serviceNetworkMIDI();
+
+/** Pass the commands queued by serviceNetworkMIDI() to the MIDI input (called by the MIDI task) */
+void pollNetworkMIDI();
+
+/**
+ * Jitter buffer delay (0 = hand commands on as packets arrive)
+ *
+ * With a delay, commands are played out at their session timestamp plus the delay, in timestamp order.
+ */
+void setNetworkJitter(int jitterMs);
+
+NetworkMidiStatus getNetworkMidiStatus();
+
+#endif // !defined(APP_NETWORK_MIDI_H)
@@ -0,0 +1,220 @@
+#if !defined(APP_NOTE_MAPPING_H)
+#define APP_NOTE_MAPPING_H
+
+#include <cstdint>
+#include <cstring>
+
+#include "app/notes.h"
+
+// Total number of MIDI notes (0-127)
+static constexpr int MAX_NOTES = 128;
+
+// Duration to temporarily turn off key during repress
+static constexpr unsigned long REPRESS_KEY_OFF_DURATION_MS = 50;
+
+// Pitch (semitones above base note) of each of the 15 Sky keys
+static constexpr int SKY_KEY_PITCHES[15] = {
+    0, 2, 4, 5, 7, 9, 11, 12, 14, 16, 17, 19, 21, 23, 24,
+};
+
+// Out-of-range handling of expand mode
+enum class FoldStrategy : uint8_t
+{
+    DROP = 0, // ignore notes outside the window
+    NEAREST = 1, // shift by octaves to the nearest pitch inside the window
+    CLAMP = 2, // play the window edge (lowest or highest key)
+    COUNT = 3,
+};
+
+static constexpr const char* FOLD_STRATEGY_NAMES[] = {"drop", "nearest", "clamp"};
+
+// Fold windows (pitches above the base note) with a split: the lower zone folds into the first octave and the
+// upper zone into the second, so bass and melody keep apart
+static constexpr int FOLD_WINDOW_MAX = 24;
+static constexpr int SPLIT_LOWER_WINDOW_MAX = 12;
+static constexpr int SPLIT_UPPER_WINDOW_MIN = 12;
+
+inline const char* getFoldStrategyName(const FoldStrategy fold)
+{
+    return fold < FoldStrategy::COUNT ? FOLD_STRATEGY_NAMES[static_cast<int>(fold)] : "?";
+}
+
+/** @return false if the name is unknown */
+inline bool parseFoldStrategy(const char* name, FoldStrategy& fold)
+{
+    for (int i = 0; i < static_cast<int>(FoldStrategy::COUNT); i++) {
+        if (strcmp(name, FOLD_STRATEGY_NAMES[i]) == 0) {
+            fold = static_cast<FoldStrategy>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Move a pitch into a window
+ *
+ * @return pitch inside [low, high], or -1 if dropped
+ */
+inline int foldPitch(int pitch, const FoldStrategy fold, const int low, const int high)
+{
+    if (low <= pitch && pitch <= high) {
+        return pitch;
+    }
+    switch (fold) {
+    case FoldStrategy::NEAREST:
+        while (pitch < low) {
+            pitch += 12;
+        }
+        while (pitch > high) {
+            pitch -= 12;
+        }
+        // A window narrower than an octave may not hold the pitch class
+        return pitch >= low ? pitch : -1;
+    case FoldStrategy::CLAMP:
+        return pitch < low ? low : high;
+    default:
+        return -1;
+    }
+}
+
+// Sky key of each MIDI note (-1 = not played), compiled from the settings
+struct NoteKeyTable
+{
+    int8_t keys[MAX_NOTES];
+};
+
+/**
+ * Compile the note to key mapping (at settings change, not per report)
+ *
+ * @param baseNote MIDI note mapped to the first key
+ * @param expand Map notes outside the range with the fold strategy (and split), otherwise drop them
+ * @param fold Strategy for notes outside their window
+ * @param split With expand, notes below this MIDI note fold into the lower octave and the others into the upper
+ *              one (0 = no split)
+ */
+inline NoteKeyTable buildNoteKeyTable(const int baseNote, const bool expand,
+                                      const FoldStrategy fold = FoldStrategy::NEAREST, const int split = 0)
+{
+    NoteKeyTable table{};
+    for (int midiNote = 0; midiNote < MAX_NOTES; midiNote++) {
+        int low = 0;
+        int high = FOLD_WINDOW_MAX;
+        if (expand && split > 0) {
+            low = midiNote < split ? 0 : SPLIT_UPPER_WINDOW_MIN;
+            high = midiNote < split ? SPLIT_LOWER_WINDOW_MAX : FOLD_WINDOW_MAX;
+        }
+        const int pitch = foldPitch(midiNote - baseNote, expand ? fold : FoldStrategy::DROP, low, high);
+
+        // Find corresponding index in 15-pitch array
+        table.keys[midiNote] = -1;
+        for (int i = 0; i < 15; i++) {
+            if (SKY_KEY_PITCHES[i] == pitch) {
+                table.keys[midiNote] = static_cast<int8_t>(i);
+                break;
+            }
+        }
+    }
+    return table;
+}
+
+// Bindings edited per Sky key on top of the note layout (MIDI-learn)
+//
+// Values are stored plus one so that a zeroed struct changes nothing.
+struct KeyBindings
+{
+    uint8_t notes[15] = {}; // MIDI note + 1 that plays the key, 0 = layout only
+    uint8_t actions[15] = {}; // key (+ 1) whose controller action the key presses, 0 = its own
+
+    /** @return MIDI note bound to the key, or -1 */
+    int getNote(const int key) const { return notes[key] - 1; }
+
+    /** @return key whose mapping entry the key presses */
+    int getAction(const int key) const { return actions[key] != 0 ? actions[key] - 1 : key; }
+
+    /** Bind a MIDI note to a key (-1 = unbind); a note plays one key only */
+    void setNote(const int key, const int note)
+    {
+        for (uint8_t& bound : notes) {
+            if (note >= 0 && bound == note + 1) {
+                bound = 0;
+            }
+        }
+        notes[key] = static_cast<uint8_t>(note + 1);
+    }
+
+    void setAction(const int key, const int action)
+    {
+        actions[key] = action == key ? 0 : static_cast<uint8_t>(action + 1);
+    }
+
+    bool operator==(const KeyBindings& other) const
+    {
+        return memcmp(notes, other.notes, sizeof(notes)) == 0 && memcmp(actions, other.actions, sizeof(actions)) == 0;
+    }
+
+    bool operator!=(const KeyBindings& other) const { return !(*this == other); }
+};
+
+/** Compile key bindings into a note table (at settings change; lookups stay one table read per note) */
+inline void applyKeyBindings(NoteKeyTable& table, const KeyBindings& bindings)
+{
+    for (int key = 0; key < 15; key++) {
+        const int note = bindings.getNote(key);
+        if (0 <= note && note < MAX_NOTES) {
+            table.keys[note] = static_cast<int8_t>(key);
+        }
+    }
+    for (int8_t& key : table.keys) {
+        if (key >= 0) {
+            key = static_cast<int8_t>(bindings.getAction(key));
+        }
+    }
+}
+
+/**
+ * Map MIDI note states to the 15 Sky keys
+ *
+ * @param notes Timestamp each MIDI note was pressed (0 = not pressed)
+ * @param repressedTime Timestamp each note was re-pressed under sustain; cleared once the off period has passed
+ * @param table Key of each MIDI note (buildNoteKeyTable())
+ * @param currentTime Current time (milliseconds)
+ * @param velocities Note On velocity of each MIDI note (nullptr = NOTE_VELOCITY_DEFAULT)
+ */
+inline Notes15 mapNotes15(const unsigned long notes[MAX_NOTES], unsigned long repressedTime[MAX_NOTES],
+                          const NoteKeyTable& table, const unsigned long currentTime,
+                          const uint8_t velocities[MAX_NOTES] = nullptr)
+{
+    // Initialize output array to 0 (not pressed)
+    unsigned long timestamps[15] = {0};
+    uint8_t keyVelocities[15] = {0};
+
+    for (int midiNote = 0; midiNote < MAX_NOTES; midiNote++) {
+        if (notes[midiNote] == 0) {
+            continue;
+        }
+
+        // Handle re-pressed state: return as off for first REPRESS_KEY_OFF_DURATION_MS, then continue normally
+        if (repressedTime[midiNote] > 0) {
+            if (currentTime - repressedTime[midiNote] >= REPRESS_KEY_OFF_DURATION_MS) {
+                repressedTime[midiNote] = 0;
+            } else {
+                continue;
+            }
+        }
+
+        const int i = table.keys[midiNote];
+        if (i < 0) {
+            continue;
+        }
+        // Keep the latest timestamp (and its velocity) for each position
+        if (timestamps[i] == 0 || notes[midiNote] > timestamps[i]) {
+            timestamps[i] = notes[midiNote];
+            keyVelocities[i] = velocities != nullptr ? velocities[midiNote] : NOTE_VELOCITY_DEFAULT;
+        }
+    }
+
+    return Notes15(timestamps, keyVelocities);
+}
+
+#endif // !defined(APP_NOTE_MAPPING_H)
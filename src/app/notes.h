@@ -1,6 +1,11 @@
 #if !defined(APP_NOTES_H)
 #define APP_NOTES_H
 
+#include <cstdint>
+
+// Velocity of pressed keys whose source gives none
+static constexpr uint8_t NOTE_VELOCITY_DEFAULT = 127;
+
 class Notes15
 {
 public:
@@ -10,6 +15,15 @@ public:
     {
         for (int i = 0; i < 15; i++) {
             this->timestamps[i] = timestamps[i];
+            velocities[i] = timestamps[i] != 0 ? NOTE_VELOCITY_DEFAULT : 0;
+        }
+    }
+
+    Notes15(const unsigned long timestamps[15], const uint8_t velocities[15])
+    {
+        for (int i = 0; i < 15; i++) {
+            this->timestamps[i] = timestamps[i];
+            this->velocities[i] = timestamps[i] != 0 ? velocities[i] : 0;
         }
     }
 
@@ -21,10 +35,30 @@ public:
         return 0;
     }
 
+    /** Note On velocity (1-127) of a pressed key, 0 if released */
+    uint8_t getVelocity(const int index) const
+    {
+        if (index >= 0 && index < 15) {
+            return velocities[index];
+        }
+        return 0;
+    }
+
+    /** Whether any key is pressed */
+    bool any() const
+    {
+        for (const unsigned long timestamp : timestamps) {
+            if (timestamp != 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
     bool operator!=(const Notes15& other) const
     {
         for (int i = 0; i < 15; i++) {
-            if (timestamps[i] != other.timestamps[i]) {
+            if (timestamps[i] != other.timestamps[i] || velocities[i] != other.velocities[i]) {
                 return true;
             }
         }
@@ -33,6 +67,7 @@ public:
 
 private:
     unsigned long timestamps[15]{};
+    uint8_t velocities[15]{};
 };
 
 // Stateful filter to prevent old notes from reappearing
@@ -42,6 +77,7 @@ public:
     Notes15 latest(const Notes15& notes15, const int num)
     {
         unsigned long newTimestamps[15] = {0};
+        uint8_t newVelocities[15] = {0};
         bool used[15] = {false};
 
         for (int n = 0; n < num; n++) {
@@ -59,20 +95,29 @@ public:
                 break;
             }
             newTimestamps[maxIdx] = maxVal;
+            newVelocities[maxIdx] = notes15.getVelocity(maxIdx);
             used[maxIdx] = true;
         }
 
         // Update cutoff threshold: find the oldest unselected note that's newer than current cutoff
         unsigned long maxUnselectedTimestamp = cutoffThreshold;
+        unsigned long oldestSelectedTimestamp = 0;
         for (int i = 0; i < 15; i++) {
             const unsigned long timestamp = notes15.get(i);
             if (!used[i] && timestamp > cutoffThreshold && timestamp > maxUnselectedTimestamp) {
                 maxUnselectedTimestamp = timestamp;
             }
+            if (used[i] && (oldestSelectedTimestamp == 0 || newTimestamps[i] < oldestSelectedTimestamp)) {
+                oldestSelectedTimestamp = newTimestamps[i];
+            }
+        }
+        // Never cut off selected notes (chord notes often share a timestamp)
+        if (oldestSelectedTimestamp != 0 && maxUnselectedTimestamp >= oldestSelectedTimestamp) {
+            maxUnselectedTimestamp = oldestSelectedTimestamp - 1;
         }
         cutoffThreshold = maxUnselectedTimestamp;
 
-        return Notes15(newTimestamps);
+        return Notes15(newTimestamps, newVelocities);
     }
 
 private:
@@ -0,0 +1,193 @@
+#include <atomic>
+
+#include "app/hal.h"
+#include "app/latency.h"
+#include "app/midi.h"
+#include "app/output.h"
+#include "app/report.h"
+#include "app/strum.h"
+#include "app/trace.h"
+
+#if defined(ARDUINO)
+#include "app/tasks.h"
+#endif
+
+// Other settings used by the output task
+static std::atomic<bool> outputForce{true};
+static std::atomic<uint32_t> outputStrumUs{0};
+static std::atomic<ConflictPolicy> outputConflict{ConflictPolicy::LAST};
+
+// Set when the note table must be rebuilt from outputTableSettings
+static std::atomic<bool> outputTableDirty{true};
+
+// Latest notes sent, for the UI, and the note table settings (changed and read as a whole); guarded by outputLock
+static Notes15 outputNotes15;
+static OutputTableSettings outputTableSettings;
+static CriticalSection outputLock;
+
+// Mapping the current note table was built for (only touched by the output task)
+static int tableMapping = 1;
+
+// Notes of the last report (only touched by the output task)
+static Notes15 prevNotes15;
+
+// Key of each MIDI note for the current settings (only touched by the output task)
+static NoteKeyTable noteKeyTable;
+
+// Spreads chord presses over consecutive reports (only touched by the output task)
+static StrumScheduler strum;
+
+#if defined(ARDUINO)
+// One-shot timer waking the output task when the next strummed press is due
+static esp_timer_handle_t strumTimer = nullptr;
+
+static void onStrumTimer(void*)
+{
+    notifyTask(TaskId::OUTPUT);
+}
+#endif
+
+void runOutput()
+{
+    startLatencyTrace();
+
+    if (outputTableDirty.exchange(false)) {
+        outputLock.enter();
+        const OutputTableSettings settings = outputTableSettings;
+        outputLock.exit();
+        tableMapping = settings.mapping;
+#if !defined(MODE_TEST)
+        noteKeyTable = buildNoteKeyTable(settings.baseNote, settings.expand, settings.fold, settings.split);
+        applyKeyBindings(noteKeyTable, settings.bindings);
+#endif
+    }
+
+#if defined(MODE_TEST)
+    // test mode
+    static int testIndex = 14;
+    static unsigned long testPrevTs = 0;
+    const unsigned long ts = getHal().clock->millis();
+    if (ts - testPrevTs > 500) {
+        testPrevTs = ts;
+        testIndex = ++testIndex % 15;
+    }
+    unsigned long testTimestamps[15] = {0};
+    testTimestamps[testIndex] = ts;
+    const Notes15 played{testTimestamps};
+#else
+    const Notes15 played = getNotes15(noteKeyTable);
+#endif
+    markLatency(LatencyStage::MAPPING);
+
+    // Chord presses go out one report at a time when strumming is on
+    const uint32_t nowUs = getHal().clock->micros();
+    strum.setSpacing(outputStrumUs.load());
+    const Notes15 notes15 = strum.update(played, nowUs);
+
+    // Update controller if there are changes
+    if (outputForce.exchange(false) || notes15 != prevNotes15) {
+        const uint16_t keys = getPressedKeys(notes15);
+        recordTrace(TraceType::NOTES, static_cast<uint8_t>(__builtin_popcount(keys)), keys);
+        getHal().hid->send(notes15, tableMapping);
+
+        outputLock.enter();
+        outputNotes15 = notes15;
+        outputLock.exit();
+
+        prevNotes15 = notes15;
+    }
+
+#if defined(ARDUINO)
+    // Due before the next periodic refresh: wake up for it exactly
+    uint32_t delayUs = 0;
+    if (strum.getNextDelay(nowUs, delayUs) && delayUs < OUTPUT_REFRESH_MS * 1000) {
+        esp_timer_stop(strumTimer);
+        esp_timer_start_once(strumTimer, delayUs);
+    }
+#endif
+}
+
+#if defined(ARDUINO)
+/** Output task: computes notes and sends the report as soon as the MIDI task signals a change */
+[[noreturn]] static void outputTask(void*)
+{
+    while (true) {
+        takeTaskNotification(TaskId::OUTPUT, pdMS_TO_TICKS(OUTPUT_REFRESH_MS));
+
+        const int64_t busyStart = beginTaskBusy();
+        runOutput();
+        endTaskBusy(TaskId::OUTPUT, busyStart);
+    }
+}
+#endif
+
+void setupOutput()
+{
+#if defined(ARDUINO)
+    const esp_timer_create_args_t timerArgs = {
+        .callback = onStrumTimer,
+        .arg = nullptr,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "strum",
+        .skip_unhandled_events = true,
+    };
+    esp_timer_create(&timerArgs, &strumTimer);
+
+    createTask(TaskId::OUTPUT, outputTask);
+#endif
+}
+
+void notifyOutput()
+{
+#if defined(ARDUINO)
+    notifyTask(TaskId::OUTPUT);
+#endif
+}
+
+void refreshOutput()
+{
+    outputForce.store(true);
+    notifyOutput();
+}
+
+void setOutputTable(const OutputTableSettings& settings)
+{
+    outputLock.enter();
+    const bool changed = settings != outputTableSettings;
+    if (changed) {
+        outputTableSettings = settings;
+        outputTableDirty.store(true);
+        outputForce.store(true);
+    }
+    outputLock.exit();
+    if (changed) {
+        notifyOutput();
+    }
+}
+
+void setOutputStrum(const int spacingMs)
+{
+    outputStrumUs.store(static_cast<uint32_t>(spacingMs) * 1000);
+}
+
+void setOutputConflict(const ConflictPolicy policy)
+{
+    if (policy == outputConflict.exchange(policy)) {
+        return;
+    }
+    outputForce.store(true);
+    notifyOutput();
+}
+
+ConflictPolicy getOutputConflict()
+{
+    return outputConflict.load();
+}
+
+Notes15 getOutputNotes15()
+{
+    outputLock.enter();
+    const Notes15 notes15 = outputNotes15;
+    outputLock.exit();
+    return notes15;
+}
@@ -0,0 +1,59 @@
+#if !defined(APP_OUTPUT_H)
+#define APP_OUTPUT_H
+
+#include "app/note-mapping.h"
+#include "app/notes.h"
+#include "app/report.h"
+
+// Re-evaluation interval without notification (repress timing)
+static constexpr unsigned long OUTPUT_REFRESH_MS = 5;
+
+void setupOutput();
+
+void notifyOutput();
+
+/** Evaluate notes and send the report if changed (called by the output task; call directly where there is no task) */
+void runOutput();
+
+void refreshOutput();
+
+// Settings compiled into the note table by the output task (see buildNoteKeyTable() and applyKeyBindings())
+struct OutputTableSettings
+{
+    int mapping = 1;
+    int baseNote = 48;
+    bool expand = false;
+    FoldStrategy fold = FoldStrategy::NEAREST;
+    int split = 0;
+    KeyBindings bindings;
+
+    bool operator==(const OutputTableSettings& other) const
+    {
+        return mapping == other.mapping &&
+            baseNote == other.baseNote &&
+            expand == other.expand &&
+            fold == other.fold &&
+            split == other.split &&
+            bindings == other.bindings;
+    }
+
+    bool operator!=(const OutputTableSettings& other) const
+    {
+        return !(*this == other);
+    }
+};
+
+/** Replace all note table settings at once, so the output task never builds a table from a mix of old and new */
+void setOutputTable(const OutputTableSettings& settings);
+
+/** Spacing between the presses of a chord in milliseconds (0 = all in one report), see app/strum.h */
+void setOutputStrum(int spacingMs);
+
+/** Resolution of opposing stick and DPad directions, compiled into the report builder of the gamepad backends */
+void setOutputConflict(ConflictPolicy policy);
+
+ConflictPolicy getOutputConflict();
+
+Notes15 getOutputNotes15();
+
+#endif // !defined(APP_OUTPUT_H)
@@ -0,0 +1,305 @@
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+
+#if defined(ARDUINO)
+#include <LittleFS.h>
+#include <esp_timer.h>
+#endif
+
+#include "app/hal.h"
+#include "app/midi.h"
+#include "app/playback.h"
+#include "app/smf-player.h"
+
+#if defined(ARDUINO)
+#include "app/tasks.h"
+#endif
+
+static SmfPlayer player;
+
+// Owner of the player: loading/closing = reader, playing/stopping = MIDI task
+static std::atomic<PlaybackState> state{PlaybackState::IDLE};
+
+// Song to open (set by the caller of startPlayback() while idle)
+static SmfSource* requestedSource = nullptr;
+static char requestedName[PLAYBACK_MAX_NAME] = {};
+static std::atomic<const char*> playbackError{nullptr};
+
+// Notes held by the song, released on stop (MIDI task only)
+static bool heldNotes[128] = {};
+
+// Statistics published by the MIDI task, guarded by statusLock
+static PlaybackStatus publishedStatus;
+static CriticalSection statusLock;
+
+#if defined(ARDUINO)
+/** Song file in LittleFS */
+class LittleFsSmfSource final : public SmfSource
+{
+public:
+    bool open(const char* path)
+    {
+        file = LittleFS.open(path, "r");
+        return static_cast<bool>(file) && !file.isDirectory();
+    }
+
+    void close() { file.close(); }
+
+    size_t readAt(const uint32_t offset, uint8_t* buffer, const size_t size) override
+    {
+        if (!file.seek(offset)) {
+            return 0;
+        }
+        return file.read(buffer, size);
+    }
+
+private:
+    File file;
+};
+
+static LittleFsSmfSource fileSource;
+static bool fileSystemMounted = false;
+
+// One-shot timer waking the MIDI task at the next event time
+static esp_timer_handle_t eventTimer = nullptr;
+
+static void onEventTimer(void*)
+{
+    notifyMIDI();
+}
+#endif
+
+static void notifyReader()
+{
+#if defined(ARDUINO)
+    notifyTask(TaskId::PLAYBACK);
+#endif
+}
+
+static void publishStatus()
+{
+    statusLock.enter();
+    publishedStatus.state = state.load();
+    publishedStatus.events = player.getEvents();
+    publishedStatus.underruns = player.getUnderruns();
+    publishedStatus.lateness = player.getLateness();
+    statusLock.exit();
+}
+
+/** Note Off for every note the song still holds */
+static void releaseHeldNotes(const uint32_t nowUs)
+{
+    for (int note = 0; note < 128; note++) {
+        if (heldNotes[note]) {
+            const uint8_t noteOff[] = {0x80, static_cast<uint8_t>(note), 0};
+            playMIDIMessage(noteOff, sizeof(noteOff), nowUs);
+            heldNotes[note] = false;
+        }
+    }
+}
+
+/** Hand the player back to the reader to close the song */
+static void finishPlayback(const uint32_t nowUs)
+{
+    releaseHeldNotes(nowUs);
+    state.store(PlaybackState::CLOSING);
+    publishStatus();
+    notifyReader();
+}
+
+#if defined(ARDUINO)
+/** Reader task: all flash access of the playback (open, read ahead, close) */
+[[noreturn]] static void playerTask(void*)
+{
+    while (true) {
+        takeTaskNotification(TaskId::PLAYBACK, portMAX_DELAY);
+        const int64_t busyStart = beginTaskBusy();
+        fillPlayback();
+        endTaskBusy(TaskId::PLAYBACK, busyStart);
+    }
+}
+#endif
+
+void setupPlayback()
+{
+#if defined(ARDUINO)
+    // Songs are uploaded with "pio run -t uploadfs"; without a formatted partition playback is unavailable
+    fileSystemMounted = LittleFS.begin(false);
+
+    const esp_timer_create_args_t timerArgs = {
+        .callback = onEventTimer,
+        .arg = nullptr,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "playback",
+        .skip_unhandled_events = true,
+    };
+    esp_timer_create(&timerArgs, &eventTimer);
+
+    createTask(TaskId::PLAYBACK, playerTask);
+#endif
+}
+
+bool startPlayback(const char* name)
+{
+    if (state.load() != PlaybackState::IDLE) {
+        return false;
+    }
+    requestedSource = nullptr;
+    snprintf(requestedName, sizeof(requestedName), "%s", name);
+    playbackError = nullptr;
+    state.store(PlaybackState::LOADING);
+    notifyReader();
+    return true;
+}
+
+bool startPlayback(SmfSource& source)
+{
+    if (state.load() != PlaybackState::IDLE) {
+        return false;
+    }
+    requestedSource = &source;
+    requestedName[0] = '\0';
+    playbackError = nullptr;
+    state.store(PlaybackState::LOADING);
+    notifyReader();
+    return true;
+}
+
+bool stopPlayback()
+{
+    PlaybackState expected = PlaybackState::PLAYING;
+    if (!state.compare_exchange_strong(expected, PlaybackState::STOPPING)) {
+        return false;
+    }
+    notifyMIDI();
+    return true;
+}
+
+/** Open the requested song (reader side), nullptr on success or the reason */
+static const char* openRequestedSong()
+{
+    SmfSource* source = requestedSource;
+#if defined(ARDUINO)
+    if (source == nullptr) {
+        if (!fileSystemMounted) {
+            return "no filesystem";
+        }
+        char path[PLAYBACK_MAX_NAME + 1];
+        snprintf(path, sizeof(path), "/%s", requestedName);
+        if (!fileSource.open(path)) {
+            return "not found";
+        }
+        source = &fileSource;
+    }
+#endif
+    if (source == nullptr) {
+        return "not found";
+    }
+    if (!player.open(*source)) {
+        return "bad file";
+    }
+    return nullptr;
+}
+
+static void closeRequestedSong()
+{
+#if defined(ARDUINO)
+    if (requestedSource == nullptr) {
+        fileSource.close();
+    }
+#endif
+    requestedSource = nullptr;
+}
+
+void fillPlayback()
+{
+    switch (state.load()) {
+    case PlaybackState::LOADING:
+        {
+            const char* error = openRequestedSong();
+            if (error != nullptr) {
+                closeRequestedSong();
+                playbackError = error;
+                state.store(PlaybackState::IDLE);
+                break;
+            }
+            statusLock.enter();
+            strcpy(publishedStatus.name, requestedName);
+            statusLock.exit();
+            memset(heldNotes, 0, sizeof(heldNotes));
+            player.start(getHal().clock->micros() + SMF_PLAYER_LEAD_US);
+            state.store(PlaybackState::PLAYING);
+            publishStatus();
+            notifyMIDI();
+            break;
+        }
+    case PlaybackState::PLAYING:
+    case PlaybackState::STOPPING:
+        // Read ahead, also while stopping (the MIDI task may still be playing the other block)
+        while (player.fill()) {
+        }
+        break;
+    case PlaybackState::CLOSING:
+        closeRequestedSong();
+        state.store(PlaybackState::IDLE);
+        publishStatus();
+        break;
+    default:
+        break;
+    }
+}
+
+void pollPlayback()
+{
+    const PlaybackState current = state.load();
+    if (current != PlaybackState::PLAYING && current != PlaybackState::STOPPING) {
+        return;
+    }
+    const uint32_t nowUs = getHal().clock->micros();
+    if (current == PlaybackState::STOPPING) {
+        finishPlayback(nowUs);
+        return;
+    }
+
+    const int sent = player.dispatch(nowUs, [nowUs](const SmfEvent& event, const uint32_t lateUs) {
+        const uint8_t type = event.data[0] & 0xF0;
+        if (type == 0x90 || type == 0x80) {
+            heldNotes[event.data[1] & 0x7F] = type == 0x90 && event.data[2] != 0;
+        }
+        playMIDIMessage(event.data, event.size, nowUs - lateUs);
+    });
+    if (player.takeReleased()) {
+        notifyReader();
+    }
+    if (player.isFinished()) {
+        finishPlayback(nowUs);
+        return;
+    }
+    if (sent > 0) {
+        publishStatus();
+    }
+
+#if defined(ARDUINO)
+    // Events due before the next tick get a timer; later ones are picked up by a following tick
+    uint32_t delayUs = 0;
+    if (player.getNextDelay(nowUs, delayUs) && delayUs < portTICK_PERIOD_MS * 1000) {
+        esp_timer_stop(eventTimer);
+        esp_timer_start_once(eventTimer, delayUs);
+    }
+#endif
+}
+
+PlaybackStatus getPlaybackStatus()
+{
+    statusLock.enter();
+    PlaybackStatus status = publishedStatus;
+    statusLock.exit();
+    status.state = state.load();
+    return status;
+}
+
+const char* getPlaybackError()
+{
+    return playbackError.load();
+}
@@ -0,0 +1,72 @@
+#if !defined(APP_PLAYBACK_H)
+#define APP_PLAYBACK_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "app/latency.h"
+#include "app/smf-reader.h"
+
+// Longest song name (LittleFS path without the leading '/') including terminator
+static constexpr size_t PLAYBACK_MAX_NAME = 32;
+
+enum class PlaybackState
+{
+    IDLE = 0,
+    LOADING = 1, // opening the song and reading ahead
+    PLAYING = 2,
+    STOPPING = 3, // releasing the notes still held by the song
+    CLOSING = 4, // closing the file
+};
+
+struct PlaybackStatus
+{
+    PlaybackState state = PlaybackState::IDLE;
+    char name[PLAYBACK_MAX_NAME] = {};
+    uint32_t events = 0;
+    uint32_t underruns = 0;
+    LatencyHistogram lateness; // against the song timeline, microseconds
+};
+
+inline const char* getPlaybackStateName(const PlaybackState state)
+{
+    const char* NAMES[] = {
+        "idle",
+        "loading",
+        "playing",
+        "stopping",
+        "closing",
+    };
+    return NAMES[static_cast<int>(state)];
+}
+
+/** Mount LittleFS and start the reader task */
+void setupPlayback();
+
+/**
+ * Play a song stored in LittleFS (Standard MIDI File)
+ *
+ * Returns once the reader has been asked to open it; see getPlaybackStatus() / getPlaybackError().
+ *
+ * @return false if a song is already playing
+ */
+bool startPlayback(const char* name);
+
+/** Play a song from any source (host tests), same as above */
+bool startPlayback(SmfSource& source);
+
+/** @return false if nothing is playing */
+bool stopPlayback();
+
+/** Send the due song events into the MIDI input (called by the MIDI task; call directly where there is no task) */
+void pollPlayback();
+
+/** Open, read ahead and close songs (called by the reader task; call directly where there is no task) */
+void fillPlayback();
+
+PlaybackStatus getPlaybackStatus();
+
+/** Why the last song could not be started, nullptr if it could */
+const char* getPlaybackError();
+
+#endif // !defined(APP_PLAYBACK_H)
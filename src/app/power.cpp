@@ -0,0 +1,108 @@
+#include <atomic>
+
+#include "app/hal.h"
+#include "app/power.h"
+
+static std::atomic<uint32_t> timeoutMs{0};
+static std::atomic<unsigned long> lastActivityMs{0};
+
+// Written by the MIDI task only
+static std::atomic<PowerState> powerState{PowerState::ACTIVE};
+static std::atomic<unsigned long> stateSinceMs{0};
+static std::atomic<uint32_t> wakes{0};
+
+// Written by the UI loop only
+static std::atomic<int32_t> activeMa{0};
+static std::atomic<int32_t> idleMa{0};
+static unsigned long lastSampleMs = 0;
+
+static void setPowerState(const PowerState state)
+{
+    getHal().power->setCpuMhz(state == PowerState::IDLE ? POWER_IDLE_MHZ : POWER_ACTIVE_MHZ);
+    powerState = state;
+    stateSinceMs = getHal().clock->millis();
+}
+
+void setupPower(const uint32_t timeoutS)
+{
+    const unsigned long now = getHal().clock->millis();
+    timeoutMs = timeoutS * 1000;
+    lastActivityMs = now;
+    if (powerState.load() == PowerState::IDLE) {
+        setPowerState(PowerState::ACTIVE);
+    }
+    stateSinceMs = now;
+    wakes = 0;
+    activeMa = 0;
+    idleMa = 0;
+    lastSampleMs = now;
+}
+
+bool wakePower()
+{
+    lastActivityMs = getHal().clock->millis();
+    if (powerState.load() != PowerState::IDLE) {
+        return false;
+    }
+    setPowerState(PowerState::ACTIVE);
+    wakes++;
+    return true;
+}
+
+void notePowerActivity()
+{
+    lastActivityMs = getHal().clock->millis();
+}
+
+void pollPower()
+{
+    const unsigned long now = getHal().clock->millis();
+    const uint32_t timeout = timeoutMs.load();
+    const bool inactive = timeout > 0 && now - lastActivityMs.load() >= timeout;
+    if (powerState.load() == PowerState::ACTIVE) {
+        if (inactive) {
+            setPowerState(PowerState::IDLE);
+        }
+    } else if (!inactive) {
+        setPowerState(PowerState::ACTIVE);
+        wakes++;
+    }
+}
+
+void samplePower()
+{
+    const unsigned long now = getHal().clock->millis();
+    if (now - lastSampleMs < POWER_SAMPLE_INTERVAL_MS) {
+        return;
+    }
+    lastSampleMs = now;
+
+    // Skip samples taken while the current may still be settling after a change of state
+    const PowerState state = powerState.load();
+    if (now - stateSinceMs.load() < POWER_SAMPLE_INTERVAL_MS) {
+        return;
+    }
+    const int32_t current = getHal().power->batteryCurrent();
+    if (state == PowerState::IDLE) {
+        idleMa = current;
+    } else {
+        activeMa = current;
+    }
+}
+
+PowerState getPowerState()
+{
+    return powerState.load();
+}
+
+PowerStatus getPowerStatus()
+{
+    PowerStatus status;
+    status.state = powerState.load();
+    status.cpuMhz = status.state == PowerState::IDLE ? POWER_IDLE_MHZ : POWER_ACTIVE_MHZ;
+    status.timeoutS = timeoutMs.load() / 1000;
+    status.activeMa = activeMa.load();
+    status.idleMa = idleMa.load();
+    status.wakes = wakes.load();
+    return status;
+}
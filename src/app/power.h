@@ -0,0 +1,74 @@
+#if !defined(APP_POWER_H)
+#define APP_POWER_H
+
+#include <cstdint>
+
+// Idle power mode
+//
+// After a period without input the CPU clock is lowered; the first channel message or button press raises it
+// again before the message is handed to the output, so the note costs only the clock switch (see the "wake"
+// latency stage). The UARTs keep receiving at the idle clock and the MIDI task keeps polling every tick, which
+// is what keeps the first note on time: light sleep would lose the bytes that wake the UART and drop the
+// Bluetooth connection.
+
+// Inactivity before the idle mode (seconds, 0 = never; override in config.h)
+#if !defined(IDLE_POWER_TIMEOUT_S)
+#define IDLE_POWER_TIMEOUT_S 60
+#endif
+
+static constexpr uint32_t POWER_ACTIVE_MHZ = 240;
+
+// Lowest CPU clock that keeps the 80 MHz APB clock
+static constexpr uint32_t POWER_IDLE_MHZ = 80;
+
+// Interval of battery current samples
+static constexpr unsigned long POWER_SAMPLE_INTERVAL_MS = 1000;
+
+// UI loop period while idle (buttons and display only; MIDI input is polled by its own task)
+static constexpr unsigned long POWER_IDLE_LOOP_MS = 20;
+
+enum class PowerState
+{
+    ACTIVE = 0,
+    IDLE = 1,
+};
+
+inline const char* getPowerStateName(const PowerState state)
+{
+    return state == PowerState::IDLE ? "idle" : "active";
+}
+
+struct PowerStatus
+{
+    PowerState state = PowerState::ACTIVE;
+    uint32_t cpuMhz = POWER_ACTIVE_MHZ;
+    uint32_t timeoutS = 0;
+    int32_t activeMa = 0; // last battery current sampled while active (settled for a sample interval)
+    int32_t idleMa = 0; // last battery current sampled while idle (settled for a sample interval)
+    uint32_t wakes = 0;
+};
+
+/** @param timeoutS inactivity before the idle mode (0 = never) */
+void setupPower(uint32_t timeoutS);
+
+/**
+ * Note a channel message and leave the idle mode at once (MIDI task)
+ *
+ * @return true if this woke the controller
+ */
+bool wakePower();
+
+/** Note other input (buttons); the MIDI task leaves the idle mode on its next tick */
+void notePowerActivity();
+
+/** Enter or leave the idle mode (MIDI task, the only one changing the CPU clock) */
+void pollPower();
+
+/** Sample the battery current (UI loop, which owns the I2C bus) */
+void samplePower();
+
+PowerState getPowerState();
+
+PowerStatus getPowerStatus();
+
+#endif // !defined(APP_POWER_H)
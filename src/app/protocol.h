@@ -0,0 +1,614 @@
+#if !defined(APP_PROTOCOL_H)
+#define APP_PROTOCOL_H
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "app/latency.h"
+#include "app/loopback.h"
+#include "app/midi-source.h"
+#include "app/network-midi.h"
+#include "app/note-mapping.h"
+#include "app/playback.h"
+#include "app/power.h"
+#include "app/report.h"
+#include "app/settings-record.h"
+#include "app/telemetry.h"
+
+// Serial command protocol
+//
+// One command per line, tokens separated by spaces:
+//   get                                  -> ok mapping=1 basenote=48 expand=0 sustain=0 autokey=0 strum=0 ...
+//   set mapping=2 basenote=50 expand=1   -> ok <settings> (all fields applied together) / err <reason>
+//   stats                                -> ok midi=10 noteon=4 ...
+//   stream <ms>                          -> ok, then "tm <counters>" every <ms> (0 = stop)
+//   tasks                                -> "task <name> core=0 prio=3 ..." per task, then ok
+//   latency [reset|overlay on|overlay off] -> "lat <stage> n=.. p50=.. p99=.. max=.." per stage, then ok
+//   trace [dump|clear|on|off]            -> dump: "trace begin ...", "trace <hex entries>" lines, "trace end", ok
+//   play [<song>|stop]                   -> start/stop a song in flash; no argument: ok state=playing song=..
+//   net                                  -> ok session=1 peer=<name> packets=.. commands=.. lost=.. ...
+//   sources                              -> "source <name> bytes=.. messages=.. foreign=.. held=.." per input, ok
+//   map [<key> note=<n>|- action=<key>|-|reset] -> "map key=1 note=60 action=1" per Sky key (1-15), then ok
+//   loopback [start|stop]                -> ok phase=done sent=.. received=.. rtt_p50=.. ... max_rate=.. line_rate=..
+//   power                                -> ok state=idle mhz=80 timeout=60 active_ma=.. idle_ma=.. wakes=.. ...
+
+// Maximum line length including terminator
+static constexpr size_t PROTOCOL_MAX_LINE = 192;
+
+// Longest set command: every field at its widest accepted value (a get reply sent back as a set line is shorter).
+// A new set field goes here too, so the static_assert below catches a line that no longer fits.
+static constexpr char SETTINGS_WORST_CASE_SET_LINE[] =
+    "set mapping=255 basenote=127 expand=off sustain=off autokey=off strum=255 fold=nearest split=127 debounce=255 "
+    "jitter=255 conflict=neutral";
+static_assert(sizeof(SETTINGS_WORST_CASE_SET_LINE) <= PROTOCOL_MAX_LINE, "set line outgrew PROTOCOL_MAX_LINE");
+
+enum class CommandType
+{
+    NONE = 0,
+    GET = 1,
+    SET = 2,
+    STATS = 3,
+    STREAM = 4,
+    TASKS = 5,
+    LATENCY = 6,
+    TRACE = 7,
+    PLAY = 8,
+    NET = 9,
+    SOURCES = 10,
+    POWER = 11,
+    MAP = 12,
+    LOOPBACK = 13,
+};
+
+enum class LatencyAction
+{
+    SHOW = 0,
+    RESET = 1,
+    OVERLAY_ON = 2,
+    OVERLAY_OFF = 3,
+};
+
+enum class TraceAction
+{
+    DUMP = 0,
+    CLEAR = 1,
+    ON = 2,
+    OFF = 3,
+};
+
+enum class PlayAction
+{
+    STATUS = 0,
+    START = 1,
+    STOP = 2,
+};
+
+enum class LoopbackAction
+{
+    STATUS = 0,
+    START = 1,
+    STOP = 2,
+};
+
+enum class MapAction
+{
+    SHOW = 0,
+    SET = 1,
+    RESET = 2,
+};
+
+// Key binding field left as it is by a map command
+static constexpr int MAP_KEEP = -2;
+
+// Settings fields present in a set command
+static constexpr uint16_t SETTING_FIELD_MAPPING = 0x0001;
+static constexpr uint16_t SETTING_FIELD_BASENOTE = 0x0002;
+static constexpr uint16_t SETTING_FIELD_EXPAND = 0x0004;
+static constexpr uint16_t SETTING_FIELD_SUSTAIN = 0x0008;
+static constexpr uint16_t SETTING_FIELD_AUTO_KEY = 0x0010;
+static constexpr uint16_t SETTING_FIELD_STRUM = 0x0020;
+static constexpr uint16_t SETTING_FIELD_FOLD = 0x0040;
+static constexpr uint16_t SETTING_FIELD_SPLIT = 0x0080;
+static constexpr uint16_t SETTING_FIELD_DEBOUNCE = 0x0100;
+static constexpr uint16_t SETTING_FIELD_JITTER = 0x0200;
+static constexpr uint16_t SETTING_FIELD_CONFLICT = 0x0400;
+
+struct Command
+{
+    CommandType type = CommandType::NONE;
+    uint16_t fields = 0;
+    SettingsRecord values;
+    unsigned long interval = 0;
+    LatencyAction latencyAction = LatencyAction::SHOW;
+    TraceAction traceAction = TraceAction::DUMP;
+    PlayAction playAction = PlayAction::STATUS;
+    char song[PLAYBACK_MAX_NAME] = {};
+    LoopbackAction loopbackAction = LoopbackAction::STATUS;
+    MapAction mapAction = MapAction::SHOW;
+    int mapKey = 0; // Sky key (0-14)
+    int mapNote = MAP_KEEP; // MIDI note to bind, -1 = unbind
+    int mapTarget = MAP_KEEP; // key whose controller action to press
+    const char* error = nullptr;
+};
+
+inline bool parseProtocolNumber(const char* text, const long min, const long max, long& value)
+{
+    if (text == nullptr || *text == '\0') {
+        return false;
+    }
+    char* end = nullptr;
+    const long parsed = strtol(text, &end, 10);
+    if (*end != '\0' || parsed < min || parsed > max) {
+        return false;
+    }
+    value = parsed;
+    return true;
+}
+
+inline bool parseProtocolBool(const char* text, bool& value)
+{
+    if (strcmp(text, "1") == 0 || strcmp(text, "on") == 0) {
+        value = true;
+        return true;
+    }
+    if (strcmp(text, "0") == 0 || strcmp(text, "off") == 0) {
+        value = false;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Parse one command line (without line terminator)
+ *
+ * @return true if the command is valid, otherwise command.error describes the problem
+ */
+inline bool parseCommand(const char* line, Command& command)
+{
+    command = Command();
+
+    char buffer[PROTOCOL_MAX_LINE];
+    if (strlen(line) >= sizeof(buffer)) {
+        command.error = "line too long";
+        return false;
+    }
+    strcpy(buffer, line);
+
+    char* saveptr = nullptr;
+    const char* name = strtok_r(buffer, " \t\r", &saveptr);
+    if (name == nullptr) {
+        command.error = "empty";
+        return false;
+    }
+
+    if (strcmp(name, "get") == 0) {
+        command.type = CommandType::GET;
+    } else if (strcmp(name, "stats") == 0) {
+        command.type = CommandType::STATS;
+    } else if (strcmp(name, "tasks") == 0) {
+        command.type = CommandType::TASKS;
+    } else if (strcmp(name, "net") == 0) {
+        command.type = CommandType::NET;
+    } else if (strcmp(name, "sources") == 0) {
+        command.type = CommandType::SOURCES;
+    } else if (strcmp(name, "power") == 0) {
+        command.type = CommandType::POWER;
+    } else if (strcmp(name, "loopback") == 0) {
+        const char* action = strtok_r(nullptr, " \t\r", &saveptr);
+        if (action == nullptr) {
+            command.loopbackAction = LoopbackAction::STATUS;
+        } else if (strcmp(action, "start") == 0) {
+            command.loopbackAction = LoopbackAction::START;
+        } else if (strcmp(action, "stop") == 0) {
+            command.loopbackAction = LoopbackAction::STOP;
+        } else {
+            command.error = "expected start or stop";
+            return false;
+        }
+        command.type = CommandType::LOOPBACK;
+    } else if (strcmp(name, "latency") == 0) {
+        const char* action = strtok_r(nullptr, " \t\r", &saveptr);
+        if (action == nullptr) {
+            command.latencyAction = LatencyAction::SHOW;
+        } else if (strcmp(action, "reset") == 0) {
+            command.latencyAction = LatencyAction::RESET;
+        } else if (strcmp(action, "overlay") == 0) {
+            bool enabled = false;
+            const char* value = strtok_r(nullptr, " \t\r", &saveptr);
+            if (value == nullptr || !parseProtocolBool(value, enabled)) {
+                command.error = "expected overlay on|off";
+                return false;
+            }
+            command.latencyAction = enabled ? LatencyAction::OVERLAY_ON : LatencyAction::OVERLAY_OFF;
+        } else {
+            command.error = "bad latency action";
+            return false;
+        }
+        command.type = CommandType::LATENCY;
+    } else if (strcmp(name, "trace") == 0) {
+        const char* action = strtok_r(nullptr, " \t\r", &saveptr);
+        if (action == nullptr || strcmp(action, "dump") == 0) {
+            command.traceAction = TraceAction::DUMP;
+        } else if (strcmp(action, "clear") == 0) {
+            command.traceAction = TraceAction::CLEAR;
+        } else if (strcmp(action, "on") == 0) {
+            command.traceAction = TraceAction::ON;
+        } else if (strcmp(action, "off") == 0) {
+            command.traceAction = TraceAction::OFF;
+        } else {
+            command.error = "bad trace action";
+            return false;
+        }
+        command.type = CommandType::TRACE;
+    } else if (strcmp(name, "play") == 0) {
+        const char* action = strtok_r(nullptr, " \t\r", &saveptr);
+        if (action == nullptr) {
+            command.playAction = PlayAction::STATUS;
+        } else if (strcmp(action, "stop") == 0) {
+            command.playAction = PlayAction::STOP;
+        } else {
+            if (*action == '/') {
+                action++;
+            }
+            if (*action == '\0' || strlen(action) >= sizeof(command.song)) {
+                command.error = "bad song name";
+                return false;
+            }
+            strcpy(command.song, action);
+            command.playAction = PlayAction::START;
+        }
+        command.type = CommandType::PLAY;
+    } else if (strcmp(name, "map") == 0) {
+        const char* key = strtok_r(nullptr, " \t\r", &saveptr);
+        long number = 0;
+        if (key == nullptr) {
+            command.mapAction = MapAction::SHOW;
+        } else if (strcmp(key, "reset") == 0) {
+            command.mapAction = MapAction::RESET;
+        } else if (parseProtocolNumber(key, 1, 15, number)) {
+            command.mapAction = MapAction::SET;
+            command.mapKey = static_cast<int>(number) - 1;
+            char* token;
+            while ((token = strtok_r(nullptr, " \t\r", &saveptr)) != nullptr) {
+                char* value = strchr(token, '=');
+                if (value == nullptr) {
+                    command.error = "expected key=value";
+                    return false;
+                }
+                *value++ = '\0';
+                const bool unset = strcmp(value, "-") == 0;
+                if (strcmp(token, "note") == 0 && (unset || parseProtocolNumber(value, 0, 127, number))) {
+                    command.mapNote = unset ? -1 : static_cast<int>(number);
+                } else if (strcmp(token, "action") == 0 && (unset || parseProtocolNumber(value, 1, 15, number))) {
+                    command.mapTarget = unset ? command.mapKey : static_cast<int>(number) - 1;
+                } else {
+                    command.error = "bad binding";
+                    return false;
+                }
+            }
+            if (command.mapNote == MAP_KEEP && command.mapTarget == MAP_KEEP) {
+                command.error = "nothing to set";
+                return false;
+            }
+        } else {
+            command.error = "bad key";
+            return false;
+        }
+        command.type = CommandType::MAP;
+    } else if (strcmp(name, "stream") == 0) {
+        long interval = 0;
+        if (!parseProtocolNumber(strtok_r(nullptr, " \t\r", &saveptr), 0, 60000, interval)) {
+            command.error = "bad interval";
+            return false;
+        }
+        command.type = CommandType::STREAM;
+        command.interval = interval;
+    } else if (strcmp(name, "set") == 0) {
+        char* token;
+        while ((token = strtok_r(nullptr, " \t\r", &saveptr)) != nullptr) {
+            char* value = strchr(token, '=');
+            if (value == nullptr) {
+                command.error = "expected key=value";
+                return false;
+            }
+            *value++ = '\0';
+
+            long number = 0;
+            bool flag = false;
+            FoldStrategy fold = FoldStrategy::NEAREST;
+            ConflictPolicy conflict = ConflictPolicy::LAST;
+            if (strcmp(token, "mapping") == 0 && parseProtocolNumber(value, 0, 255, number)) {
+                command.values.mapping = static_cast<uint8_t>(number);
+                command.fields |= SETTING_FIELD_MAPPING;
+            } else if (strcmp(token, "basenote") == 0 && parseProtocolNumber(value, 0, 127, number)) {
+                command.values.baseNote = static_cast<uint8_t>(number);
+                command.fields |= SETTING_FIELD_BASENOTE;
+            } else if (strcmp(token, "expand") == 0 && parseProtocolBool(value, flag)) {
+                command.values.flags |= flag ? SettingsRecord::FLAG_EXPAND : 0;
+                command.fields |= SETTING_FIELD_EXPAND;
+            } else if (strcmp(token, "sustain") == 0 && parseProtocolBool(value, flag)) {
+                command.values.flags |= flag ? SettingsRecord::FLAG_SUSTAIN : 0;
+                command.fields |= SETTING_FIELD_SUSTAIN;
+            } else if (strcmp(token, "autokey") == 0 && parseProtocolBool(value, flag)) {
+                command.values.flags |= flag ? SettingsRecord::FLAG_AUTO_KEY : 0;
+                command.fields |= SETTING_FIELD_AUTO_KEY;
+            } else if (strcmp(token, "strum") == 0 && parseProtocolNumber(value, 0, 255, number)) {
+                command.values.strum = static_cast<uint8_t>(number);
+                command.fields |= SETTING_FIELD_STRUM;
+            } else if (strcmp(token, "fold") == 0 && parseFoldStrategy(value, fold)) {
+                command.values.fold = static_cast<uint8_t>(fold);
+                command.fields |= SETTING_FIELD_FOLD;
+            } else if (strcmp(token, "split") == 0 && parseProtocolNumber(value, 0, 127, number)) {
+                command.values.split = static_cast<uint8_t>(number);
+                command.fields |= SETTING_FIELD_SPLIT;
+            } else if (strcmp(token, "debounce") == 0 && parseProtocolNumber(value, 0, 255, number)) {
+                command.values.debounce = static_cast<uint8_t>(number);
+                command.fields |= SETTING_FIELD_DEBOUNCE;
+            } else if (strcmp(token, "jitter") == 0 && parseProtocolNumber(value, 0, 255, number)) {
+                command.values.jitter = static_cast<uint8_t>(number);
+                command.fields |= SETTING_FIELD_JITTER;
+            } else if (strcmp(token, "conflict") == 0 && parseConflictPolicy(value, conflict)) {
+                command.values.conflict = static_cast<uint8_t>(conflict);
+                command.fields |= SETTING_FIELD_CONFLICT;
+            } else {
+                command.error = "bad setting";
+                return false;
+            }
+        }
+        if (command.fields == 0) {
+            command.error = "nothing to set";
+            return false;
+        }
+        command.type = CommandType::SET;
+    } else {
+        command.error = "unknown command";
+        return false;
+    }
+    return true;
+}
+
+// Overlay the fields of a set command on the current settings
+inline SettingsRecord applySettingFields(const SettingsRecord& current, const Command& command)
+{
+    SettingsRecord record = current;
+    if (command.fields & SETTING_FIELD_MAPPING) {
+        record.mapping = command.values.mapping;
+    }
+    if (command.fields & SETTING_FIELD_BASENOTE) {
+        record.baseNote = command.values.baseNote;
+    }
+    if (command.fields & SETTING_FIELD_EXPAND) {
+        record.flags = (record.flags & ~SettingsRecord::FLAG_EXPAND) |
+            (command.values.flags & SettingsRecord::FLAG_EXPAND);
+    }
+    if (command.fields & SETTING_FIELD_SUSTAIN) {
+        record.flags = (record.flags & ~SettingsRecord::FLAG_SUSTAIN) |
+            (command.values.flags & SettingsRecord::FLAG_SUSTAIN);
+    }
+    if (command.fields & SETTING_FIELD_AUTO_KEY) {
+        record.flags = (record.flags & ~SettingsRecord::FLAG_AUTO_KEY) |
+            (command.values.flags & SettingsRecord::FLAG_AUTO_KEY);
+    }
+    if (command.fields & SETTING_FIELD_STRUM) {
+        record.strum = command.values.strum;
+    }
+    if (command.fields & SETTING_FIELD_FOLD) {
+        record.fold = command.values.fold;
+    }
+    if (command.fields & SETTING_FIELD_SPLIT) {
+        record.split = command.values.split;
+    }
+    if (command.fields & SETTING_FIELD_DEBOUNCE) {
+        record.debounce = command.values.debounce;
+    }
+    if (command.fields & SETTING_FIELD_JITTER) {
+        record.jitter = command.values.jitter;
+    }
+    if (command.fields & SETTING_FIELD_CONFLICT) {
+        record.conflict = command.values.conflict;
+    }
+    return record;
+}
+
+// Apply the key binding changes of a map command to the current settings
+inline SettingsRecord applyMapCommand(const SettingsRecord& current, const Command& command)
+{
+    SettingsRecord record = current;
+    if (command.mapAction == MapAction::RESET) {
+        record.bindings = KeyBindings();
+    } else if (command.mapAction == MapAction::SET) {
+        if (command.mapNote != MAP_KEEP) {
+            record.bindings.setNote(command.mapKey, command.mapNote);
+        }
+        if (command.mapTarget != MAP_KEEP) {
+            record.bindings.setAction(command.mapKey, command.mapTarget);
+        }
+    }
+    return record;
+}
+
+/** Merge a set or map command into the current settings (only what the command names changes) */
+inline SettingsRecord applySettingsCommand(const SettingsRecord& current, const Command& command)
+{
+    return command.type == CommandType::MAP ? applyMapCommand(current, command) : applySettingFields(current, command);
+}
+
+inline size_t formatSettings(const SettingsRecord& record, char* buffer, const size_t size)
+{
+    const int length = snprintf(buffer, size,
+                                "mapping=%u basenote=%u expand=%d sustain=%d autokey=%d strum=%u fold=%s split=%u "
+                                "debounce=%u jitter=%u conflict=%s",
+                                record.mapping, record.baseNote,
+                                (record.flags & SettingsRecord::FLAG_EXPAND) ? 1 : 0,
+                                (record.flags & SettingsRecord::FLAG_SUSTAIN) ? 1 : 0,
+                                (record.flags & SettingsRecord::FLAG_AUTO_KEY) ? 1 : 0, record.strum,
+                                getFoldStrategyName(static_cast<FoldStrategy>(record.fold)), record.split,
+                                record.debounce, record.jitter,
+                                getConflictPolicyName(static_cast<ConflictPolicy>(record.conflict)));
+    return length < 0 ? 0 : static_cast<size_t>(length) < size ? length : size - 1;
+}
+
+inline size_t formatTelemetry(const Telemetry& telemetry, char* buffer, const size_t size)
+{
+    size_t length = 0;
+    for (int i = 0; i < static_cast<int>(Counter::COUNT) && length + 1 < size; i++) {
+        const int written = snprintf(buffer + length, size - length, "%s%s=%lu", i == 0 ? "" : " ",
+                                     getCounterName(static_cast<Counter>(i)),
+                                     static_cast<unsigned long>(telemetry.counters[i]));
+        if (written < 0) {
+            break;
+        }
+        length += written;
+    }
+    return length < size ? length : size - 1;
+}
+
+inline size_t formatLatency(const LatencyStage stage, const LatencyHistogram& histogram, char* buffer,
+                            const size_t size)
+{
+    const int length = snprintf(buffer, size, "%s n=%lu p50=%lu p99=%lu max=%lu", getLatencyStageName(stage),
+                                static_cast<unsigned long>(histogram.getCount()),
+                                static_cast<unsigned long>(histogram.percentile(50)),
+                                static_cast<unsigned long>(histogram.percentile(99)),
+                                static_cast<unsigned long>(histogram.getMax()));
+    return length < 0 ? 0 : static_cast<size_t>(length) < size ? length : size - 1;
+}
+
+inline size_t formatPlaybackStatus(const PlaybackStatus& status, char* buffer, const size_t size)
+{
+    const int length = snprintf(buffer, size,
+                                "state=%s song=%s events=%lu underruns=%lu late_p50=%lu late_p99=%lu late_max=%lu",
+                                getPlaybackStateName(status.state), status.name[0] != '\0' ? status.name : "-",
+                                static_cast<unsigned long>(status.events),
+                                static_cast<unsigned long>(status.underruns),
+                                static_cast<unsigned long>(status.lateness.percentile(50)),
+                                static_cast<unsigned long>(status.lateness.percentile(99)),
+                                static_cast<unsigned long>(status.lateness.getMax()));
+    return length < 0 ? 0 : static_cast<size_t>(length) < size ? length : size - 1;
+}
+
+inline size_t formatNetworkMidiStatus(const NetworkMidiStatus& status, char* buffer, const size_t size)
+{
+    const int length = snprintf(buffer, size,
+                                "session=%d peer=%s packets=%lu commands=%lu lost=%lu reordered=%lu late=%lu "
+                                "jitter=%lu",
+                                status.connected ? 1 : 0, status.peer[0] != '\0' ? status.peer : "-",
+                                static_cast<unsigned long>(status.packets),
+                                static_cast<unsigned long>(status.commands),
+                                static_cast<unsigned long>(status.lost),
+                                static_cast<unsigned long>(status.reordered),
+                                static_cast<unsigned long>(status.late),
+                                static_cast<unsigned long>(status.jitterMs));
+    return length < 0 ? 0 : static_cast<size_t>(length) < size ? length : size - 1;
+}
+
+inline size_t formatMidiSourceStats(const MidiSource source, const MidiSourceStats& stats, char* buffer,
+                                    const size_t size)
+{
+    const int length = snprintf(buffer, size, "%s bytes=%lu messages=%lu foreign=%lu held=%lu",
+                                getMidiSourceName(source), static_cast<unsigned long>(stats.bytes),
+                                static_cast<unsigned long>(stats.messages),
+                                static_cast<unsigned long>(stats.foreignOffs),
+                                static_cast<unsigned long>(stats.held));
+    return length < 0 ? 0 : static_cast<size_t>(length) < size ? length : size - 1;
+}
+
+/** Binding of one Sky key, numbered from 1 like the keys of the map command */
+inline size_t formatKeyBinding(const KeyBindings& bindings, const int key, char* buffer, const size_t size)
+{
+    const int note = bindings.getNote(key);
+    char noteText[4] = "-";
+    if (note >= 0) {
+        snprintf(noteText, sizeof(noteText), "%d", note);
+    }
+    const int length = snprintf(buffer, size, "key=%d note=%s action=%d", key + 1, noteText,
+                                bindings.getAction(key) + 1);
+    return length < 0 ? 0 : static_cast<size_t>(length) < size ? length : size - 1;
+}
+
+/** Power state with the battery currents and the latency of the notes that woke the controller */
+inline size_t formatPowerStatus(const PowerStatus& status, const LatencyHistogram& wake, char* buffer,
+                                const size_t size)
+{
+    const int length = snprintf(buffer, size,
+                                "state=%s mhz=%lu timeout=%lu active_ma=%ld idle_ma=%ld wakes=%lu wake_p50=%lu "
+                                "wake_max=%lu",
+                                getPowerStateName(status.state), static_cast<unsigned long>(status.cpuMhz),
+                                static_cast<unsigned long>(status.timeoutS), static_cast<long>(status.activeMa),
+                                static_cast<long>(status.idleMa), static_cast<unsigned long>(status.wakes),
+                                static_cast<unsigned long>(wake.percentile(50)),
+                                static_cast<unsigned long>(wake.getMax()));
+    return length < 0 ? 0 : static_cast<size_t>(length) < size ? length : size - 1;
+}
+
+inline size_t formatLoopbackStatus(const LoopbackStatus& status, char* buffer, const size_t size)
+{
+    const int length = snprintf(buffer, size,
+                                "phase=%s sent=%lu received=%lu rtt_p50=%lu rtt_p99=%lu rtt_max=%lu parse_p50=%lu "
+                                "parse_p99=%lu parse_max=%lu rate=%lu max_rate=%lu lost=%lu line_rate=%lu",
+                                getLoopbackPhaseName(status.phase), static_cast<unsigned long>(status.sent),
+                                static_cast<unsigned long>(status.received),
+                                static_cast<unsigned long>(status.roundTrip.percentile(50)),
+                                static_cast<unsigned long>(status.roundTrip.percentile(99)),
+                                static_cast<unsigned long>(status.roundTrip.getMax()),
+                                static_cast<unsigned long>(status.parse.percentile(50)),
+                                static_cast<unsigned long>(status.parse.percentile(99)),
+                                static_cast<unsigned long>(status.parse.getMax()),
+                                static_cast<unsigned long>(status.rate), static_cast<unsigned long>(status.maxRate),
+                                static_cast<unsigned long>(status.lost),
+                                static_cast<unsigned long>(LOOPBACK_LINE_RATE));
+    return length < 0 ? 0 : static_cast<size_t>(length) < size ? length : size - 1;
+}
+
+// Accumulates received bytes into lines with a bounded buffer
+class LineReader
+{
+public:
+    /**
+     * Feed one byte
+     *
+     * @return true when a complete line is available in line()
+     */
+    bool feed(const char c)
+    {
+        if (_complete) {
+            reset();
+        }
+        if (c == '\n' || c == '\r') {
+            // Skip empty lines (including the second half of CRLF)
+            if (_length == 0 && !_overflow) {
+                return false;
+            }
+            _buffer[_length] = '\0';
+            _complete = true;
+            return true;
+        }
+        if (_length + 1 < sizeof(_buffer)) {
+            _buffer[_length++] = c;
+        } else {
+            _overflow = true;
+        }
+        return false;
+    }
+
+    const char* line() const { return _buffer; }
+
+    // Line exceeded the buffer and was truncated
+    bool overflow() const { return _overflow; }
+
+    void reset()
+    {
+        _length = 0;
+        _overflow = false;
+        _complete = false;
+    }
+
+private:
+    char _buffer[PROTOCOL_MAX_LINE]{};
+    size_t _length = 0;
+    bool _overflow = false;
+    bool _complete = false;
+};
+
+#endif // !defined(APP_PROTOCOL_H)
@@ -0,0 +1,318 @@
+#if !defined(APP_REPORT_H)
+#define APP_REPORT_H
+
+#include <cstdint>
+#include <cstring>
+
+#include "app/notes.h"
+#include "app/velocity-curve.h"
+
+// Gamepad action type constants
+static constexpr int ACTION_BUTTON = 1;
+static constexpr int ACTION_DPAD = 2;
+static constexpr int ACTION_L_TRIGGER = 3;
+static constexpr int ACTION_R_TRIGGER = 4;
+static constexpr int ACTION_L_STICK = 5;
+static constexpr int ACTION_R_STICK = 6;
+
+// Direction constants (common for stick and DPAD)
+static constexpr int DIRECTION_LEFT = 1;
+static constexpr int DIRECTION_RIGHT = 2;
+static constexpr int DIRECTION_UP = 3;
+static constexpr int DIRECTION_DOWN = 4;
+
+// Mapping entry structure
+struct MappingEntry
+{
+    int type;
+    // ACTION_NONE, ACTION_BUTTON, ACTION_DPAD, ACTION_L_TRIGGER, ACTION_R_TRIGGER, ACTION_L_STICK, ACTION_R_STICK
+    int value;
+    // Response of ACTION_L_TRIGGER, ACTION_R_TRIGGER, ACTION_L_STICK and ACTION_R_STICK to the velocity
+    VelocityCurve curve = VelocityCurve::FIXED;
+};
+
+// Combined DPad direction (diagonal directions supported)
+enum class DpadDirection
+{
+    CENTERED = 0,
+    UP = 1,
+    UP_RIGHT = 2,
+    RIGHT = 3,
+    DOWN_RIGHT = 4,
+    DOWN = 5,
+    DOWN_LEFT = 6,
+    LEFT = 7,
+    UP_LEFT = 8,
+};
+
+// Backend-neutral gamepad state built from the pressed Sky keys
+struct GamepadState
+{
+    // Keys (bit = Sky key index) whose ACTION_BUTTON mapping is pressed
+    uint16_t buttonKeys = 0;
+
+    // DPad state: UP, DOWN, RIGHT, LEFT
+    bool dpad[4] = {false};
+
+    // Trigger values: the mapping value scaled by the velocity curve (0 = released)
+    int leftTrigger = 0;
+    int rightTrigger = 0;
+
+    // Stick levels: -ANALOG_LEVEL_MAX = full left/down, 0 = center, ANALOG_LEVEL_MAX = full right/up
+    int16_t leftX = 0;
+    int16_t leftY = 0;
+    int16_t rightX = 0;
+    int16_t rightY = 0;
+};
+
+// Bit mask of pressed Sky keys
+inline uint16_t getPressedKeys(const Notes15& notes15)
+{
+    uint16_t keys = 0;
+    for (int i = 0; i < 15; i++) {
+        if (notes15.get(i) != 0) {
+            keys |= 1 << i;
+        }
+    }
+    return keys;
+}
+
+// Resolution of opposing directions held together (left and right, or up and down, of a stick or the DPad)
+enum class ConflictPolicy : uint8_t
+{
+    LAST = 0, // the direction pressed last wins
+    NEUTRAL = 1, // opposing directions cancel out
+    FIRST = 2, // the direction held first wins until it is released
+    COUNT = 3,
+};
+
+static constexpr const char* CONFLICT_POLICY_NAMES[] = {"last", "neutral", "first"};
+
+inline const char* getConflictPolicyName(const ConflictPolicy policy)
+{
+    return policy < ConflictPolicy::COUNT ? CONFLICT_POLICY_NAMES[static_cast<int>(policy)] : "?";
+}
+
+/** @return false if the name is unknown */
+inline bool parseConflictPolicy(const char* name, ConflictPolicy& policy)
+{
+    for (int i = 0; i < static_cast<int>(ConflictPolicy::COUNT); i++) {
+        if (strcmp(name, CONFLICT_POLICY_NAMES[i]) == 0) {
+            policy = static_cast<ConflictPolicy>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Gamepad state builder compiled from a mapping
+//
+// compile() sorts the keys into bit masks per action once per mapping or policy change; build() then works on
+// the pressed-key mask without looking at the action type of each key. Each stick axis and DPad axis is a pair
+// of opposing key masks resolved by the conflict policy using the press timestamps. Equal timestamps (keys
+// pressed in the same millisecond) go to the higher key index; several keys on the same side use the one that
+// decided the conflict (the latest for LAST and NEUTRAL, the earliest for FIRST).
+//
+// build() turns each key into one press stamp ordered by the policy (press time, then key index), so an axis is
+// resolved by taking the largest stamp of its masked keys and testing which side holds that key; there is no
+// branch per key.
+class ReportBuilder
+{
+public:
+    void compile(const MappingEntry mapping[15], const ConflictPolicy policy)
+    {
+        *this = ReportBuilder();
+        source = mapping;
+        this->policy = policy;
+        for (int i = 0; i < 15; i++) {
+            const MappingEntry& entry = mapping[i];
+            const uint16_t key = static_cast<uint16_t>(1 << i);
+            values[i] = entry.value;
+            curves[i] = entry.curve;
+            switch (entry.type) {
+            case ACTION_BUTTON:
+                buttonKeys |= key;
+                break;
+            case ACTION_L_TRIGGER:
+                leftTriggerKeys |= key;
+                break;
+            case ACTION_R_TRIGGER:
+                rightTriggerKeys |= key;
+                break;
+            case ACTION_DPAD:
+                addDirection(DPAD_X, DPAD_Y, entry.value, key);
+                break;
+            case ACTION_L_STICK:
+                addDirection(LEFT_X, LEFT_Y, entry.value, key);
+                break;
+            case ACTION_R_STICK:
+                addDirection(RIGHT_X, RIGHT_Y, entry.value, key);
+                break;
+            default:
+                break;
+            }
+        }
+    }
+
+    /** Whether compile() has been called with this mapping and policy */
+    bool isCompiled(const MappingEntry* mapping, const ConflictPolicy policy) const
+    {
+        return source == mapping && this->policy == policy;
+    }
+
+    GamepadState build(const Notes15& notes15) const
+    {
+        const uint16_t pressed = getPressedKeys(notes15);
+        uint64_t stamps[15];
+        getPressStamps(notes15, stamps);
+        GamepadState state;
+        state.buttonKeys = pressed & buttonKeys;
+        state.leftTrigger = getTrigger(notes15, pressed & leftTriggerKeys);
+        state.rightTrigger = getTrigger(notes15, pressed & rightTriggerKeys);
+        state.leftX = getStick(notes15, stamps, pressed, LEFT_X);
+        state.leftY = getStick(notes15, stamps, pressed, LEFT_Y);
+        state.rightX = getStick(notes15, stamps, pressed, RIGHT_X);
+        state.rightY = getStick(notes15, stamps, pressed, RIGHT_Y);
+        const int vertical = resolveAxis(stamps, pressed, DPAD_Y);
+        const int horizontal = resolveAxis(stamps, pressed, DPAD_X);
+        state.dpad[0] = vertical > 0;
+        state.dpad[1] = vertical < 0;
+        state.dpad[2] = horizontal > 0;
+        state.dpad[3] = horizontal < 0;
+        return state;
+    }
+
+private:
+    // Axes with a negative (left/down) and a positive (right/up) key mask
+    enum Axis
+    {
+        LEFT_X = 0,
+        LEFT_Y = 1,
+        RIGHT_X = 2,
+        RIGHT_Y = 3,
+        DPAD_X = 4,
+        DPAD_Y = 5,
+        AXES = 6,
+    };
+
+    void addDirection(const Axis x, const Axis y, const int direction, const uint16_t key)
+    {
+        switch (direction) {
+        case DIRECTION_LEFT:
+            negativeKeys[x] |= key;
+            break;
+        case DIRECTION_RIGHT:
+            positiveKeys[x] |= key;
+            break;
+        case DIRECTION_DOWN:
+            negativeKeys[y] |= key;
+            break;
+        case DIRECTION_UP:
+            positiveKeys[y] |= key;
+            break;
+        default:
+            break;
+        }
+    }
+
+    // Press stamp: set for a pressed key, then the press time (inverted for FIRST), then the key index
+    static constexpr int STAMP_TIME_SHIFT = 4;
+    static constexpr uint64_t STAMP_PRESSED = 1ULL << (STAMP_TIME_SHIFT + 32);
+    static constexpr uint64_t STAMP_KEY_MASK = (1ULL << STAMP_TIME_SHIFT) - 1;
+
+    /** Stamps ordered so that the key deciding a conflict under the policy has the largest one (0 = released) */
+    void getPressStamps(const Notes15& notes15, uint64_t stamps[15]) const
+    {
+        const uint32_t invert = policy == ConflictPolicy::FIRST ? 0xFFFFFFFF : 0;
+        for (int i = 0; i < 15; i++) {
+            const uint32_t time = static_cast<uint32_t>(notes15.get(i));
+            const uint64_t stamp = STAMP_PRESSED | static_cast<uint64_t>(time ^ invert) << STAMP_TIME_SHIFT | i;
+            stamps[i] = stamp & (0 - static_cast<uint64_t>(time != 0));
+        }
+    }
+
+    /** @return key that drives the axis + 1, negated for the negative side, 0 if centered */
+    int resolveAxis(const uint64_t stamps[15], const uint16_t pressed, const Axis axis) const
+    {
+        const uint16_t negative = pressed & negativeKeys[axis];
+        const uint16_t positive = pressed & positiveKeys[axis];
+        const uint16_t keys = negative | positive;
+        uint64_t decisive = 0;
+        for (int i = 0; i < 15; i++) {
+            const uint64_t stamp = stamps[i] & (0 - static_cast<uint64_t>((keys >> i) & 1));
+            decisive = stamp > decisive ? stamp : decisive;
+        }
+        const bool conflict = negative != 0 && positive != 0;
+        if (decisive == 0 || (conflict && policy == ConflictPolicy::NEUTRAL)) {
+            return 0;
+        }
+        const int key = static_cast<int>(decisive & STAMP_KEY_MASK);
+        return (positive >> key) & 1 ? key + 1 : -(key + 1);
+    }
+
+    int16_t getStick(const Notes15& notes15, const uint64_t stamps[15], const uint16_t pressed, const Axis axis) const
+    {
+        const int resolved = resolveAxis(stamps, pressed, axis);
+        if (resolved == 0) {
+            return 0;
+        }
+        const int key = (resolved > 0 ? resolved : -resolved) - 1;
+        const int level = getVelocityLevel(curves[key], notes15.getVelocity(key));
+        return static_cast<int16_t>(resolved > 0 ? level : -level);
+    }
+
+    /** Value of the highest pressed key of a trigger, scaled by its velocity */
+    int getTrigger(const Notes15& notes15, const uint16_t keys) const
+    {
+        if (keys == 0) {
+            return 0;
+        }
+        const int key = 31 - __builtin_clz(keys);
+        return scaleByLevel(values[key], getVelocityLevel(curves[key], notes15.getVelocity(key)));
+    }
+
+    const MappingEntry* source = nullptr;
+    ConflictPolicy policy = ConflictPolicy::LAST;
+    uint16_t buttonKeys = 0;
+    uint16_t leftTriggerKeys = 0;
+    uint16_t rightTriggerKeys = 0;
+    uint16_t negativeKeys[AXES] = {};
+    uint16_t positiveKeys[AXES] = {};
+    int values[15] = {};
+    VelocityCurve curves[15] = {};
+};
+
+/** Build a gamepad state in one go (compiles the mapping on every call; backends keep a ReportBuilder) */
+inline GamepadState buildGamepadState(const Notes15& notes15, const MappingEntry mapping[15],
+                                      const ConflictPolicy policy = ConflictPolicy::LAST)
+{
+    ReportBuilder builder;
+    builder.compile(mapping, policy);
+    return builder.build(notes15);
+}
+
+inline DpadDirection getDpadDirection(const GamepadState& state)
+{
+    // [vertical + 1][horizontal + 1]; opposing directions are resolved by the builder and cancel out here
+    static constexpr DpadDirection DIRECTIONS[3][3] = {
+        {DpadDirection::DOWN_LEFT, DpadDirection::DOWN, DpadDirection::DOWN_RIGHT},
+        {DpadDirection::LEFT, DpadDirection::CENTERED, DpadDirection::RIGHT},
+        {DpadDirection::UP_LEFT, DpadDirection::UP, DpadDirection::UP_RIGHT},
+    };
+    const int vertical = static_cast<int>(state.dpad[0]) - static_cast<int>(state.dpad[1]);
+    const int horizontal = static_cast<int>(state.dpad[2]) - static_cast<int>(state.dpad[3]);
+    return DIRECTIONS[vertical + 1][horizontal + 1];
+}
+
+// Scale a stick level to a backend's axis range (integer only: runs for every report); a level other than 0 is
+// at least one step off center, like scaleByLevel()
+inline int scaleStick(const int16_t level, const int negative, const int center, const int positive)
+{
+    if (level == 0) {
+        return center;
+    }
+    const int range = level < 0 ? negative - center : positive - center;
+    return center + scaleByLevel(range, level < 0 ? -level : level);
+}
+
+#endif // !defined(APP_REPORT_H)
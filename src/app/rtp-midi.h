@@ -0,0 +1,591 @@
+#if !defined(APP_RTP_MIDI_H)
+#define APP_RTP_MIDI_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "app/midi-parser.h"
+
+// RTP-MIDI (RFC 6295) with the AppleMIDI session protocol
+//
+// A session uses two UDP ports: control (invitations, end of session) and data (control port + 1: invitations,
+// clock sync and the RTP-MIDI packets). Timestamps count 100 us ticks (10 kHz clock) on both sides.
+// Everything below parses in place: MIDI commands are handed out as pointers into the received packet.
+
+static constexpr uint16_t APPLE_MIDI_CONTROL_PORT = 5004;
+static constexpr uint32_t APPLE_MIDI_PROTOCOL_VERSION = 2;
+
+// Microseconds per timestamp tick
+static constexpr uint32_t RTP_MIDI_TICK_US = 100;
+
+static constexpr uint8_t RTP_MIDI_PAYLOAD_TYPE = 0x61;
+
+// Longest session name kept (including terminator)
+static constexpr size_t APPLE_MIDI_NAME_MAX = 32;
+
+static constexpr uint16_t appleMidiCommand(const char first, const char second)
+{
+    return static_cast<uint16_t>(static_cast<uint8_t>(first) << 8 | static_cast<uint8_t>(second));
+}
+
+// Session commands (two ASCII letters after the 0xFFFF signature)
+static constexpr uint16_t APPLE_MIDI_INVITATION = appleMidiCommand('I', 'N');
+static constexpr uint16_t APPLE_MIDI_ACCEPTED = appleMidiCommand('O', 'K');
+static constexpr uint16_t APPLE_MIDI_REJECTED = appleMidiCommand('N', 'O');
+static constexpr uint16_t APPLE_MIDI_END = appleMidiCommand('B', 'Y');
+static constexpr uint16_t APPLE_MIDI_SYNC = appleMidiCommand('C', 'K');
+static constexpr uint16_t APPLE_MIDI_FEEDBACK = appleMidiCommand('R', 'S');
+
+// Invitation packet without name, clock sync packet
+static constexpr size_t APPLE_MIDI_INVITATION_SIZE = 16;
+static constexpr size_t APPLE_MIDI_SYNC_SIZE = 36;
+
+// RTP header without contributing sources
+static constexpr size_t RTP_HEADER_SIZE = 12;
+
+inline uint16_t readBigEndian16(const uint8_t* data)
+{
+    return static_cast<uint16_t>(data[0] << 8 | data[1]);
+}
+
+inline uint32_t readBigEndian32(const uint8_t* data)
+{
+    return static_cast<uint32_t>(data[0]) << 24 | static_cast<uint32_t>(data[1]) << 16 |
+        static_cast<uint32_t>(data[2]) << 8 | data[3];
+}
+
+inline void writeBigEndian16(uint8_t* data, const uint16_t value)
+{
+    data[0] = static_cast<uint8_t>(value >> 8);
+    data[1] = static_cast<uint8_t>(value);
+}
+
+inline void writeBigEndian32(uint8_t* data, const uint32_t value)
+{
+    writeBigEndian16(data, static_cast<uint16_t>(value >> 16));
+    writeBigEndian16(data + 2, static_cast<uint16_t>(value));
+}
+
+// AppleMIDI session packet (fields not used by a command are left at 0)
+struct AppleMidiPacket
+{
+    uint16_t command = 0;
+    uint32_t version = 0;
+    uint32_t token = 0;
+    uint32_t ssrc = 0;
+    const char* name = nullptr; // points into the packet, nullptr if absent or not terminated
+    uint8_t count = 0; // clock sync: number of timestamps filled in (0-2)
+    uint64_t timestamps[3] = {};
+};
+
+inline bool isAppleMidiPacket(const uint8_t* data, const size_t size)
+{
+    return size >= 4 && data[0] == 0xFF && data[1] == 0xFF;
+}
+
+/**
+ * Parse a session packet
+ *
+ * @return false if the packet is not an AppleMIDI packet or is truncated
+ */
+inline bool parseAppleMidiPacket(const uint8_t* data, const size_t size, AppleMidiPacket& packet)
+{
+    packet = AppleMidiPacket();
+    if (!isAppleMidiPacket(data, size)) {
+        return false;
+    }
+    packet.command = readBigEndian16(data + 2);
+    switch (packet.command) {
+    case APPLE_MIDI_INVITATION:
+    case APPLE_MIDI_ACCEPTED:
+    case APPLE_MIDI_REJECTED:
+    case APPLE_MIDI_END:
+        if (size < APPLE_MIDI_INVITATION_SIZE) {
+            return false;
+        }
+        packet.version = readBigEndian32(data + 4);
+        packet.token = readBigEndian32(data + 8);
+        packet.ssrc = readBigEndian32(data + 12);
+        if (size > APPLE_MIDI_INVITATION_SIZE && memchr(data + 16, '\0', size - 16) != nullptr) {
+            packet.name = reinterpret_cast<const char*>(data + 16);
+        }
+        return true;
+    case APPLE_MIDI_SYNC:
+        if (size < APPLE_MIDI_SYNC_SIZE) {
+            return false;
+        }
+        packet.ssrc = readBigEndian32(data + 4);
+        packet.count = data[8];
+        for (int i = 0; i < 3; i++) {
+            packet.timestamps[i] = static_cast<uint64_t>(readBigEndian32(data + 12 + i * 8)) << 32 |
+                readBigEndian32(data + 16 + i * 8);
+        }
+        return packet.count <= 2;
+    case APPLE_MIDI_FEEDBACK:
+        if (size < 12) {
+            return false;
+        }
+        packet.ssrc = readBigEndian32(data + 4);
+        return true;
+    default:
+        return false;
+    }
+}
+
+/**
+ * Build an invitation, acceptance, rejection or end of session
+ *
+ * @return packet size, 0 if the buffer is too small
+ */
+inline size_t buildAppleMidiSession(const uint16_t command, const uint32_t token, const uint32_t ssrc,
+                                    const char* name, uint8_t* buffer, const size_t size)
+{
+    const size_t nameSize = name != nullptr ? strlen(name) + 1 : 0;
+    if (size < APPLE_MIDI_INVITATION_SIZE + nameSize) {
+        return 0;
+    }
+    writeBigEndian16(buffer, 0xFFFF);
+    writeBigEndian16(buffer + 2, command);
+    writeBigEndian32(buffer + 4, APPLE_MIDI_PROTOCOL_VERSION);
+    writeBigEndian32(buffer + 8, token);
+    writeBigEndian32(buffer + 12, ssrc);
+    if (nameSize > 0) {
+        memcpy(buffer + 16, name, nameSize);
+    }
+    return APPLE_MIDI_INVITATION_SIZE + nameSize;
+}
+
+/**
+ * Build a clock sync packet
+ *
+ * @return packet size, 0 if the buffer is too small
+ */
+inline size_t buildAppleMidiSync(const uint32_t ssrc, const uint8_t count, const uint64_t* timestamps,
+                                 uint8_t* buffer, const size_t size)
+{
+    if (size < APPLE_MIDI_SYNC_SIZE) {
+        return 0;
+    }
+    memset(buffer, 0, APPLE_MIDI_SYNC_SIZE);
+    writeBigEndian16(buffer, 0xFFFF);
+    writeBigEndian16(buffer + 2, APPLE_MIDI_SYNC);
+    writeBigEndian32(buffer + 4, ssrc);
+    buffer[8] = count;
+    for (int i = 0; i < 3; i++) {
+        writeBigEndian32(buffer + 12 + i * 8, static_cast<uint32_t>(timestamps[i] >> 32));
+        writeBigEndian32(buffer + 16 + i * 8, static_cast<uint32_t>(timestamps[i]));
+    }
+    return APPLE_MIDI_SYNC_SIZE;
+}
+
+struct RtpHeader
+{
+    uint16_t sequence = 0;
+    uint32_t timestamp = 0;
+    uint32_t ssrc = 0;
+};
+
+// MIDI command in a received packet
+struct RtpMidiCommand
+{
+    uint32_t timestamp; // RTP timestamp plus the delta times up to this command
+    uint8_t status; // explicit or running status
+    const uint8_t* data; // data bytes in the packet (status not included)
+    size_t length; // number of data bytes (system exclusive: up to and including 0xF7)
+};
+
+/**
+ * Parse the RTP header of an RTP-MIDI packet
+ *
+ * @param offset set to the start of the MIDI command section
+ */
+inline bool parseRtpHeader(const uint8_t* packet, const size_t size, RtpHeader& header, size_t& offset)
+{
+    if (size < RTP_HEADER_SIZE + 1 || (packet[0] & 0xC0) != 0x80 || (packet[1] & 0x7F) != RTP_MIDI_PAYLOAD_TYPE) {
+        return false;
+    }
+    header.sequence = readBigEndian16(packet + 2);
+    header.timestamp = readBigEndian32(packet + 4);
+    header.ssrc = readBigEndian32(packet + 8);
+
+    // Skip contributing sources
+    offset = RTP_HEADER_SIZE + (packet[0] & 0x0F) * 4;
+    return offset < size;
+}
+
+/** Variable length delta time of the MIDI list (1-4 bytes), false if truncated */
+inline bool readRtpMidiDelta(const uint8_t* data, const size_t size, size_t& offset, uint32_t& delta)
+{
+    delta = 0;
+    for (int i = 0; i < 4; i++) {
+        if (offset >= size) {
+            return false;
+        }
+        const uint8_t byte = data[offset++];
+        delta = delta << 7 | (byte & 0x7F);
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Parse an RTP-MIDI packet, calling onCommand(const RtpMidiCommand&) for each MIDI command in timestamp order
+ *
+ * The recovery journal is not decoded. System exclusive segments other than a complete F0 .. F7 message are
+ * skipped, as are commands with missing data bytes.
+ *
+ * @return false if the packet is not RTP-MIDI or its MIDI list is malformed (commands before the error were handed
+ *         out)
+ */
+template <typename OnCommand>
+bool parseRtpMidi(const uint8_t* packet, const size_t size, RtpHeader& header, OnCommand onCommand)
+{
+    size_t offset = 0;
+    if (!parseRtpHeader(packet, size, header, offset)) {
+        return false;
+    }
+
+    // Command section header: B J Z P LEN (4 bits, or 12 bits with B)
+    const uint8_t flags = packet[offset++];
+    size_t length = flags & 0x0F;
+    if (flags & 0x80) {
+        if (offset >= size) {
+            return false;
+        }
+        length = length << 8 | packet[offset++];
+    }
+    if (offset + length > size) {
+        return false;
+    }
+    const size_t end = offset + length;
+
+    uint32_t timestamp = header.timestamp;
+    uint8_t runningStatus = 0;
+    bool first = true;
+    while (offset < end) {
+        // Every command but the first carries a delta time; the first one only with Z
+        if (!first || (flags & 0x20)) {
+            uint32_t delta = 0;
+            if (!readRtpMidiDelta(packet, end, offset, delta)) {
+                return false;
+            }
+            timestamp += delta;
+        }
+        first = false;
+        if (offset >= end) {
+            return false;
+        }
+
+        uint8_t status = packet[offset];
+        if (status & 0x80) {
+            offset++;
+        } else if (runningStatus != 0) {
+            status = runningStatus;
+        } else {
+            return false;
+        }
+
+        size_t dataLength = 0;
+        const int expected = MidiParser::getDataLength(status);
+        if (expected < 0 || status == 0xF7) {
+            // System exclusive: up to the end marker (F7 complete, F0 or F4 segment boundaries)
+            while (offset + dataLength < end && (packet[offset + dataLength] & 0x80) == 0) {
+                dataLength++;
+            }
+            if (offset + dataLength >= end) {
+                return false;
+            }
+            const uint8_t marker = packet[offset + dataLength];
+            dataLength++;
+            if (status == 0xF0 && marker == 0xF7) {
+                onCommand(RtpMidiCommand{timestamp, status, packet + offset, dataLength});
+            }
+            offset += dataLength;
+            runningStatus = 0;
+            continue;
+        }
+
+        dataLength = static_cast<size_t>(expected);
+        if (offset + dataLength > end) {
+            return false;
+        }
+        bool complete = true;
+        for (size_t i = 0; i < dataLength; i++) {
+            complete = complete && (packet[offset + i] & 0x80) == 0;
+        }
+        if (complete) {
+            onCommand(RtpMidiCommand{timestamp, status, packet + offset, dataLength});
+        }
+        offset += dataLength;
+
+        // Channel messages set running status, system common messages cancel it, real-time leaves it
+        if (status < 0xF0) {
+            runningStatus = status;
+        } else if (status < 0xF8) {
+            runningStatus = 0;
+        }
+    }
+    return true;
+}
+
+/**
+ * Build an RTP-MIDI packet without journal
+ *
+ * @param list MIDI list: first command at the RTP timestamp, a delta time before each following one
+ * @return packet size, 0 if the buffer is too small or the list exceeds the command section
+ */
+inline size_t buildRtpMidi(const uint16_t sequence, const uint32_t timestamp, const uint32_t ssrc,
+                           const uint8_t* list, const size_t length, uint8_t* buffer, const size_t size)
+{
+    if (length > 0x0FFF || size < RTP_HEADER_SIZE + 2 + length) {
+        return 0;
+    }
+    buffer[0] = 0x80;
+    buffer[1] = RTP_MIDI_PAYLOAD_TYPE;
+    writeBigEndian16(buffer + 2, sequence);
+    writeBigEndian32(buffer + 4, timestamp);
+    writeBigEndian32(buffer + 8, ssrc);
+    buffer[12] = static_cast<uint8_t>(0x80 | length >> 8);
+    buffer[13] = static_cast<uint8_t>(length);
+    memcpy(buffer + 14, list, length);
+    return RTP_HEADER_SIZE + 2 + length;
+}
+
+// Packet loss and reordering seen on the RTP sequence numbers
+class RtpSequenceTracker
+{
+public:
+    enum class Result
+    {
+        NEXT = 0, // first packet or the one expected
+        GAP = 1, // packets were skipped (counted as lost until they turn up)
+        LATE = 2, // older than a packet already received (reordered or duplicated)
+    };
+
+    Result update(const uint16_t sequence)
+    {
+        if (!started) {
+            started = true;
+            expected = static_cast<uint16_t>(sequence + 1);
+            return Result::NEXT;
+        }
+        const int16_t ahead = static_cast<int16_t>(sequence - expected);
+        if (ahead < 0) {
+            lost = lost > 0 ? lost - 1 : 0;
+            return Result::LATE;
+        }
+        expected = static_cast<uint16_t>(sequence + 1);
+        if (ahead > 0) {
+            lost += static_cast<uint32_t>(ahead);
+            return Result::GAP;
+        }
+        return Result::NEXT;
+    }
+
+    /** Packets skipped and not received later */
+    uint32_t getLost() const { return lost; }
+
+    void reset()
+    {
+        started = false;
+        expected = 0;
+        lost = 0;
+    }
+
+private:
+    bool started = false;
+    uint16_t expected = 0;
+    uint32_t lost = 0;
+};
+
+// Playout buffer that evens out network jitter
+//
+// Maps peer timestamps onto the local clock with the smallest transit time seen and holds each command until its
+// timestamp plus a fixed delay. Commands come out in timestamp order whatever the order of the packets, as long as
+// they arrive within the delay. When packets keep arriving later than the delay can absorb (peer clock running
+// slow), the mapping is moved up gradually.
+class RtpJitterBuffer
+{
+public:
+    static constexpr size_t CAPACITY = 64;
+
+    // Longest buffered command (channel messages; system exclusive is not buffered)
+    static constexpr size_t EVENT_MAX = 3;
+
+    struct Event
+    {
+        int64_t dueUs;
+        uint32_t receivedUs;
+        uint8_t size;
+        uint8_t data[EVENT_MAX];
+    };
+
+    void setDelay(const uint32_t delayUs) { this->delayUs = delayUs; }
+
+    uint32_t getDelay() const { return delayUs; }
+
+    /**
+     * Take the timestamp of a received packet
+     *
+     * @param localUs monotonic local time of reception
+     */
+    void beginPacket(const uint32_t rtpTimestamp, const int64_t localUs)
+    {
+        if (!synced) {
+            synced = true;
+            peerTicks = 0;
+            lastTimestamp = rtpTimestamp;
+            offsetUs = localUs;
+            return;
+        }
+        peerTicks += static_cast<int32_t>(rtpTimestamp - lastTimestamp);
+        lastTimestamp = rtpTimestamp;
+        const int64_t transitUs = localUs - peerTicks * RTP_MIDI_TICK_US;
+        if (transitUs < offsetUs) {
+            offsetUs = transitUs;
+        } else if (transitUs - offsetUs > delayUs) {
+            offsetUs += (transitUs - offsetUs - delayUs) >> 4;
+        }
+    }
+
+    /**
+     * Queue a command of the current packet; if the buffer is full the earliest command is dispatched first
+     *
+     * @return true if the command is already due (arrived later than the delay)
+     */
+    template <typename Dispatch>
+    bool push(const uint32_t timestamp, const uint8_t* data, const size_t size, const uint32_t receivedUs,
+              const int64_t localUs, Dispatch dispatch)
+    {
+        if (count == CAPACITY) {
+            dispatch(events[0]);
+            removeFirst();
+        }
+
+        Event event{};
+        event.dueUs = (peerTicks + static_cast<int32_t>(timestamp - lastTimestamp)) * RTP_MIDI_TICK_US + offsetUs +
+            delayUs;
+        event.receivedUs = receivedUs;
+        event.size = static_cast<uint8_t>(size < EVENT_MAX ? size : EVENT_MAX);
+        memcpy(event.data, data, event.size);
+
+        // Keep arrival order among equal timestamps
+        size_t index = count;
+        while (index > 0 && events[index - 1].dueUs > event.dueUs) {
+            events[index] = events[index - 1];
+            index--;
+        }
+        events[index] = event;
+        count++;
+        return event.dueUs < localUs;
+    }
+
+    /** Dispatch every command due at localUs, in timestamp order */
+    template <typename Dispatch>
+    void release(const int64_t localUs, Dispatch dispatch)
+    {
+        while (count > 0 && events[0].dueUs <= localUs) {
+            dispatch(events[0]);
+            removeFirst();
+        }
+    }
+
+    /** Dispatch everything still buffered */
+    template <typename Dispatch>
+    void flush(Dispatch dispatch)
+    {
+        while (count > 0) {
+            dispatch(events[0]);
+            removeFirst();
+        }
+    }
+
+    size_t size() const { return count; }
+
+    void reset()
+    {
+        count = 0;
+        synced = false;
+    }
+
+private:
+    void removeFirst()
+    {
+        for (size_t i = 1; i < count; i++) {
+            events[i - 1] = events[i];
+        }
+        count--;
+    }
+
+    Event events[CAPACITY]{};
+    size_t count = 0;
+    uint32_t delayUs = 0;
+    bool synced = false;
+    uint32_t lastTimestamp = 0;
+    int64_t peerTicks = 0;
+    int64_t offsetUs = 0;
+};
+
+// Commands handed from the network task to the MIDI task
+//
+// Single producer, single consumer, no lock: the producer only moves head, the consumer only moves tail.
+class RtpCommandQueue
+{
+public:
+    static constexpr uint32_t CAPACITY = 128; // power of two
+
+    struct Command
+    {
+        uint32_t receivedUs;
+        uint8_t size;
+        uint8_t data[RtpJitterBuffer::EVENT_MAX];
+    };
+
+    /** @return false if the queue is full (producer) */
+    bool push(const uint8_t* data, const size_t size, const uint32_t receivedUs)
+    {
+        const uint32_t index = head.load(std::memory_order_relaxed);
+        if (index - tail.load(std::memory_order_acquire) == CAPACITY) {
+            return false;
+        }
+        Command& command = commands[index & (CAPACITY - 1)];
+        command.receivedUs = receivedUs;
+        command.size = static_cast<uint8_t>(size < RtpJitterBuffer::EVENT_MAX ? size : RtpJitterBuffer::EVENT_MAX);
+        memcpy(command.data, data, command.size);
+        head.store(index + 1, std::memory_order_release);
+        return true;
+    }
+
+    /** Dispatch every queued command in order (consumer) */
+    template <typename Dispatch>
+    void drain(Dispatch dispatch)
+    {
+        const uint32_t end = head.load(std::memory_order_acquire);
+        uint32_t index = tail.load(std::memory_order_relaxed);
+        while (index != end) {
+            dispatch(commands[index & (CAPACITY - 1)]);
+            index++;
+            tail.store(index, std::memory_order_release);
+        }
+    }
+
+    bool empty() const { return head.load() == tail.load(); }
+
+    /** Drop everything (neither side running) */
+    void reset()
+    {
+        head.store(0);
+        tail.store(0);
+    }
+
+private:
+    Command commands[CAPACITY]{};
+    std::atomic<uint32_t> head{0};
+    std::atomic<uint32_t> tail{0};
+};
+
+#endif // !defined(APP_RTP_MIDI_H)
@@ -0,0 +1,388 @@
+#include <M5Unified.h>
+
+#include <atomic>
+
+#include "app/latency.h"
+#include "app/loopback.h"
+#include "app/midi.h"
+#include "app/network-midi.h"
+#include "app/playback.h"
+#include "app/power.h"
+#include "app/protocol.h"
+#include "app/serial-command.h"
+#include "app/settings.h"
+#include "app/tasks.h"
+#include "app/trace.h"
+
+// Time to wait for loop() to apply a settings update
+static constexpr unsigned long UPDATE_TIMEOUT_MS = 200;
+
+// Settings updates waiting for loop()
+static constexpr UBaseType_t UPDATE_QUEUE_LENGTH = 4;
+
+// Time to wait for the player task to open a song
+static constexpr unsigned long PLAY_START_TIMEOUT_MS = 1000;
+
+// Idle poll interval while no bytes are available
+static constexpr unsigned long POLL_INTERVAL_MS = 10;
+
+// Reply body buffer (fits all telemetry counters at their maximum values)
+static constexpr size_t REPLY_BUFFER_SIZE = 192;
+
+// Current settings published by loop(), guarded by commandMux
+static SettingsRecord currentSettings;
+static portMUX_TYPE commandMux = portMUX_INITIALIZER_UNLOCKED;
+
+// A set or map command on its way to loop(), merged there into the live settings so that a change made on the
+// device in the meantime (buttons, MIDI-learn) is kept
+struct SettingsUpdate
+{
+    uint32_t id;
+    Command command;
+};
+
+static QueueHandle_t updateQueue = nullptr;
+static uint32_t nextUpdateId = 0; // command task only
+static uint32_t takenUpdateId = 0; // loop() only
+static std::atomic<uint32_t> appliedUpdateId{0};
+
+static SettingsRecord getCurrentSettings()
+{
+    portENTER_CRITICAL(&commandMux);
+    const SettingsRecord record = currentSettings;
+    portEXIT_CRITICAL(&commandMux);
+    return record;
+}
+
+/** Wait until loop() has applied an update, false on timeout (the update stays queued and is applied later) */
+static bool waitForUpdate(const uint32_t id)
+{
+    const TickType_t start = xTaskGetTickCount();
+    while (static_cast<int32_t>(appliedUpdateId.load() - id) < 0) {
+        const TickType_t elapsed = xTaskGetTickCount() - start;
+        if (elapsed >= pdMS_TO_TICKS(UPDATE_TIMEOUT_MS)) {
+            return false;
+        }
+        takeTaskNotification(TaskId::TELEMETRY, pdMS_TO_TICKS(UPDATE_TIMEOUT_MS) - elapsed);
+    }
+    return true;
+}
+
+static void reply(const char* status, const char* body)
+{
+    Serial.print(status);
+    if (body != nullptr && *body != '\0') {
+        Serial.print(' ');
+        Serial.print(body);
+    }
+    Serial.print('\n');
+}
+
+/**
+ * Hand a set or map command over to loop() and wait until it is applied
+ *
+ * @return true once applied; false if the reply has been sent already (queue full, or still queued at the timeout)
+ */
+static bool submitSettingsUpdate(const Command& command)
+{
+    const SettingsUpdate update = {++nextUpdateId, command};
+    if (xQueueSend(updateQueue, &update, 0) != pdTRUE) {
+        reply("err", "busy");
+        return false;
+    }
+    if (!waitForUpdate(update.id)) {
+        reply("ok", "queued");
+        return false;
+    }
+    return true;
+}
+
+/** Dump the trace buffer, oldest entry first */
+static void dumpTrace()
+{
+    TraceRing& ring = getTraceRing();
+
+    // Pause recording so the entries are not overwritten while being copied out
+    const bool enabled = ring.isEnabled();
+    ring.setEnabled(false);
+
+    const uint32_t oldest = ring.getOldest();
+    const uint32_t recorded = ring.getRecorded();
+    char buffer[TRACE_DUMP_ENTRIES_PER_LINE * 17 + 1];
+    snprintf(buffer, sizeof(buffer), "begin entries=%lu recorded=%lu capacity=%lu psram=%d",
+             static_cast<unsigned long>(recorded - oldest), static_cast<unsigned long>(recorded),
+             static_cast<unsigned long>(ring.getCapacity()), isTraceInPsram() ? 1 : 0);
+    reply("trace", buffer);
+
+    TraceEntry line[TRACE_DUMP_ENTRIES_PER_LINE];
+    for (uint32_t index = oldest; index < recorded;) {
+        size_t count = 0;
+        while (count < TRACE_DUMP_ENTRIES_PER_LINE && index < recorded) {
+            line[count++] = ring.get(index++);
+        }
+        formatTraceEntries(line, count, buffer, sizeof(buffer));
+        reply("trace", buffer);
+    }
+    reply("trace", "end");
+
+    ring.setEnabled(enabled);
+}
+
+static void handleCommand(const Command& command, unsigned long& streamInterval)
+{
+    char buffer[REPLY_BUFFER_SIZE];
+
+    switch (command.type) {
+    case CommandType::GET:
+        formatSettings(getCurrentSettings(), buffer, sizeof(buffer));
+        reply("ok", buffer);
+        break;
+    case CommandType::SET:
+        // Fields are checked one by one, so the snapshot is as good as the live settings here
+        if (!Settings::isValidRecord(applySettingFields(getCurrentSettings(), command))) {
+            reply("err", "out of range");
+            break;
+        }
+        if (!submitSettingsUpdate(command)) {
+            break;
+        }
+        formatSettings(getCurrentSettings(), buffer, sizeof(buffer));
+        reply("ok", buffer);
+        break;
+    case CommandType::MAP:
+        if (command.mapAction != MapAction::SHOW && !submitSettingsUpdate(command)) {
+            break;
+        }
+        for (int key = 0; key < 15; key++) {
+            formatKeyBinding(getCurrentSettings().bindings, key, buffer, sizeof(buffer));
+            reply("map", buffer);
+        }
+        reply("ok", nullptr);
+        break;
+    case CommandType::STATS:
+        formatTelemetry(getTelemetry(), buffer, sizeof(buffer));
+        reply("ok", buffer);
+        break;
+    case CommandType::TASKS:
+        for (int i = 0; i < static_cast<int>(TaskId::COUNT); i++) {
+            formatTaskStatus(static_cast<TaskId>(i), buffer, sizeof(buffer));
+            reply("task", buffer);
+        }
+        reply("ok", nullptr);
+        break;
+    case CommandType::LATENCY:
+        switch (command.latencyAction) {
+        case LatencyAction::RESET:
+            resetLatency();
+            break;
+        case LatencyAction::OVERLAY_ON:
+        case LatencyAction::OVERLAY_OFF:
+            setLatencyOverlay(command.latencyAction == LatencyAction::OVERLAY_ON);
+            break;
+        default:
+            for (int i = 0; i < static_cast<int>(LatencyStage::COUNT); i++) {
+                const auto stage = static_cast<LatencyStage>(i);
+                formatLatency(stage, getLatencyHistogram(stage), buffer, sizeof(buffer));
+                reply("lat", buffer);
+            }
+            break;
+        }
+        reply("ok", nullptr);
+        break;
+    case CommandType::TRACE:
+        switch (command.traceAction) {
+        case TraceAction::CLEAR:
+            getTraceRing().clear();
+            break;
+        case TraceAction::ON:
+        case TraceAction::OFF:
+            getTraceRing().setEnabled(command.traceAction == TraceAction::ON);
+            break;
+        default:
+            dumpTrace();
+            break;
+        }
+        reply("ok", nullptr);
+        break;
+    case CommandType::PLAY:
+        switch (command.playAction) {
+        case PlayAction::START:
+            {
+                if (!startPlayback(command.song)) {
+                    reply("err", "busy");
+                    break;
+                }
+                const unsigned long start = millis();
+                while (getPlaybackStatus().state == PlaybackState::LOADING &&
+                       millis() - start < PLAY_START_TIMEOUT_MS) {
+                    vTaskDelay(pdMS_TO_TICKS(POLL_INTERVAL_MS));
+                }
+                const char* error = getPlaybackError();
+                reply(error == nullptr ? "ok" : "err", error);
+                break;
+            }
+        case PlayAction::STOP:
+            if (stopPlayback()) {
+                reply("ok", nullptr);
+            } else {
+                reply("err", "not playing");
+            }
+            break;
+        default:
+            formatPlaybackStatus(getPlaybackStatus(), buffer, sizeof(buffer));
+            reply("ok", buffer);
+            break;
+        }
+        break;
+    case CommandType::NET:
+        formatNetworkMidiStatus(getNetworkMidiStatus(), buffer, sizeof(buffer));
+        reply("ok", buffer);
+        break;
+    case CommandType::SOURCES:
+        for (int i = 0; i < static_cast<int>(MidiSource::COUNT); i++) {
+            const auto source = static_cast<MidiSource>(i);
+            formatMidiSourceStats(source, getMidiSourceStats(source), buffer, sizeof(buffer));
+            reply("source", buffer);
+        }
+        reply("ok", nullptr);
+        break;
+    case CommandType::POWER:
+        formatPowerStatus(getPowerStatus(), getLatencyHistogram(LatencyStage::WAKE), buffer, sizeof(buffer));
+        reply("ok", buffer);
+        break;
+    case CommandType::LOOPBACK:
+        switch (command.loopbackAction) {
+        case LoopbackAction::START:
+            startLoopback();
+            reply("ok", nullptr);
+            break;
+        case LoopbackAction::STOP:
+            stopLoopback();
+            reply("ok", nullptr);
+            break;
+        default:
+            formatLoopbackStatus(getLoopbackStatus(), buffer, sizeof(buffer));
+            reply("ok", buffer);
+            break;
+        }
+        break;
+    case CommandType::STREAM:
+        streamInterval = command.interval;
+        reply("ok", nullptr);
+        break;
+    default:
+        break;
+    }
+}
+
+#if CPU_MONITOR
+// Tasks not created by us whose stack is reported (Bluetooth host and controller)
+static const char* const EXTERNAL_TASKS[] = {"nimble_host", "btController"};
+
+/** Print core loads, then load and free stack per task */
+static void reportCpuLoad()
+{
+    const CpuLoadSnapshot snapshot = sampleCpuLoad();
+    char buffer[REPLY_BUFFER_SIZE];
+    formatCpuLoad(snapshot, buffer, sizeof(buffer));
+    reply("cpu", buffer);
+    for (int i = 0; i < static_cast<int>(TaskId::COUNT); i++) {
+        formatTaskLoad(static_cast<TaskId>(i), snapshot, buffer, sizeof(buffer));
+        reply("cpu", buffer);
+    }
+    for (const char* name : EXTERNAL_TASKS) {
+        if (formatExternalTaskStack(name, buffer, sizeof(buffer)) > 0) {
+            reply("cpu", buffer);
+        }
+    }
+}
+#endif
+
+/** Serial command task: parses commands and streams telemetry at low priority */
+[[noreturn]] static void commandTask(void*)
+{
+    LineReader reader;
+    unsigned long streamInterval = 0;
+    unsigned long lastStream = 0;
+    bool loopbackRunning = false;
+#if CPU_MONITOR
+    unsigned long lastCpuReport = 0;
+#endif
+
+    while (true) {
+        const int64_t busyStart = beginTaskBusy();
+        while (Serial.available() > 0) {
+            if (!reader.feed(static_cast<char>(Serial.read()))) {
+                continue;
+            }
+            if (reader.overflow()) {
+                reply("err", "line too long");
+                continue;
+            }
+            Command command;
+            if (parseCommand(reader.line(), command)) {
+                handleCommand(command, streamInterval);
+            } else {
+                reply("err", command.error);
+            }
+        }
+
+        if (streamInterval > 0 && millis() - lastStream >= streamInterval) {
+            lastStream = millis();
+            char buffer[REPLY_BUFFER_SIZE];
+            formatTelemetry(getTelemetry(), buffer, sizeof(buffer));
+            reply("tm", buffer);
+        }
+
+        // Loopback self-test results once it has finished
+        if (isLoopbackRunning() != loopbackRunning) {
+            loopbackRunning = !loopbackRunning;
+            if (!loopbackRunning) {
+                char buffer[REPLY_BUFFER_SIZE];
+                formatLoopbackStatus(getLoopbackStatus(), buffer, sizeof(buffer));
+                reply("loopback", buffer);
+            }
+        }
+
+#if CPU_MONITOR
+        if (millis() - lastCpuReport >= CPU_MONITOR_INTERVAL_MS) {
+            lastCpuReport = millis();
+            reportCpuLoad();
+        }
+#endif
+        endTaskBusy(TaskId::TELEMETRY, busyStart);
+
+        vTaskDelay(pdMS_TO_TICKS(POLL_INTERVAL_MS));
+    }
+}
+
+void setupSerialCommand()
+{
+    updateQueue = xQueueCreate(UPDATE_QUEUE_LENGTH, sizeof(SettingsUpdate));
+
+    createTask(TaskId::TELEMETRY, commandTask);
+}
+
+void publishSettings(const SettingsRecord& record)
+{
+    portENTER_CRITICAL(&commandMux);
+    currentSettings = record;
+    portEXIT_CRITICAL(&commandMux);
+}
+
+bool takeSettingsUpdate(const SettingsRecord& current, SettingsRecord& record)
+{
+    SettingsUpdate update;
+    if (updateQueue == nullptr || xQueueReceive(updateQueue, &update, 0) != pdTRUE) {
+        return false;
+    }
+    takenUpdateId = update.id;
+    record = applySettingsCommand(current, update.command);
+    return true;
+}
+
+void completeSettingsUpdate()
+{
+    appliedUpdateId.store(takenUpdateId);
+    notifyTask(TaskId::TELEMETRY);
+}
@@ -0,0 +1,20 @@
+#if !defined(APP_SERIAL_COMMAND_H)
+#define APP_SERIAL_COMMAND_H
+
+#include "app/settings-record.h"
+
+void setupSerialCommand();
+
+void publishSettings(const SettingsRecord& record);
+
+/**
+ * Merge the next settings update from a serial command into the live settings (called by loop())
+ *
+ * Only the fields named by the command change; everything else keeps its value in current.
+ */
+bool takeSettingsUpdate(const SettingsRecord& current, SettingsRecord& record);
+
+/** The update taken last has been applied: the command can reply */
+void completeSettingsUpdate();
+
+#endif // !defined(APP_SERIAL_COMMAND_H)
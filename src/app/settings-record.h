@@ -0,0 +1,144 @@
+#if !defined(APP_SETTINGS_RECORD_H)
+#define APP_SETTINGS_RECORD_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "app/note-mapping.h"
+
+// Compact persisted form of the user settings
+//
+// Serialized layout: magic, version, payload length, payload, CRC-8 (over everything before it).
+// Payload fields are append-only; a decoder reads the fields it knows and leaves the rest at the
+// caller's defaults, so a shorter record written by older firmware still restores.
+struct SettingsRecord
+{
+    static constexpr uint8_t FLAG_EXPAND = 0x01;
+    static constexpr uint8_t FLAG_SUSTAIN = 0x02;
+    static constexpr uint8_t FLAG_AUTO_KEY = 0x04;
+
+    uint8_t mapping = 0;
+    uint8_t baseNote = 0;
+    uint8_t flags = 0;
+    uint8_t strum = 0; // ms between the presses of a chord, 0 = off
+    uint8_t fold = 1; // FoldStrategy of expand mode (nearest octave)
+    uint8_t split = 0; // first MIDI note of the upper fold zone, 0 = no split
+    uint8_t debounce = 0; // retrigger guard of the MIDI input in ms, 0 = off
+    uint8_t jitter = 0; // network MIDI jitter buffer delay in ms, 0 = off
+    KeyBindings bindings; // learned note and action of each Sky key
+    uint8_t conflict = 0; // ConflictPolicy of opposing stick and DPad directions (last pressed wins)
+
+    bool operator==(const SettingsRecord& other) const
+    {
+        return mapping == other.mapping &&
+            baseNote == other.baseNote &&
+            flags == other.flags &&
+            strum == other.strum &&
+            fold == other.fold &&
+            split == other.split &&
+            debounce == other.debounce &&
+            jitter == other.jitter &&
+            bindings == other.bindings &&
+            conflict == other.conflict;
+    }
+
+    bool operator!=(const SettingsRecord& other) const
+    {
+        return !(*this == other);
+    }
+};
+
+static constexpr uint8_t SETTINGS_RECORD_MAGIC = 0xA5;
+static constexpr uint8_t SETTINGS_RECORD_VERSION = 1;
+static constexpr size_t SETTINGS_RECORD_HEADER_SIZE = 3;
+static constexpr size_t SETTINGS_RECORD_PAYLOAD_SIZE = 39;
+static constexpr size_t SETTINGS_RECORD_SIZE = SETTINGS_RECORD_HEADER_SIZE + SETTINGS_RECORD_PAYLOAD_SIZE + 1;
+
+// Largest stored record read back (leaves room for the longer payloads of later firmware)
+static constexpr size_t SETTINGS_RECORD_MAX_SIZE = 64;
+static_assert(SETTINGS_RECORD_SIZE <= SETTINGS_RECORD_MAX_SIZE, "settings record outgrew SETTINGS_RECORD_MAX_SIZE");
+
+// CRC-8 (polynomial 0x07)
+inline uint8_t settingsRecordCrc8(const uint8_t* data, const size_t length)
+{
+    uint8_t crc = 0;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x80) ? static_cast<uint8_t>((crc << 1) ^ 0x07) : static_cast<uint8_t>(crc << 1);
+        }
+    }
+    return crc;
+}
+
+/**
+ * Serialize settings record
+ *
+ * @return number of bytes written, or 0 if the buffer is too small
+ */
+inline size_t encodeSettingsRecord(const SettingsRecord& record, uint8_t* buffer, const size_t size)
+{
+    if (size < SETTINGS_RECORD_SIZE) {
+        return 0;
+    }
+    buffer[0] = SETTINGS_RECORD_MAGIC;
+    buffer[1] = SETTINGS_RECORD_VERSION;
+    buffer[2] = SETTINGS_RECORD_PAYLOAD_SIZE;
+    buffer[3] = record.mapping;
+    buffer[4] = record.baseNote;
+    buffer[5] = record.flags;
+    buffer[6] = record.strum;
+    buffer[7] = record.fold;
+    buffer[8] = record.split;
+    buffer[9] = record.debounce;
+    buffer[10] = record.jitter;
+    memcpy(buffer + 11, record.bindings.notes, 15);
+    memcpy(buffer + 26, record.bindings.actions, 15);
+    buffer[41] = record.conflict;
+    buffer[42] = settingsRecordCrc8(buffer, SETTINGS_RECORD_SIZE - 1);
+    return SETTINGS_RECORD_SIZE;
+}
+
+/**
+ * Deserialize settings record
+ *
+ * Fields not present in the stored payload are left untouched in the given record.
+ *
+ * @return true if the record is valid
+ */
+inline bool decodeSettingsRecord(const uint8_t* buffer, const size_t length, SettingsRecord& record)
+{
+    if (length < SETTINGS_RECORD_HEADER_SIZE + 1) {
+        return false;
+    }
+    if (buffer[0] != SETTINGS_RECORD_MAGIC || buffer[1] != SETTINGS_RECORD_VERSION) {
+        return false;
+    }
+    const size_t payloadSize = buffer[2];
+    const size_t recordSize = SETTINGS_RECORD_HEADER_SIZE + payloadSize + 1;
+    if (length < recordSize) {
+        return false;
+    }
+    if (settingsRecordCrc8(buffer, recordSize - 1) != buffer[recordSize - 1]) {
+        return false;
+    }
+
+    const uint8_t* payload = buffer + SETTINGS_RECORD_HEADER_SIZE;
+    if (payloadSize > 0) record.mapping = payload[0];
+    if (payloadSize > 1) record.baseNote = payload[1];
+    if (payloadSize > 2) record.flags = payload[2];
+    if (payloadSize > 3) record.strum = payload[3];
+    if (payloadSize > 4) record.fold = payload[4];
+    if (payloadSize > 5) record.split = payload[5];
+    if (payloadSize > 6) record.debounce = payload[6];
+    if (payloadSize > 7) record.jitter = payload[7];
+    if (payloadSize >= 38) {
+        memcpy(record.bindings.notes, payload + 8, 15);
+        memcpy(record.bindings.actions, payload + 23, 15);
+    }
+    if (payloadSize > 38) record.conflict = payload[38];
+    return true;
+}
+
+#endif // !defined(APP_SETTINGS_RECORD_H)
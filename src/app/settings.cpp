@@ -1,25 +1,48 @@
-#include <M5Unified.h>
-
-#include "display.h"
-#include "midi.h"
-#include "settings.h"
+#include "app/hal.h"
+#include "app/midi.h"
+#include "app/network-midi.h"
+#include "app/settings.h"
+#include "app/strum.h"
 
 // Settings constants
 constexpr int MAPPING_MIN = 1;
 constexpr int MAPPING_MAX = 2;
 constexpr int MAPPING_DEFAULT = 1;
-constexpr int BASENOTE_MIN = 24; // C1
-constexpr int BASENOTE_MAX = 84; // C6
 constexpr int BASENOTE_DEFAULT = 48; // C3
 constexpr bool EXPAND_DEFAULT = false;
 constexpr bool SUSTAIN_DEFAULT = false;
+constexpr bool AUTO_KEY_DEFAULT = false;
+constexpr int STRUM_DEFAULT = 0;
+constexpr FoldStrategy FOLD_DEFAULT = FoldStrategy::NEAREST;
+constexpr int SPLIT_DEFAULT = 0;
+constexpr int DEBOUNCE_DEFAULT = 0;
+constexpr int JITTER_DEFAULT = 0;
+constexpr ConflictPolicy CONFLICT_DEFAULT = ConflictPolicy::LAST;
+
+static bool isValidBindings(const KeyBindings& bindings)
+{
+    for (int key = 0; key < 15; key++) {
+        if (bindings.notes[key] > MAX_NOTES || bindings.actions[key] > 15) {
+            return false;
+        }
+    }
+    return true;
+}
 
 Settings::Settings()
     : _settingType(SettingType::NONE),
       _mapping(MAPPING_DEFAULT),
       _baseNote(BASENOTE_DEFAULT),
       _expand(EXPAND_DEFAULT),
-      _sustain(SUSTAIN_DEFAULT)
+      _sustain(SUSTAIN_DEFAULT),
+      _autoKey(AUTO_KEY_DEFAULT),
+      _strum(STRUM_DEFAULT),
+      _fold(FOLD_DEFAULT),
+      _split(SPLIT_DEFAULT),
+      _debounce(DEBOUNCE_DEFAULT),
+      _jitter(JITTER_DEFAULT),
+      _conflict(CONFLICT_DEFAULT),
+      _learnKey(0)
 {
 }
 
@@ -28,7 +51,15 @@ bool Settings::operator==(const Settings& other) const
     return _settingType == other._settingType &&
         _mapping == other._mapping &&
         _baseNote == other._baseNote &&
-        _sustain == other._sustain;
+        _sustain == other._sustain &&
+        _autoKey == other._autoKey &&
+        _strum == other._strum &&
+        _fold == other._fold &&
+        _split == other._split &&
+        _debounce == other._debounce &&
+        _jitter == other._jitter &&
+        _conflict == other._conflict &&
+        _bindings == other._bindings;
 }
 
 bool Settings::operator!=(const Settings& other) const
@@ -45,9 +76,9 @@ bool Settings::processButtons(const bool btnPressedA, const bool btnPressedB, co
         _settingType = static_cast<SettingType>((static_cast<int>(_settingType) + 1) %
             static_cast<int>(SettingType::COUNT));
         if (_settingType == SettingType::NONE) {
-            M5.Speaker.tone(1000, 500);
+            getHal().speaker->tone(1000, 500);
         } else {
-            M5.Speaker.tone(1000, 100);
+            getHal().speaker->tone(1000, 100);
         }
         changed = true;
     }
@@ -56,7 +87,7 @@ bool Settings::processButtons(const bool btnPressedA, const bool btnPressedB, co
     if ((btnPressedA || btnPressedC) && _settingType != SettingType::NONE) {
         switch (_settingType) {
         case SettingType::MAPPING:
-            M5.Speaker.tone(2000, 100);
+            getHal().speaker->tone(2000, 100);
             if (btnPressedA && _mapping > MAPPING_MIN) {
                 _mapping--;
             }
@@ -66,7 +97,7 @@ bool Settings::processButtons(const bool btnPressedA, const bool btnPressedB, co
             changed = true;
             break;
         case SettingType::BASENOTE:
-            M5.Speaker.tone(2000, 100);
+            getHal().speaker->tone(2000, 100);
             if (btnPressedA && _baseNote > BASENOTE_MIN) {
                 _baseNote--;
             }
@@ -76,7 +107,7 @@ bool Settings::processButtons(const bool btnPressedA, const bool btnPressedB, co
             changed = true;
             break;
         case SettingType::EXPAND:
-            M5.Speaker.tone(2000, 100);
+            getHal().speaker->tone(2000, 100);
             if (btnPressedA || btnPressedC) {
                 _expand = !_expand;
                 setSustainEnabled(_expand);
@@ -84,13 +115,23 @@ bool Settings::processButtons(const bool btnPressedA, const bool btnPressedB, co
             changed = true;
             break;
         case SettingType::SUSTAIN:
-            M5.Speaker.tone(2000, 100);
+            getHal().speaker->tone(2000, 100);
             if (btnPressedA || btnPressedC) {
                 _sustain = !_sustain;
                 setSustainEnabled(_sustain);
             }
             changed = true;
             break;
+        case SettingType::LEARN:
+            getHal().speaker->tone(2000, 100);
+            _learnKey = (_learnKey + (btnPressedC ? 1 : 14)) % 15;
+            changed = true;
+            break;
+        case SettingType::ACTION:
+            getHal().speaker->tone(2000, 100);
+            _bindings.setAction(_learnKey, (_bindings.getAction(_learnKey) + (btnPressedC ? 1 : 14)) % 15);
+            changed = true;
+            break;
         default:
             break;
         }
@@ -99,63 +140,79 @@ bool Settings::processButtons(const bool btnPressedA, const bool btnPressedB, co
     return changed;
 }
 
-static const char* getBaseNote(const int baseNote)
+bool Settings::learnNote(const int note)
 {
-    const char* KEYS[] = {
-        "C",
-        "C#",
-        "D",
-        "D#",
-        "E",
-        "F",
-        "F#",
-        "G",
-        "G#",
-        "A",
-        "A#",
-        "B",
-    };
-    return KEYS[baseNote % 12];
+    if (_settingType != SettingType::LEARN || note < 0 || note >= MAX_NOTES || _bindings.getNote(_learnKey) == note) {
+        return false;
+    }
+    getHal().speaker->tone(3000, 100);
+    _bindings.setNote(_learnKey, note);
+    return true;
 }
 
-static const char* getKey(const int baseNote)
+SettingsRecord Settings::toRecord() const
 {
-    const char* KEYS[] = {
-        "C/Am",
-        "Db/Bbm",
-        "D/Bm",
-        "Eb/Cm",
-        "E/C#m",
-        "F/Dm",
-        "F#/D#m",
-        "G/Em",
-        "Ab/Fm",
-        "A/F#m",
-        "Bb/Gm",
-        "B/G#m",
-    };
-    return KEYS[baseNote % 12];
+    SettingsRecord record;
+    record.mapping = static_cast<uint8_t>(_mapping);
+    record.baseNote = static_cast<uint8_t>(_baseNote);
+    record.flags = (_expand ? SettingsRecord::FLAG_EXPAND : 0) |
+        (_sustain ? SettingsRecord::FLAG_SUSTAIN : 0) |
+        (_autoKey ? SettingsRecord::FLAG_AUTO_KEY : 0);
+    record.strum = static_cast<uint8_t>(_strum);
+    record.fold = static_cast<uint8_t>(_fold);
+    record.split = static_cast<uint8_t>(_split);
+    record.debounce = static_cast<uint8_t>(_debounce);
+    record.jitter = static_cast<uint8_t>(_jitter);
+    record.conflict = static_cast<uint8_t>(_conflict);
+    record.bindings = _bindings;
+    return record;
 }
 
-void drawSettings(const Settings& settings)
+bool Settings::isValidRecord(const SettingsRecord& record)
 {
-    const auto settingType = settings.getSettingType();
-
-    M5.Display.fillRect(0, 48, 320, static_cast<int>(SettingType::COUNT) * 16, TFT_BLACK);
-    M5.Display.setCursor(0, 48);
-
-    M5.Display.setTextColor(settingType == SettingType::MAPPING ? TFT_YELLOW : TFT_WHITE, TFT_BLACK);
-    M5.Display.printf("Mapping: %d\n", settings.getMapping());
-
-    M5.Display.setTextColor(settingType == SettingType::BASENOTE ? TFT_YELLOW : TFT_WHITE, TFT_BLACK);
-    M5.Display.printf("Base note: %s%d (%s)\n", getBaseNote(settings.getBaseNote()),
-                      settings.getBaseNote() / 12 - 1, getKey(settings.getBaseNote()));
-
-    M5.Display.setTextColor(settingType == SettingType::EXPAND ? TFT_YELLOW : TFT_WHITE, TFT_BLACK);
-    M5.Display.printf("Expand: %s\n", settings.getExpand() ? "ON" : "OFF");
-
-    M5.Display.setTextColor(settingType == SettingType::SUSTAIN ? TFT_YELLOW : TFT_WHITE, TFT_BLACK);
-    M5.Display.printf("Sustain: %s\n", settings.getSustain() ? "ON" : "OFF");
+    return MAPPING_MIN <= record.mapping && record.mapping <= MAPPING_MAX &&
+        BASENOTE_MIN <= record.baseNote && record.baseNote <= BASENOTE_MAX &&
+        record.strum <= STRUM_SPACING_MAX_MS &&
+        record.fold < static_cast<uint8_t>(FoldStrategy::COUNT) &&
+        record.split < MAX_NOTES &&
+        record.debounce <= DEBOUNCE_GUARD_MAX_MS &&
+        record.jitter <= NETWORK_JITTER_MAX_MS &&
+        record.conflict < static_cast<uint8_t>(ConflictPolicy::COUNT) &&
+        isValidBindings(record.bindings);
+}
 
-    drawKeyboard(128, 320, 60, settings.getBaseNote());
+void Settings::applyRecord(const SettingsRecord& record)
+{
+    // Ignore out-of-range values from a stale or foreign record
+    if (MAPPING_MIN <= record.mapping && record.mapping <= MAPPING_MAX) {
+        _mapping = record.mapping;
+    }
+    if (BASENOTE_MIN <= record.baseNote && record.baseNote <= BASENOTE_MAX) {
+        _baseNote = record.baseNote;
+    }
+    _expand = (record.flags & SettingsRecord::FLAG_EXPAND) != 0;
+    _sustain = (record.flags & SettingsRecord::FLAG_SUSTAIN) != 0;
+    _autoKey = (record.flags & SettingsRecord::FLAG_AUTO_KEY) != 0;
+    if (record.strum <= STRUM_SPACING_MAX_MS) {
+        _strum = record.strum;
+    }
+    if (record.fold < static_cast<uint8_t>(FoldStrategy::COUNT)) {
+        _fold = static_cast<FoldStrategy>(record.fold);
+    }
+    if (record.split < MAX_NOTES) {
+        _split = record.split;
+    }
+    if (record.debounce <= DEBOUNCE_GUARD_MAX_MS) {
+        _debounce = record.debounce;
+    }
+    if (record.jitter <= NETWORK_JITTER_MAX_MS) {
+        _jitter = record.jitter;
+    }
+    if (record.conflict < static_cast<uint8_t>(ConflictPolicy::COUNT)) {
+        _conflict = static_cast<ConflictPolicy>(record.conflict);
+    }
+    if (isValidBindings(record.bindings)) {
+        _bindings = record.bindings;
+    }
+    setSustainEnabled(_sustain);
 }
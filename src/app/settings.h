@@ -1,6 +1,14 @@
 #if !defined(APP_SETTINGS_H)
 #define APP_SETTINGS_H
 
+#include "app/note-mapping.h"
+#include "app/report.h"
+#include "app/settings-record.h"
+
+// Base note range (C1 - C6)
+static constexpr int BASENOTE_MIN = 24;
+static constexpr int BASENOTE_MAX = 84;
+
 enum class SettingType
 {
     NONE = 0,
@@ -8,7 +16,9 @@ enum class SettingType
     BASENOTE = 2,
     EXPAND = 3,
     SUSTAIN = 4,
-    COUNT = 5,
+    LEARN = 5, // select a key, then play the MIDI note to bind to it
+    ACTION = 6, // controller action of the selected key
+    COUNT = 7,
 };
 
 class Settings
@@ -22,9 +32,31 @@ public:
     int getBaseNote() const { return _baseNote; }
     bool getExpand() const { return _expand; }
     bool getSustain() const { return _sustain; }
+    bool getAutoKey() const { return _autoKey; }
+    int getStrum() const { return _strum; }
+    FoldStrategy getFold() const { return _fold; }
+    int getSplit() const { return _split; }
+    int getDebounce() const { return _debounce; }
+    int getJitter() const { return _jitter; }
+    ConflictPolicy getConflict() const { return _conflict; }
+    const KeyBindings& getBindings() const { return _bindings; }
+
+    /** Key edited on the learn and action pages */
+    int getLearnKey() const { return _learnKey; }
 
     bool processButtons(bool btnPressedA, bool btnPressedB, bool btnPressedC);
 
+    /**
+     * Bind a played MIDI note to the selected key (learn page only)
+     *
+     * @return true if the bindings changed
+     */
+    bool learnNote(int note);
+
+    SettingsRecord toRecord() const;
+    void applyRecord(const SettingsRecord& record);
+    static bool isValidRecord(const SettingsRecord& record);
+
     bool operator==(const Settings& other) const;
     bool operator!=(const Settings& other) const;
 
@@ -34,8 +66,15 @@ private:
     int _baseNote;
     bool _expand;
     bool _sustain;
+    bool _autoKey;
+    int _strum;
+    FoldStrategy _fold;
+    int _split;
+    int _debounce;
+    int _jitter;
+    ConflictPolicy _conflict;
+    KeyBindings _bindings;
+    int _learnKey;
 };
 
-void drawSettings(const Settings& settings);
-
 #endif // !defined(APP_SETTINGS_H)
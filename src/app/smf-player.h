@@ -0,0 +1,206 @@
+#if !defined(APP_SMF_PLAYER_H)
+#define APP_SMF_PLAYER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "app/latency.h"
+#include "app/smf-reader.h"
+
+// Events per block of the double buffer (one block is played while the other is read ahead)
+static constexpr size_t SMF_PLAYER_BLOCK_EVENTS = 64;
+
+// Time between start() and the first tick of the song, so that the first events are not late already
+static constexpr uint32_t SMF_PLAYER_LEAD_US = 50000;
+
+// Song player with a double-buffered reader
+//
+// The reader side (open(), fill(): the task doing the flash reads) decodes events into whichever of the two
+// blocks is free; the scheduler side (start(), dispatch(): woken at each event time) only reads from memory
+// and hands a block back once it has been played. A slow read delays nothing as long as the other block
+// lasts; otherwise the scheduler waits and counts an underrun.
+//
+// Times are 32-bit microseconds (songs up to 71 minutes). Lateness is measured against the song timeline,
+// i.e. the start time plus the tempo-mapped time of each event.
+class SmfPlayer
+{
+public:
+    /** Open a song and read ahead both blocks (reader side, while stopped) */
+    bool open(SmfSource& source)
+    {
+        for (Block& block : blocks) {
+            block.ready.store(false, std::memory_order_relaxed);
+            block.count = 0;
+            block.last = false;
+        }
+        fillIndex = 0;
+        readerDone = false;
+        playIndex = 0;
+        playPosition = 0;
+        finished = false;
+        stalled = false;
+        released = false;
+        events = 0;
+        underruns = 0;
+        lateness.reset();
+
+        if (!reader.open(source)) {
+            return false;
+        }
+        fill();
+        fill();
+        return true;
+    }
+
+    /**
+     * Read ahead into the next free block (reader side)
+     *
+     * @return false if there was nothing to do
+     */
+    bool fill()
+    {
+        Block& block = blocks[fillIndex];
+        if (readerDone || block.ready.load(std::memory_order_acquire)) {
+            return false;
+        }
+        block.count = 0;
+        while (block.count < SMF_PLAYER_BLOCK_EVENTS && reader.next(block.events[block.count])) {
+            block.count++;
+        }
+        block.last = block.count < SMF_PLAYER_BLOCK_EVENTS;
+        readerDone = block.last;
+        block.ready.store(true, std::memory_order_release);
+        fillIndex ^= 1;
+        return true;
+    }
+
+    /** Start the timeline: song time 0 is at startUs (scheduler side) */
+    void start(const uint32_t startUs)
+    {
+        songStartUs = startUs;
+    }
+
+    /**
+     * Send the events due at nowUs (scheduler side)
+     *
+     * @param send called as send(event, lateUs) for each event in song order
+     * @return number of events sent
+     */
+    template <typename Send>
+    int dispatch(const uint32_t nowUs, Send&& send)
+    {
+        int sent = 0;
+        while (!finished) {
+            Block& block = blocks[playIndex];
+            if (!block.ready.load(std::memory_order_acquire)) {
+                // Reader fell behind: wait for it (events sent afterwards are counted as late)
+                if (!stalled) {
+                    stalled = true;
+                    underruns++;
+                }
+                break;
+            }
+            stalled = false;
+
+            if (playPosition >= block.count) {
+                if (block.last) {
+                    finished = true;
+                    break;
+                }
+                // Hand the block back to the reader
+                block.ready.store(false, std::memory_order_release);
+                playIndex ^= 1;
+                playPosition = 0;
+                released = true;
+                continue;
+            }
+
+            const SmfEvent& event = block.events[playPosition];
+            const uint32_t lateUs = nowUs - getDueUs(event);
+            if (static_cast<int32_t>(lateUs) < 0) {
+                break;
+            }
+            send(event, lateUs);
+            lateness.record(lateUs);
+            playPosition++;
+            events++;
+            sent++;
+            if (playPosition >= block.count && block.last) {
+                finished = true;
+            }
+        }
+        return sent;
+    }
+
+    /**
+     * Time from nowUs to the next buffered event (scheduler side)
+     *
+     * @return false if no event is buffered (finished or waiting for the reader)
+     */
+    bool getNextDelay(const uint32_t nowUs, uint32_t& delayUs) const
+    {
+        const Block& block = blocks[playIndex];
+        if (finished || !block.ready.load(std::memory_order_acquire)) {
+            return false;
+        }
+        if (playPosition >= block.count) {
+            delayUs = 0;
+            return !block.last;
+        }
+        const int32_t delay = static_cast<int32_t>(getDueUs(block.events[playPosition]) - nowUs);
+        delayUs = delay > 0 ? static_cast<uint32_t>(delay) : 0;
+        return true;
+    }
+
+    /** Whether a block was handed back since the last call, i.e. the reader has work (scheduler side) */
+    bool takeReleased()
+    {
+        const bool result = released;
+        released = false;
+        return result;
+    }
+
+    bool isFinished() const { return finished; }
+
+    uint32_t getEvents() const { return events; }
+
+    uint32_t getUnderruns() const { return underruns; }
+
+    /** Lateness of the sent events against the song timeline in microseconds */
+    const LatencyHistogram& getLateness() const { return lateness; }
+
+private:
+    struct Block
+    {
+        SmfEvent events[SMF_PLAYER_BLOCK_EVENTS];
+        size_t count = 0;
+        bool last = false; // no more events after this block
+        std::atomic<bool> ready{false}; // filled, owned by the scheduler until handed back
+    };
+
+    uint32_t getDueUs(const SmfEvent& event) const
+    {
+        return songStartUs + static_cast<uint32_t>(event.timeUs);
+    }
+
+    Block blocks[2];
+
+    // Reader side
+    SmfReader reader;
+    int fillIndex = 0;
+    bool readerDone = false;
+
+    // Scheduler side
+    uint32_t songStartUs = 0;
+    int playIndex = 0;
+    size_t playPosition = 0;
+    bool finished = false;
+    bool stalled = false;
+    bool released = false;
+    uint32_t events = 0;
+    uint32_t underruns = 0;
+    LatencyHistogram lateness;
+};
+
+#endif // !defined(APP_SMF_PLAYER_H)
@@ -0,0 +1,315 @@
+#if !defined(APP_SMF_READER_H)
+#define APP_SMF_READER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Maximum number of tracks merged by SmfReader (extra tracks are ignored)
+static constexpr int SMF_MAX_TRACKS = 16;
+
+// Bytes buffered per track between reads from the source
+static constexpr size_t SMF_TRACK_BUFFER = 32;
+
+/** Random-access byte source of a Standard MIDI File (file, flash, memory) */
+class SmfSource
+{
+public:
+    virtual ~SmfSource() = default;
+
+    /** Read up to size bytes at offset, returns the number of bytes read */
+    virtual size_t readAt(uint32_t offset, uint8_t* buffer, size_t size) = 0;
+};
+
+class MemorySmfSource final : public SmfSource
+{
+public:
+    MemorySmfSource(const uint8_t* data, const size_t size) : data(data), size(size) {}
+
+    size_t readAt(const uint32_t offset, uint8_t* buffer, const size_t length) override
+    {
+        if (offset >= size) {
+            return 0;
+        }
+        const size_t count = length < size - offset ? length : size - offset;
+        memcpy(buffer, data + offset, count);
+        return count;
+    }
+
+private:
+    const uint8_t* data;
+    size_t size;
+};
+
+// Channel message read from a file
+struct SmfEvent
+{
+    uint32_t tick = 0;
+    uint64_t timeUs = 0; // from the start of the song, tempo map applied
+    uint8_t data[3] = {0};
+    uint8_t size = 0;
+};
+
+// Streaming Standard MIDI File reader (format 0 and 1)
+//
+// The file is never loaded whole: each track keeps a cursor and a small buffer, and next() merges the tracks
+// in time order. Meta events (tempo) and system exclusive are consumed internally; only channel messages
+// are returned.
+class SmfReader
+{
+public:
+    /** Parse the header and locate the tracks */
+    bool open(SmfSource& smfSource)
+    {
+        source = &smfSource;
+        trackCount = 0;
+        tempo = 500000;
+        tempoTick = 0;
+        tempoUs = 0;
+
+        uint8_t header[14];
+        if (source->readAt(0, header, sizeof(header)) != sizeof(header) || memcmp(header, "MThd", 4) != 0) {
+            return false;
+        }
+        const uint32_t headerLength = readUint32(header + 4);
+        format = readUint16(header + 8);
+        const uint16_t declaredTracks = readUint16(header + 10);
+        division = readUint16(header + 12);
+        if (headerLength < 6 || format > 1 || division == 0) {
+            return false;
+        }
+
+        // Walk the chunks, skipping unknown ones
+        uint32_t offset = 8 + headerLength;
+        while (trackCount < declaredTracks && trackCount < SMF_MAX_TRACKS) {
+            uint8_t chunk[8];
+            if (source->readAt(offset, chunk, sizeof(chunk)) != sizeof(chunk)) {
+                break;
+            }
+            const uint32_t length = readUint32(chunk + 4);
+            if (memcmp(chunk, "MTrk", 4) == 0) {
+                Track& track = tracks[trackCount++];
+                track = Track();
+                track.position = offset + 8;
+                track.end = offset + 8 + length;
+                track.active = readDelta(track);
+            }
+            offset += 8 + length;
+        }
+        return trackCount > 0;
+    }
+
+    /**
+     * Next channel message in time order
+     *
+     * @return false at the end of all tracks
+     */
+    bool next(SmfEvent& event)
+    {
+        while (true) {
+            // Track with the earliest pending event (lowest index first on ties)
+            Track* track = nullptr;
+            for (int i = 0; i < trackCount; i++) {
+                if (tracks[i].active && (track == nullptr || tracks[i].nextTick < track->nextTick)) {
+                    track = &tracks[i];
+                }
+            }
+            if (track == nullptr) {
+                return false;
+            }
+            if (readEvent(*track, event)) {
+                track->active = readDelta(*track);
+                return true;
+            }
+            track->active = track->active && readDelta(*track);
+        }
+    }
+
+    uint16_t getFormat() const { return format; }
+
+    int getTrackCount() const { return trackCount; }
+
+    uint16_t getDivision() const { return division; }
+
+private:
+    struct Track
+    {
+        uint32_t position = 0;
+        uint32_t end = 0;
+        uint32_t nextTick = 0;
+        uint8_t runningStatus = 0;
+        bool active = false;
+        uint32_t bufferStart = 0;
+        uint8_t bufferSize = 0;
+        uint8_t buffer[SMF_TRACK_BUFFER] = {0};
+    };
+
+    static uint16_t readUint16(const uint8_t* bytes)
+    {
+        return static_cast<uint16_t>(bytes[0] << 8 | bytes[1]);
+    }
+
+    static uint32_t readUint32(const uint8_t* bytes)
+    {
+        return static_cast<uint32_t>(bytes[0]) << 24 | bytes[1] << 16 | bytes[2] << 8 | bytes[3];
+    }
+
+    /** Next byte of the track, -1 at its end */
+    int readByte(Track& track)
+    {
+        if (track.position >= track.end) {
+            return -1;
+        }
+        if (track.position < track.bufferStart || track.position >= track.bufferStart + track.bufferSize) {
+            const uint32_t remaining = track.end - track.position;
+            track.bufferStart = track.position;
+            track.bufferSize = static_cast<uint8_t>(source->readAt(
+                track.position, track.buffer, remaining < SMF_TRACK_BUFFER ? remaining : SMF_TRACK_BUFFER));
+            if (track.bufferSize == 0) {
+                // Truncated file
+                track.end = track.position;
+                return -1;
+            }
+        }
+        return track.buffer[track.position++ - track.bufferStart];
+    }
+
+    bool readVarLen(Track& track, uint32_t& value)
+    {
+        value = 0;
+        for (int i = 0; i < 4; i++) {
+            const int byte = readByte(track);
+            if (byte < 0) {
+                return false;
+            }
+            value = value << 7 | (byte & 0x7F);
+            if ((byte & 0x80) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool readDelta(Track& track)
+    {
+        uint32_t delta;
+        if (!readVarLen(track, delta)) {
+            return false;
+        }
+        track.nextTick += delta;
+        return true;
+    }
+
+    uint64_t getTimeUs(const uint32_t tick) const
+    {
+        if (division & 0x8000) {
+            // SMPTE: frames per second (negative) and ticks per frame
+            const uint32_t fps = 256 - (division >> 8);
+            const uint32_t ticksPerFrame = division & 0xFF;
+            return static_cast<uint64_t>(tick) * 1000000 / (fps * ticksPerFrame);
+        }
+        return tempoUs + static_cast<uint64_t>(tick - tempoTick) * tempo / division;
+    }
+
+    /**
+     * Consume the event at the track position
+     *
+     * @return true if it is a channel message (stored in event)
+     */
+    bool readEvent(Track& track, SmfEvent& event)
+    {
+        int status = readByte(track);
+        if (status < 0) {
+            track.active = false;
+            return false;
+        }
+
+        if (status == 0xFF) {
+            // Meta event
+            track.runningStatus = 0;
+            const int type = readByte(track);
+            uint32_t length;
+            if (type < 0 || !readVarLen(track, length)) {
+                track.active = false;
+                return false;
+            }
+            if (type == 0x51 && length == 3) {
+                // Set tempo (microseconds per quarter note)
+                const int b0 = readByte(track);
+                const int b1 = readByte(track);
+                const int b2 = readByte(track);
+                if (b2 < 0) {
+                    track.active = false;
+                    return false;
+                }
+                tempoUs = getTimeUs(track.nextTick);
+                tempoTick = track.nextTick;
+                tempo = static_cast<uint32_t>(b0 << 16 | b1 << 8 | b2);
+            } else {
+                track.position += length;
+            }
+            if (type == 0x2F) {
+                // End of track
+                track.active = false;
+            }
+            return false;
+        }
+
+        if (status == 0xF0 || status == 0xF7) {
+            // System exclusive (not forwarded)
+            track.runningStatus = 0;
+            uint32_t length;
+            if (!readVarLen(track, length)) {
+                track.active = false;
+                return false;
+            }
+            track.position += length;
+            return false;
+        }
+
+        event.size = 0;
+        if (status < 0x80) {
+            // Running status: this byte is the first data byte
+            if (track.runningStatus == 0) {
+                track.active = false;
+                return false;
+            }
+            event.data[event.size++] = track.runningStatus;
+            event.data[event.size++] = static_cast<uint8_t>(status);
+        } else {
+            track.runningStatus = static_cast<uint8_t>(status);
+            event.data[event.size++] = static_cast<uint8_t>(status);
+            const int data1 = readByte(track);
+            if (data1 < 0) {
+                track.active = false;
+                return false;
+            }
+            event.data[event.size++] = static_cast<uint8_t>(data1);
+        }
+        const uint8_t type = event.data[0] & 0xF0;
+        if (type != 0xC0 && type != 0xD0) {
+            const int data2 = readByte(track);
+            if (data2 < 0) {
+                track.active = false;
+                return false;
+            }
+            event.data[event.size++] = static_cast<uint8_t>(data2);
+        }
+        event.tick = track.nextTick;
+        event.timeUs = getTimeUs(track.nextTick);
+        return true;
+    }
+
+    SmfSource* source = nullptr;
+    Track tracks[SMF_MAX_TRACKS];
+    int trackCount = 0;
+    uint16_t format = 0;
+    uint16_t division = 0;
+
+    // Tempo map: tempo (us per quarter note) in effect since tempoTick, which is at tempoUs
+    uint32_t tempo = 500000;
+    uint32_t tempoTick = 0;
+    uint64_t tempoUs = 0;
+};
+
+#endif // !defined(APP_SMF_READER_H)
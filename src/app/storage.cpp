@@ -0,0 +1,95 @@
+#include <M5Unified.h>
+#include <Preferences.h>
+
+#include "app/midi.h"
+#include "app/storage.h"
+#include "app/tasks.h"
+
+// NVS namespace and key of the settings record
+static constexpr const char* STORAGE_NAMESPACE = "m5midisky";
+static constexpr const char* STORAGE_KEY_SETTINGS = "settings";
+
+// Quiet period after the last change before the record is written
+static constexpr unsigned long SAVE_DEBOUNCE_MS = 3000;
+
+// Postpone writing while notes are being played (flash writes stall both cores)
+static constexpr unsigned long SAVE_IDLE_MS = 2000;
+
+static Preferences preferences;
+
+// Record waiting to be written, guarded by storageMux
+static SettingsRecord pendingRecord;
+static portMUX_TYPE storageMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Last record known to be in flash (written or restored)
+static SettingsRecord storedRecord;
+static bool hasStoredRecord = false;
+
+/** Write-behind task: writes the latest pending record once changes settle */
+[[noreturn]] static void storageTask(void*)
+{
+    while (true) {
+        takeTaskNotification(TaskId::STORAGE, portMAX_DELAY);
+
+        // Restart the quiet period on every further change
+        while (takeTaskNotification(TaskId::STORAGE, pdMS_TO_TICKS(SAVE_DEBOUNCE_MS)) > 0) {
+        }
+
+        // Wait for a pause in playing
+        while (millis() - getLastNoteTime() < SAVE_IDLE_MS) {
+            vTaskDelay(pdMS_TO_TICKS(SAVE_IDLE_MS));
+        }
+
+        portENTER_CRITICAL(&storageMux);
+        const SettingsRecord record = pendingRecord;
+        portEXIT_CRITICAL(&storageMux);
+
+        // Skip unchanged records to keep flash wear low
+        if (hasStoredRecord && record == storedRecord) {
+            continue;
+        }
+
+        const int64_t busyStart = beginTaskBusy();
+        uint8_t buffer[SETTINGS_RECORD_SIZE];
+        const size_t length = encodeSettingsRecord(record, buffer, sizeof(buffer));
+        if (preferences.putBytes(STORAGE_KEY_SETTINGS, buffer, length) == length) {
+            storedRecord = record;
+            hasStoredRecord = true;
+        } else {
+            Serial.println("Failed to save settings");
+        }
+        endTaskBusy(TaskId::STORAGE, busyStart);
+    }
+}
+
+void setupStorage()
+{
+    preferences.begin(STORAGE_NAMESPACE, false);
+
+    createTask(TaskId::STORAGE, storageTask);
+}
+
+bool loadSettings(SettingsRecord& record)
+{
+    if (!preferences.isKey(STORAGE_KEY_SETTINGS)) {
+        return false;
+    }
+
+    uint8_t buffer[SETTINGS_RECORD_MAX_SIZE];
+    const size_t length = preferences.getBytes(STORAGE_KEY_SETTINGS, buffer, sizeof(buffer));
+    if (!decodeSettingsRecord(buffer, length, record)) {
+        return false;
+    }
+    storedRecord = record;
+    hasStoredRecord = true;
+    return true;
+}
+
+void saveSettings(const SettingsRecord& record)
+{
+    portENTER_CRITICAL(&storageMux);
+    pendingRecord = record;
+    portEXIT_CRITICAL(&storageMux);
+
+    notifyTask(TaskId::STORAGE);
+}
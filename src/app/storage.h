@@ -0,0 +1,12 @@
+#if !defined(APP_STORAGE_H)
+#define APP_STORAGE_H
+
+#include "app/settings-record.h"
+
+void setupStorage();
+
+bool loadSettings(SettingsRecord& record);
+
+void saveSettings(const SettingsRecord& record);
+
+#endif // !defined(APP_STORAGE_H)
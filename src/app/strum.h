@@ -0,0 +1,115 @@
+#if !defined(APP_STRUM_H)
+#define APP_STRUM_H
+
+#include <cstdint>
+
+#include "app/notes.h"
+
+// Largest configurable spacing between strummed presses
+static constexpr uint32_t STRUM_SPACING_MAX_MS = 20;
+
+// Longest a press may be held back, however many keys a chord has
+static constexpr uint32_t STRUM_MAX_SPREAD_MS = 50;
+
+// Chord strum scheduler (output stage between the note mapping and the controller report)
+//
+// Some targets register only part of a chord that arrives in a single report. With a spacing set, the keys
+// newly pressed in one Notes15 change are queued lowest key first, each due a spacing after the previous
+// queued press but never more than STRUM_MAX_SPREAD_MS after it was played; presses that reach that bound
+// together go out together. Releases pass through at once, and a key released while still queued leaves the
+// queue, so a press is never sent after its own release.
+class StrumScheduler
+{
+public:
+    /** Spacing between presses, 0 = pass everything through */
+    void setSpacing(const uint32_t spacingUs)
+    {
+        spacing = spacingUs;
+    }
+
+    /** Keys to report at nowUs for the currently played keys */
+    Notes15 update(const Notes15& played, const uint32_t nowUs)
+    {
+        // Forget the last press once its spacing has passed (keeps the 32-bit time comparisons in range)
+        if (hasLastDue && queued == 0 && static_cast<int32_t>(nowUs - lastDue) >= static_cast<int32_t>(spacing)) {
+            hasLastDue = false;
+        }
+
+        for (int i = 0; i < 15; i++) {
+            const unsigned long timestamp = played.get(i);
+            if (timestamp == 0) {
+                // Released (or never sent)
+                sent[i] = 0;
+                queued &= ~(1 << i);
+            } else if (sent[i] != 0) {
+                sent[i] = timestamp;
+                velocities[i] = played.getVelocity(i);
+            } else if ((queued & (1 << i)) == 0) {
+                // New press, in key order
+                if (spacing == 0) {
+                    sent[i] = timestamp;
+                    velocities[i] = played.getVelocity(i);
+                    continue;
+                }
+                uint32_t due = nowUs;
+                if (hasLastDue && static_cast<int32_t>(lastDue + spacing - nowUs) > 0) {
+                    due = lastDue + spacing;
+                }
+                const uint32_t latest = nowUs + STRUM_MAX_SPREAD_MS * 1000;
+                if (static_cast<int32_t>(due - latest) > 0) {
+                    due = latest;
+                }
+                dueUs[i] = due;
+                lastDue = due;
+                hasLastDue = true;
+                queued |= 1 << i;
+            }
+        }
+
+        // Presses whose turn has come
+        for (int i = 0; i < 15; i++) {
+            if ((queued & (1 << i)) != 0 && static_cast<int32_t>(nowUs - dueUs[i]) >= 0) {
+                sent[i] = played.get(i);
+                velocities[i] = played.getVelocity(i);
+                queued &= ~(1 << i);
+            }
+        }
+        return Notes15(sent, velocities);
+    }
+
+    /**
+     * Time from nowUs to the next queued press
+     *
+     * @return false if nothing is queued
+     */
+    bool getNextDelay(const uint32_t nowUs, uint32_t& delayUs) const
+    {
+        bool found = false;
+        int32_t next = 0;
+        for (int i = 0; i < 15; i++) {
+            if ((queued & (1 << i)) != 0) {
+                const int32_t delay = static_cast<int32_t>(dueUs[i] - nowUs);
+                if (!found || delay < next) {
+                    next = delay;
+                    found = true;
+                }
+            }
+        }
+        delayUs = next > 0 ? static_cast<uint32_t>(next) : 0;
+        return found;
+    }
+
+    /** Keys waiting for their turn (bit = Sky key index) */
+    uint16_t getQueuedKeys() const { return queued; }
+
+private:
+    uint32_t spacing = 0;
+    unsigned long sent[15] = {}; // timestamps of the keys in the report, 0 = not pressed
+    uint8_t velocities[15] = {};
+    uint32_t dueUs[15] = {};
+    uint16_t queued = 0;
+    uint32_t lastDue = 0;
+    bool hasLastDue = false;
+};
+
+#endif // !defined(APP_STRUM_H)
@@ -0,0 +1,184 @@
+#include <M5Unified.h>
+#include <atomic>
+#include <esp_freertos_hooks.h>
+
+#include "app/tasks.h"
+
+static_assert(static_cast<int>(TaskId::COUNT) <= CPU_LOAD_MAX_TASKS, "CPU_LOAD_MAX_TASKS too small");
+
+static TaskHandle_t taskHandles[static_cast<int>(TaskId::COUNT)] = {};
+
+// Scheduling latency per task, guarded by tasksMux
+static SchedulingLatency latencies[static_cast<int>(TaskId::COUNT)];
+
+// Time of the oldest notification of each task not yet served (micros, 0 = none)
+static std::atomic<uint32_t> notifyTimes[static_cast<int>(TaskId::COUNT)];
+static portMUX_TYPE tasksMux = portMUX_INITIALIZER_UNLOCKED;
+
+// CPU monitor: counters of the current window and the last closed one (guarded by tasksMux)
+static CpuLoad cpuLoad;
+static CpuLoadSnapshot lastCpuLoad;
+
+TaskHandle_t createTask(const TaskId id, const TaskFunction_t function)
+{
+    const TaskLayout& layout = getTaskLayout(id);
+    TaskHandle_t handle = nullptr;
+    xTaskCreatePinnedToCore(
+        function,
+        layout.name,
+        layout.stackSize,
+        nullptr,
+        layout.priority,
+        &handle,
+        layout.core < 0 ? tskNO_AFFINITY : layout.core
+    );
+    taskHandles[static_cast<int>(id)] = handle;
+    return handle;
+}
+
+void registerTask(const TaskId id)
+{
+    const TaskHandle_t handle = xTaskGetCurrentTaskHandle();
+    vTaskPrioritySet(handle, getTaskLayout(id).priority);
+    taskHandles[static_cast<int>(id)] = handle;
+}
+
+void recordSchedulingLatency(const TaskId id, const uint32_t us)
+{
+    portENTER_CRITICAL(&tasksMux);
+    latencies[static_cast<int>(id)].add(us);
+    portEXIT_CRITICAL(&tasksMux);
+}
+
+void notifyTask(const TaskId id)
+{
+    const TaskHandle_t handle = taskHandles[static_cast<int>(id)];
+    if (handle == nullptr) {
+        return;
+    }
+    uint32_t expected = 0;
+    const uint32_t now = static_cast<uint32_t>(esp_timer_get_time()) | 1;
+    notifyTimes[static_cast<int>(id)].compare_exchange_strong(expected, now);
+    xTaskNotifyGive(handle);
+}
+
+uint32_t takeTaskNotification(const TaskId id, const TickType_t timeout)
+{
+    const uint32_t count = ulTaskNotifyTake(pdTRUE, timeout);
+    if (count > 0) {
+        const uint32_t notifiedAt = notifyTimes[static_cast<int>(id)].exchange(0);
+        if (notifiedAt != 0) {
+            recordSchedulingLatency(id, static_cast<uint32_t>(esp_timer_get_time()) - notifiedAt);
+        }
+    }
+    return count;
+}
+
+size_t formatTaskStatus(const TaskId id, char* buffer, const size_t size)
+{
+    const TaskLayout& layout = getTaskLayout(id);
+    const TaskHandle_t handle = taskHandles[static_cast<int>(id)];
+    if (handle == nullptr) {
+        return snprintf(buffer, size, "%s stopped", layout.name);
+    }
+
+    portENTER_CRITICAL(&tasksMux);
+    const SchedulingLatency latency = latencies[static_cast<int>(id)];
+    portEXIT_CRITICAL(&tasksMux);
+
+    int length = snprintf(buffer, size, "%s core=%d prio=%u stack=%lu free=%lu",
+                          layout.name, xTaskGetAffinity(handle) == tskNO_AFFINITY ? -1 : xTaskGetAffinity(handle),
+                          uxTaskPriorityGet(handle),
+                          static_cast<unsigned long>(layout.stackSize),
+                          static_cast<unsigned long>(uxTaskGetStackHighWaterMark(handle)));
+
+    // Only wake-ups requested by notifyTask() are measured; tasks that just poll or sleep print no latency
+    if (length >= 0 && static_cast<size_t>(length) < size && latency.count > 0) {
+        const int written = snprintf(buffer + length, size - length, " lat_n=%lu lat_avg=%lu lat_max=%lu",
+                                     static_cast<unsigned long>(latency.count),
+                                     static_cast<unsigned long>(latency.average()),
+                                     static_cast<unsigned long>(latency.max));
+        length = written < 0 ? written : length + written;
+    }
+    return length < 0 ? 0 : static_cast<size_t>(length) < size ? length : size - 1;
+}
+
+void addTaskBusyTime(const TaskId id, const uint32_t us)
+{
+    cpuLoad.addTaskBusy(static_cast<int>(id), us);
+}
+
+#if CPU_MONITOR
+// Time of the previous idle hook call on each core
+static int64_t lastIdleUs[CPU_LOAD_CORES] = {};
+
+/** Idle hook: accumulates the time the idle task runs */
+static bool cpuIdleHook()
+{
+    const int core = xPortGetCoreID();
+    const int64_t now = esp_timer_get_time();
+    const int64_t gap = now - lastIdleUs[core];
+    lastIdleUs[core] = now;
+    if (gap < CPU_IDLE_GAP_US) {
+        cpuLoad.addIdle(core, static_cast<uint32_t>(gap));
+    }
+
+    // Keep the idle task spinning instead of waiting for an interrupt, so that idle time is seen continuously
+    // (costs power, hence development builds only)
+    return false;
+}
+#endif
+
+void setupCpuMonitor()
+{
+#if CPU_MONITOR
+    cpuLoad.take(static_cast<uint32_t>(esp_timer_get_time()));
+    for (int core = 0; core < CPU_LOAD_CORES; core++) {
+        esp_register_freertos_idle_hook_for_cpu(cpuIdleHook, core);
+    }
+#endif
+}
+
+CpuLoadSnapshot sampleCpuLoad()
+{
+    const CpuLoadSnapshot snapshot = cpuLoad.take(static_cast<uint32_t>(esp_timer_get_time()));
+    portENTER_CRITICAL(&tasksMux);
+    lastCpuLoad = snapshot;
+    portEXIT_CRITICAL(&tasksMux);
+    return snapshot;
+}
+
+CpuLoadSnapshot getLastCpuLoad()
+{
+    portENTER_CRITICAL(&tasksMux);
+    const CpuLoadSnapshot snapshot = lastCpuLoad;
+    portEXIT_CRITICAL(&tasksMux);
+    return snapshot;
+}
+
+size_t formatTaskLoad(const TaskId id, const CpuLoadSnapshot& snapshot, char* buffer, const size_t size)
+{
+    const TaskLayout& layout = getTaskLayout(id);
+    const TaskHandle_t handle = taskHandles[static_cast<int>(id)];
+    if (handle == nullptr) {
+        return snprintf(buffer, size, "%s stopped", layout.name);
+    }
+
+    const uint32_t permille = snapshot.taskPermille(static_cast<int>(id));
+    const int length = snprintf(buffer, size, "%s core=%d load=%lu.%lu%% free=%lu", layout.name,
+                                xTaskGetAffinity(handle) == tskNO_AFFINITY ? -1 : xTaskGetAffinity(handle),
+                                static_cast<unsigned long>(permille / 10), static_cast<unsigned long>(permille % 10),
+                                static_cast<unsigned long>(uxTaskGetStackHighWaterMark(handle)));
+    return length < 0 ? 0 : static_cast<size_t>(length) < size ? length : size - 1;
+}
+
+size_t formatExternalTaskStack(const char* name, char* buffer, const size_t size)
+{
+    const TaskHandle_t handle = xTaskGetHandle(name);
+    if (handle == nullptr) {
+        return 0;
+    }
+    const int length = snprintf(buffer, size, "%s free=%lu", name,
+                                static_cast<unsigned long>(uxTaskGetStackHighWaterMark(handle)));
+    return length < 0 ? 0 : static_cast<size_t>(length) < size ? length : size - 1;
+}
@@ -0,0 +1,215 @@
+#if !defined(APP_TASKS_H)
+#define APP_TASKS_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "../config.h"
+
+#include "app/cpu-load.h"
+
+// Task layout: core affinity, priority and stack size of each task
+//
+// Defaults below can be overridden in config.h or per build environment (platformio.ini build_flags).
+// Stack sizes are budgets checked against the high-water marks reported by the "tasks" serial command;
+// keep at least 1 KB free and re-check after changing what a task does. The sizes below are not derived from
+// measured high-water marks: 8192 is what the ingest, output and render tasks had before this table, and the
+// network task got the same size.
+
+// MIDI ingest (midiTask); the Bluetooth controller and host stack occupy core 0, so Bluetooth builds use core 1
+#if !defined(INGEST_TASK_CORE)
+#if defined(CONTROLLER_BT_GAMEPAD)
+#define INGEST_TASK_CORE 1
+#else
+#define INGEST_TASK_CORE 0
+#endif
+#endif
+#if !defined(INGEST_TASK_PRIORITY)
+#define INGEST_TASK_PRIORITY 3
+#endif
+#if !defined(INGEST_TASK_STACK)
+#define INGEST_TASK_STACK 8192
+#endif
+
+// Report output (outputTask)
+#if !defined(OUTPUT_TASK_CORE)
+#define OUTPUT_TASK_CORE 1
+#endif
+#if !defined(OUTPUT_TASK_PRIORITY)
+#define OUTPUT_TASK_PRIORITY 2
+#endif
+#if !defined(OUTPUT_TASK_STACK)
+#define OUTPUT_TASK_STACK 8192
+#endif
+
+// UI rendering and input (Arduino loop task, core is fixed by ARDUINO_RUNNING_CORE)
+#if !defined(RENDER_TASK_PRIORITY)
+#define RENDER_TASK_PRIORITY 1
+#endif
+#if !defined(RENDER_TASK_STACK)
+#define RENDER_TASK_STACK 8192
+#endif
+
+// Serial commands and telemetry (commandTask)
+#if !defined(TELEMETRY_TASK_CORE)
+#define TELEMETRY_TASK_CORE 1
+#endif
+#if !defined(TELEMETRY_TASK_PRIORITY)
+#define TELEMETRY_TASK_PRIORITY 1
+#endif
+#if !defined(TELEMETRY_TASK_STACK)
+#define TELEMETRY_TASK_STACK 4096
+#endif
+
+// Settings write-behind (storageTask)
+#if !defined(STORAGE_TASK_CORE)
+#define STORAGE_TASK_CORE 1
+#endif
+#if !defined(STORAGE_TASK_PRIORITY)
+#define STORAGE_TASK_PRIORITY 1
+#endif
+#if !defined(STORAGE_TASK_STACK)
+#define STORAGE_TASK_STACK 4096
+#endif
+
+// Song playback read-ahead (playerTask)
+#if !defined(PLAYBACK_TASK_CORE)
+#define PLAYBACK_TASK_CORE 1
+#endif
+#if !defined(PLAYBACK_TASK_PRIORITY)
+#define PLAYBACK_TASK_PRIORITY 1
+#endif
+#if !defined(PLAYBACK_TASK_STACK)
+#define PLAYBACK_TASK_STACK 4096
+#endif
+
+// Network MIDI sockets and session (networkTask, NETWORK_MIDI builds only); below ingest so that socket calls
+// never delay reading the UART, on the other core where the layout allows it
+#if !defined(NETWORK_TASK_CORE)
+#define NETWORK_TASK_CORE 1
+#endif
+#if !defined(NETWORK_TASK_PRIORITY)
+#define NETWORK_TASK_PRIORITY 1
+#endif
+#if !defined(NETWORK_TASK_STACK)
+#define NETWORK_TASK_STACK 8192
+#endif
+
+enum class TaskId
+{
+    INGEST = 0,
+    OUTPUT = 1,
+    RENDER = 2,
+    TELEMETRY = 3,
+    STORAGE = 4,
+    PLAYBACK = 5,
+    NETWORK = 6,
+    COUNT = 7,
+};
+
+struct TaskLayout
+{
+    const char* name;
+    int core; // -1 = not pinned by us
+    int priority;
+    uint32_t stackSize;
+};
+
+inline const TaskLayout& getTaskLayout(const TaskId id)
+{
+    static const TaskLayout LAYOUTS[] = {
+        {"midiTask", INGEST_TASK_CORE, INGEST_TASK_PRIORITY, INGEST_TASK_STACK},
+        {"outputTask", OUTPUT_TASK_CORE, OUTPUT_TASK_PRIORITY, OUTPUT_TASK_STACK},
+        {"loopTask", -1, RENDER_TASK_PRIORITY, RENDER_TASK_STACK},
+        {"commandTask", TELEMETRY_TASK_CORE, TELEMETRY_TASK_PRIORITY, TELEMETRY_TASK_STACK},
+        {"storageTask", STORAGE_TASK_CORE, STORAGE_TASK_PRIORITY, STORAGE_TASK_STACK},
+        {"playerTask", PLAYBACK_TASK_CORE, PLAYBACK_TASK_PRIORITY, PLAYBACK_TASK_STACK},
+        {"networkTask", NETWORK_TASK_CORE, NETWORK_TASK_PRIORITY, NETWORK_TASK_STACK},
+    };
+    return LAYOUTS[static_cast<int>(id)];
+}
+
+// Scheduling latency (time from wake-up request to the task running) in microseconds
+struct SchedulingLatency
+{
+    uint32_t count = 0;
+    uint32_t total = 0;
+    uint32_t max = 0;
+
+    void add(const uint32_t us)
+    {
+        count++;
+        total += us;
+        if (us > max) {
+            max = us;
+        }
+    }
+
+    uint32_t average() const
+    {
+        return count == 0 ? 0 : total / count;
+    }
+};
+
+TaskHandle_t createTask(TaskId id, TaskFunction_t function);
+
+void registerTask(TaskId id);
+
+void recordSchedulingLatency(TaskId id, uint32_t us);
+
+/** Wake a task waiting in takeTaskNotification(), timing the wake-up for its scheduling latency */
+void notifyTask(TaskId id);
+
+/**
+ * Wait for a notification (ulTaskNotifyTake() with clear on exit) and record the scheduling latency of a wake-up
+ * requested by notifyTask(); waits that time out are not measured
+ *
+ * @return notification count, 0 on timeout
+ */
+uint32_t takeTaskNotification(TaskId id, TickType_t timeout);
+
+size_t formatTaskStatus(TaskId id, char* buffer, size_t size);
+
+void addTaskBusyTime(TaskId id, uint32_t us);
+
+/** Start of a stretch of work measured by the CPU monitor (no-op unless CPU_MONITOR) */
+inline int64_t beginTaskBusy()
+{
+#if CPU_MONITOR
+    return esp_timer_get_time();
+#else
+    return 0;
+#endif
+}
+
+/** End of a stretch of work started with beginTaskBusy() */
+inline void endTaskBusy(const TaskId id, const int64_t startUs)
+{
+#if CPU_MONITOR
+    addTaskBusyTime(id, static_cast<uint32_t>(esp_timer_get_time() - startUs));
+#else
+    (void)id;
+    (void)startUs;
+#endif
+}
+
+/** Start measuring idle time of both cores (CPU_MONITOR) */
+void setupCpuMonitor();
+
+/** Close the current sampling window and start the next */
+CpuLoadSnapshot sampleCpuLoad();
+
+/** Last window closed by sampleCpuLoad() */
+CpuLoadSnapshot getLastCpuLoad();
+
+/** Load and free stack of a task as "midiTask core=0 load=1.2% free=2100" */
+size_t formatTaskLoad(TaskId id, const CpuLoadSnapshot& snapshot, char* buffer, size_t size);
+
+/** Free stack of a task not created by us (e.g. the Bluetooth host), 0 if it does not exist */
+size_t formatExternalTaskStack(const char* name, char* buffer, size_t size);
+
+#endif // !defined(APP_TASKS_H)
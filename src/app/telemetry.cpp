@@ -0,0 +1,26 @@
+#include <atomic>
+
+#include "app/hal.h"
+#include "app/telemetry.h"
+
+static std::atomic<uint32_t> counters[static_cast<int>(Counter::COUNT)];
+
+void countTelemetry(const Counter counter)
+{
+    counters[static_cast<int>(counter)].fetch_add(1, std::memory_order_relaxed);
+}
+
+Telemetry getTelemetry()
+{
+    Telemetry telemetry;
+    for (int i = 0; i < static_cast<int>(Counter::COUNT); i++) {
+        telemetry.counters[i] = counters[i].load(std::memory_order_relaxed);
+    }
+    return telemetry;
+}
+
+void logBootPhase(const char* phase)
+{
+    const unsigned long now = getHal().clock->micros();
+    getHal().console->printf("boot %s %lu.%03lu ms\n", phase, now / 1000, now % 1000);
+}
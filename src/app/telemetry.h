@@ -0,0 +1,58 @@
+#if !defined(APP_TELEMETRY_H)
+#define APP_TELEMETRY_H
+
+#include <cstdint>
+
+// Telemetry counters
+enum class Counter
+{
+    MIDI_MESSAGES = 0,
+    NOTE_ON = 1,
+    NOTE_OFF = 2,
+    CONTROL_CHANGE = 3,
+    REPORTS = 4,
+    REPORTS_DROPPED = 5,
+    RX_OVERFLOW = 6, // MIDI UART hardware FIFO overran (bytes lost)
+    RX_BUFFER_FULL = 7, // MIDI UART receive buffer full (bytes lost)
+    RX_ERRORS = 8, // MIDI UART framing, parity or break errors
+    DEBOUNCED_DOUBLES = 9, // repeated Note On within the retrigger guard (dropped)
+    DEBOUNCED_BLIPS = 10, // Note Off/Note On within the retrigger guard (both dropped)
+    COUNT = 11,
+};
+
+inline const char* getCounterName(const Counter counter)
+{
+    const char* NAMES[] = {
+        "midi",
+        "noteon",
+        "noteoff",
+        "cc",
+        "reports",
+        "dropped",
+        "rxovf",
+        "rxfull",
+        "rxerr",
+        "dbldrop",
+        "blipdrop",
+    };
+    return NAMES[static_cast<int>(counter)];
+}
+
+// Snapshot of all counters
+struct Telemetry
+{
+    uint32_t counters[static_cast<int>(Counter::COUNT)]{};
+
+    uint32_t get(const Counter counter) const
+    {
+        return counters[static_cast<int>(counter)];
+    }
+};
+
+void countTelemetry(Counter counter);
+
+Telemetry getTelemetry();
+
+void logBootPhase(const char* phase);
+
+#endif // !defined(APP_TELEMETRY_H)
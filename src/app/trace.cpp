@@ -0,0 +1,53 @@
+#if defined(ARDUINO)
+#include "../config.h"
+
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+#endif
+
+#include "app/hal.h"
+#include "app/trace.h"
+
+static_assert((TRACE_ENTRIES_PSRAM & (TRACE_ENTRIES_PSRAM - 1)) == 0, "TRACE_ENTRIES_PSRAM must be a power of two");
+static_assert((TRACE_ENTRIES_INTERNAL & (TRACE_ENTRIES_INTERNAL - 1)) == 0,
+              "TRACE_ENTRIES_INTERNAL must be a power of two");
+
+static TraceRing traceRing;
+static bool traceInPsram = false;
+
+void setupTrace()
+{
+#if defined(ARDUINO)
+    void* storage = nullptr;
+    uint32_t capacity = TRACE_ENTRIES_PSRAM;
+    if (psramFound()) {
+        storage = heap_caps_malloc(capacity * sizeof(TraceEntry), MALLOC_CAP_SPIRAM);
+    }
+    traceInPsram = storage != nullptr;
+    if (storage == nullptr) {
+        capacity = TRACE_ENTRIES_INTERNAL;
+        storage = heap_caps_malloc(capacity * sizeof(TraceEntry), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    }
+    if (storage != nullptr) {
+        traceRing.attach(static_cast<TraceEntry*>(storage), capacity);
+    }
+#else
+    static TraceEntry storage[TRACE_ENTRIES_INTERNAL];
+    traceRing.attach(storage, TRACE_ENTRIES_INTERNAL);
+#endif
+}
+
+void recordTrace(const TraceType type, const uint8_t value, const uint16_t keys)
+{
+    traceRing.record(type, value, keys, getHal().clock->micros());
+}
+
+TraceRing& getTraceRing()
+{
+    return traceRing;
+}
+
+bool isTraceInPsram()
+{
+    return traceInPsram;
+}
@@ -0,0 +1,127 @@
+#if !defined(APP_TRACE_H)
+#define APP_TRACE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+// Trace buffer size in entries (power of two, 8 bytes each), overridable in build_flags or config.h
+#if !defined(TRACE_ENTRIES_PSRAM)
+#define TRACE_ENTRIES_PSRAM 32768
+#endif
+#if !defined(TRACE_ENTRIES_INTERNAL)
+#define TRACE_ENTRIES_INTERNAL 1024
+#endif
+
+// Entries per dump line
+static constexpr size_t TRACE_DUMP_ENTRIES_PER_LINE = 8;
+
+enum class TraceType : uint8_t
+{
+    NONE = 0,
+    MIDI = 1, // value: status byte, keys: data1 | data2 << 8 (system messages: data2 only)
+    NOTES = 2, // value: pressed keys, keys: key mask from the mapping (output task)
+    FILTER = 3, // value: keys dropped by the filter, keys: key mask kept
+    REPORT = 4, // value: mapping, keys: key mask sent
+    DROPPED = 5, // value: 0, keys: key mask of a report dropped (host not ready)
+};
+
+// Compact trace entry, dumped as its little-endian bytes
+struct TraceEntry
+{
+    uint32_t timeUs;
+    uint8_t type;
+    uint8_t value;
+    uint16_t keys;
+};
+
+static_assert(sizeof(TraceEntry) == 8, "TraceEntry must stay 8 bytes (dump format)");
+
+// Lock-free ring buffer of trace entries
+//
+// Writers on any task claim a slot with one atomic increment and overwrite the oldest entry.
+// Readers should pause recording (setEnabled(false)) while copying entries out.
+class TraceRing
+{
+public:
+    /** Use the given storage; capacity must be a power of two */
+    void attach(TraceEntry* storage, const uint32_t capacity)
+    {
+        entries = storage;
+        mask = capacity - 1;
+        head.store(0);
+    }
+
+    void record(const TraceType type, const uint8_t value, const uint16_t keys, const uint32_t timeUs)
+    {
+        if (entries == nullptr || !enabled.load(std::memory_order_relaxed)) {
+            return;
+        }
+        const uint32_t index = head.fetch_add(1, std::memory_order_relaxed);
+        entries[index & mask] = {timeUs, static_cast<uint8_t>(type), value, keys};
+    }
+
+    void setEnabled(const bool value) { enabled.store(value); }
+
+    bool isEnabled() const { return enabled.load(); }
+
+    uint32_t getCapacity() const { return entries == nullptr ? 0 : mask + 1; }
+
+    /** Total number of entries recorded since the last clear */
+    uint32_t getRecorded() const { return head.load(); }
+
+    /** Index of the oldest entry still in the buffer */
+    uint32_t getOldest() const
+    {
+        const uint32_t recorded = getRecorded();
+        return recorded > getCapacity() ? recorded - getCapacity() : 0;
+    }
+
+    const TraceEntry& get(const uint32_t index) const { return entries[index & mask]; }
+
+    void clear() { head.store(0); }
+
+private:
+    TraceEntry* entries = nullptr;
+    uint32_t mask = 0;
+    std::atomic<uint32_t> head{0};
+    std::atomic<bool> enabled{true};
+};
+
+/** Hex-encode entries (16 hex digits each, space separated) */
+inline size_t formatTraceEntries(const TraceEntry* entries, const size_t count, char* buffer, const size_t size)
+{
+    size_t length = 0;
+    for (size_t i = 0; i < count && length + 17 < size; i++) {
+        const auto* bytes = reinterpret_cast<const uint8_t*>(&entries[i]);
+        if (i > 0) {
+            buffer[length++] = ' ';
+        }
+        for (size_t b = 0; b < sizeof(TraceEntry); b++) {
+            length += snprintf(buffer + length, size - length, "%02x", bytes[b]);
+        }
+    }
+    if (size > 0) {
+        buffer[length < size ? length : size - 1] = '\0';
+    }
+    return length;
+}
+
+void setupTrace();
+
+/** Record an entry with the current time */
+void recordTrace(TraceType type, uint8_t value, uint16_t keys);
+
+/** Record a filter decision: keys kept out of the keys pressed */
+inline void traceFilter(const uint16_t pressedKeys, const uint16_t keptKeys)
+{
+    recordTrace(TraceType::FILTER, static_cast<uint8_t>(__builtin_popcount(pressedKeys & ~keptKeys)), keptKeys);
+}
+
+TraceRing& getTraceRing();
+
+/** Whether the trace buffer is in PSRAM */
+bool isTraceInPsram();
+
+#endif // !defined(APP_TRACE_H)
@@ -0,0 +1,68 @@
+#if defined(CONTROLLER_USB_GAMEPAD) || defined(CONTROLLER_USB_NSWITCH) || defined(CONTROLLER_USB_KEYBOARD)
+
+#include <atomic>
+
+#include <M5Unified.h>
+#include <USB.h>
+
+#include "app/output.h"
+#include "app/telemetry.h"
+#include "app/usb-ready.h"
+
+// Time to wait for the host to configure the device before reporting it
+static constexpr unsigned long USB_READY_TIMEOUT_MS = 5000;
+
+// Host has configured the device
+static std::atomic<bool> usbReady{false};
+
+static TimerHandle_t timeoutTimer = nullptr;
+
+static void usbEventCallback(void*, const esp_event_base_t eventBase, const int32_t eventId, void*)
+{
+    if (eventBase != ARDUINO_USB_EVENTS) {
+        return;
+    }
+    switch (eventId) {
+    case ARDUINO_USB_STARTED_EVENT:
+    case ARDUINO_USB_RESUME_EVENT:
+        if (!usbReady.exchange(true)) {
+            logBootPhase("usb-ready");
+        }
+        // Send the current state now that the host listens
+        refreshOutput();
+        break;
+    case ARDUINO_USB_STOPPED_EVENT:
+    case ARDUINO_USB_SUSPEND_EVENT:
+        usbReady.store(false);
+        break;
+    default:
+        break;
+    }
+}
+
+static void timeoutCallback(TimerHandle_t)
+{
+    if (!usbReady.load()) {
+        logBootPhase("usb-timeout");
+    }
+}
+
+void setupUSBReady()
+{
+    USB.onEvent(usbEventCallback);
+
+    timeoutTimer = xTimerCreate("usbTimeout", pdMS_TO_TICKS(USB_READY_TIMEOUT_MS), pdFALSE, nullptr, timeoutCallback);
+    xTimerStart(timeoutTimer, 0);
+}
+
+bool isUSBReady()
+{
+    return usbReady.load();
+}
+
+void drawUSBStatus()
+{
+    M5.Display.println(isUSBReady() ? "Connected       " : "Waiting for host");
+}
+
+#endif // defined(CONTROLLER_USB_GAMEPAD) || defined(CONTROLLER_USB_NSWITCH) || defined(CONTROLLER_USB_KEYBOARD)
@@ -0,0 +1,10 @@
+#if !defined(APP_USB_READY_H)
+#define APP_USB_READY_H
+
+void setupUSBReady();
+
+bool isUSBReady();
+
+void drawUSBStatus();
+
+#endif // !defined(APP_USB_READY_H)
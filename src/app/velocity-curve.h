@@ -0,0 +1,73 @@
+#if !defined(APP_VELOCITY_CURVE_H)
+#define APP_VELOCITY_CURVE_H
+
+#include <cstdint>
+
+// Full scale of an analog level (trigger or stick deflection) after the velocity curve
+static constexpr int ANALOG_LEVEL_MAX = 255;
+
+// Response of an analog output (trigger, stick) to the Note On velocity
+enum class VelocityCurve : uint8_t
+{
+    FIXED = 0, // full deflection whatever the velocity
+    LINEAR = 1, // proportional to the velocity
+    SOFT = 2, // more deflection for light playing (inverted square)
+    HARD = 3, // less deflection until played hard (square)
+    COUNT = 4,
+};
+
+// Level (1-ANALOG_LEVEL_MAX) for each velocity, 0 for velocity 0
+struct VelocityCurveTable
+{
+    uint8_t level[128];
+};
+
+/** Build the table of a curve (compile time only: the report path just indexes it) */
+constexpr VelocityCurveTable makeVelocityCurveTable(const VelocityCurve curve)
+{
+    VelocityCurveTable table{};
+    for (int velocity = 1; velocity < 128; velocity++) {
+        int level = ANALOG_LEVEL_MAX;
+        switch (curve) {
+        case VelocityCurve::LINEAR:
+            level = velocity * ANALOG_LEVEL_MAX / 127;
+            break;
+        case VelocityCurve::SOFT:
+            level = ANALOG_LEVEL_MAX - (127 - velocity) * (127 - velocity) * ANALOG_LEVEL_MAX / (127 * 127);
+            break;
+        case VelocityCurve::HARD:
+            level = velocity * velocity * ANALOG_LEVEL_MAX / (127 * 127);
+            break;
+        default:
+            break;
+        }
+        // A pressed key always moves the output
+        table.level[velocity] = static_cast<uint8_t>(level > 0 ? level : 1);
+    }
+    return table;
+}
+
+static constexpr VelocityCurveTable VELOCITY_CURVE_TABLES[static_cast<int>(VelocityCurve::COUNT)] = {
+    makeVelocityCurveTable(VelocityCurve::FIXED),
+    makeVelocityCurveTable(VelocityCurve::LINEAR),
+    makeVelocityCurveTable(VelocityCurve::SOFT),
+    makeVelocityCurveTable(VelocityCurve::HARD),
+};
+
+/** Analog level (0-ANALOG_LEVEL_MAX) of a key played with a velocity */
+inline int getVelocityLevel(const VelocityCurve curve, const uint8_t velocity)
+{
+    return VELOCITY_CURVE_TABLES[static_cast<int>(curve)].level[velocity & 0x7F];
+}
+
+/** Scale a full-scale value (e.g. a trigger maximum) by a level, never below 1 while the level is not 0 */
+inline int scaleByLevel(const int value, const int level)
+{
+    if (level == 0) {
+        return 0;
+    }
+    const int scaled = value * level / ANALOG_LEVEL_MAX;
+    return scaled != 0 ? scaled : (value < 0 ? -1 : 1);
+}
+
+#endif // !defined(APP_VELOCITY_CURVE_H)
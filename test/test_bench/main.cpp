@@ -0,0 +1,244 @@
+#include <unity.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include "app/key-estimator.h"
+#include "app/note-mapping.h"
+#include "app/notes.h"
+#include "app/report.h"
+
+// Micro-benchmarks for the note pipeline
+//
+// Run with `pio test -e test -f test_bench`. Each benchmark prints one JSON line:
+//   {"bench":"mapping","workload":"chord10","iterations":100000,"ns_per_op":123.4}
+// and fails if the time per operation exceeds a generous budget, so only gross regressions break the build.
+
+static constexpr int ITERATIONS = 100000;
+
+// Budget per operation (nanoseconds), far above the expected cost on a desktop CPU
+static constexpr double BUDGET_NS = 20000.0;
+
+static constexpr int BASE_NOTE = 48;
+
+// Representative gamepad mapping (buttons, DPad, triggers and sticks)
+static const MappingEntry gamepadMapping[15] = {
+    {ACTION_L_TRIGGER, 1023},
+    {ACTION_R_TRIGGER, 1023},
+    {ACTION_DPAD, DIRECTION_DOWN},
+    {ACTION_BUTTON, 1},
+    {ACTION_DPAD, DIRECTION_LEFT},
+    {ACTION_BUTTON, 2},
+    {ACTION_DPAD, DIRECTION_UP},
+    {ACTION_BUTTON, 3},
+    {ACTION_DPAD, DIRECTION_RIGHT},
+    {ACTION_BUTTON, 4},
+    {ACTION_BUTTON, 5},
+    {ACTION_BUTTON, 6},
+    {ACTION_L_STICK, DIRECTION_LEFT},
+    {ACTION_R_STICK, DIRECTION_LEFT},
+    {ACTION_L_STICK, DIRECTION_RIGHT},
+};
+
+// MIDI note state of a workload: two frames, alternated between iterations
+struct Workload
+{
+    const char* name;
+    unsigned long notes[2][MAX_NOTES];
+    int pressedKeys[2];
+};
+
+static Workload workloads[4];
+
+static void pressNote(Workload& workload, const int frame, const int note, const unsigned long time)
+{
+    workload.notes[frame][note] = time;
+}
+
+static void buildWorkloads()
+{
+    memset(workloads, 0, sizeof(workloads));
+
+    // Nothing pressed
+    workloads[0].name = "idle";
+
+    // One key at a time
+    workloads[1].name = "single";
+    pressNote(workloads[1], 0, BASE_NOTE, 1000);
+    pressNote(workloads[1], 1, BASE_NOTE + 7, 1100);
+    workloads[1].pressedKeys[0] = 1;
+    workloads[1].pressedKeys[1] = 1;
+
+    // 10-note chord spanning two octaves, plus the same chord one step up
+    workloads[2].name = "chord10";
+    for (int i = 0; i < 10; i++) {
+        pressNote(workloads[2], 0, BASE_NOTE + SKY_KEY_PITCHES[i], 2000 + i);
+        pressNote(workloads[2], 1, BASE_NOTE + SKY_KEY_PITCHES[i + 1], 2100 + i);
+    }
+    workloads[2].pressedKeys[0] = 10;
+    workloads[2].pressedKeys[1] = 10;
+
+    // Fast alternation between two neighbouring keys over a held bass note
+    workloads[3].name = "trill";
+    pressNote(workloads[3], 0, BASE_NOTE, 3000);
+    pressNote(workloads[3], 0, BASE_NOTE + 12, 3010);
+    pressNote(workloads[3], 1, BASE_NOTE, 3000);
+    pressNote(workloads[3], 1, BASE_NOTE + 14, 3020);
+    workloads[3].pressedKeys[0] = 2;
+    workloads[3].pressedKeys[1] = 2;
+}
+
+static int countKeys(const Notes15& notes15)
+{
+    return __builtin_popcount(getPressedKeys(notes15));
+}
+
+// Keeps results observable so the compiler cannot drop the measured work
+static volatile unsigned long sink = 0;
+
+template <typename F>
+static double measure(const char* bench, const char* workload, F&& operation)
+{
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS; i++) {
+        operation(i & 1);
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    const double nsPerOp = std::chrono::duration<double, std::nano>(elapsed).count() / ITERATIONS;
+
+    printf("{\"bench\":\"%s\",\"workload\":\"%s\",\"iterations\":%d,\"ns_per_op\":%.1f}\n",
+           bench, workload, ITERATIONS, nsPerOp);
+    return nsPerOp;
+}
+
+static Notes15 mapWorkload(const Workload& workload, const int frame)
+{
+    static const NoteKeyTable table = buildNoteKeyTable(BASE_NOTE, true);
+    unsigned long repressedTime[MAX_NOTES] = {0};
+    return mapNotes15(workload.notes[frame], repressedTime, table, 10000);
+}
+
+void setUp()
+{
+    buildWorkloads();
+}
+
+void tearDown()
+{
+}
+
+void test_bench_mapping()
+{
+    for (const Workload& workload : workloads) {
+        // Correctness
+        for (int frame = 0; frame < 2; frame++) {
+            TEST_ASSERT_EQUAL(workload.pressedKeys[frame], countKeys(mapWorkload(workload, frame)));
+        }
+
+        const double nsPerOp = measure("mapping", workload.name, [&](const int frame) {
+            sink = sink + mapWorkload(workload, frame).get(0);
+        });
+        TEST_ASSERT_TRUE(nsPerOp < BUDGET_NS);
+    }
+}
+
+void test_bench_filter()
+{
+    for (const Workload& workload : workloads) {
+        const Notes15 frames[2] = {mapWorkload(workload, 0), mapWorkload(workload, 1)};
+
+        // Correctness
+        Notes15Filter check;
+        for (const Notes15& frame : frames) {
+            const int expected = countKeys(frame) < 5 ? countKeys(frame) : 5;
+            TEST_ASSERT_EQUAL(expected, countKeys(check.latest(frame, 5)));
+        }
+
+        Notes15Filter filter;
+        const double nsPerOp = measure("filter", workload.name, [&](const int frame) {
+            sink = sink + filter.latest(frames[frame], 5).get(0);
+        });
+        TEST_ASSERT_TRUE(nsPerOp < BUDGET_NS);
+    }
+}
+
+void test_bench_gamepad_report()
+{
+    for (const Workload& workload : workloads) {
+        const Notes15 frames[2] = {mapWorkload(workload, 0), mapWorkload(workload, 1)};
+        ReportBuilder builder;
+        builder.compile(gamepadMapping, ConflictPolicy::LAST);
+
+        const double nsPerOp = measure("gamepad_report", workload.name, [&](const int frame) {
+            const GamepadState state = builder.build(frames[frame]);
+            const DpadDirection direction = getDpadDirection(state);
+            sink = sink + state.buttonKeys + static_cast<int>(direction)
+                + scaleStick(state.leftX, -32768, 0, 32767) + state.leftTrigger;
+        });
+        TEST_ASSERT_TRUE(nsPerOp < BUDGET_NS);
+    }
+}
+
+void test_bench_keyboard_report()
+{
+    for (const Workload& workload : workloads) {
+        const Notes15 frames[2] = {mapWorkload(workload, 0), mapWorkload(workload, 1)};
+
+        const double nsPerOp = measure("keyboard_report", workload.name, [&](const int frame) {
+            const uint16_t currentKeys = getPressedKeys(frames[frame]);
+            const uint16_t prevKeys = getPressedKeys(frames[frame ^ 1]);
+            sink = sink + (currentKeys & ~prevKeys) + (prevKeys & ~currentKeys);
+        });
+        TEST_ASSERT_TRUE(nsPerOp < BUDGET_NS);
+    }
+}
+
+void test_bench_key_estimator()
+{
+    // Ingest side: one Note On (runs on every message, must stay negligible next to mapping)
+    KeyEstimator estimator;
+    const double addNs = measure("key_add_note", "melody", [&](const int frame) {
+        estimator.addNote(BASE_NOTE + SKY_KEY_PITCHES[frame * 4]);
+    });
+    TEST_ASSERT_TRUE(addNs < BUDGET_NS);
+
+    // UI side: full re-estimate after a new note
+    KeyEstimate estimate;
+    const double updateNs = measure("key_update", "melody", [&](const int frame) {
+        estimator.addNote(BASE_NOTE + SKY_KEY_PITCHES[frame * 4]);
+        sink = sink + (estimator.update(estimate) ? estimate.basePitchClass : 0);
+    });
+    TEST_ASSERT_TRUE(updateNs < BUDGET_NS);
+}
+
+void test_gamepad_state_chord()
+{
+    unsigned long timestamps[15] = {0};
+    timestamps[0] = 1; // LT
+    timestamps[3] = 2; // button
+    timestamps[6] = 3; // DPad up
+    timestamps[8] = 4; // DPad right
+    timestamps[12] = 5; // L-Stick left
+    timestamps[14] = 6; // L-Stick right (pressed last wins)
+    const GamepadState state = buildGamepadState(Notes15(timestamps), gamepadMapping);
+
+    TEST_ASSERT_EQUAL(1 << 3, state.buttonKeys);
+    TEST_ASSERT_EQUAL(1023, state.leftTrigger);
+    TEST_ASSERT_EQUAL(0, state.rightTrigger);
+    TEST_ASSERT_EQUAL(ANALOG_LEVEL_MAX, state.leftX);
+    TEST_ASSERT_EQUAL(0, state.rightX);
+    TEST_ASSERT_TRUE(getDpadDirection(state) == DpadDirection::UP_RIGHT);
+}
+
+int main(int argc, char** argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_gamepad_state_chord);
+    RUN_TEST(test_bench_mapping);
+    RUN_TEST(test_bench_filter);
+    RUN_TEST(test_bench_gamepad_report);
+    RUN_TEST(test_bench_keyboard_report);
+    RUN_TEST(test_bench_key_estimator);
+    return UNITY_END();
+}
@@ -0,0 +1,81 @@
+#include <unity.h>
+
+#include <string>
+
+#include "app/cpu-load.h"
+#include "app/display.h"
+#include "app/hal-host.h"
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_take_computes_window_and_restarts()
+{
+    CpuLoad load;
+    load.take(1000);
+    load.addTaskBusy(0, 2500);
+    load.addTaskBusy(0, 2500);
+    load.addTaskBusy(3, 100000);
+    load.addIdle(0, 75000);
+    load.addIdle(1, 0);
+
+    const CpuLoadSnapshot snapshot = load.take(101000);
+    TEST_ASSERT_EQUAL(100000, snapshot.windowUs);
+    TEST_ASSERT_EQUAL(50, snapshot.taskPermille(0));
+    TEST_ASSERT_EQUAL(1000, snapshot.taskPermille(3));
+    TEST_ASSERT_EQUAL(250, snapshot.corePermille(0));
+    TEST_ASSERT_EQUAL(1000, snapshot.corePermille(1));
+
+    // Next window starts empty
+    const CpuLoadSnapshot next = load.take(201000);
+    TEST_ASSERT_EQUAL(100000, next.windowUs);
+    TEST_ASSERT_EQUAL(0, next.taskUs[0]);
+    TEST_ASSERT_EQUAL(1000, next.corePermille(0));
+}
+
+void test_permille_is_clamped_and_safe_on_empty_window()
+{
+    CpuLoadSnapshot snapshot;
+    TEST_ASSERT_EQUAL(0, snapshot.corePermille(0));
+    TEST_ASSERT_EQUAL(0, snapshot.taskPermille(0));
+
+    // Idle measured slightly beyond the window (hook gaps straddle its edges)
+    snapshot.windowUs = 1000;
+    snapshot.idleUs[0] = 1010;
+    snapshot.taskUs[1] = 2000;
+    TEST_ASSERT_EQUAL(0, snapshot.corePermille(0));
+    TEST_ASSERT_EQUAL(1000, snapshot.taskPermille(1));
+}
+
+void test_format_and_status_line()
+{
+    CpuLoadSnapshot snapshot;
+    snapshot.windowUs = 1000000;
+    snapshot.idleUs[0] = 875000;
+    snapshot.idleUs[1] = 970000;
+    char buffer[48];
+
+    formatCpuLoad(snapshot, buffer, sizeof(buffer));
+    TEST_ASSERT_EQUAL_STRING("core0=12.5% core1=3.0%", buffer);
+
+    HostHal hal;
+    hal.install();
+    drawCpuLoadLine(snapshot, 184, 320);
+    TEST_ASSERT_EQUAL_STRING("cpu core0=12.5% core1=3.0%", hal.display.text.c_str());
+}
+
+int main()
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_take_computes_window_and_restarts);
+    RUN_TEST(test_permille_is_clamped_and_safe_on_empty_window);
+    RUN_TEST(test_format_and_status_line);
+
+    UNITY_END();
+}
@@ -0,0 +1,198 @@
+#include <unity.h>
+
+#include <cstdio>
+#include <string>
+
+#include "app/hal-host.h"
+#include "app/midi.h"
+#include "app/output.h"
+#include "app/report.h"
+#include "app/telemetry.h"
+
+// Debounce stage of the MIDI input: synthetic jittery streams on the fake clock
+
+static HostHal* hal = nullptr;
+
+// Start of the test on the fake clock (milliseconds)
+static unsigned long startMs = 0;
+
+// Reports sent so far as "<ms since start>:<keys hex>"
+static std::string timeline;
+
+static Telemetry before;
+
+static void output()
+{
+    runOutput();
+    for (const RecordingHid::Report& report : hal->hid.reports) {
+        char entry[24];
+        snprintf(entry, sizeof(entry), "%s%lu:%x", timeline.empty() ? "" : " ", hal->clock.millis() - startMs,
+                 getPressedKeys(report.notes15));
+        timeline += entry;
+    }
+    hal->hid.reports.clear();
+}
+
+/** Feed bytes and run the MIDI task and the output once */
+static void send(std::initializer_list<uint8_t> bytes)
+{
+    hal->midiSerial.push(bytes);
+    pollMIDI();
+    output();
+}
+
+/** Let time pass, running the MIDI task and the output every millisecond */
+static void runFor(const unsigned long ms)
+{
+    for (unsigned long i = 0; i < ms; i++) {
+        hal->clock.advance(1);
+        pollMIDI();
+        output();
+    }
+}
+
+static uint32_t delta(const Counter counter)
+{
+    return getTelemetry().get(counter) - before.get(counter);
+}
+
+void setUp()
+{
+    hal = new HostHal();
+    hal->install();
+
+    setupMIDI(0, 0);
+    setSustainEnabled(false);
+    setDebounceGuard(0);
+    setOutputTable(OutputTableSettings());
+    setOutputStrum(0);
+    refreshOutput();
+    runOutput();
+    hal->hid.reports.clear();
+    startMs = hal->clock.millis();
+    timeline.clear();
+    before = getTelemetry();
+}
+
+void tearDown()
+{
+    delete hal;
+    hal = nullptr;
+}
+
+void test_without_guard_every_glitch_reaches_the_report()
+{
+    send({0x90, 48, 100});
+    runFor(1);
+    send({0x80, 48, 0, 0x90, 48, 100}); // blip inside one poll: the net state does not change
+    runFor(1);
+    send({0x80, 48, 0});
+    runFor(2);
+    send({0x90, 48, 100});
+
+    TEST_ASSERT_EQUAL_STRING("0:1 1:1 2:0 4:1", timeline.c_str());
+    TEST_ASSERT_EQUAL(0, delta(Counter::DEBOUNCED_BLIPS));
+}
+
+void test_double_note_on_within_guard_is_dropped()
+{
+    setDebounceGuard(8);
+
+    // Cheap keyboard: second Note On 3 ms after the first, a real repeat after the guard
+    send({0x90, 48, 100});
+    runFor(3);
+    send({0x90, 48, 90});
+    runFor(10);
+    send({0x90, 48, 80});
+
+    TEST_ASSERT_EQUAL_STRING("0:1 13:1", timeline.c_str());
+    TEST_ASSERT_EQUAL(1, delta(Counter::DEBOUNCED_DOUBLES));
+    TEST_ASSERT_EQUAL(0, delta(Counter::DEBOUNCED_BLIPS));
+    TEST_ASSERT_EQUAL(3, delta(Counter::NOTE_ON));
+}
+
+void test_short_release_blip_is_dropped()
+{
+    setDebounceGuard(8);
+
+    // Held note with a 2 ms Note Off/Note On blip: no report at all
+    send({0x90, 48, 100});
+    runFor(20);
+    send({0x80, 48, 0});
+    runFor(2);
+    send({0x90, 48, 100});
+    runFor(20);
+
+    // Real release: applied once the guard has passed
+    send({0x80, 48, 0});
+    runFor(20);
+
+    TEST_ASSERT_EQUAL_STRING("0:1 50:0", timeline.c_str());
+    TEST_ASSERT_EQUAL(1, delta(Counter::DEBOUNCED_BLIPS));
+    TEST_ASSERT_EQUAL(0, delta(Counter::DEBOUNCED_DOUBLES));
+}
+
+void test_repress_after_guard_is_a_new_press()
+{
+    setDebounceGuard(5);
+
+    send({0x90, 48, 100});
+    runFor(10);
+    send({0x80, 48, 0});
+
+    // Note On after the guard, before the MIDI task got to apply the release: released and pressed again
+    hal->clock.advance(6);
+    send({0x90, 48, 100});
+    runFor(1);
+
+    TEST_ASSERT_EQUAL_STRING("0:1 16:1", timeline.c_str());
+    TEST_ASSERT_EQUAL(0, delta(Counter::DEBOUNCED_BLIPS));
+    TEST_ASSERT_EQUAL(1, getPressedKeys(getOutputNotes15()));
+}
+
+void test_jittery_stream_reports_only_real_changes()
+{
+    setDebounceGuard(6);
+
+    // Chord C-E-G on a long DIN run: every key bounces once on press and once while held
+    send({0x90, 48, 100, 52, 100, 55, 100});
+    runFor(1);
+    send({48, 100, 52, 100, 55, 100});
+    runFor(30);
+    send({0x80, 52, 0});
+    runFor(1);
+    send({0x90, 52, 100});
+    runFor(30);
+    send({0x80, 48, 0, 52, 0, 55, 0});
+    runFor(30);
+
+    TEST_ASSERT_EQUAL_STRING("0:15 68:0", timeline.c_str());
+    TEST_ASSERT_EQUAL(3, delta(Counter::DEBOUNCED_DOUBLES));
+    TEST_ASSERT_EQUAL(1, delta(Counter::DEBOUNCED_BLIPS));
+}
+
+void test_disabling_guard_applies_held_back_release()
+{
+    setDebounceGuard(20);
+
+    send({0x90, 48, 100});
+    runFor(30);
+    send({0x80, 48, 0});
+    runFor(1);
+    setDebounceGuard(0);
+    runFor(1);
+
+    TEST_ASSERT_EQUAL_STRING("0:1 32:0", timeline.c_str());
+}
+
+int main(int argc, char** argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_without_guard_every_glitch_reaches_the_report);
+    RUN_TEST(test_double_note_on_within_guard_is_dropped);
+    RUN_TEST(test_short_release_blip_is_dropped);
+    RUN_TEST(test_repress_after_guard_is_a_new_press);
+    RUN_TEST(test_jittery_stream_reports_only_real_changes);
+    RUN_TEST(test_disabling_guard_applies_held_back_release);
+    return UNITY_END();
+}
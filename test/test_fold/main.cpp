@@ -0,0 +1,198 @@
+#include <unity.h>
+
+#include "app/hal-host.h"
+#include "app/midi.h"
+#include "app/note-mapping.h"
+#include "app/output.h"
+#include "app/report.h"
+#include "app/settings.h"
+
+// Expand mode folding strategies, checked against every MIDI note
+
+static HostHal* hal = nullptr;
+
+static constexpr int BASE_NOTE = 48;
+
+/** Sky key of a pitch above the base note, -1 if none */
+static int keyOfPitch(const int pitch)
+{
+    for (int i = 0; i < 15; i++) {
+        if (SKY_KEY_PITCHES[i] == pitch) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/** Expand mode before fold strategies existed: octave loops into 0..24 */
+static int legacyExpandKey(const int midiNote, const int baseNote)
+{
+    int targetNote = midiNote - baseNote;
+    while (targetNote < 0) {
+        targetNote += 12;
+    }
+    while (targetNote > 24) {
+        targetNote -= 12;
+    }
+    return keyOfPitch(targetNote);
+}
+
+static void pumpMIDI()
+{
+    while (hal->midiSerial.available() > 0) {
+        pollMIDI();
+    }
+    runOutput();
+}
+
+static uint16_t lastReportKeys()
+{
+    return getPressedKeys(hal->hid.reports.back().notes15);
+}
+
+void setUp()
+{
+    hal = new HostHal();
+    hal->install();
+
+    setupMIDI(0, 0);
+    setSustainEnabled(false);
+    OutputTableSettings table;
+    table.baseNote = BASE_NOTE;
+    setOutputTable(table);
+    refreshOutput();
+    runOutput();
+    hal->hid.reports.clear();
+}
+
+void tearDown()
+{
+    delete hal;
+    hal = nullptr;
+}
+
+void test_without_expand_only_range_is_mapped()
+{
+    for (int fold = 0; fold < static_cast<int>(FoldStrategy::COUNT); fold++) {
+        const NoteKeyTable table = buildNoteKeyTable(BASE_NOTE, false, static_cast<FoldStrategy>(fold), 60);
+        for (int note = 0; note < MAX_NOTES; note++) {
+            const int pitch = note - BASE_NOTE;
+            TEST_ASSERT_EQUAL(pitch >= 0 && pitch <= 24 ? keyOfPitch(pitch) : -1, table.keys[note]);
+        }
+    }
+}
+
+void test_nearest_matches_legacy_expand()
+{
+    for (int baseNote = BASENOTE_MIN; baseNote <= BASENOTE_MAX; baseNote++) {
+        const NoteKeyTable table = buildNoteKeyTable(baseNote, true, FoldStrategy::NEAREST, 0);
+        for (int note = 0; note < MAX_NOTES; note++) {
+            TEST_ASSERT_EQUAL(legacyExpandKey(note, baseNote), table.keys[note]);
+        }
+    }
+}
+
+void test_clamp_to_edge_keys()
+{
+    const NoteKeyTable table = buildNoteKeyTable(BASE_NOTE, true, FoldStrategy::CLAMP, 0);
+    for (int note = 0; note < MAX_NOTES; note++) {
+        const int pitch = note - BASE_NOTE;
+        const int expected = pitch < 0 ? 0 : pitch > 24 ? 14 : keyOfPitch(pitch);
+        TEST_ASSERT_EQUAL(expected, table.keys[note]);
+    }
+}
+
+void test_drop_outside_window()
+{
+    const NoteKeyTable table = buildNoteKeyTable(BASE_NOTE, true, FoldStrategy::DROP, 0);
+    const NoteKeyTable plain = buildNoteKeyTable(BASE_NOTE, false);
+    for (int note = 0; note < MAX_NOTES; note++) {
+        TEST_ASSERT_EQUAL(plain.keys[note], table.keys[note]);
+    }
+}
+
+void test_split_zones_fold_into_own_octave()
+{
+    // Split at C4: bass folds into keys 0-7, melody into keys 7-14
+    const int split = 60;
+    const FoldStrategy strategies[] = {FoldStrategy::NEAREST, FoldStrategy::CLAMP, FoldStrategy::DROP};
+    for (const FoldStrategy fold : strategies) {
+        const NoteKeyTable table = buildNoteKeyTable(BASE_NOTE, true, fold, split);
+        for (int note = 0; note < MAX_NOTES; note++) {
+            const int key = table.keys[note];
+            if (key < 0) {
+                continue;
+            }
+            if (note < split) {
+                TEST_ASSERT_TRUE(key <= 7);
+            } else {
+                TEST_ASSERT_TRUE(key >= 7);
+            }
+            // Folding keeps the pitch class, clamping lands on a C
+            const int pitchClass = ((note - BASE_NOTE) % 12 + 12) % 12;
+            const int keyPitchClass = SKY_KEY_PITCHES[key] % 12;
+            TEST_ASSERT_TRUE(keyPitchClass == pitchClass || (fold == FoldStrategy::CLAMP && keyPitchClass == 0));
+        }
+    }
+
+    const NoteKeyTable table = buildNoteKeyTable(BASE_NOTE, true, FoldStrategy::NEAREST, split);
+    TEST_ASSERT_EQUAL(0, table.keys[36]); // C2 -> C3
+    TEST_ASSERT_EQUAL(3, table.keys[53]); // F3 stays
+    TEST_ASSERT_EQUAL(10, table.keys[65]); // F4 stays
+    TEST_ASSERT_EQUAL(10, table.keys[77]); // F5 -> F4
+    TEST_ASSERT_EQUAL(7, table.keys[60]); // C4 is shared by both windows
+    TEST_ASSERT_EQUAL(14, table.keys[72]); // C5 stays
+    TEST_ASSERT_EQUAL(-1, table.keys[61]); // black keys stay unmapped
+}
+
+void test_bass_and_melody_no_longer_collide()
+{
+    // A bass C2 folds onto the key of a melody C3
+    const NoteKeyTable plain = buildNoteKeyTable(BASE_NOTE, true, FoldStrategy::NEAREST, 0);
+    TEST_ASSERT_EQUAL(0, plain.keys[36]);
+    TEST_ASSERT_EQUAL(0, plain.keys[48]);
+
+    // Split at the base note: the melody moves to the upper octave, the bass keeps the lower one
+    const NoteKeyTable split = buildNoteKeyTable(BASE_NOTE, true, FoldStrategy::NEAREST, BASE_NOTE);
+    TEST_ASSERT_EQUAL(0, split.keys[36]);
+    TEST_ASSERT_EQUAL(7, split.keys[48]);
+}
+
+void test_pipeline_uses_new_table_after_settings_change()
+{
+    OutputTableSettings table;
+    table.baseNote = BASE_NOTE;
+    table.expand = true;
+    table.fold = FoldStrategy::CLAMP;
+    setOutputTable(table);
+    runOutput();
+
+    // C6 is above the range: clamped to the last key
+    hal->midiSerial.push({0x90, 84, 100});
+    pumpMIDI();
+    TEST_ASSERT_EQUAL_HEX16(1 << 14, lastReportKeys());
+
+    // Switching to drop removes it from the report at once
+    table.fold = FoldStrategy::DROP;
+    setOutputTable(table);
+    runOutput();
+    TEST_ASSERT_EQUAL_HEX16(0, lastReportKeys());
+
+    table.fold = FoldStrategy::NEAREST;
+    setOutputTable(table);
+    runOutput();
+    TEST_ASSERT_EQUAL_HEX16(1 << 14, lastReportKeys());
+}
+
+int main(int argc, char** argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_without_expand_only_range_is_mapped);
+    RUN_TEST(test_nearest_matches_legacy_expand);
+    RUN_TEST(test_clamp_to_edge_keys);
+    RUN_TEST(test_drop_outside_window);
+    RUN_TEST(test_split_zones_fold_into_own_octave);
+    RUN_TEST(test_bass_and_melody_no_longer_collide);
+    RUN_TEST(test_pipeline_uses_new_table_after_settings_change);
+    return UNITY_END();
+}
@@ -0,0 +1,303 @@
+#include <unity.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "app/hal-host.h"
+#include "app/midi.h"
+#include "app/note-mapping.h"
+#include "app/report.h"
+#include "app/telemetry.h"
+
+// MIDI ingest under a saturated 31250 baud input stream
+//
+// Bytes arrive every 320 us on the fake clock into a receive buffer bounded like the UART's
+// (MIDI_RX_BUFFER_SIZE), while the MIDI task wakes once per 1 ms tick. Every message sent must reach the
+// parser and the note state.
+
+static constexpr uint32_t BYTE_US = 1000000 / MIDI_BYTES_PER_SECOND;
+static constexpr uint32_t TICK_US = 1000;
+static constexpr int BASE_NOTE = 48;
+
+// Deterministic dense MIDI stream: a held chord, a glissando over it with controller, pressure and pitch
+// bend traffic, running status and real-time bytes inside messages
+class StressGenerator
+{
+public:
+    struct Expected
+    {
+        uint32_t messages = 0;
+        uint32_t noteOn = 0;
+        uint32_t noteOff = 0;
+        uint32_t controlChange = 0;
+    };
+
+    /** Next phrase: releases the previous chord, plays the glissando and holds a new chord */
+    std::vector<uint8_t> phrase(uint16_t& heldKeys)
+    {
+        bytes.clear();
+        for (int i = 0; i < 15; i++) {
+            if (chordKeys & 1 << i) {
+                if (random() % 2 == 0) {
+                    message(0x80, BASE_NOTE + SKY_KEY_PITCHES[i], 64);
+                } else {
+                    message(0x90, BASE_NOTE + SKY_KEY_PITCHES[i], 0);
+                }
+            }
+        }
+
+        // Chord of three keys (pressed after the release above)
+        chordKeys = 0;
+        while (__builtin_popcount(chordKeys) < 3) {
+            chordKeys |= 1 << random() % 15;
+        }
+
+        for (int note = 30; note < 100; note++) {
+            if (isChordNote(note)) {
+                continue;
+            }
+            message(0x90, note, 1 + random() % 127);
+            message(0xB1, 1, random() % 128);
+            message(0xA0, note, random() % 128);
+            message(0xD1, random() % 128, 0);
+            message(0xE1, random() % 128, random() % 128);
+            if (note % 16 == 0) {
+                // Short system exclusive
+                for (const uint8_t byte : {0xF0, 0x7D, 0x01, 0x02, 0xF7}) {
+                    bytes.push_back(byte);
+                }
+                expected.messages++;
+                runningStatus = 0;
+            }
+            message(0x80, note, 0);
+        }
+
+        for (int i = 0; i < 15; i++) {
+            if (chordKeys & 1 << i) {
+                message(0x90, BASE_NOTE + SKY_KEY_PITCHES[i], 100);
+            }
+        }
+        heldKeys = chordKeys;
+        return bytes;
+    }
+
+    /** Release the held chord */
+    std::vector<uint8_t> release()
+    {
+        bytes.clear();
+        for (int i = 0; i < 15; i++) {
+            if (chordKeys & 1 << i) {
+                message(0x80, BASE_NOTE + SKY_KEY_PITCHES[i], 64);
+            }
+        }
+        chordKeys = 0;
+        return bytes;
+    }
+
+    const Expected& getExpected() const { return expected; }
+
+private:
+    uint32_t random()
+    {
+        seed = seed * 1103515245 + 12345;
+        return seed >> 16 & 0x7FFF;
+    }
+
+    bool isChordNote(const int note) const
+    {
+        for (int i = 0; i < 15; i++) {
+            if (chordKeys & 1 << i && BASE_NOTE + SKY_KEY_PITCHES[i] == note) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void message(const uint8_t status, const uint32_t data1, const uint32_t data2)
+    {
+        if (status != runningStatus) {
+            push(status);
+            runningStatus = status;
+        }
+        push(static_cast<uint8_t>(data1));
+        const uint8_t type = status & 0xF0;
+        if (type != 0xC0 && type != 0xD0) {
+            push(static_cast<uint8_t>(data2));
+        }
+
+        expected.messages++;
+        if (type == 0x90 && data2 > 0) {
+            expected.noteOn++;
+        } else if (type == 0x80 || type == 0x90) {
+            expected.noteOff++;
+        } else if (type == 0xB0) {
+            expected.controlChange++;
+        }
+    }
+
+    void push(const uint8_t byte)
+    {
+        bytes.push_back(byte);
+        if (++sinceClock == 7) {
+            // Timing clock, possibly inside a message
+            sinceClock = 0;
+            bytes.push_back(0xF8);
+            expected.messages++;
+        }
+    }
+
+    uint32_t seed = 1;
+    std::vector<uint8_t> bytes;
+    uint16_t chordKeys = 0;
+    uint8_t runningStatus = 0;
+    int sinceClock = 0;
+    Expected expected;
+};
+
+// Saturated line into a bounded receive buffer, drained by the MIDI task once per tick
+class SaturatedLine
+{
+public:
+    explicit SaturatedLine(HostHal& hal) : hal(hal) {}
+
+    /** Send the bytes back to back; the task does not run during [stallFromUs, stallToUs) */
+    void send(const std::vector<uint8_t>& bytes, const uint64_t stallFromUs = 0, const uint64_t stallToUs = 0)
+    {
+        size_t next = 0;
+        while (next < bytes.size()) {
+            hal.clock.advanceMicros(TICK_US);
+            elapsedUs += TICK_US;
+            while (next < bytes.size() && nextByteUs <= elapsedUs) {
+                if (hal.midiSerial.input.size() < MIDI_RX_BUFFER_SIZE) {
+                    hal.midiSerial.input.push_back(bytes[next]);
+                } else {
+                    lost++;
+                }
+                sent++;
+                next++;
+                nextByteUs += BYTE_US;
+            }
+            if (elapsedUs < stallFromUs || elapsedUs >= stallToUs) {
+                pollMIDI();
+            }
+        }
+        hal.clock.advanceMicros(TICK_US);
+        elapsedUs += TICK_US;
+        nextByteUs = elapsedUs;
+        pollMIDI();
+    }
+
+    uint64_t getElapsedUs() const { return elapsedUs; }
+
+    uint32_t sent = 0;
+    uint32_t lost = 0;
+
+private:
+    HostHal& hal;
+    uint64_t elapsedUs = 0;
+    uint64_t nextByteUs = 0;
+};
+
+static HostHal* hal = nullptr;
+
+static uint16_t pressedKeys()
+{
+    static const NoteKeyTable table = buildNoteKeyTable(BASE_NOTE, false);
+    return getPressedKeys(getNotes15(table));
+}
+
+static uint32_t delta(const Telemetry& before, const Counter counter)
+{
+    return getTelemetry().get(counter) - before.get(counter);
+}
+
+void setUp()
+{
+    hal = new HostHal();
+    hal->install();
+
+    setupMIDI(0, 0);
+    setSustainEnabled(false);
+}
+
+void tearDown()
+{
+    delete hal;
+    hal = nullptr;
+}
+
+void test_saturated_stream_loses_nothing()
+{
+    const Telemetry before = getTelemetry();
+    StressGenerator generator;
+    SaturatedLine line(*hal);
+
+    for (int i = 0; i < 20; i++) {
+        uint16_t heldKeys = 0;
+        line.send(generator.phrase(heldKeys));
+
+        // State layer: only the held chord remains pressed after the glissando
+        TEST_ASSERT_EQUAL_HEX16(heldKeys, pressedKeys());
+        TEST_ASSERT_EQUAL(0, hal->midiSerial.available());
+    }
+    line.send(generator.release());
+    TEST_ASSERT_EQUAL_HEX16(0, pressedKeys());
+
+    const StressGenerator::Expected& expected = generator.getExpected();
+    TEST_ASSERT_EQUAL(0, line.lost);
+    TEST_ASSERT_EQUAL(expected.messages, delta(before, Counter::MIDI_MESSAGES));
+    TEST_ASSERT_EQUAL(expected.noteOn, delta(before, Counter::NOTE_ON));
+    TEST_ASSERT_EQUAL(expected.noteOff, delta(before, Counter::NOTE_OFF));
+    TEST_ASSERT_EQUAL(expected.controlChange, delta(before, Counter::CONTROL_CHANGE));
+
+    // MIDI thru forwarded every byte
+    TEST_ASSERT_EQUAL(line.sent, hal->midiSerial.output.size());
+
+    // The stream really was saturated
+    TEST_ASSERT_TRUE(line.sent > 15000);
+    TEST_ASSERT_TRUE(line.getElapsedUs() < static_cast<uint64_t>(line.sent) * BYTE_US * 11 / 10);
+}
+
+void test_stall_within_budget_loses_nothing()
+{
+    const Telemetry before = getTelemetry();
+    StressGenerator generator;
+    SaturatedLine line(*hal);
+
+    uint16_t heldKeys = 0;
+    std::vector<uint8_t> bytes = generator.phrase(heldKeys);
+    const std::vector<uint8_t> second = generator.phrase(heldKeys);
+    bytes.insert(bytes.end(), second.begin(), second.end());
+    line.send(bytes, 100000, 100000 + MIDI_RX_STALL_BUDGET_MS * 1000);
+
+    TEST_ASSERT_EQUAL(0, line.lost);
+    TEST_ASSERT_EQUAL_HEX16(heldKeys, pressedKeys());
+    TEST_ASSERT_EQUAL(generator.getExpected().messages, delta(before, Counter::MIDI_MESSAGES));
+}
+
+void test_stall_beyond_buffer_is_detected()
+{
+    StressGenerator generator;
+    SaturatedLine line(*hal);
+
+    // The harness bounds the buffer like the UART: a stall longer than it covers must lose bytes
+    uint16_t heldKeys = 0;
+    std::vector<uint8_t> bytes = generator.phrase(heldKeys);
+    const std::vector<uint8_t> second = generator.phrase(heldKeys);
+    bytes.insert(bytes.end(), second.begin(), second.end());
+    const uint64_t bufferUs = static_cast<uint64_t>(MIDI_RX_BUFFER_SIZE) * BYTE_US;
+    line.send(bytes, 100000, 100000 + bufferUs * 2);
+
+    TEST_ASSERT_TRUE(line.lost > 0);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_saturated_stream_loses_nothing);
+    RUN_TEST(test_stall_within_budget_loses_nothing);
+    RUN_TEST(test_stall_beyond_buffer_is_detected);
+
+    UNITY_END();
+}
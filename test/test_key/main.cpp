@@ -0,0 +1,130 @@
+#include <unity.h>
+
+#include "app/key-estimator.h"
+
+static KeyEstimator estimator;
+
+static void play(const int* notes, const int count, const int repeat)
+{
+    for (int r = 0; r < repeat; r++) {
+        for (int i = 0; i < count; i++) {
+            estimator.addNote(notes[i]);
+        }
+    }
+}
+
+void setUp()
+{
+    estimator.reset();
+}
+
+void tearDown()
+{
+}
+
+void test_major_melody()
+{
+    // D major, tonic and dominant emphasized
+    const int melody[] = {62, 66, 69, 74, 73, 71, 69, 67, 66, 64, 62, 69, 62};
+    play(melody, 13, 3);
+
+    KeyEstimate estimate;
+    TEST_ASSERT_TRUE(estimator.update(estimate));
+    TEST_ASSERT_TRUE(estimate.valid);
+    TEST_ASSERT_EQUAL_STRING("D", getKeyName(estimate.tonic, estimate.minor));
+    TEST_ASSERT_EQUAL(2, estimate.basePitchClass);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 1.0f, estimate.coverage);
+
+    // Keys D3-D5 cover the melody (D4-D5)
+    TEST_ASSERT_EQUAL(50, KeyEstimator::suggestBaseNote(estimate, 24, 84));
+}
+
+void test_minor_melody_maps_to_relative_major()
+{
+    // A natural minor around A3
+    const int melody[] = {57, 60, 64, 57, 59, 60, 62, 64, 65, 64, 62, 60, 59, 57, 64, 57};
+    play(melody, 16, 2);
+
+    KeyEstimate estimate;
+    TEST_ASSERT_TRUE(estimator.update(estimate));
+    TEST_ASSERT_EQUAL_STRING("Am", getKeyName(estimate.tonic, estimate.minor));
+    TEST_ASSERT_EQUAL(0, estimate.basePitchClass);
+    TEST_ASSERT_EQUAL(48, KeyEstimator::suggestBaseNote(estimate, 24, 84));
+}
+
+void test_update_only_after_new_notes()
+{
+    KeyEstimate estimate;
+    estimator.update(estimate);
+    TEST_ASSERT_FALSE(estimator.update(estimate));
+
+    const int notes[] = {60, 64, 67};
+    play(notes, 3, 1);
+    TEST_ASSERT_TRUE(estimator.update(estimate));
+    TEST_ASSERT_FALSE(estimate.valid);
+    TEST_ASSERT_FALSE(estimator.update(estimate));
+
+    estimator.addNote(72);
+    TEST_ASSERT_TRUE(estimator.update(estimate));
+}
+
+void test_decay_follows_modulation()
+{
+    const int cMajor[] = {60, 62, 64, 65, 67, 69, 71, 72, 67, 64, 60};
+    const int eMajor[] = {64, 66, 68, 69, 71, 73, 75, 76, 71, 68, 64};
+    KeyEstimate estimate;
+
+    play(cMajor, 11, 20);
+    TEST_ASSERT_TRUE(estimator.update(estimate));
+    TEST_ASSERT_EQUAL(0, estimate.basePitchClass);
+
+    // Older notes fade: after a few bars in E the estimate follows, and weights stay finite
+    play(eMajor, 11, 10);
+    TEST_ASSERT_TRUE(estimator.update(estimate));
+    TEST_ASSERT_EQUAL(4, estimate.basePitchClass);
+    TEST_ASSERT_TRUE(estimate.coverage > 0.9f);
+
+    play(eMajor, 11, 2000);
+    TEST_ASSERT_TRUE(estimator.update(estimate));
+    TEST_ASSERT_EQUAL(4, estimate.basePitchClass);
+    TEST_ASSERT_FLOAT_WITHIN(0.5f, 70.0f, estimate.meanPitch);
+}
+
+void test_should_apply_needs_clear_gain()
+{
+    KeyEstimate estimate;
+    estimate.valid = true;
+    estimate.basePitchClass = 2;
+    estimate.coverage = 1.0f;
+    estimate.coverageByBase[0] = 0.85f;
+    estimate.coverageByBase[7] = 0.95f;
+
+    TEST_ASSERT_TRUE(KeyEstimator::shouldApply(estimate, 48)); // C3
+    TEST_ASSERT_FALSE(KeyEstimator::shouldApply(estimate, 55)); // G3: within the margin
+    TEST_ASSERT_FALSE(KeyEstimator::shouldApply(estimate, 50)); // already D (octave is left alone)
+
+    estimate.valid = false;
+    TEST_ASSERT_FALSE(KeyEstimator::shouldApply(estimate, 48));
+}
+
+void test_nearest_note_in_range()
+{
+    TEST_ASSERT_EQUAL(50, KeyEstimator::nearestNote(2, 48, 24, 84));
+    TEST_ASSERT_EQUAL(43, KeyEstimator::nearestNote(7, 48, 24, 84));
+    TEST_ASSERT_EQUAL(26, KeyEstimator::nearestNote(2, 10, 24, 84));
+    TEST_ASSERT_EQUAL(83, KeyEstimator::nearestNote(11, 100, 24, 84));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_major_melody);
+    RUN_TEST(test_minor_melody_maps_to_relative_major);
+    RUN_TEST(test_update_only_after_new_notes);
+    RUN_TEST(test_decay_follows_modulation);
+    RUN_TEST(test_should_apply_needs_clear_gain);
+    RUN_TEST(test_nearest_note_in_range);
+
+    UNITY_END();
+}
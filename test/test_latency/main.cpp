@@ -0,0 +1,88 @@
+#include <unity.h>
+#include "../src/app/latency.h"
+
+void test_histogram_empty()
+{
+    const LatencyHistogram histogram;
+
+    TEST_ASSERT_EQUAL(0, histogram.getCount());
+    TEST_ASSERT_EQUAL(0, histogram.percentile(50));
+    TEST_ASSERT_EQUAL(0, histogram.getMax());
+}
+
+void test_histogram_buckets_cover_values()
+{
+    // Every value falls in a bucket whose upper bound is >= value and within 25%
+    for (uint32_t us = 0; us < 100000; us++) {
+        const int index = LatencyHistogram::bucketOf(us);
+        const uint32_t upper = LatencyHistogram::upperBoundOf(index);
+        TEST_ASSERT_TRUE(upper >= us);
+        TEST_ASSERT_TRUE(upper - us <= us / 4 + 1);
+        if (index > 0) {
+            TEST_ASSERT_TRUE(LatencyHistogram::upperBoundOf(index - 1) < us);
+        }
+    }
+}
+
+void test_histogram_overflow_bucket()
+{
+    LatencyHistogram histogram;
+
+    histogram.record(0xFFFFFFFF);
+
+    TEST_ASSERT_EQUAL(LatencyHistogram::BUCKETS - 1, LatencyHistogram::bucketOf(0xFFFFFFFF));
+    TEST_ASSERT_EQUAL(0xFFFFFFFF, histogram.getMax());
+    TEST_ASSERT_EQUAL(0xFFFFFFFF, histogram.percentile(100));
+}
+
+void test_histogram_percentiles()
+{
+    LatencyHistogram histogram;
+
+    // 98 fast samples, 2 slow ones
+    for (int i = 0; i < 98; i++) {
+        histogram.record(100);
+    }
+    histogram.record(5000);
+    histogram.record(9000);
+
+    TEST_ASSERT_EQUAL(100, histogram.getCount());
+    TEST_ASSERT_EQUAL(9000, histogram.getMax());
+    TEST_ASSERT_TRUE(histogram.percentile(50) >= 100);
+    TEST_ASSERT_TRUE(histogram.percentile(50) <= 125);
+    TEST_ASSERT_TRUE(histogram.percentile(99) >= 5000);
+    TEST_ASSERT_TRUE(histogram.percentile(99) <= 6250);
+    TEST_ASSERT_EQUAL(9000, histogram.percentile(100));
+}
+
+void test_histogram_reset()
+{
+    LatencyHistogram histogram;
+    histogram.record(42);
+
+    histogram.reset();
+
+    TEST_ASSERT_EQUAL(0, histogram.getCount());
+    TEST_ASSERT_EQUAL(0, histogram.getMax());
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+int main()
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_histogram_empty);
+    RUN_TEST(test_histogram_buckets_cover_values);
+    RUN_TEST(test_histogram_overflow_bucket);
+    RUN_TEST(test_histogram_percentiles);
+    RUN_TEST(test_histogram_reset);
+
+    UNITY_END();
+}
@@ -0,0 +1,227 @@
+#include <unity.h>
+
+#include "app/hal-host.h"
+#include "app/midi.h"
+#include "app/note-mapping.h"
+#include "app/output.h"
+#include "app/report.h"
+#include "app/settings.h"
+
+// MIDI-learn key bindings: the settings pages, the compiled note table and the report keys they produce
+
+static HostHal* hal = nullptr;
+
+/** Run the MIDI task and the output once, and return the keys of the last report (0xFFFF if none was sent) */
+static uint16_t pollKeys()
+{
+    pollMIDI();
+    runOutput();
+    if (hal->hid.reports.empty()) {
+        return 0xFFFF;
+    }
+    return getPressedKeys(hal->hid.reports.back().notes15);
+}
+
+/** Press B until the given settings page is selected */
+static void selectPage(Settings& settings, const SettingType type)
+{
+    while (settings.getSettingType() != type) {
+        settings.processButtons(false, true, false);
+    }
+}
+
+/** Hand bindings over to the output task with the other table settings at their defaults */
+static void setBindings(const KeyBindings& bindings)
+{
+    OutputTableSettings table;
+    table.bindings = bindings;
+    setOutputTable(table);
+}
+
+void setUp()
+{
+    hal = new HostHal();
+    hal->install();
+
+    setupMIDI(0, 0);
+    setSustainEnabled(false);
+    setDebounceGuard(0);
+    setOutputTable(OutputTableSettings());
+
+    // Start from an empty report
+    refreshOutput();
+    runOutput();
+    hal->hid.reports.clear();
+    takeLearnNote();
+}
+
+void tearDown()
+{
+    delete hal;
+    hal = nullptr;
+}
+
+void test_set_note_binds_one_key()
+{
+    KeyBindings bindings;
+
+    bindings.setNote(3, 60);
+    TEST_ASSERT_EQUAL(60, bindings.getNote(3));
+    bindings.setNote(5, 60);
+    TEST_ASSERT_EQUAL(-1, bindings.getNote(3));
+    TEST_ASSERT_EQUAL(60, bindings.getNote(5));
+    bindings.setNote(5, -1);
+    TEST_ASSERT_EQUAL(-1, bindings.getNote(5));
+    TEST_ASSERT_TRUE(bindings == KeyBindings());
+}
+
+void test_apply_key_bindings()
+{
+    KeyBindings bindings;
+    bindings.setNote(0, 84);
+    bindings.setAction(2, 7);
+    bindings.setAction(7, 7);
+    NoteKeyTable table = buildNoteKeyTable(48, false, FoldStrategy::NEAREST, 0);
+
+    applyKeyBindings(table, bindings);
+
+    // The learned note plays key 0 next to the layout's own note
+    TEST_ASSERT_EQUAL(0, table.keys[84]);
+    TEST_ASSERT_EQUAL(0, table.keys[48]);
+    // Key 2 (E3) presses the action of key 7
+    TEST_ASSERT_EQUAL(7, table.keys[52]);
+    TEST_ASSERT_EQUAL(7, table.keys[60]);
+    TEST_ASSERT_EQUAL(-1, table.keys[49]);
+}
+
+void test_learn_page_binds_played_note()
+{
+    Settings settings;
+    selectPage(settings, SettingType::LEARN);
+
+    // Not a note for the selected key
+    TEST_ASSERT_FALSE(settings.learnNote(MAX_NOTES));
+
+    // C: next key, A: back around to the last key
+    TEST_ASSERT_TRUE(settings.processButtons(false, false, true));
+    TEST_ASSERT_EQUAL(1, settings.getLearnKey());
+    settings.processButtons(true, false, false);
+    settings.processButtons(true, false, false);
+    TEST_ASSERT_EQUAL(14, settings.getLearnKey());
+
+    TEST_ASSERT_TRUE(settings.learnNote(30));
+    TEST_ASSERT_EQUAL(3000, static_cast<int>(hal->speaker.tones.back().frequency));
+    TEST_ASSERT_EQUAL(30, settings.getBindings().getNote(14));
+
+    // Same note again is not a change
+    TEST_ASSERT_FALSE(settings.learnNote(30));
+}
+
+void test_learn_only_on_learn_page()
+{
+    Settings settings;
+    selectPage(settings, SettingType::ACTION);
+
+    TEST_ASSERT_FALSE(settings.learnNote(30));
+    TEST_ASSERT_TRUE(settings.getBindings() == KeyBindings());
+}
+
+void test_action_page_cycles_action()
+{
+    Settings settings;
+    selectPage(settings, SettingType::LEARN);
+    settings.processButtons(false, false, true);
+    selectPage(settings, SettingType::ACTION);
+
+    settings.processButtons(false, false, true);
+    TEST_ASSERT_EQUAL(2, settings.getBindings().getAction(1));
+    settings.processButtons(true, false, false);
+    settings.processButtons(true, false, false);
+    TEST_ASSERT_EQUAL(0, settings.getBindings().getAction(1));
+
+    // Bindings survive the settings record
+    Settings restored;
+    restored.applyRecord(settings.toRecord());
+    TEST_ASSERT_TRUE(restored.getBindings() == settings.getBindings());
+}
+
+void test_record_with_bad_bindings_is_invalid()
+{
+    SettingsRecord record = Settings().toRecord();
+    record.bindings.notes[0] = MAX_NOTES + 1;
+
+    TEST_ASSERT_FALSE(Settings::isValidRecord(record));
+
+    record.bindings.notes[0] = 0;
+    record.bindings.actions[0] = 16;
+    TEST_ASSERT_FALSE(Settings::isValidRecord(record));
+}
+
+void test_played_note_is_offered_for_learning()
+{
+    hal->midiSerial.push({0x90, 30, 100, 0x80, 30, 0});
+    pollMIDI();
+
+    TEST_ASSERT_EQUAL(30, takeLearnNote());
+    TEST_ASSERT_EQUAL(-1, takeLearnNote());
+}
+
+void test_learned_note_plays_key()
+{
+    Settings settings;
+    selectPage(settings, SettingType::LEARN);
+    settings.processButtons(false, false, true);
+
+    // Below the layout: no key
+    hal->midiSerial.push({0x90, 30, 100});
+    pollMIDI();
+    runOutput();
+    TEST_ASSERT_EQUAL(0, hal->hid.reports.size());
+    TEST_ASSERT_TRUE(settings.learnNote(takeLearnNote()));
+    setBindings(settings.getBindings());
+
+    // The held note is remapped at once
+    TEST_ASSERT_EQUAL_HEX16(1 << 1, pollKeys());
+    hal->midiSerial.push({0x80, 30, 0});
+    TEST_ASSERT_EQUAL_HEX16(0, pollKeys());
+}
+
+void test_action_remaps_report_key()
+{
+    KeyBindings bindings;
+    bindings.setAction(0, 14);
+    setBindings(bindings);
+
+    hal->midiSerial.push({0x90, 48, 100});
+    TEST_ASSERT_EQUAL_HEX16(1 << 14, pollKeys());
+
+    // Back to the key's own action
+    setBindings(KeyBindings());
+    TEST_ASSERT_EQUAL_HEX16(1 << 0, pollKeys());
+}
+
+void test_unchanged_bindings_send_nothing()
+{
+    setBindings(KeyBindings());
+    runOutput();
+
+    TEST_ASSERT_EQUAL(0, hal->hid.reports.size());
+}
+
+int main()
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_set_note_binds_one_key);
+    RUN_TEST(test_apply_key_bindings);
+    RUN_TEST(test_learn_page_binds_played_note);
+    RUN_TEST(test_learn_only_on_learn_page);
+    RUN_TEST(test_action_page_cycles_action);
+    RUN_TEST(test_record_with_bad_bindings_is_invalid);
+    RUN_TEST(test_played_note_is_offered_for_learning);
+    RUN_TEST(test_learned_note_plays_key);
+    RUN_TEST(test_action_remaps_report_key);
+    RUN_TEST(test_unchanged_bindings_send_nothing);
+
+    UNITY_END();
+}
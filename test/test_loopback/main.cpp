@@ -0,0 +1,228 @@
+#include <unity.h>
+
+#include <string>
+
+#include "app/display.h"
+#include "app/hal-host.h"
+#include "app/loopback.h"
+#include "app/midi.h"
+#include "app/output.h"
+#include "app/protocol.h"
+#include "app/report.h"
+
+// UART loopback self-test on the fake clock, with the host serial port jumpered TX to RX
+
+static HostHal* hal = nullptr;
+
+/** One MIDI task tick of 1 ms */
+static void tick()
+{
+    hal->clock.advance(1);
+    pollMIDI();
+    pollLoopback();
+}
+
+/** Run until the test has finished (or the time limit) */
+static void runLoopback(const unsigned long limitMs = 20000)
+{
+    for (unsigned long i = 0; i < limitMs && (i == 0 || isLoopbackRunning()); i++) {
+        tick();
+    }
+}
+
+void setUp()
+{
+    hal = new HostHal();
+    hal->install();
+
+    setupMIDI(0, 0);
+    setSustainEnabled(false);
+    setDebounceGuard(0);
+    setOutputTable(OutputTableSettings());
+    stopLoopback();
+    pollLoopback();
+    refreshOutput();
+    runOutput();
+    hal->hid.reports.clear();
+}
+
+void tearDown()
+{
+    delete hal;
+    hal = nullptr;
+}
+
+void test_message_encoding()
+{
+    MidiParser parser;
+    uint8_t message[LOOPBACK_MESSAGE_SIZE];
+    const uint32_t sentUs = 0x12345678;
+
+    encodeLoopbackMessage(sentUs, message);
+    TEST_ASSERT_EQUAL_HEX8(0xA0, message[0] & 0xF0);
+    TEST_ASSERT_EQUAL_HEX8(0, (message[1] | message[2]) & 0x80);
+    for (const uint8_t byte : message) {
+        parser.feed(byte);
+    }
+
+    TEST_ASSERT_EQUAL(1000, getLoopbackRoundTrip(parser.message(), sentUs + 1000));
+
+    // Across the wrap-around of the 18-bit time
+    encodeLoopbackMessage(0xFFFFFFF0, message);
+    for (const uint8_t byte : message) {
+        parser.feed(byte);
+    }
+    TEST_ASSERT_EQUAL(1024, getLoopbackRoundTrip(parser.message(), 0xFFFFFFF0 + 1024));
+
+    MidiMessage note;
+    note.type = MidiType::NOTE_ON;
+    TEST_ASSERT_EQUAL(-1, getLoopbackRoundTrip(note, 0));
+}
+
+void test_full_run()
+{
+    hal->midiSerial.jumpered = true;
+    startLoopback();
+    TEST_ASSERT_FALSE(isLoopbackRunning());
+    runLoopback();
+
+    const LoopbackStatus status = getLoopbackStatus();
+    TEST_ASSERT_EQUAL(static_cast<int>(LoopbackPhase::DONE), static_cast<int>(status.phase));
+    TEST_ASSERT_EQUAL(LOOPBACK_PROBES, status.sent);
+    TEST_ASSERT_EQUAL(LOOPBACK_PROBES, status.received);
+
+    // Sent at the end of one tick, read at the start of the next
+    TEST_ASSERT_EQUAL(1000, status.roundTrip.getMax());
+    TEST_ASSERT_EQUAL(0, status.parse.getMax());
+    TEST_ASSERT_EQUAL(LOOPBACK_LINE_RATE, status.maxRate);
+    TEST_ASSERT_EQUAL(0, status.lost);
+
+    // Test messages are neither echoed nor played
+    const size_t sent = hal->midiSerial.output.size();
+    TEST_ASSERT_EQUAL(0, sent % LOOPBACK_MESSAGE_SIZE);
+    TEST_ASSERT_TRUE(sent / LOOPBACK_MESSAGE_SIZE > LOOPBACK_PROBES + LOOPBACK_LINE_RATE);
+    runOutput();
+    TEST_ASSERT_EQUAL(0, hal->hid.reports.size());
+}
+
+void test_rate_steps_send_at_their_rate()
+{
+    hal->midiSerial.jumpered = true;
+    startLoopback();
+    while (getLoopbackStatus().phase != LoopbackPhase::RATE) {
+        tick();
+    }
+    const size_t before = hal->midiSerial.output.size();
+    for (unsigned long i = 0; i < LOOPBACK_STEP_MS; i++) {
+        tick();
+    }
+
+    const size_t messages = (hal->midiSerial.output.size() - before) / LOOPBACK_MESSAGE_SIZE;
+    TEST_ASSERT_UINT32_WITHIN(2, LOOPBACK_LINE_RATE * LOOPBACK_RATE_PERCENT[0] / 100, messages);
+}
+
+void test_loss_ends_rate_phase()
+{
+    hal->midiSerial.jumpered = true;
+    startLoopback();
+
+    // A receiver that drops a data byte now and then above half the line rate
+    unsigned long received = 0;
+    for (unsigned long i = 0; i < 20000 && (i == 0 || isLoopbackRunning()); i++) {
+        if (getLoopbackStatus().rate > LOOPBACK_LINE_RATE / 2 && !hal->midiSerial.input.empty() &&
+            ++received % 50 == 0) {
+            hal->midiSerial.input.pop_back();
+        }
+        tick();
+    }
+
+    const LoopbackStatus status = getLoopbackStatus();
+    TEST_ASSERT_EQUAL(static_cast<int>(LoopbackPhase::DONE), static_cast<int>(status.phase));
+    TEST_ASSERT_EQUAL(LOOPBACK_LINE_RATE * LOOPBACK_RATE_PERCENT[1] / 100, status.maxRate);
+    TEST_ASSERT_EQUAL(LOOPBACK_LINE_RATE * LOOPBACK_RATE_PERCENT[2] / 100, status.rate);
+    TEST_ASSERT_TRUE(status.lost > 0);
+}
+
+void test_no_signal_without_jumper()
+{
+    startLoopback();
+    runLoopback();
+
+    const LoopbackStatus status = getLoopbackStatus();
+    TEST_ASSERT_EQUAL(static_cast<int>(LoopbackPhase::NO_SIGNAL), static_cast<int>(status.phase));
+    TEST_ASSERT_EQUAL(LOOPBACK_PROBES, status.sent);
+    TEST_ASSERT_EQUAL(0, status.received);
+}
+
+void test_stop_returns_din_to_playing()
+{
+    hal->midiSerial.jumpered = true;
+    startLoopback();
+    tick();
+    tick();
+    TEST_ASSERT_TRUE(isLoopbackRunning());
+
+    stopLoopback();
+    tick();
+    TEST_ASSERT_FALSE(isLoopbackRunning());
+    TEST_ASSERT_EQUAL(static_cast<int>(LoopbackPhase::IDLE), static_cast<int>(getLoopbackStatus().phase));
+
+    hal->midiSerial.jumpered = false;
+    hal->midiSerial.output.clear();
+    hal->midiSerial.push({0x90, 48, 100});
+    pollMIDI();
+    runOutput();
+    TEST_ASSERT_EQUAL(3, hal->midiSerial.output.size());
+    TEST_ASSERT_EQUAL_HEX16(1 << 0, getPressedKeys(hal->hid.reports.back().notes15));
+}
+
+void test_second_input_plays_during_test()
+{
+    hal->midiSerial.jumpered = true;
+    startLoopback();
+    tick();
+
+    hal->midiSerial2.push({0x90, 52, 100});
+    tick();
+    runOutput();
+    TEST_ASSERT_EQUAL_HEX16(1 << 2, getPressedKeys(hal->hid.reports.back().notes15));
+}
+
+void test_format_and_draw_status()
+{
+    LoopbackStatus status;
+    status.phase = LoopbackPhase::DONE;
+    status.sent = 200;
+    status.received = 200;
+    status.roundTrip.record(1000);
+    status.parse.record(30);
+    status.rate = 781;
+    status.maxRate = 520;
+    status.lost = 3;
+    char buffer[192];
+
+    formatLoopbackStatus(status, buffer, sizeof(buffer));
+    TEST_ASSERT_EQUAL_STRING("phase=done sent=200 received=200 rtt_p50=1000 rtt_p99=1000 rtt_max=1000 parse_p50=30 "
+                             "parse_p99=30 parse_max=30 rate=781 max_rate=520 lost=3 line_rate=1041",
+                             buffer);
+
+    drawLoopbackStatus(status, 188, 320);
+    TEST_ASSERT_TRUE(hal->display.text.find("loopback done 200/200 rtt p50 1000us") != std::string::npos);
+    TEST_ASSERT_TRUE(hal->display.text.find("rate 520/1041 msg/s") != std::string::npos);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_message_encoding);
+    RUN_TEST(test_full_run);
+    RUN_TEST(test_rate_steps_send_at_their_rate);
+    RUN_TEST(test_loss_ends_rate_phase);
+    RUN_TEST(test_no_signal_without_jumper);
+    RUN_TEST(test_stop_returns_din_to_playing);
+    RUN_TEST(test_second_input_plays_during_test);
+    RUN_TEST(test_format_and_draw_status);
+
+    UNITY_END();
+}
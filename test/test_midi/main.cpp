@@ -1,6 +1,7 @@
 #include <unity.h>
 
 #include <unity.h>
+#include "../src/app/midi-parser.h"
 #include "../src/app/notes.h"
 
 void test_notes15_constructor()
@@ -52,6 +53,84 @@ void test_notes15_filter()
     TEST_ASSERT_EQUAL(0, result.get(3));
 }
 
+void test_notes15_filter_chord_with_same_timestamp()
+{
+    unsigned long timestamps[15] = {9, 9, 9, 9, 9, 9, 9, 0, 0, 0, 0, 0, 0, 0, 0};
+    const Notes15 notes15(timestamps);
+    Notes15Filter filter;
+
+    // A 7-note chord keeps 5 keys, also on the next evaluation
+    for (int i = 0; i < 2; i++) {
+        const Notes15 result = filter.latest(notes15, 5);
+        int pressed = 0;
+        for (int key = 0; key < 15; key++) {
+            pressed += result.get(key) != 0 ? 1 : 0;
+        }
+        TEST_ASSERT_EQUAL(5, pressed);
+    }
+}
+
+static int feedAll(MidiParser& parser, const uint8_t* bytes, const int size)
+{
+    int messages = 0;
+    for (int i = 0; i < size; i++) {
+        if (parser.feed(bytes[i])) {
+            messages++;
+        }
+    }
+    return messages;
+}
+
+void test_midi_parser_running_status()
+{
+    MidiParser parser;
+    const uint8_t bytes[] = {0x92, 60, 100, 62, 0};
+
+    TEST_ASSERT_EQUAL(1, feedAll(parser, bytes, 3));
+    TEST_ASSERT_EQUAL(static_cast<int>(MidiType::NOTE_ON), static_cast<int>(parser.message().type));
+    TEST_ASSERT_EQUAL(3, parser.message().channel);
+    TEST_ASSERT_EQUAL(60, parser.message().data1);
+    TEST_ASSERT_EQUAL(100, parser.message().data2);
+
+    // Running status, velocity 0 is note off
+    TEST_ASSERT_EQUAL(1, feedAll(parser, bytes + 3, 2));
+    TEST_ASSERT_EQUAL(static_cast<int>(MidiType::NOTE_OFF), static_cast<int>(parser.message().type));
+    TEST_ASSERT_EQUAL(62, parser.message().data1);
+}
+
+void test_midi_parser_realtime_inside_message()
+{
+    MidiParser parser;
+
+    TEST_ASSERT_FALSE(parser.feed(0xB0));
+    TEST_ASSERT_FALSE(parser.feed(64));
+    TEST_ASSERT_TRUE(parser.feed(0xF8));
+    TEST_ASSERT_EQUAL(static_cast<int>(MidiType::SYSTEM), static_cast<int>(parser.message().type));
+    TEST_ASSERT_EQUAL(0xF8, parser.message().data1);
+    TEST_ASSERT_TRUE(parser.feed(127));
+    TEST_ASSERT_EQUAL(static_cast<int>(MidiType::CONTROL_CHANGE), static_cast<int>(parser.message().type));
+    TEST_ASSERT_EQUAL(64, parser.message().data1);
+    TEST_ASSERT_EQUAL(127, parser.message().data2);
+}
+
+void test_midi_parser_sysex_and_system_common()
+{
+    MidiParser parser;
+    const uint8_t sysex[] = {0xF0, 0x7E, 0x7F, 0x06, 0x01, 0xF7};
+    TEST_ASSERT_EQUAL(1, feedAll(parser, sysex, sizeof(sysex)));
+    TEST_ASSERT_EQUAL(0xF0, parser.message().data1);
+
+    // Song select cancels running status: following data bytes are ignored
+    const uint8_t bytes[] = {0x90, 60, 100, 0xF3, 1, 61, 100, 0x90, 61, 100};
+    TEST_ASSERT_EQUAL(3, feedAll(parser, bytes, sizeof(bytes)));
+    TEST_ASSERT_EQUAL(61, parser.message().data1);
+
+    // Data bytes without status are ignored
+    MidiParser fresh;
+    const uint8_t orphan[] = {60, 100};
+    TEST_ASSERT_EQUAL(0, feedAll(fresh, orphan, sizeof(orphan)));
+}
+
 void setUp()
 {
 }
@@ -68,6 +147,10 @@ int main()
     RUN_TEST(test_notes15_get_bounds);
     RUN_TEST(test_notes15_inequality);
     RUN_TEST(test_notes15_filter);
+    RUN_TEST(test_notes15_filter_chord_with_same_timestamp);
+    RUN_TEST(test_midi_parser_running_status);
+    RUN_TEST(test_midi_parser_realtime_inside_message);
+    RUN_TEST(test_midi_parser_sysex_and_system_common);
 
     UNITY_END();
 }
@@ -0,0 +1,439 @@
+#include <unity.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "app/hal-host.h"
+#include "app/latency.h"
+#include "app/midi.h"
+#include "app/network-midi.h"
+#include "app/output.h"
+#include "app/report.h"
+#include "app/rtp-midi.h"
+
+// RTP-MIDI parsing, jitter buffer and an AppleMIDI session against a loopback UDP peer
+
+static HostHal* hal = nullptr;
+
+// Session ports of the controller and the peer playing into it
+static UdpDatagramPort* controlPort = nullptr;
+static UdpDatagramPort* dataPort = nullptr;
+static UdpDatagramPort* peerControl = nullptr;
+static UdpDatagramPort* peerData = nullptr;
+
+static constexpr uint32_t PEER_SSRC = 0x1234ABCD;
+
+// Start of the test on the fake clock (milliseconds)
+static unsigned long startMs = 0;
+
+// Reports sent so far as "<ms since start>:<keys hex>"
+static std::string timeline;
+
+static std::vector<RtpMidiCommand> parsed;
+
+static bool parse(const std::vector<uint8_t>& packet, RtpHeader& header)
+{
+    parsed.clear();
+    return parseRtpMidi(packet.data(), packet.size(), header,
+                        [](const RtpMidiCommand& command) { parsed.push_back(command); });
+}
+
+static void output()
+{
+    runOutput();
+    for (const RecordingHid::Report& report : hal->hid.reports) {
+        char entry[24];
+        snprintf(entry, sizeof(entry), "%s%lu:%x", timeline.empty() ? "" : " ", hal->clock.millis() - startMs,
+                 getPressedKeys(report.notes15));
+        timeline += entry;
+    }
+    hal->hid.reports.clear();
+}
+
+/** Run the network task, the MIDI task and the output once */
+static void poll()
+{
+    serviceNetworkMIDI();
+    pollNetworkMIDI();
+    output();
+}
+
+/** Let time pass, running the tasks every millisecond */
+static void runFor(const unsigned long ms)
+{
+    for (unsigned long i = 0; i < ms; i++) {
+        hal->clock.advance(1);
+        poll();
+    }
+}
+
+/** Reply received by a peer port (the controller answers within one poll) */
+static std::vector<uint8_t> receiveReply(UdpDatagramPort& port)
+{
+    uint8_t buffer[NETWORK_MIDI_PACKET_SIZE];
+    DatagramAddress from;
+    for (int attempt = 0; attempt < 100; attempt++) {
+        const int size = port.receive(buffer, sizeof(buffer), from);
+        if (size >= 0) {
+            return std::vector<uint8_t>(buffer, buffer + size);
+        }
+        poll();
+    }
+    return {};
+}
+
+static void sendSession(UdpDatagramPort& from, UdpDatagramPort& to, const uint16_t command)
+{
+    uint8_t buffer[64];
+    const size_t size = buildAppleMidiSession(command, 0x55AA, PEER_SSRC, "studio", buffer, sizeof(buffer));
+    from.send(to.address(), buffer, size);
+}
+
+static void sendMIDI(const uint16_t sequence, const uint32_t timestamp, std::initializer_list<uint8_t> midiList)
+{
+    const std::vector<uint8_t> list(midiList);
+    uint8_t buffer[64];
+    const size_t size = buildRtpMidi(sequence, timestamp, PEER_SSRC, list.data(), list.size(), buffer, sizeof(buffer));
+    peerData->send(dataPort->address(), buffer, size);
+}
+
+/** Invite the controller on both ports */
+static void connect()
+{
+    AppleMidiPacket packet;
+    sendSession(*peerControl, *controlPort, APPLE_MIDI_INVITATION);
+    const std::vector<uint8_t> controlReply = receiveReply(*peerControl);
+    TEST_ASSERT_TRUE(parseAppleMidiPacket(controlReply.data(), controlReply.size(), packet));
+    TEST_ASSERT_EQUAL_HEX16(APPLE_MIDI_ACCEPTED, packet.command);
+
+    sendSession(*peerData, *dataPort, APPLE_MIDI_INVITATION);
+    const std::vector<uint8_t> dataReply = receiveReply(*peerData);
+    TEST_ASSERT_TRUE(parseAppleMidiPacket(dataReply.data(), dataReply.size(), packet));
+    TEST_ASSERT_EQUAL_HEX16(APPLE_MIDI_ACCEPTED, packet.command);
+    TEST_ASSERT_EQUAL_HEX32(0x55AA, packet.token);
+    TEST_ASSERT_EQUAL_STRING("M5 MIDI Sky", packet.name);
+}
+
+void setUp()
+{
+    hal = new HostHal();
+    hal->install();
+    controlPort = new UdpDatagramPort();
+    dataPort = new UdpDatagramPort();
+    peerControl = new UdpDatagramPort();
+    peerData = new UdpDatagramPort();
+
+    setupMIDI(0, 0);
+    setSustainEnabled(false);
+    setDebounceGuard(0);
+    setOutputTable(OutputTableSettings());
+    setOutputStrum(0);
+    setupNetworkMIDI("M5 MIDI Sky", controlPort, dataPort);
+    setNetworkJitter(0);
+    refreshOutput();
+    runOutput();
+    resetLatency();
+    hal->hid.reports.clear();
+    startMs = hal->clock.millis();
+    timeline.clear();
+}
+
+void tearDown()
+{
+    setupNetworkMIDI("", nullptr, nullptr);
+    delete peerData;
+    delete peerControl;
+    delete dataPort;
+    delete controlPort;
+    delete hal;
+    hal = nullptr;
+}
+
+void test_parse_running_status_and_delta_times()
+{
+    // Note On C3, running status E3 after 2 ticks, clock (real-time keeps running status), G3 after 3 more ticks
+    const std::vector<uint8_t> packet = {0x80, 0x61, 0x00, 0x07, 0x00, 0x00, 0x10, 0x00, 0x12, 0x34, 0xAB, 0xCD,
+                                         0x0B, 0x90, 48, 100, 0x02, 52, 90, 0x00, 0xF8, 0x03, 55, 80};
+    RtpHeader header;
+
+    TEST_ASSERT_TRUE(parse(packet, header));
+    TEST_ASSERT_EQUAL(7, header.sequence);
+    TEST_ASSERT_EQUAL_HEX32(0x1000, header.timestamp);
+    TEST_ASSERT_EQUAL_HEX32(PEER_SSRC, header.ssrc);
+
+    TEST_ASSERT_EQUAL(4, parsed.size());
+    TEST_ASSERT_EQUAL(0x1000, parsed[0].timestamp);
+    TEST_ASSERT_EQUAL_HEX8(0x90, parsed[1].status);
+    TEST_ASSERT_EQUAL(0x1002, parsed[1].timestamp);
+    TEST_ASSERT_EQUAL_HEX8(0xF8, parsed[2].status);
+    TEST_ASSERT_EQUAL(0, parsed[2].length);
+    TEST_ASSERT_EQUAL_HEX8(0x90, parsed[3].status);
+    TEST_ASSERT_EQUAL(0x1005, parsed[3].timestamp);
+
+    // Data bytes are handed out in place
+    TEST_ASSERT_TRUE(parsed[3].data == packet.data() + 22);
+    TEST_ASSERT_EQUAL(2, parsed[3].length);
+}
+
+void test_parse_long_header_sysex_and_first_delta()
+{
+    // B and Z flags: 12-bit length, first command with a two-byte delta time; a complete SysEx and a Note Off
+    const std::vector<uint8_t> packet = {0x80, 0x61, 0x00, 0x01, 0x00, 0x00, 0x00, 0x10, 0x12, 0x34, 0xAB, 0xCD,
+                                         0xA0, 0x0A, 0x81, 0x00, 0xF0, 0x7E, 0x01, 0xF7, 0x00, 0x80, 48, 0};
+    RtpHeader header;
+
+    TEST_ASSERT_TRUE(parse(packet, header));
+    TEST_ASSERT_EQUAL(2, parsed.size());
+    TEST_ASSERT_EQUAL(0x10 + 128, parsed[0].timestamp);
+    TEST_ASSERT_EQUAL_HEX8(0xF0, parsed[0].status);
+    TEST_ASSERT_EQUAL(3, parsed[0].length);
+    TEST_ASSERT_EQUAL_HEX8(0x80, parsed[1].status);
+}
+
+void test_parse_rejects_malformed_packets()
+{
+    RtpHeader header;
+
+    // Not RTP-MIDI (payload type), truncated command section, data byte without status
+    TEST_ASSERT_FALSE(parse({0x80, 0x60, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0x03, 0x90, 48, 100}, header));
+    TEST_ASSERT_FALSE(parse({0x80, 0x61, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0x05, 0x90, 48, 100}, header));
+    TEST_ASSERT_FALSE(parse({0x80, 0x61, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0x02, 48, 100}, header));
+
+    // Commands before the error are still handed out
+    TEST_ASSERT_FALSE(parse({0x80, 0x61, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0x05, 0x90, 48, 100, 0x00, 0x90}, header));
+    TEST_ASSERT_EQUAL(1, parsed.size());
+}
+
+void test_session_packets_roundtrip()
+{
+    uint8_t buffer[64];
+    AppleMidiPacket packet;
+
+    const size_t size = buildAppleMidiSession(APPLE_MIDI_INVITATION, 42, PEER_SSRC, "studio", buffer, sizeof(buffer));
+    TEST_ASSERT_EQUAL(APPLE_MIDI_INVITATION_SIZE + 7, size);
+    TEST_ASSERT_TRUE(parseAppleMidiPacket(buffer, size, packet));
+    TEST_ASSERT_EQUAL_HEX16(APPLE_MIDI_INVITATION, packet.command);
+    TEST_ASSERT_EQUAL(APPLE_MIDI_PROTOCOL_VERSION, packet.version);
+    TEST_ASSERT_EQUAL(42, packet.token);
+    TEST_ASSERT_EQUAL_HEX32(PEER_SSRC, packet.ssrc);
+    TEST_ASSERT_EQUAL_STRING("studio", packet.name);
+
+    // Name without terminator is not handed out
+    TEST_ASSERT_TRUE(parseAppleMidiPacket(buffer, size - 1, packet));
+    TEST_ASSERT_NULL(packet.name);
+
+    const uint64_t timestamps[3] = {0x0000000100000002ULL, 7, 0};
+    TEST_ASSERT_EQUAL(APPLE_MIDI_SYNC_SIZE, buildAppleMidiSync(PEER_SSRC, 1, timestamps, buffer, sizeof(buffer)));
+    TEST_ASSERT_TRUE(parseAppleMidiPacket(buffer, APPLE_MIDI_SYNC_SIZE, packet));
+    TEST_ASSERT_EQUAL(1, packet.count);
+    TEST_ASSERT_TRUE(packet.timestamps[0] == timestamps[0]);
+    TEST_ASSERT_TRUE(packet.timestamps[1] == 7);
+
+    TEST_ASSERT_FALSE(parseAppleMidiPacket(buffer, APPLE_MIDI_SYNC_SIZE - 1, packet));
+}
+
+void test_sequence_tracker()
+{
+    RtpSequenceTracker tracker;
+
+    TEST_ASSERT_EQUAL(static_cast<int>(RtpSequenceTracker::Result::NEXT), static_cast<int>(tracker.update(0xFFFE)));
+    TEST_ASSERT_EQUAL(static_cast<int>(RtpSequenceTracker::Result::NEXT), static_cast<int>(tracker.update(0xFFFF)));
+    TEST_ASSERT_EQUAL(static_cast<int>(RtpSequenceTracker::Result::GAP), static_cast<int>(tracker.update(2)));
+    TEST_ASSERT_EQUAL(2, tracker.getLost());
+
+    // A skipped packet turning up late is no longer lost
+    TEST_ASSERT_EQUAL(static_cast<int>(RtpSequenceTracker::Result::LATE), static_cast<int>(tracker.update(0)));
+    TEST_ASSERT_EQUAL(1, tracker.getLost());
+}
+
+void test_jitter_buffer_plays_out_in_timestamp_order()
+{
+    RtpJitterBuffer buffer;
+    buffer.setDelay(5000);
+    std::vector<uint8_t> notes;
+    auto dispatch = [&](const RtpJitterBuffer::Event& event) { notes.push_back(event.data[1]); };
+    const uint8_t c3[] = {0x90, 48, 100};
+    const uint8_t e3[] = {0x90, 52, 100};
+    const uint8_t g3[] = {0x90, 55, 100};
+
+    // First packet at peer time 0 received at local 1000 us, the second one (2 ms later) overtaken by a third
+    buffer.beginPacket(0, 1000);
+    TEST_ASSERT_FALSE(buffer.push(0, c3, 3, 0, 1000, dispatch));
+    buffer.beginPacket(40, 5500);
+    TEST_ASSERT_FALSE(buffer.push(40, g3, 3, 0, 5500, dispatch));
+    buffer.beginPacket(20, 5600);
+    TEST_ASSERT_FALSE(buffer.push(20, e3, 3, 0, 5600, dispatch));
+
+    buffer.release(5999, dispatch);
+    TEST_ASSERT_EQUAL(0, notes.size());
+    buffer.release(6000, dispatch);
+    TEST_ASSERT_EQUAL(1, notes.size());
+    buffer.release(8000, dispatch);
+    TEST_ASSERT_EQUAL(2, notes.size());
+    buffer.release(10000, dispatch);
+    TEST_ASSERT_EQUAL(3, notes.size());
+    TEST_ASSERT_EQUAL(52, notes[1]);
+    TEST_ASSERT_EQUAL(55, notes[2]);
+
+    // Later than the delay: due at once
+    buffer.beginPacket(300, 50000);
+    TEST_ASSERT_TRUE(buffer.push(300, c3, 3, 0, 50000, dispatch));
+}
+
+void test_session_reaches_report_with_network_latency()
+{
+    connect();
+
+    // Clock sync: the first timestamp is echoed with ours
+    const uint64_t timestamps[3] = {1234, 0, 0};
+    uint8_t buffer[APPLE_MIDI_SYNC_SIZE];
+    peerData->send(dataPort->address(), buffer, buildAppleMidiSync(PEER_SSRC, 0, timestamps, buffer, sizeof(buffer)));
+    const std::vector<uint8_t> sync = receiveReply(*peerData);
+    AppleMidiPacket packet;
+    TEST_ASSERT_TRUE(parseAppleMidiPacket(sync.data(), sync.size(), packet));
+    TEST_ASSERT_EQUAL(1, packet.count);
+    TEST_ASSERT_TRUE(packet.timestamps[0] == 1234);
+
+    sendMIDI(1, 0, {0x90, 48, 100, 0x00, 52, 100});
+    poll();
+    TEST_ASSERT_EQUAL_STRING("0:5", timeline.c_str());
+
+    // Network probes end in their own stage (the report is marked by the controller backend)
+    markLatency(LatencyStage::REPORT);
+    TEST_ASSERT_EQUAL(1, getLatencyHistogram(LatencyStage::NETWORK).getCount());
+    TEST_ASSERT_EQUAL(0, getLatencyHistogram(LatencyStage::TOTAL).getCount());
+    TEST_ASSERT_EQUAL(0, getLatencyHistogram(LatencyStage::PARSE).getCount());
+
+    const NetworkMidiStatus status = getNetworkMidiStatus();
+    TEST_ASSERT_TRUE(status.connected);
+    TEST_ASSERT_EQUAL_STRING("studio", status.peer);
+    TEST_ASSERT_EQUAL(1, status.packets);
+    TEST_ASSERT_EQUAL(2, status.commands);
+}
+
+void test_packets_from_outside_the_session_are_ignored()
+{
+    sendMIDI(1, 0, {0x90, 48, 100});
+    runFor(2);
+    TEST_ASSERT_EQUAL_STRING("", timeline.c_str());
+
+    // Data port invitation without the control one is rejected
+    sendSession(*peerData, *dataPort, APPLE_MIDI_INVITATION);
+    const std::vector<uint8_t> reply = receiveReply(*peerData);
+    AppleMidiPacket packet;
+    TEST_ASSERT_TRUE(parseAppleMidiPacket(reply.data(), reply.size(), packet));
+    TEST_ASSERT_EQUAL_HEX16(APPLE_MIDI_REJECTED, packet.command);
+}
+
+void test_end_of_session_releases_held_notes()
+{
+    connect();
+    sendMIDI(1, 0, {0x90, 48, 100, 0x00, 55, 100});
+    poll();
+    runFor(5);
+
+    sendSession(*peerControl, *controlPort, APPLE_MIDI_END);
+    runFor(1);
+
+    TEST_ASSERT_EQUAL_STRING("0:11 6:0", timeline.c_str());
+    TEST_ASSERT_FALSE(getNetworkMidiStatus().connected);
+}
+
+void test_jitter_buffer_evens_out_bursts()
+{
+    setNetworkJitter(10);
+    connect();
+
+    // Notes 5 ms apart on the peer clock; the second packet is delayed by 8 ms and overtaken by the third
+    sendMIDI(1, 0, {0x90, 48, 100});
+    poll();
+    runFor(13);
+    sendMIDI(3, 100, {0x90, 55, 100});
+    poll();
+    runFor(1);
+    sendMIDI(2, 50, {0x90, 52, 100});
+    poll();
+    runFor(20);
+
+    // Played out at the peer timing plus the delay, in timestamp order
+    TEST_ASSERT_EQUAL_STRING("10:1 15:5 20:15", timeline.c_str());
+
+    const NetworkMidiStatus status = getNetworkMidiStatus();
+    TEST_ASSERT_EQUAL(1, status.reordered);
+    TEST_ASSERT_EQUAL(0, status.lost);
+    TEST_ASSERT_EQUAL(0, status.late);
+    TEST_ASSERT_EQUAL(10, status.jitterMs);
+}
+
+void test_command_queue_keeps_order()
+{
+    RtpCommandQueue queue;
+    const uint8_t note[] = {0x90, 48, 100};
+    std::vector<uint32_t> received;
+    auto dispatch = [&](const RtpCommandQueue::Command& command) { received.push_back(command.receivedUs); };
+
+    for (uint32_t i = 0; i < RtpCommandQueue::CAPACITY; i++) {
+        TEST_ASSERT_TRUE(queue.push(note, sizeof(note), i));
+    }
+    TEST_ASSERT_FALSE(queue.push(note, sizeof(note), 999));
+
+    queue.drain(dispatch);
+    TEST_ASSERT_TRUE(queue.empty());
+    TEST_ASSERT_EQUAL(RtpCommandQueue::CAPACITY, received.size());
+    TEST_ASSERT_EQUAL(RtpCommandQueue::CAPACITY - 1, received.back());
+
+    // Across the wrap-around of the slots
+    TEST_ASSERT_TRUE(queue.push(note, sizeof(note), 1000));
+    queue.drain(dispatch);
+    TEST_ASSERT_EQUAL(1000, received.back());
+}
+
+void test_commands_wait_for_the_midi_task()
+{
+    connect();
+    sendMIDI(1, 0, {0x90, 48, 100});
+
+    // The network task only queues; nothing is played until the MIDI task takes the command
+    serviceNetworkMIDI();
+    output();
+    TEST_ASSERT_EQUAL_STRING("", timeline.c_str());
+    TEST_ASSERT_EQUAL(1, getNetworkMidiStatus().commands);
+
+    pollNetworkMIDI();
+    output();
+    TEST_ASSERT_EQUAL_STRING("0:1", timeline.c_str());
+}
+
+void test_packets_read_per_poll_are_bounded()
+{
+    connect();
+    for (int i = 0; i < NETWORK_MIDI_PACKETS_PER_POLL + 2; i++) {
+        sendMIDI(static_cast<uint16_t>(i + 1), 0, {0x90, static_cast<uint8_t>(48 + i), 100});
+    }
+
+    // The rest stays in the socket for the next pass
+    serviceNetworkMIDI();
+    TEST_ASSERT_EQUAL(NETWORK_MIDI_PACKETS_PER_POLL, getNetworkMidiStatus().packets);
+    serviceNetworkMIDI();
+    TEST_ASSERT_EQUAL(NETWORK_MIDI_PACKETS_PER_POLL + 2, getNetworkMidiStatus().packets);
+}
+
+int main(int argc, char** argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_parse_running_status_and_delta_times);
+    RUN_TEST(test_parse_long_header_sysex_and_first_delta);
+    RUN_TEST(test_parse_rejects_malformed_packets);
+    RUN_TEST(test_session_packets_roundtrip);
+    RUN_TEST(test_sequence_tracker);
+    RUN_TEST(test_jitter_buffer_plays_out_in_timestamp_order);
+    RUN_TEST(test_session_reaches_report_with_network_latency);
+    RUN_TEST(test_packets_from_outside_the_session_are_ignored);
+    RUN_TEST(test_end_of_session_releases_held_notes);
+    RUN_TEST(test_jitter_buffer_evens_out_bursts);
+    RUN_TEST(test_command_queue_keeps_order);
+    RUN_TEST(test_commands_wait_for_the_midi_task);
+    RUN_TEST(test_packets_read_per_poll_are_bounded);
+    return UNITY_END();
+}
@@ -0,0 +1,266 @@
+#include <unity.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+#include "app/display.h"
+#include "app/hal-host.h"
+#include "app/midi.h"
+#include "app/output.h"
+#include "app/report.h"
+#include "app/settings.h"
+#include "app/telemetry.h"
+
+// Firmware logic from MIDI bytes to controller report, running on the host stand-ins
+
+static HostHal* hal = nullptr;
+
+static void pumpMIDI()
+{
+    while (hal->midiSerial.available() > 0) {
+        pollMIDI();
+    }
+}
+
+// Keys of the last report (0xFFFF if none was sent)
+static uint16_t lastReportKeys()
+{
+    if (hal->hid.reports.empty()) {
+        return 0xFFFF;
+    }
+    return getPressedKeys(hal->hid.reports.back().notes15);
+}
+
+void setUp()
+{
+    hal = new HostHal();
+    hal->install();
+
+    setupMIDI(0, 0);
+    setSustainEnabled(false);
+    setOutputTable(OutputTableSettings());
+
+    // Start from an empty report
+    refreshOutput();
+    runOutput();
+    hal->hid.reports.clear();
+}
+
+void tearDown()
+{
+    delete hal;
+    hal = nullptr;
+}
+
+void test_note_on_sends_report()
+{
+    hal->midiSerial.push({0x90, 48, 100});
+    pumpMIDI();
+    runOutput();
+
+    TEST_ASSERT_EQUAL(1, hal->hid.reports.size());
+    TEST_ASSERT_EQUAL(1, hal->hid.reports.back().mapping);
+    TEST_ASSERT_EQUAL_HEX16(1 << 0, lastReportKeys());
+
+    // No change, no report
+    runOutput();
+    TEST_ASSERT_EQUAL(1, hal->hid.reports.size());
+}
+
+void test_running_status_note_off()
+{
+    hal->midiSerial.push({0x90, 48, 100, 52, 100});
+    pumpMIDI();
+    runOutput();
+    TEST_ASSERT_EQUAL_HEX16((1 << 0) | (1 << 2), lastReportKeys());
+
+    hal->midiSerial.push({48, 0});
+    pumpMIDI();
+    runOutput();
+    TEST_ASSERT_EQUAL_HEX16(1 << 2, lastReportKeys());
+}
+
+void test_midi_thru()
+{
+    hal->midiSerial.push({0x90, 60, 100, 0xF8, 0x80, 60, 0});
+    pumpMIDI();
+
+    const uint8_t expected[] = {0x90, 60, 100, 0xF8, 0x80, 60, 0};
+    TEST_ASSERT_EQUAL(sizeof(expected), hal->midiSerial.output.size());
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, hal->midiSerial.output.data(), sizeof(expected));
+}
+
+void test_sustain_repress_with_fake_clock()
+{
+    Settings settings;
+    SettingsRecord record = settings.toRecord();
+    record.flags = SettingsRecord::FLAG_SUSTAIN;
+    settings.applyRecord(record);
+
+    // Pedal down, key released: note is held
+    hal->midiSerial.push({0xB0, 64, 127, 0x90, 48, 100, 0x80, 48, 0});
+    pumpMIDI();
+    runOutput();
+    TEST_ASSERT_EQUAL_HEX16(1 << 0, lastReportKeys());
+
+    // Re-press: key goes off for REPRESS_KEY_OFF_DURATION_MS so the game sees a new press
+    hal->midiSerial.push({0x90, 48, 100});
+    pumpMIDI();
+    runOutput();
+    TEST_ASSERT_EQUAL_HEX16(0, lastReportKeys());
+
+    hal->clock.advance(49);
+    runOutput();
+    TEST_ASSERT_EQUAL_HEX16(0, lastReportKeys());
+
+    hal->clock.advance(1);
+    runOutput();
+    TEST_ASSERT_EQUAL_HEX16(1 << 0, lastReportKeys());
+
+    // Pedal up keeps the physically pressed key
+    hal->midiSerial.push({0xB0, 64, 0});
+    pumpMIDI();
+    runOutput();
+    TEST_ASSERT_EQUAL_HEX16(1 << 0, lastReportKeys());
+}
+
+void test_settings_buttons_change_mapping()
+{
+    Settings settings;
+
+    // B: select mapping, B: select base note, C: base note up
+    TEST_ASSERT_TRUE(settings.processButtons(false, true, false));
+    TEST_ASSERT_TRUE(settings.processButtons(false, true, false));
+    TEST_ASSERT_TRUE(settings.processButtons(false, false, true));
+    TEST_ASSERT_EQUAL(49, settings.getBaseNote());
+    TEST_ASSERT_EQUAL(3, hal->speaker.tones.size());
+    TEST_ASSERT_EQUAL(2000, static_cast<int>(hal->speaker.tones.back().frequency));
+
+    hal->midiSerial.push({0x90, 49, 100});
+    pumpMIDI();
+    OutputTableSettings table;
+    table.mapping = settings.getMapping();
+    table.baseNote = settings.getBaseNote();
+    table.expand = settings.getExpand();
+    setOutputTable(table);
+    runOutput();
+    TEST_ASSERT_EQUAL_HEX16(1 << 0, lastReportKeys());
+}
+
+void test_mapping_and_base_note_change_together()
+{
+    hal->midiSerial.push({0x90, 50, 100});
+    pumpMIDI();
+    runOutput();
+    hal->hid.reports.clear();
+
+    // The next report uses the new mapping with keys from the new base note, never a mix
+    OutputTableSettings table;
+    table.mapping = 2;
+    table.baseNote = 50;
+    setOutputTable(table);
+    runOutput();
+    TEST_ASSERT_EQUAL(1, hal->hid.reports.size());
+    TEST_ASSERT_EQUAL(2, hal->hid.reports.back().mapping);
+    TEST_ASSERT_EQUAL_HEX16(1 << 0, lastReportKeys());
+}
+
+// Keys of the held notes with the given note table settings
+static uint16_t keysWithTable(const OutputTableSettings& table)
+{
+    setOutputTable(table);
+    runOutput();
+    return lastReportKeys();
+}
+
+void test_table_settings_change_as_one_unit()
+{
+    // In range for both tables, folded only by the new one, and bound to the last key by the new one
+    hal->midiSerial.push({0x90, 52, 100, 0x90, 84, 100, 0x90, 30, 100});
+    pumpMIDI();
+
+    const OutputTableSettings before;
+    OutputTableSettings after;
+    after.mapping = 2;
+    after.baseNote = 50;
+    after.expand = true;
+    after.fold = FoldStrategy::CLAMP;
+    after.split = 60;
+    after.bindings.setNote(14, 30);
+
+    // A table built from the new base note with the old folding and bindings sends different keys
+    OutputTableSettings mixed = before;
+    mixed.baseNote = after.baseNote;
+    const uint16_t keysBefore = keysWithTable(before);
+    const uint16_t keysAfter = keysWithTable(after);
+    const uint16_t keysMixed = keysWithTable(mixed);
+    TEST_ASSERT_NOT_EQUAL(keysBefore, keysAfter);
+    TEST_ASSERT_NOT_EQUAL(keysBefore, keysMixed);
+    TEST_ASSERT_NOT_EQUAL(keysAfter, keysMixed);
+    setOutputTable(before);
+    runOutput();
+    hal->hid.reports.clear();
+
+    // The output task runs while the settings flip back and forth
+    std::atomic<bool> done{false};
+    std::thread output([&done]() {
+        while (!done.load()) {
+            runOutput();
+        }
+    });
+    for (int i = 0; i < 2000; i++) {
+        setOutputTable(i % 2 == 0 ? after : before);
+    }
+    done.store(true);
+    output.join();
+    runOutput();
+
+    TEST_ASSERT_TRUE(hal->hid.reports.size() > 0);
+    for (const RecordingHid::Report& report : hal->hid.reports) {
+        const uint16_t keys = getPressedKeys(report.notes15);
+        if (report.mapping == before.mapping) {
+            TEST_ASSERT_EQUAL_HEX16(keysBefore, keys);
+        } else {
+            TEST_ASSERT_EQUAL(after.mapping, report.mapping);
+            TEST_ASSERT_EQUAL_HEX16(keysAfter, keys);
+        }
+    }
+}
+
+void test_draw_settings()
+{
+    Settings settings;
+    drawSettings(settings);
+
+    TEST_ASSERT_TRUE(hal->display.text.find("Mapping: 1\n") != std::string::npos);
+    TEST_ASSERT_TRUE(hal->display.text.find("Base note: C3 (C/Am)\n") != std::string::npos);
+    TEST_ASSERT_TRUE(hal->display.text.find("Learn: key 1 = -\n") != std::string::npos);
+    TEST_ASSERT_TRUE(hal->display.text.find("Action: key 1 -> 1\n") != std::string::npos);
+    TEST_ASSERT_TRUE(hal->display.drawCalls > 0);
+}
+
+void test_boot_log_uses_clock()
+{
+    logBootPhase("ready");
+
+    const std::string log(hal->console.output.begin(), hal->console.output.end());
+    TEST_ASSERT_EQUAL_STRING("boot ready 1000.000 ms\n", log.c_str());
+}
+
+int main()
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_note_on_sends_report);
+    RUN_TEST(test_running_status_note_off);
+    RUN_TEST(test_midi_thru);
+    RUN_TEST(test_sustain_repress_with_fake_clock);
+    RUN_TEST(test_settings_buttons_change_mapping);
+    RUN_TEST(test_mapping_and_base_note_change_together);
+    RUN_TEST(test_table_settings_change_as_one_unit);
+    RUN_TEST(test_draw_settings);
+    RUN_TEST(test_boot_log_uses_clock);
+
+    UNITY_END();
+}
@@ -0,0 +1,230 @@
+#include <unity.h>
+
+#include <vector>
+
+#include "app/hal-host.h"
+#include "app/midi.h"
+#include "app/output.h"
+#include "app/playback.h"
+#include "app/report.h"
+#include "app/smf-player.h"
+
+// Song playback: double-buffered player and the path into the MIDI input
+
+static HostHal* hal = nullptr;
+
+// Format 0 song at 96 ticks per quarter, 120 bpm: a note every 250 ms, released after 125 ms, stepping through the
+// first three keys from firstNote
+static std::vector<uint8_t> makeSong(const int notes, const uint8_t firstNote = 48)
+{
+    std::vector<uint8_t> track;
+    for (int i = 0; i < notes; i++) {
+        const uint8_t note = static_cast<uint8_t>(firstNote + i % 3 * 2);
+        track.insert(track.end(), {static_cast<uint8_t>(i == 0 ? 0 : 24), 0x90, note, 100, 24, 0x80, note, 0});
+    }
+    track.insert(track.end(), {0x00, 0xFF, 0x2F, 0x00});
+
+    std::vector<uint8_t> song = {'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 0, 0, 1, 0, 96, 'M', 'T', 'r', 'k'};
+    const uint32_t length = static_cast<uint32_t>(track.size());
+    song.insert(song.end(), {static_cast<uint8_t>(length >> 24), static_cast<uint8_t>(length >> 16),
+                             static_cast<uint8_t>(length >> 8), static_cast<uint8_t>(length)});
+    song.insert(song.end(), track.begin(), track.end());
+    return song;
+}
+
+// Keys of the last report (0xFFFF if none was sent)
+static uint16_t lastReportKeys()
+{
+    if (hal->hid.reports.empty()) {
+        return 0xFFFF;
+    }
+    return getPressedKeys(hal->hid.reports.back().notes15);
+}
+
+void setUp()
+{
+    hal = new HostHal();
+    hal->install();
+
+    setupMIDI(0, 0);
+    setOutputTable(OutputTableSettings());
+    refreshOutput();
+    runOutput();
+    hal->hid.reports.clear();
+}
+
+void tearDown()
+{
+    // Leave the player idle for the next test
+    stopPlayback();
+    pollPlayback();
+    fillPlayback();
+
+    delete hal;
+    hal = nullptr;
+}
+
+void test_player_streams_blocks_on_time()
+{
+    const std::vector<uint8_t> song = makeSong(100);
+    MemorySmfSource source(song.data(), song.size());
+    static SmfPlayer player;
+    TEST_ASSERT_TRUE(player.open(source));
+    player.start(1000);
+
+    // 200 events, more than both blocks: the reader refills each block handed back
+    uint32_t nowUs = 1000;
+    int sent = 0;
+    uint32_t previousUs = 0;
+    bool ordered = true;
+    while (!player.isFinished()) {
+        uint32_t delayUs = 0;
+        TEST_ASSERT_TRUE(player.getNextDelay(nowUs, delayUs));
+        nowUs += delayUs;
+        sent += player.dispatch(nowUs, [&](const SmfEvent& event, const uint32_t lateUs) {
+            ordered = ordered && lateUs == 0 && event.timeUs >= previousUs;
+            previousUs = static_cast<uint32_t>(event.timeUs);
+        });
+        if (player.takeReleased()) {
+            player.fill();
+        }
+    }
+    TEST_ASSERT_TRUE(ordered);
+    TEST_ASSERT_EQUAL(200, sent);
+    TEST_ASSERT_EQUAL(200, player.getEvents());
+    TEST_ASSERT_EQUAL(0, player.getUnderruns());
+    TEST_ASSERT_EQUAL(0, player.getLateness().getMax());
+    TEST_ASSERT_EQUAL(1000 + 99 * 250000 + 125000, nowUs);
+}
+
+void test_player_counts_underrun_when_reader_is_late()
+{
+    const std::vector<uint8_t> song = makeSong(100);
+    MemorySmfSource source(song.data(), song.size());
+    static SmfPlayer player;
+    TEST_ASSERT_TRUE(player.open(source));
+    player.start(0);
+
+    // Both read-ahead blocks play out on time (128 events, the last at 63 * 250 ms + 125 ms) without a refill
+    uint32_t nowUs = 0;
+    uint32_t delayUs = 0;
+    int sent = 0;
+    while (player.getNextDelay(nowUs, delayUs)) {
+        nowUs += delayUs;
+        sent += player.dispatch(nowUs, [](const SmfEvent&, uint32_t) {});
+    }
+    const uint32_t endOfBlocksUs = 63 * 250000 + 125000;
+    TEST_ASSERT_EQUAL(2 * SMF_PLAYER_BLOCK_EVENTS, sent);
+    TEST_ASSERT_EQUAL(endOfBlocksUs, nowUs);
+    TEST_ASSERT_TRUE(player.takeReleased());
+    TEST_ASSERT_EQUAL(1, player.getUnderruns());
+    TEST_ASSERT_EQUAL(0, player.dispatch(endOfBlocksUs + 300000, [](const SmfEvent&, uint32_t) {}));
+    TEST_ASSERT_EQUAL(1, player.getUnderruns());
+    TEST_ASSERT_EQUAL(0, player.getLateness().getMax());
+
+    // Once read, the waiting events go out late
+    TEST_ASSERT_TRUE(player.fill());
+    uint32_t maxLateUs = 0;
+    TEST_ASSERT_EQUAL(2, player.dispatch(endOfBlocksUs + 300000, [&](const SmfEvent&, const uint32_t lateUs) {
+        maxLateUs = lateUs > maxLateUs ? lateUs : maxLateUs;
+    }));
+    TEST_ASSERT_EQUAL(175000, maxLateUs);
+    TEST_ASSERT_EQUAL(175000, player.getLateness().getMax());
+    TEST_ASSERT_EQUAL(1, player.getUnderruns());
+}
+
+void test_player_rejects_bad_file()
+{
+    const uint8_t data[] = {'R', 'I', 'F', 'F', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+    MemorySmfSource source(data, sizeof(data));
+    static SmfPlayer player;
+    TEST_ASSERT_FALSE(player.open(source));
+}
+
+void test_playback_through_pipeline_with_transpose()
+{
+    // D major scale from D3 with the base note on D3: first note on the first key
+    OutputTableSettings table;
+    table.baseNote = 50;
+    setOutputTable(table);
+    runOutput();
+    hal->hid.reports.clear();
+
+    const std::vector<uint8_t> song = makeSong(2, 50);
+    MemorySmfSource source(song.data(), song.size());
+    TEST_ASSERT_TRUE(startPlayback(source));
+    TEST_ASSERT_FALSE(startPlayback(source));
+    TEST_ASSERT_EQUAL(PlaybackState::LOADING, getPlaybackStatus().state);
+    fillPlayback();
+    TEST_ASSERT_NULL(getPlaybackError());
+    TEST_ASSERT_EQUAL(PlaybackState::PLAYING, getPlaybackStatus().state);
+
+    // Nothing before the lead-in has passed
+    pollPlayback();
+    runOutput();
+    TEST_ASSERT_EQUAL(0, hal->hid.reports.size());
+
+    hal->clock.advanceMicros(SMF_PLAYER_LEAD_US);
+    pollPlayback();
+    runOutput();
+    TEST_ASSERT_EQUAL_HEX16(1 << 0, lastReportKeys());
+
+    hal->clock.advance(125);
+    pollPlayback();
+    runOutput();
+    TEST_ASSERT_EQUAL_HEX16(0, lastReportKeys());
+
+    // Second note 2 ms late
+    hal->clock.advance(127);
+    pollPlayback();
+    runOutput();
+    TEST_ASSERT_EQUAL_HEX16(1 << 1, lastReportKeys());
+
+    hal->clock.advance(125);
+    pollPlayback();
+    runOutput();
+    TEST_ASSERT_EQUAL_HEX16(0, lastReportKeys());
+
+    // End of the song: the reader closes it
+    TEST_ASSERT_EQUAL(PlaybackState::CLOSING, getPlaybackStatus().state);
+    fillPlayback();
+    const PlaybackStatus status = getPlaybackStatus();
+    TEST_ASSERT_EQUAL(PlaybackState::IDLE, status.state);
+    TEST_ASSERT_EQUAL(4, status.events);
+    TEST_ASSERT_EQUAL(0, status.underruns);
+    TEST_ASSERT_EQUAL(2000, status.lateness.getMax());
+}
+
+void test_stop_releases_held_notes()
+{
+    const std::vector<uint8_t> song = makeSong(4, 48);
+    MemorySmfSource source(song.data(), song.size());
+    TEST_ASSERT_TRUE(startPlayback(source));
+    fillPlayback();
+
+    hal->clock.advanceMicros(SMF_PLAYER_LEAD_US);
+    pollPlayback();
+    runOutput();
+    TEST_ASSERT_EQUAL_HEX16(1 << 0, lastReportKeys());
+
+    TEST_ASSERT_TRUE(stopPlayback());
+    TEST_ASSERT_FALSE(stopPlayback());
+    pollPlayback();
+    runOutput();
+    TEST_ASSERT_EQUAL_HEX16(0, lastReportKeys());
+
+    fillPlayback();
+    TEST_ASSERT_EQUAL(PlaybackState::IDLE, getPlaybackStatus().state);
+    TEST_ASSERT_EQUAL(1, getPlaybackStatus().events);
+}
+
+int main(int argc, char** argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_player_streams_blocks_on_time);
+    RUN_TEST(test_player_counts_underrun_when_reader_is_late);
+    RUN_TEST(test_player_rejects_bad_file);
+    RUN_TEST(test_playback_through_pipeline_with_transpose);
+    RUN_TEST(test_stop_releases_held_notes);
+    return UNITY_END();
+}
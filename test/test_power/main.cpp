@@ -0,0 +1,185 @@
+#include <unity.h>
+
+#include "app/hal-host.h"
+#include "app/latency.h"
+#include "app/midi.h"
+#include "app/output.h"
+#include "app/power.h"
+#include "app/report.h"
+
+// Idle power mode: clock changes on the fake clock and the latency of the note that wakes the controller
+
+static HostHal* hal = nullptr;
+
+static constexpr uint32_t TIMEOUT_S = 10;
+
+/** Run the MIDI task once */
+static void tick()
+{
+    pollMIDI();
+    pollPower();
+}
+
+static void idle()
+{
+    hal->clock.advance(TIMEOUT_S * 1000);
+    tick();
+}
+
+void setUp()
+{
+    hal = new HostHal();
+    hal->install();
+
+    setupMIDI(0, 0);
+    setSustainEnabled(false);
+    setDebounceGuard(0);
+    setOutputTable(OutputTableSettings());
+    setupPower(TIMEOUT_S);
+    refreshOutput();
+    runOutput();
+    resetLatency();
+    hal->hid.reports.clear();
+    hal->power.changes.clear();
+}
+
+void tearDown()
+{
+    delete hal;
+    hal = nullptr;
+}
+
+void test_idle_after_timeout()
+{
+    hal->clock.advance(TIMEOUT_S * 1000 - 1);
+    tick();
+    TEST_ASSERT_EQUAL(static_cast<int>(PowerState::ACTIVE), static_cast<int>(getPowerState()));
+    TEST_ASSERT_EQUAL(0, hal->power.changes.size());
+
+    hal->clock.advance(1);
+    tick();
+    TEST_ASSERT_EQUAL(static_cast<int>(PowerState::IDLE), static_cast<int>(getPowerState()));
+    TEST_ASSERT_EQUAL(POWER_IDLE_MHZ, hal->power.cpuMhz);
+
+    // Stays idle without changing the clock again
+    idle();
+    TEST_ASSERT_EQUAL(1, hal->power.changes.size());
+}
+
+void test_timeout_zero_never_idles()
+{
+    setupPower(0);
+    hal->clock.advance(3600000);
+    tick();
+
+    TEST_ASSERT_EQUAL(static_cast<int>(PowerState::ACTIVE), static_cast<int>(getPowerState()));
+    TEST_ASSERT_EQUAL(0, hal->power.changes.size());
+}
+
+void test_notes_keep_active()
+{
+    for (int i = 0; i < 3; i++) {
+        hal->clock.advance(TIMEOUT_S * 1000 - 1);
+        hal->midiSerial.push({0x90, 48, 100, 0x80, 48, 0});
+        tick();
+    }
+
+    TEST_ASSERT_EQUAL(static_cast<int>(PowerState::ACTIVE), static_cast<int>(getPowerState()));
+}
+
+void test_real_time_messages_do_not_wake()
+{
+    idle();
+
+    // Timing clock and active sensing from an idle keyboard or sequencer
+    hal->midiSerial.push({0xF8, 0xFE});
+    tick();
+
+    TEST_ASSERT_EQUAL(static_cast<int>(PowerState::IDLE), static_cast<int>(getPowerState()));
+    TEST_ASSERT_EQUAL(POWER_IDLE_MHZ, hal->power.cpuMhz);
+}
+
+void test_note_wakes_before_output()
+{
+    idle();
+
+    hal->midiSerial.push({0x90, 48, 100});
+    pollMIDI();
+
+    // The clock is raised by the MIDI task before the output task sees the note
+    TEST_ASSERT_EQUAL(static_cast<int>(PowerState::ACTIVE), static_cast<int>(getPowerState()));
+    TEST_ASSERT_EQUAL(POWER_ACTIVE_MHZ, hal->power.cpuMhz);
+    TEST_ASSERT_EQUAL(1, getPowerStatus().wakes);
+
+    hal->clock.advanceMicros(300);
+    runOutput();
+    TEST_ASSERT_EQUAL(1, hal->hid.reports.size());
+    TEST_ASSERT_EQUAL_HEX16(1 << 0, getPressedKeys(hal->hid.reports.back().notes15));
+
+    // Wake probes end in the wake stage and the total (the report is marked by the controller backend)
+    markLatency(LatencyStage::REPORT);
+    TEST_ASSERT_EQUAL(1, getLatencyHistogram(LatencyStage::WAKE).getCount());
+    TEST_ASSERT_EQUAL(1, getLatencyHistogram(LatencyStage::TOTAL).getCount());
+    TEST_ASSERT_EQUAL(1, getLatencyHistogram(LatencyStage::PARSE).getCount());
+    TEST_ASSERT_EQUAL(getLatencyHistogram(LatencyStage::TOTAL).getMax(),
+                      getLatencyHistogram(LatencyStage::WAKE).getMax());
+
+    // Later notes are not wake probes
+    hal->midiSerial.push({0x80, 48, 0});
+    tick();
+    runOutput();
+    markLatency(LatencyStage::REPORT);
+    TEST_ASSERT_EQUAL(1, getLatencyHistogram(LatencyStage::WAKE).getCount());
+    TEST_ASSERT_EQUAL(2, getLatencyHistogram(LatencyStage::TOTAL).getCount());
+}
+
+void test_button_wakes_on_next_tick()
+{
+    idle();
+
+    notePowerActivity();
+    TEST_ASSERT_EQUAL(static_cast<int>(PowerState::IDLE), static_cast<int>(getPowerState()));
+
+    pollPower();
+    TEST_ASSERT_EQUAL(static_cast<int>(PowerState::ACTIVE), static_cast<int>(getPowerState()));
+    TEST_ASSERT_EQUAL(POWER_ACTIVE_MHZ, hal->power.cpuMhz);
+    TEST_ASSERT_EQUAL(1, getPowerStatus().wakes);
+}
+
+void test_battery_current_per_state()
+{
+    hal->power.current = -120;
+    hal->clock.advance(POWER_SAMPLE_INTERVAL_MS);
+    samplePower();
+    TEST_ASSERT_EQUAL(-120, getPowerStatus().activeMa);
+
+    idle();
+    hal->power.current = -85;
+
+    // Not settled yet
+    samplePower();
+    TEST_ASSERT_EQUAL(0, getPowerStatus().idleMa);
+
+    hal->clock.advance(POWER_SAMPLE_INTERVAL_MS);
+    samplePower();
+    const PowerStatus status = getPowerStatus();
+    TEST_ASSERT_EQUAL(-85, status.idleMa);
+    TEST_ASSERT_EQUAL(-120, status.activeMa);
+    TEST_ASSERT_EQUAL(POWER_IDLE_MHZ, status.cpuMhz);
+    TEST_ASSERT_EQUAL(TIMEOUT_S, status.timeoutS);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_idle_after_timeout);
+    RUN_TEST(test_timeout_zero_never_idles);
+    RUN_TEST(test_notes_keep_active);
+    RUN_TEST(test_real_time_messages_do_not_wake);
+    RUN_TEST(test_note_wakes_before_output);
+    RUN_TEST(test_button_wakes_on_next_tick);
+    RUN_TEST(test_battery_current_per_state);
+
+    UNITY_END();
+}
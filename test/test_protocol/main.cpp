@@ -0,0 +1,543 @@
+#include <unity.h>
+#include "../src/app/protocol.h"
+
+void test_parse_get()
+{
+    Command command;
+
+    TEST_ASSERT_TRUE(parseCommand("get", command));
+    TEST_ASSERT_EQUAL(static_cast<int>(CommandType::GET), static_cast<int>(command.type));
+}
+
+void test_parse_net()
+{
+    Command command;
+
+    TEST_ASSERT_TRUE(parseCommand("net", command));
+    TEST_ASSERT_EQUAL(static_cast<int>(CommandType::NET), static_cast<int>(command.type));
+}
+
+void test_parse_sources()
+{
+    Command command;
+
+    TEST_ASSERT_TRUE(parseCommand("sources", command));
+    TEST_ASSERT_EQUAL(static_cast<int>(CommandType::SOURCES), static_cast<int>(command.type));
+}
+
+void test_parse_power()
+{
+    Command command;
+
+    TEST_ASSERT_TRUE(parseCommand("power", command));
+    TEST_ASSERT_EQUAL(static_cast<int>(CommandType::POWER), static_cast<int>(command.type));
+}
+
+void test_parse_loopback()
+{
+    Command command;
+
+    TEST_ASSERT_TRUE(parseCommand("loopback", command));
+    TEST_ASSERT_EQUAL(static_cast<int>(CommandType::LOOPBACK), static_cast<int>(command.type));
+    TEST_ASSERT_EQUAL(static_cast<int>(LoopbackAction::STATUS), static_cast<int>(command.loopbackAction));
+    TEST_ASSERT_TRUE(parseCommand("loopback start", command));
+    TEST_ASSERT_EQUAL(static_cast<int>(LoopbackAction::START), static_cast<int>(command.loopbackAction));
+    TEST_ASSERT_TRUE(parseCommand("loopback stop", command));
+    TEST_ASSERT_EQUAL(static_cast<int>(LoopbackAction::STOP), static_cast<int>(command.loopbackAction));
+    TEST_ASSERT_FALSE(parseCommand("loopback fast", command));
+}
+
+void test_parse_map()
+{
+    Command command;
+
+    TEST_ASSERT_TRUE(parseCommand("map", command));
+    TEST_ASSERT_EQUAL(static_cast<int>(CommandType::MAP), static_cast<int>(command.type));
+    TEST_ASSERT_EQUAL(static_cast<int>(MapAction::SHOW), static_cast<int>(command.mapAction));
+    TEST_ASSERT_TRUE(parseCommand("map reset", command));
+    TEST_ASSERT_EQUAL(static_cast<int>(MapAction::RESET), static_cast<int>(command.mapAction));
+
+    TEST_ASSERT_TRUE(parseCommand("map 15 note=72 action=3", command));
+    TEST_ASSERT_EQUAL(static_cast<int>(MapAction::SET), static_cast<int>(command.mapAction));
+    TEST_ASSERT_EQUAL(14, command.mapKey);
+    TEST_ASSERT_EQUAL(72, command.mapNote);
+    TEST_ASSERT_EQUAL(2, command.mapTarget);
+
+    Command unset;
+    TEST_ASSERT_TRUE(parseCommand("map 2 note=-", unset));
+    TEST_ASSERT_EQUAL(-1, unset.mapNote);
+    TEST_ASSERT_EQUAL(MAP_KEEP, unset.mapTarget);
+
+    TEST_ASSERT_FALSE(parseCommand("map 0 note=60", command));
+    TEST_ASSERT_FALSE(parseCommand("map 1", command));
+    TEST_ASSERT_FALSE(parseCommand("map 1 note=128", command));
+    TEST_ASSERT_FALSE(parseCommand("map 1 action=16", command));
+    TEST_ASSERT_FALSE(parseCommand("map 1 velocity=3", command));
+}
+
+void test_apply_map_command()
+{
+    SettingsRecord current;
+    current.mapping = 2;
+    current.bindings.setNote(0, 72);
+    Command command;
+
+    TEST_ASSERT_TRUE(parseCommand("map 2 note=72 action=1", command));
+    SettingsRecord record = applyMapCommand(current, command);
+    TEST_ASSERT_EQUAL(2, record.mapping);
+    TEST_ASSERT_EQUAL(-1, record.bindings.getNote(0));
+    TEST_ASSERT_EQUAL(72, record.bindings.getNote(1));
+    TEST_ASSERT_EQUAL(0, record.bindings.getAction(1));
+
+    // action=- restores the key's own action
+    TEST_ASSERT_TRUE(parseCommand("map 2 action=-", command));
+    record = applyMapCommand(record, command);
+    TEST_ASSERT_EQUAL(1, record.bindings.getAction(1));
+    TEST_ASSERT_EQUAL(72, record.bindings.getNote(1));
+
+    TEST_ASSERT_TRUE(parseCommand("map reset", command));
+    TEST_ASSERT_TRUE(applyMapCommand(record, command).bindings == KeyBindings());
+}
+
+void test_settings_commands_merge_into_live_settings()
+{
+    SettingsRecord live;
+    live.baseNote = 50;
+    live.bindings.setNote(3, 40);
+    Command command;
+
+    // A binding learned on the device meanwhile stays next to the one set over serial
+    TEST_ASSERT_TRUE(parseCommand("map 1 note=72", command));
+    SettingsRecord record = applySettingsCommand(live, command);
+    TEST_ASSERT_EQUAL(72, record.bindings.getNote(0));
+    TEST_ASSERT_EQUAL(40, record.bindings.getNote(3));
+    TEST_ASSERT_EQUAL(50, record.baseNote);
+
+    TEST_ASSERT_TRUE(parseCommand("set strum=8", command));
+    record = applySettingsCommand(record, command);
+    TEST_ASSERT_EQUAL(8, record.strum);
+    TEST_ASSERT_EQUAL(72, record.bindings.getNote(0));
+}
+
+void test_parse_set_multiple_fields()
+{
+    Command command;
+
+    TEST_ASSERT_TRUE(parseCommand("set mapping=2 basenote=50 expand=on sustain=0", command));
+    TEST_ASSERT_EQUAL(static_cast<int>(CommandType::SET), static_cast<int>(command.type));
+    TEST_ASSERT_EQUAL(SETTING_FIELD_MAPPING | SETTING_FIELD_BASENOTE | SETTING_FIELD_EXPAND | SETTING_FIELD_SUSTAIN,
+                      command.fields);
+    TEST_ASSERT_EQUAL(2, command.values.mapping);
+    TEST_ASSERT_EQUAL(50, command.values.baseNote);
+    TEST_ASSERT_EQUAL(SettingsRecord::FLAG_EXPAND, command.values.flags);
+}
+
+void test_parse_set_rejects_whole_line_on_error()
+{
+    Command command;
+
+    TEST_ASSERT_FALSE(parseCommand("set mapping=2 basenote=abc", command));
+    TEST_ASSERT_NOT_NULL(command.error);
+    TEST_ASSERT_FALSE(parseCommand("set mapping", command));
+    TEST_ASSERT_FALSE(parseCommand("set volume=3", command));
+    TEST_ASSERT_FALSE(parseCommand("set", command));
+    TEST_ASSERT_FALSE(parseCommand("set basenote=128", command));
+}
+
+void test_parse_stream()
+{
+    Command command;
+
+    TEST_ASSERT_TRUE(parseCommand("stream 500", command));
+    TEST_ASSERT_EQUAL(static_cast<int>(CommandType::STREAM), static_cast<int>(command.type));
+    TEST_ASSERT_EQUAL(500, command.interval);
+    TEST_ASSERT_FALSE(parseCommand("stream", command));
+    TEST_ASSERT_FALSE(parseCommand("stream -1", command));
+}
+
+void test_parse_unknown()
+{
+    Command command;
+
+    TEST_ASSERT_FALSE(parseCommand("reboot", command));
+    TEST_ASSERT_FALSE(parseCommand("   ", command));
+}
+
+void test_parse_latency()
+{
+    Command command;
+
+    TEST_ASSERT_TRUE(parseCommand("latency", command));
+    TEST_ASSERT_EQUAL(static_cast<int>(CommandType::LATENCY), static_cast<int>(command.type));
+    TEST_ASSERT_EQUAL(static_cast<int>(LatencyAction::SHOW), static_cast<int>(command.latencyAction));
+    TEST_ASSERT_TRUE(parseCommand("latency overlay on", command));
+    TEST_ASSERT_EQUAL(static_cast<int>(LatencyAction::OVERLAY_ON), static_cast<int>(command.latencyAction));
+    TEST_ASSERT_TRUE(parseCommand("latency reset", command));
+    TEST_ASSERT_EQUAL(static_cast<int>(LatencyAction::RESET), static_cast<int>(command.latencyAction));
+    TEST_ASSERT_FALSE(parseCommand("latency overlay", command));
+    TEST_ASSERT_FALSE(parseCommand("latency clear", command));
+}
+
+void test_parse_trace()
+{
+    Command command;
+
+    TEST_ASSERT_TRUE(parseCommand("trace", command));
+    TEST_ASSERT_EQUAL(static_cast<int>(CommandType::TRACE), static_cast<int>(command.type));
+    TEST_ASSERT_EQUAL(static_cast<int>(TraceAction::DUMP), static_cast<int>(command.traceAction));
+    TEST_ASSERT_TRUE(parseCommand("trace clear", command));
+    TEST_ASSERT_EQUAL(static_cast<int>(TraceAction::CLEAR), static_cast<int>(command.traceAction));
+    TEST_ASSERT_TRUE(parseCommand("trace off", command));
+    TEST_ASSERT_EQUAL(static_cast<int>(TraceAction::OFF), static_cast<int>(command.traceAction));
+    TEST_ASSERT_FALSE(parseCommand("trace reset", command));
+}
+
+void test_parse_play()
+{
+    Command command;
+
+    TEST_ASSERT_TRUE(parseCommand("play", command));
+    TEST_ASSERT_EQUAL(static_cast<int>(CommandType::PLAY), static_cast<int>(command.type));
+    TEST_ASSERT_EQUAL(static_cast<int>(PlayAction::STATUS), static_cast<int>(command.playAction));
+    TEST_ASSERT_TRUE(parseCommand("play stop", command));
+    TEST_ASSERT_EQUAL(static_cast<int>(PlayAction::STOP), static_cast<int>(command.playAction));
+    TEST_ASSERT_TRUE(parseCommand("play /songs/dawn.mid", command));
+    TEST_ASSERT_EQUAL(static_cast<int>(PlayAction::START), static_cast<int>(command.playAction));
+    TEST_ASSERT_EQUAL_STRING("songs/dawn.mid", command.song);
+    TEST_ASSERT_FALSE(parseCommand("play /", command));
+    TEST_ASSERT_FALSE(parseCommand("play a-song-name-longer-than-the-limit.mid", command));
+}
+
+void test_apply_setting_fields_keeps_unset_fields()
+{
+    SettingsRecord current;
+    current.mapping = 1;
+    current.baseNote = 48;
+    current.flags = SettingsRecord::FLAG_SUSTAIN | SettingsRecord::FLAG_EXPAND;
+
+    Command command;
+    TEST_ASSERT_TRUE(parseCommand("set basenote=60 expand=0", command));
+    const SettingsRecord record = applySettingFields(current, command);
+
+    TEST_ASSERT_EQUAL(1, record.mapping);
+    TEST_ASSERT_EQUAL(60, record.baseNote);
+    TEST_ASSERT_EQUAL(SettingsRecord::FLAG_SUSTAIN, record.flags);
+
+    TEST_ASSERT_TRUE(parseCommand("set autokey=on", command));
+    TEST_ASSERT_EQUAL(SettingsRecord::FLAG_SUSTAIN | SettingsRecord::FLAG_EXPAND | SettingsRecord::FLAG_AUTO_KEY,
+                      applySettingFields(current, command).flags);
+
+    TEST_ASSERT_TRUE(parseCommand("set strum=8", command));
+    TEST_ASSERT_EQUAL(8, applySettingFields(current, command).strum);
+    TEST_ASSERT_EQUAL(48, applySettingFields(current, command).baseNote);
+
+    TEST_ASSERT_TRUE(parseCommand("set fold=clamp split=60", command));
+    TEST_ASSERT_EQUAL(static_cast<uint8_t>(FoldStrategy::CLAMP), applySettingFields(current, command).fold);
+    TEST_ASSERT_EQUAL(60, applySettingFields(current, command).split);
+    TEST_ASSERT_FALSE(parseCommand("set fold=wrap", command));
+    TEST_ASSERT_EQUAL_STRING("bad setting", command.error);
+    TEST_ASSERT_FALSE(parseCommand("set split=128", command));
+
+    TEST_ASSERT_TRUE(parseCommand("set debounce=6", command));
+    TEST_ASSERT_EQUAL(6, applySettingFields(current, command).debounce);
+    TEST_ASSERT_EQUAL(SETTING_FIELD_DEBOUNCE, command.fields);
+
+    TEST_ASSERT_TRUE(parseCommand("set jitter=4", command));
+    TEST_ASSERT_EQUAL(4, applySettingFields(current, command).jitter);
+    TEST_ASSERT_EQUAL(SETTING_FIELD_JITTER, command.fields);
+
+    TEST_ASSERT_TRUE(parseCommand("set conflict=neutral", command));
+    TEST_ASSERT_EQUAL(static_cast<uint8_t>(ConflictPolicy::NEUTRAL), applySettingFields(current, command).conflict);
+    TEST_ASSERT_EQUAL(SETTING_FIELD_CONFLICT, command.fields);
+    TEST_ASSERT_FALSE(parseCommand("set conflict=bogus", command));
+    TEST_ASSERT_EQUAL_STRING("bad setting", command.error);
+}
+
+void test_set_keeps_fields_changed_meanwhile()
+{
+    SettingsRecord snapshot;
+    snapshot.mapping = 1;
+    Command command;
+    TEST_ASSERT_TRUE(parseCommand("set basenote=50", command));
+
+    // A binding learned and the mapping changed on the device after the snapshot was taken
+    SettingsRecord live = snapshot;
+    live.mapping = 3;
+    live.bindings.setNote(2, 30);
+
+    const SettingsRecord record = applySettingFields(live, command);
+    TEST_ASSERT_EQUAL(50, record.baseNote);
+    TEST_ASSERT_EQUAL(3, record.mapping);
+    TEST_ASSERT_EQUAL(30, record.bindings.getNote(2));
+}
+
+void test_format_settings()
+{
+    SettingsRecord record;
+    record.mapping = 2;
+    record.baseNote = 53;
+    record.flags = SettingsRecord::FLAG_EXPAND;
+    record.strum = 12;
+    record.fold = static_cast<uint8_t>(FoldStrategy::DROP);
+    record.split = 60;
+    record.jitter = 4;
+    record.conflict = static_cast<uint8_t>(ConflictPolicy::FIRST);
+    char buffer[160];
+
+    formatSettings(record, buffer, sizeof(buffer));
+
+    TEST_ASSERT_EQUAL_STRING("mapping=2 basenote=53 expand=1 sustain=0 autokey=0 strum=12 fold=drop split=60 "
+                             "debounce=0 jitter=4 conflict=first", buffer);
+}
+
+void test_format_telemetry()
+{
+    Telemetry telemetry;
+    telemetry.counters[static_cast<int>(Counter::NOTE_ON)] = 7;
+    char buffer[128];
+
+    formatTelemetry(telemetry, buffer, sizeof(buffer));
+    TEST_ASSERT_EQUAL_STRING("midi=0 noteon=7 noteoff=0 cc=0 reports=0 dropped=0 rxovf=0 rxfull=0 rxerr=0 "
+                             "dbldrop=0 blipdrop=0", buffer);
+
+    // Truncated output stays terminated
+    char small[10];
+    TEST_ASSERT_EQUAL(9, formatTelemetry(telemetry, small, sizeof(small)));
+    TEST_ASSERT_EQUAL_STRING("midi=0 no", small);
+}
+
+void test_format_latency()
+{
+    LatencyHistogram histogram;
+    histogram.record(100);
+    histogram.record(300);
+    char buffer[PROTOCOL_MAX_LINE];
+
+    formatLatency(LatencyStage::TOTAL, histogram, buffer, sizeof(buffer));
+
+    TEST_ASSERT_EQUAL_STRING("total n=2 p50=111 p99=300 max=300", buffer);
+}
+
+void test_format_playback_status()
+{
+    PlaybackStatus status;
+    status.state = PlaybackState::PLAYING;
+    strcpy(status.name, "dawn.mid");
+    status.events = 42;
+    status.lateness.record(100);
+    status.lateness.record(300);
+    char buffer[PROTOCOL_MAX_LINE];
+
+    formatPlaybackStatus(status, buffer, sizeof(buffer));
+
+    TEST_ASSERT_EQUAL_STRING("state=playing song=dawn.mid events=42 underruns=0 late_p50=111 late_p99=300 "
+                             "late_max=300", buffer);
+}
+
+void test_format_network_midi_status()
+{
+    NetworkMidiStatus status;
+    status.connected = true;
+    strcpy(status.peer, "studio");
+    status.packets = 12;
+    status.commands = 30;
+    status.lost = 1;
+    status.jitterMs = 4;
+    char buffer[128];
+
+    formatNetworkMidiStatus(status, buffer, sizeof(buffer));
+
+    TEST_ASSERT_EQUAL_STRING("session=1 peer=studio packets=12 commands=30 lost=1 reordered=0 late=0 jitter=4",
+                             buffer);
+}
+
+void test_format_midi_source_stats()
+{
+    MidiSourceStats stats;
+    stats.bytes = 300;
+    stats.messages = 100;
+    stats.foreignOffs = 2;
+    stats.held = 3;
+    char buffer[PROTOCOL_MAX_LINE];
+
+    formatMidiSourceStats(MidiSource::DIN2, stats, buffer, sizeof(buffer));
+
+    TEST_ASSERT_EQUAL_STRING("din2 bytes=300 messages=100 foreign=2 held=3", buffer);
+}
+
+void test_format_power_status()
+{
+    PowerStatus status;
+    status.state = PowerState::IDLE;
+    status.cpuMhz = POWER_IDLE_MHZ;
+    status.timeoutS = 60;
+    status.activeMa = -120;
+    status.idleMa = -85;
+    status.wakes = 2;
+    LatencyHistogram wake;
+    wake.record(5);
+    wake.record(7);
+    char buffer[128];
+
+    formatPowerStatus(status, wake, buffer, sizeof(buffer));
+
+    TEST_ASSERT_EQUAL_STRING("state=idle mhz=80 timeout=60 active_ma=-120 idle_ma=-85 wakes=2 wake_p50=5 wake_max=7",
+                             buffer);
+}
+
+void test_format_key_binding()
+{
+    KeyBindings bindings;
+    bindings.setNote(0, 60);
+    bindings.setAction(0, 4);
+    char buffer[PROTOCOL_MAX_LINE];
+
+    formatKeyBinding(bindings, 0, buffer, sizeof(buffer));
+    TEST_ASSERT_EQUAL_STRING("key=1 note=60 action=5", buffer);
+    formatKeyBinding(bindings, 14, buffer, sizeof(buffer));
+    TEST_ASSERT_EQUAL_STRING("key=15 note=- action=15", buffer);
+}
+
+void test_line_reader()
+{
+    LineReader reader;
+    const char* input = "get\r\nstats\n";
+    int lines = 0;
+
+    for (const char* p = input; *p != '\0'; p++) {
+        if (reader.feed(*p)) {
+            lines++;
+            TEST_ASSERT_EQUAL_STRING(lines == 1 ? "get" : "stats", reader.line());
+        }
+    }
+    TEST_ASSERT_EQUAL(2, lines);
+}
+
+void test_line_reader_overflow()
+{
+    LineReader reader;
+
+    for (size_t i = 0; i < PROTOCOL_MAX_LINE * 2; i++) {
+        TEST_ASSERT_FALSE(reader.feed('x'));
+    }
+    TEST_ASSERT_TRUE(reader.feed('\n'));
+    TEST_ASSERT_TRUE(reader.overflow());
+
+    // Next line is read normally
+    reader.feed('g');
+    reader.feed('e');
+    reader.feed('t');
+    TEST_ASSERT_TRUE(reader.feed('\n'));
+    TEST_ASSERT_FALSE(reader.overflow());
+    TEST_ASSERT_EQUAL_STRING("get", reader.line());
+}
+
+// Feed a line byte by byte, as the command task does
+static void feedLine(LineReader& reader, const char* line)
+{
+    for (const char* p = line; *p != '\0'; p++) {
+        TEST_ASSERT_FALSE(reader.feed(*p));
+    }
+    TEST_ASSERT_TRUE(reader.feed('\n'));
+}
+
+void test_worst_case_set_line_fits()
+{
+    LineReader reader;
+    feedLine(reader, SETTINGS_WORST_CASE_SET_LINE);
+    TEST_ASSERT_FALSE(reader.overflow());
+
+    Command command;
+    TEST_ASSERT_TRUE(parseCommand(reader.line(), command));
+    TEST_ASSERT_EQUAL(CommandType::SET, command.type);
+    TEST_ASSERT_EQUAL(255, command.values.jitter);
+    TEST_ASSERT_EQUAL(static_cast<uint8_t>(ConflictPolicy::NEUTRAL), command.values.conflict);
+}
+
+void test_documented_set_example_fits()
+{
+    // The set example of the README
+    LineReader reader;
+    feedLine(reader, "set mapping=2 basenote=50 expand=1 sustain=0 autokey=1 strum=8 fold=clamp split=60 debounce=6 "
+                     "jitter=4 conflict=neutral");
+    TEST_ASSERT_FALSE(reader.overflow());
+
+    Command command;
+    TEST_ASSERT_TRUE(parseCommand(reader.line(), command));
+    TEST_ASSERT_EQUAL(CommandType::SET, command.type);
+    TEST_ASSERT_EQUAL(6, command.values.debounce);
+    TEST_ASSERT_EQUAL(4, command.values.jitter);
+    TEST_ASSERT_EQUAL(static_cast<uint8_t>(ConflictPolicy::NEUTRAL), command.values.conflict);
+}
+
+void test_get_reply_round_trips_as_set_line()
+{
+    SettingsRecord record;
+    record.mapping = 255;
+    record.baseNote = 127;
+    record.flags = SettingsRecord::FLAG_EXPAND | SettingsRecord::FLAG_SUSTAIN | SettingsRecord::FLAG_AUTO_KEY;
+    record.strum = 255;
+    record.fold = static_cast<uint8_t>(FoldStrategy::NEAREST);
+    record.split = 127;
+    record.debounce = 255;
+    record.jitter = 255;
+    record.conflict = static_cast<uint8_t>(ConflictPolicy::NEUTRAL);
+    char line[PROTOCOL_MAX_LINE] = "set ";
+    const size_t length = formatSettings(record, line + 4, sizeof(line) - 4);
+    TEST_ASSERT_LESS_THAN(sizeof(line) - 5, length);
+
+    LineReader reader;
+    feedLine(reader, line);
+    TEST_ASSERT_FALSE(reader.overflow());
+    TEST_ASSERT_EQUAL_STRING(line, reader.line());
+
+    Command command;
+    TEST_ASSERT_TRUE(parseCommand(reader.line(), command));
+    TEST_ASSERT_TRUE(record == applySettingFields(SettingsRecord(), command));
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+int main()
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_parse_get);
+    RUN_TEST(test_parse_net);
+    RUN_TEST(test_parse_sources);
+    RUN_TEST(test_parse_power);
+    RUN_TEST(test_parse_loopback);
+    RUN_TEST(test_parse_map);
+    RUN_TEST(test_apply_map_command);
+    RUN_TEST(test_settings_commands_merge_into_live_settings);
+    RUN_TEST(test_parse_set_multiple_fields);
+    RUN_TEST(test_parse_set_rejects_whole_line_on_error);
+    RUN_TEST(test_parse_stream);
+    RUN_TEST(test_parse_unknown);
+    RUN_TEST(test_parse_latency);
+    RUN_TEST(test_parse_trace);
+    RUN_TEST(test_parse_play);
+    RUN_TEST(test_apply_setting_fields_keeps_unset_fields);
+    RUN_TEST(test_set_keeps_fields_changed_meanwhile);
+    RUN_TEST(test_format_settings);
+    RUN_TEST(test_format_telemetry);
+    RUN_TEST(test_format_latency);
+    RUN_TEST(test_format_playback_status);
+    RUN_TEST(test_format_network_midi_status);
+    RUN_TEST(test_format_midi_source_stats);
+    RUN_TEST(test_format_power_status);
+    RUN_TEST(test_format_key_binding);
+    RUN_TEST(test_line_reader);
+    RUN_TEST(test_line_reader_overflow);
+    RUN_TEST(test_worst_case_set_line_fits);
+    RUN_TEST(test_documented_set_example_fits);
+    RUN_TEST(test_get_reply_round_trips_as_set_line);
+
+    UNITY_END();
+}
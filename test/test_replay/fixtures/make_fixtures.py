@@ -0,0 +1,93 @@
+#!/usr/bin/env python3
+"""Generate the Standard MIDI File fixtures used by test_replay.
+
+Run from this directory; regenerate the golden traces afterwards with
+UPDATE_GOLDEN=1 pio test -e test -f test_replay
+"""
+
+import struct
+
+
+def var_len(value):
+    out = [value & 0x7F]
+    value >>= 7
+    while value:
+        out.insert(0, (value & 0x7F) | 0x80)
+        value >>= 7
+    return bytes(out)
+
+
+def track(events):
+    """events: list of (delta, bytes)"""
+    body = b"".join(var_len(delta) + data for delta, data in events)
+    body += var_len(0) + b"\xff\x2f\x00"
+    return b"MTrk" + struct.pack(">I", len(body)) + body
+
+
+def smf(fmt, division, tracks):
+    header = b"MThd" + struct.pack(">IHHH", 6, fmt, len(tracks), division)
+    return header + b"".join(tracks)
+
+
+def tempo(us_per_quarter):
+    return b"\xff\x51\x03" + us_per_quarter.to_bytes(3, "big")
+
+
+def scale():
+    """Format 0: two-octave C major scale with running status, a tempo change, out-of-range and black keys"""
+    events = [(0, tempo(500000)), (0, b"\xc0\x05"), (0, b"\xf0\x03\x7e\x7f\xf7")]
+    pitches = [48, 50, 52, 53, 55, 57, 59, 60, 62, 64, 65, 67, 69, 71, 72]
+    first = True
+    for pitch in pitches:
+        # note on (running status after the first), note off as velocity 0
+        events.append((0, (b"\x90" if first else b"") + bytes([pitch, 100])))
+        events.append((48, bytes([pitch, 0])))
+        first = False
+    events.append((0, tempo(1000000)))
+    events.append((0, b"\xe0\x00\x40"))
+    for pitch in [36, 49, 84, 47, 73]:
+        events.append((0, bytes([0x90, pitch, 90])))
+        events.append((48, bytes([0x80, pitch, 0])))
+    return smf(0, 96, [track(events)])
+
+
+def sustain():
+    """Format 1: tempo track, pedal with re-press and a 7-note chord, plus a second melody track"""
+    conductor = track([(0, tempo(600000)), (0, b"\xff\x58\x04\x04\x02\x18\x08")])
+    piano = track([
+        (0, b"\xb0\x40\x7f"),  # pedal down
+        (0, b"\x90\x30\x64"),  # C3
+        (24, b"\x80\x30\x00"),  # released, held by pedal
+        (24, b"\x90\x30\x64"),  # re-press while sustained
+        (24, b"\x80\x30\x00"),
+        (24, b"\xb0\x40\x00"),  # pedal up
+        (24, b"\x90\x30\x64"),  # 7-note chord (running status)
+    ] + [(0, bytes([pitch, 0x64])) for pitch in [0x34, 0x37, 0x3C, 0x40, 0x43, 0x48]] + [
+        (96, b"\x80\x30\x00"),
+    ] + [(0, bytes([pitch, 0x00])) for pitch in [0x34, 0x37, 0x3C, 0x40, 0x43, 0x48]])
+    melody = track([
+        (12, b"\x91\x3e\x50"),
+        (36, b"\x81\x3e\x00"),
+        (12, b"\x91\x41\x50"),
+        (36, b"\x81\x41\x00"),
+    ])
+    return smf(1, 96, [conductor, piano, melody])
+
+
+def melody_d():
+    """Format 1: D major melody over a bass line, for the key estimator"""
+    melody = []
+    for pitch in [62, 66, 69, 74, 73, 71, 69, 67, 66, 64, 62, 69, 71, 73, 74, 69, 66, 62]:
+        melody.append((0, bytes([0x90, pitch, 90])))
+        melody.append((48, bytes([0x80, pitch, 0])))
+    bass = []
+    for pitch in [38, 45, 43, 45, 38, 43, 45, 38, 45]:
+        bass.append((0, bytes([0x91, pitch, 70])))
+        bass.append((96, bytes([0x81, pitch, 0])))
+    return smf(1, 96, [track([(0, tempo(500000))]), track(melody), track(bass)])
+
+
+if __name__ == "__main__":
+    for name, data in [("scale.mid", scale()), ("sustain.mid", sustain()), ("melody-d.mid", melody_d())]:
+        with open(name, "wb") as f:
+            f.write(data)
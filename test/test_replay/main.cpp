@@ -0,0 +1,289 @@
+#include <unity.h>
+
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "replay.h"
+
+// Standard MIDI File replay tests
+//
+// Golden traces live next to the fixtures. After an intended behavior change, regenerate them with
+//   UPDATE_GOLDEN=1 pio test -e test -f test_replay
+// and review the diff. On mismatch the actual trace is written to <golden>.actual.
+//
+// Any song can be replayed with
+//   REPLAY_FILE=song.mid pio test -e test -f test_replay -v
+// which prints its trace. Optional: REPLAY_BASE_NOTE=50, REPLAY_EXPAND=1, REPLAY_SUSTAIN=1 and
+// REPLAY_SPEED (0 = unpaced, 1 = real time, 2 = double speed).
+
+static constexpr const char* FIXTURES = "test/test_replay/fixtures/";
+
+static HostHal* hal = nullptr;
+
+static std::string readFile(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    std::stringstream content;
+    content << file.rdbuf();
+    return content.str();
+}
+
+static void writeFile(const std::string& path, const std::string& content)
+{
+    std::ofstream file(path, std::ios::binary);
+    file << content;
+}
+
+static void replayFile(const std::string& path, const ReplayOptions& options, std::string& trace,
+                       ReplayStats& stats)
+{
+    FileSmfSource source(path.c_str());
+    SmfReader reader;
+    TEST_ASSERT_TRUE(source.isOpen());
+    TEST_ASSERT_TRUE(reader.open(source));
+    Replay replay(*hal, options);
+    stats = replay.run(reader, trace);
+}
+
+static void checkGolden(const char* fixture, const ReplayOptions& options, const char* golden)
+{
+    std::string trace;
+    ReplayStats stats;
+    replayFile(std::string(FIXTURES) + fixture, options, trace, stats);
+
+    const std::string goldenPath = std::string(FIXTURES) + golden;
+    if (getenv("UPDATE_GOLDEN") != nullptr) {
+        writeFile(goldenPath, trace);
+        return;
+    }
+    const std::string expected = readFile(goldenPath);
+    if (trace != expected) {
+        writeFile(goldenPath + ".actual", trace);
+    }
+    TEST_ASSERT_EQUAL_STRING(expected.c_str(), trace.c_str());
+}
+
+void setUp()
+{
+    hal = new HostHal();
+    hal->install();
+}
+
+void tearDown()
+{
+    delete hal;
+    hal = nullptr;
+}
+
+void test_smf_reader_running_status_and_tempo()
+{
+    const uint8_t smf[] = {
+        'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 0, 0, 1, 0, 96,
+        'M', 'T', 'r', 'k', 0, 0, 0, 23,
+        0x00, 0x90, 60, 100, // note on at 0
+        0x60, 60, 0, // running status, one quarter later (500 ms)
+        0x00, 0xFF, 0x51, 0x03, 0x0F, 0x42, 0x40, // tempo 1 s per quarter
+        0x30, 0xC0, 5, // program change, half a quarter later (500 ms)
+        0x00, 0xFF, 0x2F, 0x00,
+    };
+    MemorySmfSource source(smf, sizeof(smf));
+    SmfReader reader;
+    TEST_ASSERT_TRUE(reader.open(source));
+    TEST_ASSERT_EQUAL(0, reader.getFormat());
+    TEST_ASSERT_EQUAL(1, reader.getTrackCount());
+
+    SmfEvent event;
+    TEST_ASSERT_TRUE(reader.next(event));
+    TEST_ASSERT_EQUAL(3, event.size);
+    TEST_ASSERT_EQUAL(0x90, event.data[0]);
+    TEST_ASSERT_EQUAL(0, event.timeUs);
+
+    TEST_ASSERT_TRUE(reader.next(event));
+    TEST_ASSERT_EQUAL(0x90, event.data[0]);
+    TEST_ASSERT_EQUAL(60, event.data[1]);
+    TEST_ASSERT_EQUAL(0, event.data[2]);
+    TEST_ASSERT_EQUAL(96, event.tick);
+    TEST_ASSERT_EQUAL(500000, event.timeUs);
+
+    TEST_ASSERT_TRUE(reader.next(event));
+    TEST_ASSERT_EQUAL(2, event.size);
+    TEST_ASSERT_EQUAL(0xC0, event.data[0]);
+    TEST_ASSERT_EQUAL(1000000, event.timeUs);
+
+    TEST_ASSERT_FALSE(reader.next(event));
+}
+
+void test_smf_reader_merges_tracks()
+{
+    FileSmfSource source((std::string(FIXTURES) + "sustain.mid").c_str());
+    SmfReader reader;
+    TEST_ASSERT_TRUE(reader.open(source));
+    TEST_ASSERT_EQUAL(1, reader.getFormat());
+    TEST_ASSERT_EQUAL(3, reader.getTrackCount());
+
+    SmfEvent event;
+    uint32_t previousTick = 0;
+    int events = 0;
+    int channel2 = 0;
+    while (reader.next(event)) {
+        TEST_ASSERT_TRUE(event.tick >= previousTick);
+        previousTick = event.tick;
+        if ((event.data[0] & 0x0F) == 1) {
+            channel2++;
+        }
+        events++;
+    }
+    TEST_ASSERT_EQUAL(24, events);
+    TEST_ASSERT_EQUAL(4, channel2);
+}
+
+void test_smf_reader_truncated_and_invalid()
+{
+    const uint8_t truncated[] = {
+        'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 0, 0, 1, 0, 96,
+        'M', 'T', 'r', 'k', 0, 0, 0, 100,
+        0x00, 0x90, 60, 100,
+        0x10, 0x80, 60,
+    };
+    MemorySmfSource source(truncated, sizeof(truncated));
+    SmfReader reader;
+    TEST_ASSERT_TRUE(reader.open(source));
+    SmfEvent event;
+    TEST_ASSERT_TRUE(reader.next(event));
+    TEST_ASSERT_FALSE(reader.next(event));
+
+    // Format 2 is not supported
+    const uint8_t format2[] = {'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 2, 0, 1, 0, 96};
+    MemorySmfSource format2Source(format2, sizeof(format2));
+    TEST_ASSERT_FALSE(reader.open(format2Source));
+
+    const uint8_t garbage[] = {'R', 'I', 'F', 'F', 0, 0, 0, 6, 0, 0, 0, 1, 0, 96};
+    MemorySmfSource garbageSource(garbage, sizeof(garbage));
+    TEST_ASSERT_FALSE(reader.open(garbageSource));
+}
+
+void test_golden_scale()
+{
+    ReplayOptions options;
+    checkGolden("scale.mid", options, "scale.trace");
+}
+
+void test_golden_scale_expand()
+{
+    ReplayOptions options;
+    options.expand = true;
+    checkGolden("scale.mid", options, "scale-expand.trace");
+}
+
+void test_golden_scale_transpose()
+{
+    ReplayOptions options;
+    options.baseNote = 50;
+    checkGolden("scale.mid", options, "scale-transpose.trace");
+}
+
+void test_golden_sustain()
+{
+    ReplayOptions options;
+    options.sustain = true;
+    checkGolden("sustain.mid", options, "sustain.trace");
+}
+
+void test_golden_sustain_off()
+{
+    ReplayOptions options;
+    checkGolden("sustain.mid", options, "sustain-off.trace");
+}
+
+void test_key_estimate_from_file()
+{
+    std::string trace;
+    ReplayStats stats;
+    replayFile(std::string(FIXTURES) + "melody-d.mid", ReplayOptions(), trace, stats);
+
+    // Estimated from the Note Ons seen by the MIDI layer
+    KeyEstimate estimate;
+    TEST_ASSERT_TRUE(getKeyEstimator().update(estimate));
+    TEST_ASSERT_TRUE(estimate.valid);
+    TEST_ASSERT_EQUAL_STRING("D", getKeyName(estimate.tonic, estimate.minor));
+    TEST_ASSERT_EQUAL(50, KeyEstimator::suggestBaseNote(estimate, BASENOTE_MIN, BASENOTE_MAX));
+    TEST_ASSERT_TRUE(KeyEstimator::shouldApply(estimate, 48));
+}
+
+void test_replay_throughput()
+{
+    // Wall time is printed for comparison only; the counts are what the fixtures must produce
+    static const struct
+    {
+        const char* fixture;
+        unsigned long events;
+        unsigned long reports;
+    } WORKLOADS[] = {
+        {"scale.mid", 42, 30},
+        {"sustain.mid", 24, 22},
+    };
+    for (const auto& workload : WORKLOADS) {
+        std::string trace;
+        ReplayStats stats;
+        replayFile(std::string(FIXTURES) + workload.fixture, ReplayOptions(), trace, stats);
+        printf("{\"bench\":\"replay\",\"workload\":\"%s\",\"events\":%lu,\"reports\":%lu,"
+               "\"song_ms\":%llu,\"wall_us\":%.1f}\n",
+               workload.fixture, static_cast<unsigned long>(stats.events), static_cast<unsigned long>(stats.reports),
+               static_cast<unsigned long long>(stats.songUs / 1000), stats.wallSeconds * 1e6);
+        TEST_ASSERT_EQUAL(workload.events, stats.events);
+        TEST_ASSERT_EQUAL(workload.reports, stats.reports);
+    }
+}
+
+void test_replay_file_from_environment()
+{
+    const char* path = getenv("REPLAY_FILE");
+    if (path == nullptr) {
+        TEST_IGNORE_MESSAGE("REPLAY_FILE not set");
+    }
+
+    ReplayOptions options;
+    if (const char* value = getenv("REPLAY_BASE_NOTE")) {
+        options.baseNote = atoi(value);
+    }
+    options.expand = getenv("REPLAY_EXPAND") != nullptr && atoi(getenv("REPLAY_EXPAND")) != 0;
+    options.sustain = getenv("REPLAY_SUSTAIN") != nullptr && atoi(getenv("REPLAY_SUSTAIN")) != 0;
+    if (const char* value = getenv("REPLAY_SPEED")) {
+        options.speed = atof(value);
+    }
+
+    std::string trace;
+    ReplayStats stats;
+    replayFile(path, options, trace, stats);
+    printf("%s", trace.c_str());
+    printf("# events %lu reports %lu song %llu ms wall %.3f s\n",
+           static_cast<unsigned long>(stats.events), static_cast<unsigned long>(stats.reports),
+           static_cast<unsigned long long>(stats.songUs / 1000), stats.wallSeconds);
+
+    KeyEstimate estimate;
+    getKeyEstimator().update(estimate);
+    printf("# key %s, suggested base note %d (%.0f%% of recent notes on keys)\n",
+           getKeyName(estimate.tonic, estimate.minor),
+           KeyEstimator::suggestBaseNote(estimate, BASENOTE_MIN, BASENOTE_MAX), estimate.coverage * 100);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_smf_reader_running_status_and_tempo);
+    RUN_TEST(test_smf_reader_merges_tracks);
+    RUN_TEST(test_smf_reader_truncated_and_invalid);
+    RUN_TEST(test_golden_scale);
+    RUN_TEST(test_golden_scale_expand);
+    RUN_TEST(test_golden_scale_transpose);
+    RUN_TEST(test_golden_sustain);
+    RUN_TEST(test_golden_sustain_off);
+    RUN_TEST(test_key_estimate_from_file);
+    RUN_TEST(test_replay_throughput);
+    RUN_TEST(test_replay_file_from_environment);
+
+    return UNITY_END();
+}
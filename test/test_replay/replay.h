@@ -0,0 +1,189 @@
+#if !defined(TEST_REPLAY_H)
+#define TEST_REPLAY_H
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+#include "app/hal-host.h"
+#include "app/midi.h"
+#include "app/notes.h"
+#include "app/output.h"
+#include "app/report.h"
+#include "app/settings.h"
+#include "app/smf-reader.h"
+
+// Standard MIDI File replay through the firmware pipeline
+//
+// Events are streamed from the file into the MIDI serial stand-in at their song time on the fake clock, with
+// the output task emulated by a runOutput() after each message and every OUTPUT_REFRESH_MS in between.
+// Each report becomes one trace line:
+//   <song time ms> notes <15 keys> report <15 keys>
+// where "notes" is what the output task sent and "report" what a backend keeps after voice stealing.
+
+// Simultaneous keys kept by the backends (MAX_SIMULTANEOUS_NOTES)
+static constexpr int REPLAY_MAX_SIMULTANEOUS_NOTES = 5;
+
+class FileSmfSource final : public SmfSource
+{
+public:
+    explicit FileSmfSource(const char* path) : file(fopen(path, "rb")) {}
+
+    ~FileSmfSource() override
+    {
+        if (file != nullptr) {
+            fclose(file);
+        }
+    }
+
+    bool isOpen() const { return file != nullptr; }
+
+    size_t readAt(const uint32_t offset, uint8_t* buffer, const size_t size) override
+    {
+        if (file == nullptr || fseek(file, offset, SEEK_SET) != 0) {
+            return 0;
+        }
+        return fread(buffer, 1, size, file);
+    }
+
+private:
+    FILE* file;
+};
+
+struct ReplayOptions
+{
+    int mapping = 1;
+    int baseNote = 48;
+    bool expand = false;
+    bool sustain = false;
+
+    // Wall-clock pacing: 0 = as fast as possible, 1 = real time, 2 = double speed, ...
+    double speed = 0;
+};
+
+struct ReplayStats
+{
+    uint32_t events = 0;
+    uint32_t reports = 0;
+    uint64_t songUs = 0;
+    double wallSeconds = 0;
+};
+
+// Sky key grid as text (rows of 5 separated by '|')
+inline std::string formatKeys(const Notes15& notes15)
+{
+    std::string text;
+    for (int i = 0; i < 15; i++) {
+        if (i > 0 && i % 5 == 0) {
+            text += '|';
+        }
+        text += notes15.get(i) != 0 ? 'x' : '.';
+    }
+    return text;
+}
+
+class Replay
+{
+public:
+    Replay(HostHal& hal, const ReplayOptions& options) : hal(hal), options(options) {}
+
+    /** Replay the whole song, appending trace lines */
+    ReplayStats run(SmfReader& reader, std::string& trace)
+    {
+        ReplayStats stats;
+
+        setupMIDI(0, 0);
+        Settings settings;
+        SettingsRecord record = settings.toRecord();
+        record.mapping = static_cast<uint8_t>(options.mapping);
+        record.baseNote = static_cast<uint8_t>(options.baseNote);
+        record.flags = (options.expand ? SettingsRecord::FLAG_EXPAND : 0) |
+            (options.sustain ? SettingsRecord::FLAG_SUSTAIN : 0);
+        settings.applyRecord(record);
+        OutputTableSettings table;
+        table.mapping = settings.getMapping();
+        table.baseNote = settings.getBaseNote();
+        table.expand = settings.getExpand();
+        setOutputTable(table);
+        refreshOutput();
+        runOutput();
+        hal.hid.reports.clear();
+
+        startUs = hal.clock.micros();
+        lastRunUs = startUs;
+        reported = 0;
+
+        const auto wallStart = std::chrono::steady_clock::now();
+        SmfEvent event;
+        while (reader.next(event)) {
+            if (options.speed > 0) {
+                const auto due = std::chrono::microseconds(static_cast<int64_t>(event.timeUs / options.speed));
+                std::this_thread::sleep_until(wallStart + due);
+            }
+
+            advanceTo(startUs + event.timeUs, trace);
+            hal.midiSerial.input.insert(hal.midiSerial.input.end(), event.data, event.data + event.size);
+            hal.midiSerial.output.clear(); // MIDI thru, not traced
+            while (hal.midiSerial.available() > 0) {
+                pollMIDI();
+            }
+            runOutput();
+            lastRunUs = hal.clock.micros();
+            flush(trace);
+
+            stats.events++;
+            stats.songUs = event.timeUs;
+        }
+
+        // Let pending re-presses settle
+        advanceTo(hal.clock.micros() + REPRESS_SETTLE_US, trace);
+
+        stats.reports = reported;
+        stats.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+        return stats;
+    }
+
+private:
+    static constexpr uint32_t REFRESH_US = OUTPUT_REFRESH_MS * 1000;
+    static constexpr uint32_t REPRESS_SETTLE_US = 100000;
+
+    /** Move the fake clock, running the periodic output refresh on the way */
+    void advanceTo(const uint64_t targetUs, std::string& trace)
+    {
+        while (lastRunUs + REFRESH_US <= targetUs) {
+            hal.clock.advanceMicros(static_cast<uint32_t>(lastRunUs + REFRESH_US - hal.clock.micros()));
+            runOutput();
+            lastRunUs = hal.clock.micros();
+            flush(trace);
+        }
+        if (targetUs > hal.clock.micros()) {
+            hal.clock.advanceMicros(static_cast<uint32_t>(targetUs - hal.clock.micros()));
+        }
+    }
+
+    void flush(std::string& trace)
+    {
+        for (const RecordingHid::Report& report : hal.hid.reports) {
+            const Notes15 kept = filter.latest(report.notes15, REPLAY_MAX_SIMULTANEOUS_NOTES);
+            const uint64_t timeUs = hal.clock.micros() - startUs;
+            char line[96];
+            snprintf(line, sizeof(line), "%llu.%03llu notes %s report %s\n",
+                     static_cast<unsigned long long>(timeUs / 1000),
+                     static_cast<unsigned long long>(timeUs % 1000),
+                     formatKeys(report.notes15).c_str(), formatKeys(kept).c_str());
+            trace += line;
+            reported++;
+        }
+        hal.hid.reports.clear();
+    }
+
+    HostHal& hal;
+    ReplayOptions options;
+    Notes15Filter filter;
+    uint64_t startUs = 0;
+    uint64_t lastRunUs = 0;
+    uint32_t reported = 0;
+};
+
+#endif // !defined(TEST_REPLAY_H)
@@ -0,0 +1,289 @@
+#include <unity.h>
+
+#include "app/report.h"
+#include "app/velocity-curve.h"
+
+// Gamepad state from the pressed keys: conflict policies of opposing directions and the compiled builder
+
+// Two keys per side of the L-stick X axis, the four DPad directions, and one key per side of the R-stick Y axis
+static const MappingEntry conflictMapping[15] = {
+    {ACTION_L_STICK, DIRECTION_LEFT, VelocityCurve::LINEAR},
+    {ACTION_L_STICK, DIRECTION_LEFT, VelocityCurve::LINEAR},
+    {ACTION_L_STICK, DIRECTION_RIGHT, VelocityCurve::LINEAR},
+    {ACTION_L_STICK, DIRECTION_RIGHT, VelocityCurve::LINEAR},
+    {ACTION_DPAD, DIRECTION_UP},
+    {ACTION_DPAD, DIRECTION_DOWN},
+    {ACTION_DPAD, DIRECTION_RIGHT},
+    {ACTION_DPAD, DIRECTION_LEFT},
+    {ACTION_R_STICK, DIRECTION_UP, VelocityCurve::LINEAR},
+    {ACTION_R_STICK, DIRECTION_DOWN, VelocityCurve::LINEAR},
+    {ACTION_L_TRIGGER, 1000},
+    {ACTION_L_TRIGGER, 500},
+    {ACTION_BUTTON, 1},
+    {ACTION_R_TRIGGER, 800, VelocityCurve::LINEAR},
+    {ACTION_BUTTON, 2},
+};
+
+static const ConflictPolicy POLICIES[] = {ConflictPolicy::LAST, ConflictPolicy::NEUTRAL, ConflictPolicy::FIRST};
+
+// Press times tried for each key of a group: released, then three instants (so ties occur)
+static constexpr int TIMES = 4;
+
+/** Distinct velocity per key, so that a stick level tells which key drove it */
+static uint8_t getKeyVelocity(const int key)
+{
+    return static_cast<uint8_t>(8 * (key + 1));
+}
+
+static Notes15 makeNotes(const unsigned long timestamps[15])
+{
+    uint8_t velocities[15];
+    for (int i = 0; i < 15; i++) {
+        velocities[i] = getKeyVelocity(i);
+    }
+    return Notes15(timestamps, velocities);
+}
+
+/** Set the press times of a group of keys from a combination number (base TIMES digits) */
+static void setTimes(unsigned long timestamps[15], const int firstKey, const int keyCount, int combination)
+{
+    for (int i = 0; i < keyCount; i++) {
+        timestamps[firstKey + i] = static_cast<unsigned long>(combination % TIMES);
+        combination /= TIMES;
+    }
+}
+
+/**
+ * Reference resolution of one axis, ordering all pressed keys of both sides by (time, index)
+ *
+ * @return key that drives the axis + 1, negated for the negative side, 0 if centered
+ */
+static int resolveReference(const unsigned long timestamps[15], const uint16_t negative, const uint16_t positive,
+                            const ConflictPolicy policy)
+{
+    int first = -1;
+    int last = -1;
+    bool negativePressed = false;
+    bool positivePressed = false;
+    for (int i = 0; i < 15; i++) {
+        if (timestamps[i] == 0 || ((negative | positive) & (1 << i)) == 0) {
+            continue;
+        }
+        negativePressed = negativePressed || (negative & (1 << i)) != 0;
+        positivePressed = positivePressed || (positive & (1 << i)) != 0;
+        // Equal times: the higher index counts as pressed later for LAST and as held first for FIRST
+        if (last < 0 || timestamps[i] >= timestamps[last]) {
+            last = i;
+        }
+        if (first < 0 || timestamps[i] <= timestamps[first]) {
+            first = i;
+        }
+    }
+    if (policy == ConflictPolicy::NEUTRAL && negativePressed && positivePressed) {
+        return 0;
+    }
+    const int key = policy == ConflictPolicy::FIRST ? first : last;
+    if (key < 0) {
+        return 0;
+    }
+    return (negative & (1 << key)) ? -(key + 1) : key + 1;
+}
+
+static int16_t getReferenceStick(const int resolved)
+{
+    if (resolved == 0) {
+        return 0;
+    }
+    const int key = (resolved > 0 ? resolved : -resolved) - 1;
+    const int level = getVelocityLevel(VelocityCurve::LINEAR, getKeyVelocity(key));
+    return static_cast<int16_t>(resolved > 0 ? level : -level);
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_conflict_policy_names()
+{
+    ConflictPolicy policy = ConflictPolicy::LAST;
+
+    TEST_ASSERT_TRUE(parseConflictPolicy("neutral", policy));
+    TEST_ASSERT_TRUE(policy == ConflictPolicy::NEUTRAL);
+    TEST_ASSERT_TRUE(parseConflictPolicy("first", policy));
+    TEST_ASSERT_TRUE(policy == ConflictPolicy::FIRST);
+    TEST_ASSERT_FALSE(parseConflictPolicy("bogus", policy));
+    TEST_ASSERT_TRUE(policy == ConflictPolicy::FIRST);
+    TEST_ASSERT_EQUAL_STRING("last", getConflictPolicyName(ConflictPolicy::LAST));
+    TEST_ASSERT_EQUAL_STRING("?", getConflictPolicyName(ConflictPolicy::COUNT));
+}
+
+void test_stick_all_combinations()
+{
+    ReportBuilder builder;
+    for (const ConflictPolicy policy : POLICIES) {
+        builder.compile(conflictMapping, policy);
+        // Keys 0-1 left, 2-3 right: every press order including ties and several keys on one side
+        for (int combination = 0; combination < TIMES * TIMES * TIMES * TIMES; combination++) {
+            unsigned long timestamps[15] = {};
+            setTimes(timestamps, 0, 4, combination);
+
+            const GamepadState state = builder.build(makeNotes(timestamps));
+            const int resolved = resolveReference(timestamps, 0x0003, 0x000C, policy);
+            TEST_ASSERT_EQUAL_MESSAGE(getReferenceStick(resolved), state.leftX, getConflictPolicyName(policy));
+            TEST_ASSERT_EQUAL(0, state.leftY);
+            TEST_ASSERT_EQUAL(0, state.rightX);
+            TEST_ASSERT_EQUAL(0, state.rightY);
+        }
+    }
+}
+
+void test_dpad_all_combinations()
+{
+    ReportBuilder builder;
+    for (const ConflictPolicy policy : POLICIES) {
+        builder.compile(conflictMapping, policy);
+        // Keys 4-7: up, down, right, left
+        for (int combination = 0; combination < TIMES * TIMES * TIMES * TIMES; combination++) {
+            unsigned long timestamps[15] = {};
+            setTimes(timestamps, 4, 4, combination);
+
+            const GamepadState state = builder.build(makeNotes(timestamps));
+            const int vertical = resolveReference(timestamps, 1 << 5, 1 << 4, policy);
+            const int horizontal = resolveReference(timestamps, 1 << 7, 1 << 6, policy);
+            TEST_ASSERT_EQUAL_MESSAGE(vertical > 0, state.dpad[0], getConflictPolicyName(policy));
+            TEST_ASSERT_EQUAL(vertical < 0, state.dpad[1]);
+            TEST_ASSERT_EQUAL(horizontal > 0, state.dpad[2]);
+            TEST_ASSERT_EQUAL(horizontal < 0, state.dpad[3]);
+            TEST_ASSERT_EQUAL(0, state.leftX);
+        }
+    }
+}
+
+void test_conflict_over_time()
+{
+    unsigned long timestamps[15] = {};
+    ReportBuilder last;
+    ReportBuilder neutral;
+    ReportBuilder first;
+    last.compile(conflictMapping, ConflictPolicy::LAST);
+    neutral.compile(conflictMapping, ConflictPolicy::NEUTRAL);
+    first.compile(conflictMapping, ConflictPolicy::FIRST);
+
+    // Hold R-stick up, then press down as well
+    timestamps[8] = 100;
+    timestamps[9] = 200;
+    TEST_ASSERT_TRUE(last.build(makeNotes(timestamps)).rightY < 0);
+    TEST_ASSERT_EQUAL(0, neutral.build(makeNotes(timestamps)).rightY);
+    TEST_ASSERT_TRUE(first.build(makeNotes(timestamps)).rightY > 0);
+
+    // Up pressed again (retrigger): now the latest
+    timestamps[8] = 300;
+    TEST_ASSERT_TRUE(last.build(makeNotes(timestamps)).rightY > 0);
+    TEST_ASSERT_TRUE(first.build(makeNotes(timestamps)).rightY < 0);
+
+    // Released: the remaining direction for every policy
+    timestamps[8] = 0;
+    TEST_ASSERT_TRUE(last.build(makeNotes(timestamps)).rightY < 0);
+    TEST_ASSERT_TRUE(neutral.build(makeNotes(timestamps)).rightY < 0);
+    TEST_ASSERT_TRUE(first.build(makeNotes(timestamps)).rightY < 0);
+}
+
+void test_triggers_and_buttons()
+{
+    unsigned long timestamps[15] = {};
+    timestamps[10] = 5;
+    timestamps[11] = 1;
+    timestamps[12] = 2;
+    timestamps[13] = 3;
+    ReportBuilder builder;
+    builder.compile(conflictMapping, ConflictPolicy::NEUTRAL);
+
+    const GamepadState state = builder.build(makeNotes(timestamps));
+
+    // Highest trigger key wins whatever the policy
+    TEST_ASSERT_EQUAL(500, state.leftTrigger);
+    TEST_ASSERT_EQUAL(scaleByLevel(800, getVelocityLevel(VelocityCurve::LINEAR, getKeyVelocity(13))),
+                      state.rightTrigger);
+    TEST_ASSERT_EQUAL_HEX16(1 << 12, state.buttonKeys);
+}
+
+void test_builder_recompiles_on_change()
+{
+    static const MappingEntry otherMapping[15] = {
+        {ACTION_BUTTON, 1},
+    };
+    ReportBuilder builder;
+    TEST_ASSERT_FALSE(builder.isCompiled(conflictMapping, ConflictPolicy::LAST));
+
+    builder.compile(conflictMapping, ConflictPolicy::LAST);
+    TEST_ASSERT_TRUE(builder.isCompiled(conflictMapping, ConflictPolicy::LAST));
+    TEST_ASSERT_FALSE(builder.isCompiled(conflictMapping, ConflictPolicy::FIRST));
+    TEST_ASSERT_FALSE(builder.isCompiled(otherMapping, ConflictPolicy::LAST));
+
+    // Nothing of the previous mapping is left
+    builder.compile(otherMapping, ConflictPolicy::LAST);
+    unsigned long timestamps[15] = {};
+    timestamps[0] = 1;
+    timestamps[2] = 2;
+    const GamepadState state = builder.build(makeNotes(timestamps));
+    TEST_ASSERT_EQUAL_HEX16(1 << 0, state.buttonKeys);
+    TEST_ASSERT_EQUAL(0, state.leftX);
+}
+
+void test_build_gamepad_state_matches_builder()
+{
+    ReportBuilder builder;
+    for (const ConflictPolicy policy : POLICIES) {
+        builder.compile(conflictMapping, policy);
+        for (int combination = 0; combination < TIMES * TIMES * TIMES; combination++) {
+            unsigned long timestamps[15] = {};
+            setTimes(timestamps, 8, 3, combination);
+            timestamps[2] = 2;
+            const Notes15 notes15 = makeNotes(timestamps);
+
+            const GamepadState expected = builder.build(notes15);
+            const GamepadState state = buildGamepadState(notes15, conflictMapping, policy);
+            TEST_ASSERT_EQUAL(expected.leftX, state.leftX);
+            TEST_ASSERT_EQUAL(expected.rightY, state.rightY);
+            TEST_ASSERT_EQUAL(expected.leftTrigger, state.leftTrigger);
+        }
+    }
+}
+
+void test_dpad_direction()
+{
+    // Index bits: up, down, right, left
+    static const DpadDirection EXPECTED[16] = {
+        DpadDirection::CENTERED, DpadDirection::UP, DpadDirection::DOWN, DpadDirection::CENTERED,
+        DpadDirection::RIGHT, DpadDirection::UP_RIGHT, DpadDirection::DOWN_RIGHT, DpadDirection::RIGHT,
+        DpadDirection::LEFT, DpadDirection::UP_LEFT, DpadDirection::DOWN_LEFT, DpadDirection::LEFT,
+        DpadDirection::CENTERED, DpadDirection::UP, DpadDirection::DOWN, DpadDirection::CENTERED,
+    };
+    for (int bits = 0; bits < 16; bits++) {
+        GamepadState state;
+        for (int i = 0; i < 4; i++) {
+            state.dpad[i] = (bits & (1 << i)) != 0;
+        }
+        TEST_ASSERT_EQUAL(static_cast<int>(EXPECTED[bits]), static_cast<int>(getDpadDirection(state)));
+    }
+}
+
+int main()
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_conflict_policy_names);
+    RUN_TEST(test_stick_all_combinations);
+    RUN_TEST(test_dpad_all_combinations);
+    RUN_TEST(test_conflict_over_time);
+    RUN_TEST(test_triggers_and_buttons);
+    RUN_TEST(test_builder_recompiles_on_change);
+    RUN_TEST(test_build_gamepad_state_matches_builder);
+    RUN_TEST(test_dpad_direction);
+
+    UNITY_END();
+}
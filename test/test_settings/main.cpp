@@ -0,0 +1,175 @@
+#include <cstring>
+#include <unity.h>
+#include "../src/app/note-mapping.h"
+#include "../src/app/report.h"
+#include "../src/app/settings-record.h"
+
+static SettingsRecord makeRecord()
+{
+    SettingsRecord record;
+    record.mapping = 2;
+    record.baseNote = 53;
+    record.flags = SettingsRecord::FLAG_SUSTAIN;
+    record.strum = 8;
+    record.fold = static_cast<uint8_t>(FoldStrategy::CLAMP);
+    record.split = 60;
+    record.debounce = 6;
+    record.jitter = 4;
+    record.conflict = static_cast<uint8_t>(ConflictPolicy::FIRST);
+    record.bindings.setNote(0, 72);
+    record.bindings.setAction(14, 3);
+    return record;
+}
+
+void test_settings_record_roundtrip()
+{
+    const SettingsRecord record = makeRecord();
+    uint8_t buffer[SETTINGS_RECORD_SIZE];
+
+    TEST_ASSERT_EQUAL(SETTINGS_RECORD_SIZE, encodeSettingsRecord(record, buffer, sizeof(buffer)));
+
+    SettingsRecord decoded;
+    TEST_ASSERT_TRUE(decodeSettingsRecord(buffer, sizeof(buffer), decoded));
+    TEST_ASSERT_EQUAL(2, decoded.mapping);
+    TEST_ASSERT_EQUAL(53, decoded.baseNote);
+    TEST_ASSERT_EQUAL(SettingsRecord::FLAG_SUSTAIN, decoded.flags);
+    TEST_ASSERT_EQUAL(8, decoded.strum);
+    TEST_ASSERT_EQUAL(static_cast<uint8_t>(FoldStrategy::CLAMP), decoded.fold);
+    TEST_ASSERT_EQUAL(60, decoded.split);
+    TEST_ASSERT_EQUAL(6, decoded.debounce);
+    TEST_ASSERT_EQUAL(4, decoded.jitter);
+    TEST_ASSERT_EQUAL(static_cast<uint8_t>(ConflictPolicy::FIRST), decoded.conflict);
+    TEST_ASSERT_EQUAL(72, decoded.bindings.getNote(0));
+    TEST_ASSERT_EQUAL(3, decoded.bindings.getAction(14));
+    TEST_ASSERT_TRUE(decoded == record);
+}
+
+void test_settings_record_buffer_too_small()
+{
+    uint8_t buffer[SETTINGS_RECORD_SIZE - 1];
+
+    TEST_ASSERT_EQUAL(0, encodeSettingsRecord(makeRecord(), buffer, sizeof(buffer)));
+}
+
+void test_settings_record_rejects_corruption()
+{
+    uint8_t buffer[SETTINGS_RECORD_SIZE];
+    encodeSettingsRecord(makeRecord(), buffer, sizeof(buffer));
+
+    SettingsRecord decoded;
+    for (size_t i = 0; i < sizeof(buffer); i++) {
+        uint8_t corrupted[SETTINGS_RECORD_SIZE];
+        memcpy(corrupted, buffer, sizeof(buffer));
+        corrupted[i] ^= 0x10;
+        TEST_ASSERT_FALSE(decodeSettingsRecord(corrupted, sizeof(corrupted), decoded));
+    }
+}
+
+void test_settings_record_rejects_truncated()
+{
+    uint8_t buffer[SETTINGS_RECORD_SIZE];
+    encodeSettingsRecord(makeRecord(), buffer, sizeof(buffer));
+
+    SettingsRecord decoded;
+    for (size_t length = 0; length < sizeof(buffer); length++) {
+        TEST_ASSERT_FALSE(decodeSettingsRecord(buffer, length, decoded));
+    }
+}
+
+void test_settings_record_shorter_payload_keeps_defaults()
+{
+    // Record with only the mapping field
+    uint8_t buffer[5] = {SETTINGS_RECORD_MAGIC, SETTINGS_RECORD_VERSION, 1, 2, 0};
+    buffer[4] = settingsRecordCrc8(buffer, 4);
+
+    SettingsRecord decoded;
+    decoded.baseNote = 48;
+    decoded.flags = SettingsRecord::FLAG_EXPAND;
+    TEST_ASSERT_TRUE(decodeSettingsRecord(buffer, sizeof(buffer), decoded));
+    TEST_ASSERT_EQUAL(2, decoded.mapping);
+    TEST_ASSERT_EQUAL(48, decoded.baseNote);
+    TEST_ASSERT_EQUAL(SettingsRecord::FLAG_EXPAND, decoded.flags);
+}
+
+void test_settings_record_version_1_without_strum()
+{
+    // Record written before the strum field existed
+    uint8_t buffer[7] = {SETTINGS_RECORD_MAGIC, SETTINGS_RECORD_VERSION, 3, 2, 53, SettingsRecord::FLAG_EXPAND, 0};
+    buffer[6] = settingsRecordCrc8(buffer, 6);
+
+    SettingsRecord decoded;
+    TEST_ASSERT_TRUE(decodeSettingsRecord(buffer, sizeof(buffer), decoded));
+    TEST_ASSERT_EQUAL(53, decoded.baseNote);
+    TEST_ASSERT_EQUAL(0, decoded.strum);
+}
+
+void test_settings_record_version_1_without_fold()
+{
+    // Record written before the fold fields existed: expand keeps folding to the nearest octave
+    uint8_t buffer[8] = {SETTINGS_RECORD_MAGIC, SETTINGS_RECORD_VERSION, 4, 2, 53, SettingsRecord::FLAG_EXPAND, 8, 0};
+    buffer[7] = settingsRecordCrc8(buffer, 7);
+
+    SettingsRecord decoded;
+    TEST_ASSERT_TRUE(decodeSettingsRecord(buffer, sizeof(buffer), decoded));
+    TEST_ASSERT_EQUAL(8, decoded.strum);
+    TEST_ASSERT_EQUAL(static_cast<uint8_t>(FoldStrategy::NEAREST), decoded.fold);
+    TEST_ASSERT_EQUAL(0, decoded.split);
+    TEST_ASSERT_EQUAL(0, decoded.debounce);
+    TEST_ASSERT_EQUAL(0, decoded.jitter);
+    TEST_ASSERT_TRUE(decoded.bindings == KeyBindings());
+    TEST_ASSERT_EQUAL(static_cast<uint8_t>(ConflictPolicy::LAST), decoded.conflict);
+}
+
+void test_settings_record_without_conflict()
+{
+    // Record written before the conflict policy existed: opposing directions keep going to the last pressed
+    SettingsRecord record = makeRecord();
+    record.conflict = static_cast<uint8_t>(ConflictPolicy::NEUTRAL);
+    uint8_t buffer[SETTINGS_RECORD_SIZE];
+    encodeSettingsRecord(record, buffer, sizeof(buffer));
+    const size_t size = SETTINGS_RECORD_SIZE - 1;
+    buffer[2] = static_cast<uint8_t>(buffer[2] - 1);
+    buffer[size - 1] = settingsRecordCrc8(buffer, size - 1);
+
+    SettingsRecord decoded;
+    TEST_ASSERT_TRUE(decodeSettingsRecord(buffer, size, decoded));
+    TEST_ASSERT_EQUAL(4, decoded.jitter);
+    TEST_ASSERT_EQUAL(3, decoded.bindings.getAction(14));
+    TEST_ASSERT_EQUAL(static_cast<uint8_t>(ConflictPolicy::LAST), decoded.conflict);
+}
+
+void test_settings_record_rejects_other_version()
+{
+    uint8_t buffer[SETTINGS_RECORD_SIZE];
+    encodeSettingsRecord(makeRecord(), buffer, sizeof(buffer));
+    buffer[1] = SETTINGS_RECORD_VERSION + 1;
+    buffer[SETTINGS_RECORD_SIZE - 1] = settingsRecordCrc8(buffer, SETTINGS_RECORD_SIZE - 1);
+
+    SettingsRecord decoded;
+    TEST_ASSERT_FALSE(decodeSettingsRecord(buffer, sizeof(buffer), decoded));
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+int main()
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_settings_record_roundtrip);
+    RUN_TEST(test_settings_record_buffer_too_small);
+    RUN_TEST(test_settings_record_rejects_corruption);
+    RUN_TEST(test_settings_record_rejects_truncated);
+    RUN_TEST(test_settings_record_shorter_payload_keeps_defaults);
+    RUN_TEST(test_settings_record_version_1_without_strum);
+    RUN_TEST(test_settings_record_version_1_without_fold);
+    RUN_TEST(test_settings_record_without_conflict);
+    RUN_TEST(test_settings_record_rejects_other_version);
+
+    UNITY_END();
+}
@@ -0,0 +1,238 @@
+#include <unity.h>
+
+#include <string>
+
+#include "app/hal-host.h"
+#include "app/midi-source.h"
+#include "app/midi.h"
+#include "app/output.h"
+#include "app/report.h"
+
+// Merged MIDI inputs: arrival ordering, note ownership and per-input counters
+
+static HostHal* hal = nullptr;
+
+static MidiMessage noteOn(const uint8_t note)
+{
+    MidiMessage message;
+    message.type = MidiType::NOTE_ON;
+    message.channel = 1;
+    message.data1 = note;
+    message.data2 = 100;
+    return message;
+}
+
+/** Run the MIDI task and the output once, and return the keys of the last report (0xFFFF if none was sent) */
+static uint16_t pollKeys()
+{
+    pollMIDI();
+    runOutput();
+    if (hal->hid.reports.empty()) {
+        return 0xFFFF;
+    }
+    return getPressedKeys(hal->hid.reports.back().notes15);
+}
+
+void setUp()
+{
+    hal = new HostHal();
+    hal->install();
+
+    setupMIDI(0, 0);
+    setSustainEnabled(false);
+    setDebounceGuard(0);
+    setOutputTable(OutputTableSettings());
+
+    // Start from an empty report
+    refreshOutput();
+    runOutput();
+    hal->hid.reports.clear();
+}
+
+void tearDown()
+{
+    delete hal;
+    hal = nullptr;
+}
+
+void test_merger_orders_by_arrival()
+{
+    MidiMerger merger;
+    merger.add(300, MidiSource::DIN, noteOn(60));
+    merger.add(100, MidiSource::DIN2, noteOn(61));
+    merger.add(200, MidiSource::DIN, noteOn(62));
+    merger.add(200, MidiSource::DIN2, noteOn(63));
+
+    std::string order;
+    merger.flush([&](const MidiMerger::Entry& entry) {
+        order += std::to_string(entry.message.data1) + getMidiSourceName(entry.source) + " ";
+    });
+
+    // Same arrival: the order of adding is kept
+    TEST_ASSERT_EQUAL_STRING("61din2 62din 63din2 60din ", order.c_str());
+    TEST_ASSERT_EQUAL(0, merger.size());
+}
+
+void test_merger_orders_across_wrap_around()
+{
+    MidiMerger merger;
+    merger.add(0x00000010, MidiSource::DIN, noteOn(60));
+    merger.add(0xFFFFFFF0, MidiSource::DIN2, noteOn(61));
+
+    std::string order;
+    merger.flush([&](const MidiMerger::Entry& entry) { order += std::to_string(entry.message.data1) + " "; });
+
+    TEST_ASSERT_EQUAL_STRING("61 60 ", order.c_str());
+}
+
+void test_merger_capacity()
+{
+    MidiMerger merger;
+    for (size_t i = 0; i < MidiMerger::CAPACITY + 1; i++) {
+        merger.add(static_cast<uint32_t>(i), MidiSource::DIN, noteOn(60));
+    }
+
+    TEST_ASSERT_TRUE(merger.isFull());
+    TEST_ASSERT_EQUAL(MidiMerger::CAPACITY, merger.size());
+}
+
+void test_ownership()
+{
+    NoteOwnership ownership;
+
+    TEST_ASSERT_TRUE(ownership.press(60, MidiSource::DIN));
+    TEST_ASSERT_FALSE(ownership.press(60, MidiSource::DIN));
+    TEST_ASSERT_TRUE(ownership.press(60, MidiSource::NETWORK));
+    TEST_ASSERT_EQUAL_HEX8(0x05, ownership.getOwners(60));
+
+    TEST_ASSERT_FALSE(ownership.release(60, MidiSource::DIN2));
+    TEST_ASSERT_TRUE(ownership.release(60, MidiSource::DIN));
+    TEST_ASSERT_TRUE(ownership.isHeld(60));
+    TEST_ASSERT_TRUE(ownership.release(60, MidiSource::NETWORK));
+    TEST_ASSERT_FALSE(ownership.isHeld(60));
+    TEST_ASSERT_EQUAL(0, ownership.getHeldCount(MidiSource::DIN));
+}
+
+void test_foreign_note_off_is_ignored()
+{
+    const MidiSourceStats before = getMidiSourceStats(MidiSource::DIN2);
+
+    hal->midiSerial.push({0x90, 48, 100});
+    TEST_ASSERT_EQUAL_HEX16(1 << 0, pollKeys());
+
+    // The second input never pressed the note
+    hal->midiSerial2.push({0x80, 48, 0});
+    pollMIDI();
+    runOutput();
+    TEST_ASSERT_EQUAL_HEX16(1 << 0, getPressedKeys(hal->hid.reports.back().notes15));
+    TEST_ASSERT_EQUAL(1, getMidiSourceStats(MidiSource::DIN2).foreignOffs - before.foreignOffs);
+
+    hal->midiSerial.push({0x80, 48, 0});
+    TEST_ASSERT_EQUAL_HEX16(0, pollKeys());
+}
+
+void test_note_held_until_last_owner_releases()
+{
+    hal->midiSerial.push({0x90, 48, 100});
+    hal->midiSerial2.push({0x90, 48, 100});
+    TEST_ASSERT_EQUAL_HEX16(1 << 0, pollKeys());
+    TEST_ASSERT_EQUAL(1, getMidiSourceStats(MidiSource::DIN).held);
+    TEST_ASSERT_EQUAL(1, getMidiSourceStats(MidiSource::DIN2).held);
+
+    hal->midiSerial2.push({0x80, 48, 0});
+    pollMIDI();
+    runOutput();
+    TEST_ASSERT_EQUAL_HEX16(1 << 0, getPressedKeys(hal->hid.reports.back().notes15));
+
+    hal->midiSerial.push({0x80, 48, 0});
+    TEST_ASSERT_EQUAL_HEX16(0, pollKeys());
+    TEST_ASSERT_EQUAL(0, getMidiSourceStats(MidiSource::DIN).held);
+    TEST_ASSERT_EQUAL(0, getMidiSourceStats(MidiSource::DIN2).held);
+}
+
+void test_playback_does_not_release_played_key()
+{
+    hal->midiSerial.push({0x90, 52, 100});
+    TEST_ASSERT_EQUAL_HEX16(1 << 2, pollKeys());
+
+    const uint8_t songOn[] = {0x90, 52, 90};
+    const uint8_t songOff[] = {0x80, 52, 0};
+    playMIDIMessage(songOn, sizeof(songOn), hal->clock.micros());
+    playMIDIMessage(songOff, sizeof(songOff), hal->clock.micros());
+    runOutput();
+    TEST_ASSERT_EQUAL_HEX16(1 << 2, getPressedKeys(hal->hid.reports.back().notes15));
+
+    hal->midiSerial.push({0x80, 52, 0});
+    TEST_ASSERT_EQUAL_HEX16(0, pollKeys());
+}
+
+void test_parsers_are_independent()
+{
+    // A Note On split across polls on the first input, a complete one on the second in between
+    hal->midiSerial.push({0x90, 48});
+    hal->midiSerial2.push({0x90, 52, 100});
+    TEST_ASSERT_EQUAL_HEX16(1 << 2, pollKeys());
+
+    hal->midiSerial.push({100});
+    TEST_ASSERT_EQUAL_HEX16((1 << 0) | (1 << 2), pollKeys());
+
+    // Running status stays with its input
+    hal->midiSerial2.push({55, 100});
+    hal->midiSerial.push({48, 0});
+    TEST_ASSERT_EQUAL_HEX16((1 << 2) | (1 << 4), pollKeys());
+}
+
+void test_each_input_echoes_its_own_bytes()
+{
+    hal->midiSerial.push({0x90, 48, 100});
+    hal->midiSerial2.push({0x90, 52, 100, 0xF8});
+    pollMIDI();
+
+    TEST_ASSERT_EQUAL(3, hal->midiSerial.output.size());
+    TEST_ASSERT_EQUAL(4, hal->midiSerial2.output.size());
+}
+
+void test_source_counters()
+{
+    MidiSourceStats before[static_cast<int>(MidiSource::COUNT)];
+    for (int i = 0; i < static_cast<int>(MidiSource::COUNT); i++) {
+        before[i] = getMidiSourceStats(static_cast<MidiSource>(i));
+    }
+
+    hal->midiSerial.push({0x90, 48, 100, 0xF8});
+    hal->midiSerial2.push({0x90, 52, 100, 52, 0});
+    pollMIDI();
+    const uint8_t networkOn[] = {0x90, 55, 100};
+    receiveNetworkMIDIMessage(networkOn, sizeof(networkOn), hal->clock.micros());
+
+    const MidiSourceStats din = getMidiSourceStats(MidiSource::DIN);
+    const MidiSourceStats din2 = getMidiSourceStats(MidiSource::DIN2);
+    const MidiSourceStats network = getMidiSourceStats(MidiSource::NETWORK);
+    TEST_ASSERT_EQUAL(4, din.bytes - before[0].bytes);
+    TEST_ASSERT_EQUAL(2, din.messages - before[0].messages);
+    TEST_ASSERT_EQUAL(1, din.held);
+    TEST_ASSERT_EQUAL(5, din2.bytes - before[1].bytes);
+    TEST_ASSERT_EQUAL(2, din2.messages - before[1].messages);
+    TEST_ASSERT_EQUAL(0, din2.held);
+    TEST_ASSERT_EQUAL(0, network.bytes - before[2].bytes);
+    TEST_ASSERT_EQUAL(1, network.messages - before[2].messages);
+    TEST_ASSERT_EQUAL(1, network.held);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_merger_orders_by_arrival);
+    RUN_TEST(test_merger_orders_across_wrap_around);
+    RUN_TEST(test_merger_capacity);
+    RUN_TEST(test_ownership);
+    RUN_TEST(test_foreign_note_off_is_ignored);
+    RUN_TEST(test_note_held_until_last_owner_releases);
+    RUN_TEST(test_playback_does_not_release_played_key);
+    RUN_TEST(test_parsers_are_independent);
+    RUN_TEST(test_each_input_echoes_its_own_bytes);
+    RUN_TEST(test_source_counters);
+
+    UNITY_END();
+}
@@ -0,0 +1,190 @@
+#include <unity.h>
+
+#include <cstdio>
+#include <string>
+
+#include "app/hal-host.h"
+#include "app/midi.h"
+#include "app/output.h"
+#include "app/report.h"
+#include "app/strum.h"
+
+// Chord strum stage: report timeline on the fake clock
+
+static HostHal* hal = nullptr;
+
+// Start of the test on the fake clock (microseconds)
+static uint32_t startUs = 0;
+
+static Notes15 makeNotes(const uint16_t keys, const unsigned long timestamp)
+{
+    unsigned long timestamps[15] = {};
+    for (int i = 0; i < 15; i++) {
+        if (keys & (1 << i)) {
+            timestamps[i] = timestamp;
+        }
+    }
+    return Notes15(timestamps);
+}
+
+// Reports sent so far as "<ms since start>:<keys hex>"
+static std::string timeline;
+
+/** Run the output stage and log the reports it sent */
+static void output()
+{
+    runOutput();
+    for (const RecordingHid::Report& report : hal->hid.reports) {
+        char entry[24];
+        snprintf(entry, sizeof(entry), "%s%lu:%x", timeline.empty() ? "" : " ",
+                 static_cast<unsigned long>((hal->clock.micros() - startUs) / 1000), getPressedKeys(report.notes15));
+        timeline += entry;
+    }
+    hal->hid.reports.clear();
+}
+
+static void pumpMIDI()
+{
+    while (hal->midiSerial.available() > 0) {
+        pollMIDI();
+    }
+    output();
+}
+
+/** Let time pass, running the output every millisecond (periodic refresh and timer wake-ups) */
+static void runFor(const unsigned long ms)
+{
+    for (unsigned long i = 0; i < ms; i++) {
+        hal->clock.advance(1);
+        output();
+    }
+}
+
+void setUp()
+{
+    hal = new HostHal();
+    hal->install();
+
+    setupMIDI(0, 0);
+    setSustainEnabled(false);
+    setOutputTable(OutputTableSettings());
+    setOutputStrum(0);
+    refreshOutput();
+    runOutput();
+    hal->hid.reports.clear();
+    startUs = hal->clock.micros();
+    timeline.clear();
+}
+
+void tearDown()
+{
+    delete hal;
+    hal = nullptr;
+}
+
+void test_scheduler_spaces_chord_lowest_key_first()
+{
+    StrumScheduler strum;
+    strum.setSpacing(8000);
+
+    const Notes15 chord = makeNotes(0x15, 100);
+    TEST_ASSERT_EQUAL_HEX16(0x01, getPressedKeys(strum.update(chord, 0)));
+    uint32_t delayUs = 0;
+    TEST_ASSERT_TRUE(strum.getNextDelay(0, delayUs));
+    TEST_ASSERT_EQUAL(8000, delayUs);
+
+    TEST_ASSERT_EQUAL_HEX16(0x01, getPressedKeys(strum.update(chord, 7999)));
+    TEST_ASSERT_EQUAL_HEX16(0x05, getPressedKeys(strum.update(chord, 8000)));
+    TEST_ASSERT_EQUAL_HEX16(0x15, getPressedKeys(strum.update(chord, 16000)));
+    TEST_ASSERT_FALSE(strum.getNextDelay(16000, delayUs));
+
+    // Timestamps are kept for the voice stealing filter of the backends
+    TEST_ASSERT_EQUAL(100, strum.update(chord, 16000).get(4));
+}
+
+void test_scheduler_bounds_total_spread()
+{
+    StrumScheduler strum;
+    strum.setSpacing(20000);
+
+    // Six keys at 20 ms would take 100 ms: the last ones are held back at most STRUM_MAX_SPREAD_MS
+    const Notes15 chord = makeNotes(0x3F, 100);
+    TEST_ASSERT_EQUAL_HEX16(0x01, getPressedKeys(strum.update(chord, 0)));
+    TEST_ASSERT_EQUAL_HEX16(0x03, getPressedKeys(strum.update(chord, 20000)));
+    TEST_ASSERT_EQUAL_HEX16(0x07, getPressedKeys(strum.update(chord, 40000)));
+    TEST_ASSERT_EQUAL_HEX16(0x07, getPressedKeys(strum.update(chord, STRUM_MAX_SPREAD_MS * 1000 - 1)));
+    TEST_ASSERT_EQUAL_HEX16(0x3F, getPressedKeys(strum.update(chord, STRUM_MAX_SPREAD_MS * 1000)));
+}
+
+void test_scheduler_release_before_turn_cancels_press()
+{
+    StrumScheduler strum;
+    strum.setSpacing(8000);
+
+    TEST_ASSERT_EQUAL_HEX16(0x01, getPressedKeys(strum.update(makeNotes(0x15, 100), 0)));
+
+    // Key 4 is released while queued, key 0 is released after being sent
+    TEST_ASSERT_EQUAL_HEX16(0x00, getPressedKeys(strum.update(makeNotes(0x04, 100), 4000)));
+    TEST_ASSERT_EQUAL_HEX16(0x04, strum.getQueuedKeys());
+    TEST_ASSERT_EQUAL_HEX16(0x04, getPressedKeys(strum.update(makeNotes(0x04, 100), 8000)));
+    TEST_ASSERT_EQUAL_HEX16(0x04, getPressedKeys(strum.update(makeNotes(0x04, 100), 30000)));
+    TEST_ASSERT_EQUAL_HEX16(0x00, strum.getQueuedKeys());
+}
+
+void test_scheduler_passes_through_without_spacing()
+{
+    StrumScheduler strum;
+
+    TEST_ASSERT_EQUAL_HEX16(0x15, getPressedKeys(strum.update(makeNotes(0x15, 100), 0)));
+    uint32_t delayUs = 0;
+    TEST_ASSERT_FALSE(strum.getNextDelay(0, delayUs));
+}
+
+void test_pipeline_report_timeline()
+{
+    setOutputStrum(8);
+
+    // C-E-G chord in one burst: keys 0, 2, 4 one report apart
+    hal->midiSerial.push({0x90, 48, 100, 52, 100, 55, 100});
+    pumpMIDI();
+    runFor(20);
+
+    // Releases are sent at once
+    hal->midiSerial.push({0x80, 52, 0});
+    pumpMIDI();
+    runFor(5);
+    hal->midiSerial.push({48, 0, 55, 0});
+    pumpMIDI();
+
+    // Chord of C and G where G is released before its turn: never pressed
+    runFor(10);
+    hal->midiSerial.push({0x90, 48, 100, 55, 100});
+    pumpMIDI();
+    runFor(3);
+    hal->midiSerial.push({0x80, 55, 0});
+    pumpMIDI();
+    runFor(20);
+
+    TEST_ASSERT_EQUAL_STRING("0:1 8:5 16:15 20:11 25:0 35:1", timeline.c_str());
+}
+
+void test_pipeline_without_strum_sends_chord_at_once()
+{
+    hal->midiSerial.push({0x90, 48, 100, 52, 100, 55, 100});
+    pumpMIDI();
+    runFor(20);
+
+    TEST_ASSERT_EQUAL_STRING("0:15", timeline.c_str());
+}
+
+int main(int argc, char** argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_scheduler_spaces_chord_lowest_key_first);
+    RUN_TEST(test_scheduler_bounds_total_spread);
+    RUN_TEST(test_scheduler_release_before_turn_cancels_press);
+    RUN_TEST(test_scheduler_passes_through_without_spacing);
+    RUN_TEST(test_pipeline_report_timeline);
+    RUN_TEST(test_pipeline_without_strum_sends_chord_at_once);
+    return UNITY_END();
+}
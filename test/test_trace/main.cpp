@@ -0,0 +1,128 @@
+#include <unity.h>
+
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "../src/app/trace.h"
+
+static TraceEntry storage[16];
+static TraceRing ring;
+
+void setUp()
+{
+    memset(storage, 0, sizeof(storage));
+    ring.attach(storage, 16);
+    ring.setEnabled(true);
+}
+
+void tearDown()
+{
+}
+
+void test_record_in_order()
+{
+    ring.record(TraceType::MIDI, 0x90, 60 | 100 << 8, 1000);
+    ring.record(TraceType::REPORT, 1, 0x0003, 1200);
+
+    TEST_ASSERT_EQUAL(2, ring.getRecorded());
+    TEST_ASSERT_EQUAL(0, ring.getOldest());
+    TEST_ASSERT_EQUAL(1000, ring.get(0).timeUs);
+    TEST_ASSERT_EQUAL(static_cast<int>(TraceType::MIDI), ring.get(0).type);
+    TEST_ASSERT_EQUAL(0x90, ring.get(0).value);
+    TEST_ASSERT_EQUAL(60 | 100 << 8, ring.get(0).keys);
+    TEST_ASSERT_EQUAL(static_cast<int>(TraceType::REPORT), ring.get(1).type);
+}
+
+void test_wraparound_keeps_newest()
+{
+    for (uint32_t i = 0; i < 40; i++) {
+        ring.record(TraceType::NOTES, 0, static_cast<uint16_t>(i), i);
+    }
+
+    TEST_ASSERT_EQUAL(40, ring.getRecorded());
+    TEST_ASSERT_EQUAL(24, ring.getOldest());
+    for (uint32_t i = ring.getOldest(); i < ring.getRecorded(); i++) {
+        TEST_ASSERT_EQUAL(i, ring.get(i).timeUs);
+    }
+
+    ring.clear();
+    TEST_ASSERT_EQUAL(0, ring.getRecorded());
+    TEST_ASSERT_EQUAL(0, ring.getOldest());
+}
+
+void test_disabled_and_detached()
+{
+    ring.setEnabled(false);
+    ring.record(TraceType::NOTES, 0, 1, 1);
+    TEST_ASSERT_EQUAL(0, ring.getRecorded());
+
+    TraceRing detached;
+    detached.record(TraceType::NOTES, 0, 1, 1);
+    TEST_ASSERT_EQUAL(0, detached.getRecorded());
+    TEST_ASSERT_EQUAL(0, detached.getCapacity());
+}
+
+void test_format_entries()
+{
+    const TraceEntry entries[] = {
+        {0x04030201, static_cast<uint8_t>(TraceType::FILTER), 2, 0x1F00},
+        {0xFFFFFFFF, static_cast<uint8_t>(TraceType::DROPPED), 0, 0x0001},
+    };
+    char buffer[TRACE_DUMP_ENTRIES_PER_LINE * 17 + 1];
+
+    const size_t length = formatTraceEntries(entries, 2, buffer, sizeof(buffer));
+    TEST_ASSERT_EQUAL_STRING("010203040302001f ffffffff05000100", buffer);
+    TEST_ASSERT_EQUAL(strlen(buffer), length);
+
+    // Entries that do not fit are left out
+    char small[20];
+    formatTraceEntries(entries, 2, small, sizeof(small));
+    TEST_ASSERT_EQUAL_STRING("010203040302001f", small);
+}
+
+void test_concurrent_writers_claim_unique_slots()
+{
+    static TraceEntry large[4096];
+    TraceRing shared;
+    shared.attach(large, 4096);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&shared, t]() {
+            for (uint32_t i = 0; i < 1000; i++) {
+                shared.record(TraceType::MIDI, static_cast<uint8_t>(t), static_cast<uint16_t>(i), i);
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    // Every entry of every writer is present exactly once
+    TEST_ASSERT_EQUAL(4000, shared.getRecorded());
+    int seen[4][1000] = {};
+    for (uint32_t i = 0; i < shared.getRecorded(); i++) {
+        const TraceEntry& entry = shared.get(i);
+        TEST_ASSERT_TRUE(entry.value < 4 && entry.keys < 1000);
+        seen[entry.value][entry.keys]++;
+    }
+    for (int t = 0; t < 4; t++) {
+        for (int i = 0; i < 1000; i++) {
+            TEST_ASSERT_EQUAL(1, seen[t][i]);
+        }
+    }
+}
+
+int main()
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_record_in_order);
+    RUN_TEST(test_wraparound_keeps_newest);
+    RUN_TEST(test_disabled_and_detached);
+    RUN_TEST(test_format_entries);
+    RUN_TEST(test_concurrent_writers_claim_unique_slots);
+
+    UNITY_END();
+}
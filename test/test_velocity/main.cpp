@@ -0,0 +1,214 @@
+#include <unity.h>
+
+#include "app/hal-host.h"
+#include "app/midi.h"
+#include "app/output.h"
+#include "app/report.h"
+#include "app/strum.h"
+#include "app/velocity-curve.h"
+
+// Note On velocity from the MIDI input to the analog levels of the report
+
+static HostHal* hal = nullptr;
+
+// Triggers on keys 0 and 1, sticks on keys 12-14, one entry per curve
+static const MappingEntry analogMapping[15] = {
+    {ACTION_L_TRIGGER, 1023, VelocityCurve::LINEAR},
+    {ACTION_R_TRIGGER, 1023},
+    {ACTION_BUTTON, 1},
+    {ACTION_BUTTON, 2},
+    {ACTION_BUTTON, 3},
+    {ACTION_BUTTON, 4},
+    {ACTION_BUTTON, 5},
+    {ACTION_BUTTON, 6},
+    {ACTION_BUTTON, 7},
+    {ACTION_BUTTON, 8},
+    {ACTION_BUTTON, 9},
+    {ACTION_BUTTON, 10},
+    {ACTION_L_STICK, DIRECTION_LEFT, VelocityCurve::SOFT},
+    {ACTION_R_STICK, DIRECTION_UP, VelocityCurve::HARD},
+    {ACTION_L_STICK, DIRECTION_DOWN, VelocityCurve::LINEAR},
+};
+
+static Notes15 makeNotes(const uint16_t keys, const uint8_t velocity)
+{
+    unsigned long timestamps[15] = {};
+    uint8_t velocities[15] = {};
+    for (int i = 0; i < 15; i++) {
+        if (keys & (1 << i)) {
+            timestamps[i] = 100 + i;
+            velocities[i] = velocity;
+        }
+    }
+    return Notes15(timestamps, velocities);
+}
+
+static void pumpMIDI()
+{
+    while (hal->midiSerial.available() > 0) {
+        pollMIDI();
+    }
+    runOutput();
+}
+
+void setUp()
+{
+    hal = new HostHal();
+    hal->install();
+
+    setupMIDI(0, 0);
+    setSustainEnabled(false);
+    setOutputTable(OutputTableSettings());
+    setOutputStrum(0);
+    refreshOutput();
+    runOutput();
+    hal->hid.reports.clear();
+}
+
+void tearDown()
+{
+    delete hal;
+    hal = nullptr;
+}
+
+void test_curve_tables()
+{
+    for (int curve = 0; curve < static_cast<int>(VelocityCurve::COUNT); curve++) {
+        const VelocityCurve velocityCurve = static_cast<VelocityCurve>(curve);
+        TEST_ASSERT_EQUAL(0, getVelocityLevel(velocityCurve, 0));
+        TEST_ASSERT_EQUAL(ANALOG_LEVEL_MAX, getVelocityLevel(velocityCurve, 127));
+        for (int velocity = 1; velocity < 127; velocity++) {
+            const int level = getVelocityLevel(velocityCurve, velocity);
+            TEST_ASSERT_TRUE(level >= 1);
+            TEST_ASSERT_TRUE(getVelocityLevel(velocityCurve, velocity + 1) >= level);
+        }
+    }
+
+    TEST_ASSERT_EQUAL(ANALOG_LEVEL_MAX, getVelocityLevel(VelocityCurve::FIXED, 1));
+    TEST_ASSERT_EQUAL(128, getVelocityLevel(VelocityCurve::LINEAR, 64));
+    TEST_ASSERT_EQUAL(193, getVelocityLevel(VelocityCurve::SOFT, 64));
+    TEST_ASSERT_EQUAL(64, getVelocityLevel(VelocityCurve::HARD, 64));
+    TEST_ASSERT_EQUAL(1, getVelocityLevel(VelocityCurve::HARD, 1));
+}
+
+void test_state_scales_triggers_and_sticks()
+{
+    const GamepadState state = buildGamepadState(makeNotes(0x7003, 64), analogMapping);
+
+    TEST_ASSERT_EQUAL(1023 * 128 / ANALOG_LEVEL_MAX, state.leftTrigger);
+    TEST_ASSERT_EQUAL(1023, state.rightTrigger);
+    TEST_ASSERT_EQUAL(-193, state.leftX);
+    TEST_ASSERT_EQUAL(-128, state.leftY);
+    TEST_ASSERT_EQUAL(0, state.rightX);
+    TEST_ASSERT_EQUAL(64, state.rightY);
+
+    // Backend ranges
+    TEST_ASSERT_EQUAL(-32768 * 193 / ANALOG_LEVEL_MAX, scaleStick(state.leftX, -32768, 0, 32767));
+    TEST_ASSERT_EQUAL(32767 * 64 / ANALOG_LEVEL_MAX, scaleStick(state.rightY, -32768, 0, 32767));
+    TEST_ASSERT_EQUAL(128 - 128 * 193 / ANALOG_LEVEL_MAX, scaleStick(state.leftX, 0, 128, 255));
+    TEST_ASSERT_EQUAL(128, scaleStick(state.rightX, 0, 128, 255));
+    TEST_ASSERT_EQUAL(-127, scaleStick(-ANALOG_LEVEL_MAX, -127, 0, 127));
+    TEST_ASSERT_EQUAL(127, scaleStick(ANALOG_LEVEL_MAX, -127, 0, 127));
+}
+
+void test_softest_press_still_moves_output()
+{
+    const GamepadState state = buildGamepadState(makeNotes(0x2001, 1), analogMapping);
+
+    TEST_ASSERT_EQUAL(8, state.leftTrigger);
+    TEST_ASSERT_EQUAL(1, state.rightY);
+    TEST_ASSERT_EQUAL(1, scaleByLevel(255, 1));
+    TEST_ASSERT_EQUAL(-1, scaleByLevel(-127, 1));
+    TEST_ASSERT_EQUAL(0, scaleByLevel(1023, 0));
+}
+
+void test_softest_press_moves_every_stick_range()
+{
+    // Lowest level of any curve: velocity 1 on HARD (LINEAR gives 2, still under one step of a 127 range)
+    const int16_t level = static_cast<int16_t>(getVelocityLevel(VelocityCurve::HARD, 1));
+    TEST_ASSERT_EQUAL(1, level);
+
+    // Bluetooth gamepad
+    TEST_ASSERT_EQUAL(128, scaleStick(level, -32768, 0, 32767));
+    TEST_ASSERT_EQUAL(-128, scaleStick(static_cast<int16_t>(-level), -32768, 0, 32767));
+    // USB gamepad
+    TEST_ASSERT_EQUAL(1, scaleStick(level, -127, 0, 127));
+    TEST_ASSERT_EQUAL(-1, scaleStick(static_cast<int16_t>(-level), -127, 0, 127));
+    TEST_ASSERT_EQUAL(1, scaleStick(static_cast<int16_t>(getVelocityLevel(VelocityCurve::LINEAR, 1)), -127, 0, 127));
+    // Nintendo Switch (X, and Y with the inverted range)
+    TEST_ASSERT_EQUAL(129, scaleStick(level, 0, 128, 255));
+    TEST_ASSERT_EQUAL(127, scaleStick(static_cast<int16_t>(-level), 0, 128, 255));
+    TEST_ASSERT_EQUAL(127, scaleStick(level, 255, 128, 0));
+    TEST_ASSERT_EQUAL(129, scaleStick(static_cast<int16_t>(-level), 255, 128, 0));
+
+    TEST_ASSERT_EQUAL(128, scaleStick(0, 0, 128, 255));
+}
+
+void test_filter_and_strum_keep_velocities()
+{
+    Notes15Filter filter;
+    const Notes15 latest = filter.latest(makeNotes(0x0007, 90), 2);
+    TEST_ASSERT_EQUAL(0, latest.getVelocity(0));
+    TEST_ASSERT_EQUAL(90, latest.getVelocity(1));
+    TEST_ASSERT_EQUAL(90, latest.getVelocity(2));
+
+    StrumScheduler strum;
+    strum.setSpacing(8000);
+    TEST_ASSERT_EQUAL(90, strum.update(makeNotes(0x0005, 90), 0).getVelocity(0));
+    TEST_ASSERT_EQUAL(90, strum.update(makeNotes(0x0005, 90), 8000).getVelocity(2));
+}
+
+void test_velocity_reaches_report()
+{
+    // C3 soft, E3 hard: keys 0 and 2
+    hal->midiSerial.push({0x90, 48, 20, 52, 110});
+    pumpMIDI();
+
+    TEST_ASSERT_EQUAL(1, hal->hid.reports.size());
+    const Notes15& notes15 = hal->hid.reports.back().notes15;
+    TEST_ASSERT_EQUAL(20, notes15.getVelocity(0));
+    TEST_ASSERT_EQUAL(0, notes15.getVelocity(1));
+    TEST_ASSERT_EQUAL(110, notes15.getVelocity(2));
+
+    // Replaying a held note with another velocity is a change on its own
+    hal->midiSerial.push({48, 90});
+    pumpMIDI();
+    TEST_ASSERT_EQUAL(2, hal->hid.reports.size());
+    TEST_ASSERT_EQUAL(90, hal->hid.reports.back().notes15.getVelocity(0));
+
+    // Released keys carry no velocity
+    hal->midiSerial.push({0x80, 48, 0});
+    pumpMIDI();
+    TEST_ASSERT_EQUAL(0, hal->hid.reports.back().notes15.getVelocity(0));
+}
+
+void test_folded_key_takes_velocity_of_latest_note()
+{
+    OutputTableSettings table;
+    table.expand = true;
+    setOutputTable(table);
+    runOutput();
+    hal->hid.reports.clear();
+
+    // C3 then C2 (folded onto the same key): the later note decides
+    hal->midiSerial.push({0x90, 48, 30});
+    pumpMIDI();
+    hal->clock.advance(1);
+    hal->midiSerial.push({36, 100});
+    pumpMIDI();
+
+    TEST_ASSERT_EQUAL(100, hal->hid.reports.back().notes15.getVelocity(0));
+}
+
+int main(int argc, char** argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_curve_tables);
+    RUN_TEST(test_state_scales_triggers_and_sticks);
+    RUN_TEST(test_softest_press_still_moves_output);
+    RUN_TEST(test_softest_press_moves_every_stick_range);
+    RUN_TEST(test_filter_and_strum_keep_velocities);
+    RUN_TEST(test_velocity_reaches_report);
+    RUN_TEST(test_folded_key_takes_velocity_of_latest_note);
+    return UNITY_END();
+}
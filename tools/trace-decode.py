@@ -0,0 +1,100 @@
+#!/usr/bin/env python3
+"""Decode a `trace` dump from the serial log into a timeline.
+
+Usage:
+    pio device monitor | tee session.log    # then send "trace" to the device
+    python3 tools/trace-decode.py session.log
+
+Each entry is 8 little-endian bytes: time (us, uint32), type, value, keys (uint16).
+Key masks are shown as the 3x5 Sky key grid (rows separated by '|').
+"""
+
+import struct
+import sys
+
+TYPES = {1: 'midi', 2: 'notes', 3: 'filter', 4: 'report', 5: 'dropped'}
+
+NOTE_NAMES = ['C', 'C#', 'D', 'D#', 'E', 'F', 'F#', 'G', 'G#', 'A', 'A#', 'B']
+
+
+def format_keys(keys):
+    grid = ''.join('x' if keys & (1 << i) else '.' for i in range(15))
+    return '|'.join(grid[i:i + 5] for i in range(0, 15, 5))
+
+
+def format_note(number):
+    return '%s%d' % (NOTE_NAMES[number % 12], number // 12 - 1)
+
+
+def format_midi(status, keys):
+    data1 = keys & 0xFF
+    data2 = keys >> 8
+    kind = status & 0xF0
+    channel = (status & 0x0F) + 1
+    if kind == 0x90:
+        return 'ch%-2d note on  %-4s vel %d' % (channel, format_note(data1), data2)
+    if kind == 0x80:
+        return 'ch%-2d note off %-4s' % (channel, format_note(data1))
+    if kind == 0xB0:
+        return 'ch%-2d cc %d = %d' % (channel, data1, data2)
+    if kind == 0xC0:
+        return 'ch%-2d program %d' % (channel, data1)
+    if kind == 0xE0:
+        return 'ch%-2d pitch bend %d' % (channel, (data1 | data2 << 7) - 8192)
+    if kind == 0xA0 or kind == 0xD0:
+        return 'ch%-2d pressure %d %d' % (channel, data1, data2)
+    return 'system %02x %02x' % (status, keys & 0xFF)
+
+
+def format_entry(kind, value, keys):
+    name = TYPES.get(kind, 'type%d' % kind)
+    if kind == 1:
+        return '%-8s%s' % (name, format_midi(value, keys))
+    if kind == 2:
+        return '%-8s%s  %d pressed' % (name, format_keys(keys), value)
+    if kind == 3:
+        return '%-8s%s  %d dropped' % (name, format_keys(keys), value)
+    if kind == 4:
+        return '%-8s%s  mapping %d' % (name, format_keys(keys), value)
+    return '%-8s%s' % (name, format_keys(keys))
+
+
+def read_entries(lines):
+    entries = []
+    for line in lines:
+        tokens = line.split()
+        if len(tokens) < 2 or tokens[0] != 'trace':
+            continue
+        if tokens[1] == 'begin':
+            # Keep only the last dump of the log
+            entries = []
+            print('#', ' '.join(tokens[2:]))
+            continue
+        if tokens[1] == 'end':
+            continue
+        for token in tokens[1:]:
+            if len(token) == 16:
+                entries.append(struct.unpack('<IBBH', bytes.fromhex(token)))
+    return entries
+
+
+def main():
+    if len(sys.argv) > 2:
+        sys.exit(__doc__)
+    with open(sys.argv[1]) if len(sys.argv) == 2 else sys.stdin as source:
+        entries = read_entries(source)
+    if not entries:
+        sys.exit('no trace entries found')
+
+    start = entries[0][0]
+    previous = start
+    for time_us, kind, value, keys in entries:
+        # Times are 32-bit microseconds and wrap every ~71 minutes
+        elapsed = (time_us - start) & 0xFFFFFFFF
+        delta = (time_us - previous) & 0xFFFFFFFF
+        previous = time_us
+        print('%10.3f ms  +%8.3f  %s' % (elapsed / 1000, delta / 1000, format_entry(kind, value, keys)))
+
+
+if __name__ == '__main__':
+    main()